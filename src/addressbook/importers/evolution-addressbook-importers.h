@@ -18,6 +18,10 @@
  */
 
 #include <gtk/gtk.h>
+#include <libebook/libebook.h>
+
+/* how many contacts the importers add to the book in one call */
+#define EVOLUTION_CONTACT_IMPORTER_BATCH_SIZE 100
 
 struct _EImportImporter *evolution_ldif_importer_peek (void);
 struct _EImportImporter *evolution_vcard_importer_peek (void);
@@ -25,5 +29,9 @@ struct _EImportImporter *evolution_csv_outlook_importer_peek (void);
 struct _EImportImporter *evolution_csv_mozilla_importer_peek (void);
 struct _EImportImporter *evolution_csv_evolution_importer_peek (void);
 
-/* private utility function for importers only */
+/* private utility functions for importers only */
 GtkWidget *evolution_contact_importer_get_preview_widget (const GSList *contacts);
+gboolean evolution_contact_importer_add_contacts_sync (EBookClient *book_client,
+						       GSList *contacts,
+						       GCancellable *cancellable,
+						       GError **error);
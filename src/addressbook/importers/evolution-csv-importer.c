@@ -55,7 +55,9 @@ typedef struct {
 
 	guint idle_id;
 
-	gint state;
+	GCancellable *cancellable;
+	gint progress;		/* percent, updated by the import thread */
+
 	FILE *file;
 	gulong size;
 	gint count;
@@ -65,13 +67,12 @@ typedef struct {
 	GHashTable *fields_map;
 
 	EBookClient *book_client;
-	GSList *contacts;
 } CSVImporter;
 
 static gint importer;
 static gchar delimiter;
 
-static void csv_import_done (CSVImporter *gci);
+static void csv_import_done (CSVImporter *gci, const GError *error);
 
 typedef struct {
 	const gchar *csv_attribute;
@@ -767,36 +768,80 @@ getNextCSVEntry (CSVImporter *gci,
 	return contact;
 }
 
-static gboolean
-csv_import_contacts (gpointer d)
+static void
+csv_import_thread (GTask *task,
+                   gpointer source_object,
+                   gpointer task_data,
+                   GCancellable *cancellable)
 {
-	CSVImporter *gci = d;
-	EContact *contact = NULL;
-
-	while ((contact = getNextCSVEntry (gci, gci->file))) {
-		gchar *uid = NULL;
-
-		e_book_client_add_contact_sync (
-			gci->book_client, contact, E_BOOK_OPERATION_FLAG_NONE, &uid, NULL, NULL);
-		if (uid != NULL) {
-			e_contact_set (contact, E_CONTACT_UID, uid);
-			g_free (uid);
+	CSVImporter *gci = task_data;
+	EContact *contact;
+	GSList *batch = NULL;
+	guint batch_len = 0;
+	GError *local_error = NULL;
+
+	while (!g_cancellable_set_error_if_cancelled (cancellable, &local_error) &&
+	       (contact = getNextCSVEntry (gci, gci->file))) {
+		batch = g_slist_prepend (batch, contact);
+		batch_len++;
+
+		if (batch_len >= EVOLUTION_CONTACT_IMPORTER_BATCH_SIZE) {
+			gboolean success;
+
+			batch = g_slist_reverse (batch);
+			success = evolution_contact_importer_add_contacts_sync (
+				gci->book_client, batch, cancellable, &local_error);
+			g_slist_free_full (batch, g_object_unref);
+			batch = NULL;
+			batch_len = 0;
+
+			if (!success)
+				break;
 		}
-		gci->contacts = g_slist_prepend (gci->contacts, contact);
-	}
-	if (contact == NULL) {
-		gci->state = 1;
-	}
-	if (gci->state == 1) {
-		csv_import_done (gci);
-		return FALSE;
+
+		if (gci->size > 0)
+			g_atomic_int_set (&gci->progress, ftell (gci->file) * 100 / gci->size);
 	}
-	else {
-		e_import_status (
-			gci->import, gci->target, _("Importing…"),
-			ftell (gci->file) * 100 / gci->size);
-		return TRUE;
+
+	if (batch && !local_error) {
+		batch = g_slist_reverse (batch);
+		evolution_contact_importer_add_contacts_sync (
+			gci->book_client, batch, cancellable, &local_error);
 	}
+
+	g_slist_free_full (batch, g_object_unref);
+
+	if (local_error)
+		g_task_return_error (task, local_error);
+	else
+		g_task_return_boolean (task, TRUE);
+}
+
+static void
+csv_import_thread_done_cb (GObject *source_object,
+                           GAsyncResult *result,
+                           gpointer user_data)
+{
+	CSVImporter *gci = user_data;
+	GError *local_error = NULL;
+
+	g_task_propagate_boolean (G_TASK (result), &local_error);
+
+	csv_import_done (gci, local_error);
+
+	g_clear_error (&local_error);
+}
+
+static gboolean
+csv_import_progress_cb (gpointer user_data)
+{
+	CSVImporter *gci = user_data;
+
+	e_import_status (
+		gci->import, gci->target, _("Importing…"),
+		g_atomic_int_get (&gci->progress));
+
+	return TRUE;
 }
 
 static void
@@ -911,20 +956,23 @@ csv_supported (EImport *ei,
 }
 
 static void
-csv_import_done (CSVImporter *gci)
+csv_import_done (CSVImporter *gci,
+                 const GError *error)
 {
 	if (gci->idle_id)
 		g_source_remove (gci->idle_id);
 
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		error = NULL;
+
 	fclose (gci->file);
-	g_object_unref (gci->book_client);
-	g_slist_foreach (gci->contacts, (GFunc) g_object_unref, NULL);
-	g_slist_free (gci->contacts);
+	g_clear_object (&gci->book_client);
+	g_clear_object (&gci->cancellable);
 
 	if (gci->fields_map)
 		g_hash_table_destroy (gci->fields_map);
 
-	e_import_complete (gci->import, gci->target, NULL);
+	e_import_complete (gci->import, gci->target, error);
 	g_object_unref (gci->import);
 
 	g_free (gci);
@@ -937,16 +985,27 @@ book_client_connect_cb (GObject *source_object,
 {
 	CSVImporter *gci = user_data;
 	EClient *client;
+	GTask *task;
+	GError *local_error = NULL;
 
-	client = e_book_client_connect_finish (result, NULL);
+	client = e_book_client_connect_finish (result, &local_error);
 
 	if (client == NULL) {
-		csv_import_done (gci);
+		csv_import_done (gci, local_error);
+		g_clear_error (&local_error);
 		return;
 	}
 
 	gci->book_client = E_BOOK_CLIENT (client);
-	gci->idle_id = g_idle_add (csv_import_contacts, gci);
+
+	/* Parse and add the contacts in a dedicated thread, the main
+	 * thread only shows the progress. */
+	gci->idle_id = e_named_timeout_add (250, csv_import_progress_cb, gci);
+
+	task = g_task_new (NULL, gci->cancellable, csv_import_thread_done_cb, gci);
+	g_task_set_task_data (task, gci, NULL);
+	g_task_run_in_thread (task, csv_import_thread);
+	g_object_unref (task);
 }
 
 static void
@@ -989,6 +1048,7 @@ csv_import (EImport *ei,
 	gci->file = file;
 	gci->fields_map = NULL;
 	gci->count = 0;
+	gci->cancellable = g_cancellable_new ();
 	fseek (file, 0, SEEK_END);
 	gci->size = ftell (file);
 	fseek (file, 0, SEEK_SET);
@@ -999,7 +1059,7 @@ csv_import (EImport *ei,
 
 	source = g_datalist_get_data (&target->data, "csv-source");
 
-	e_book_client_connect (source, 30, NULL, book_client_connect_cb, gci);
+	e_book_client_connect (source, 30, gci->cancellable, book_client_connect_cb, gci);
 }
 
 static void
@@ -1037,7 +1097,7 @@ csv_cancel (EImport *ei,
 	CSVImporter *gci = g_datalist_get_data (&target->data, "csv-data");
 
 	if (gci)
-		gci->state = 1;
+		g_cancellable_cancel (gci->cancellable);
 }
 
 static GtkWidget *
@@ -53,18 +53,18 @@ typedef struct {
 
 	GHashTable *dn_contact_hash;
 
-	gint state;		/* 0 - initial scan, 1 - list cards, 2 - cancelled/complete */
+	GCancellable *cancellable;
+	gint progress;		/* percent, updated by the import thread */
+
 	FILE *file;
 	gulong size;
 
 	EBookClient *book_client;
 
-	GSList *contacts;
 	GSList *list_contacts;
-	GSList *list_iterator;
 } LDIFImporter;
 
-static void ldif_import_done (LDIFImporter *gci);
+static void ldif_import_done (LDIFImporter *gci, const GError *error);
 
 static struct {
 	const gchar *ldif_attribute;
@@ -316,7 +316,8 @@ parseLine (GHashTable *dn_contact_hash,
 			if (!g_ascii_strcasecmp (ptr, "dn"))
 				g_hash_table_insert (
 					dn_contact_hash,
-					g_strdup (ldif_value->str), contact);
+					g_strdup (ldif_value->str),
+					g_object_ref (contact));
 			else if (!g_ascii_strcasecmp (ptr, "objectclass") &&
 				!g_ascii_strcasecmp (ldif_value->str, "groupofnames")) {
 				e_contact_set (
@@ -481,73 +482,111 @@ add_to_notes (EContact *contact,
 	g_free (new_text);
 }
 
+/* Adds the contacts collected in the *@pbatch and frees it */
 static gboolean
-ldif_import_contacts (gpointer d)
+ldif_import_flush_batch (LDIFImporter *gci,
+                         GSList **pbatch,
+                         guint *pbatch_len,
+                         GCancellable *cancellable,
+                         GError **error)
+{
+	gboolean success;
+
+	*pbatch = g_slist_reverse (*pbatch);
+	success = evolution_contact_importer_add_contacts_sync (
+		gci->book_client, *pbatch, cancellable, error);
+	g_slist_free_full (*pbatch, g_object_unref);
+	*pbatch = NULL;
+	*pbatch_len = 0;
+
+	return success;
+}
+
+static void
+ldif_import_thread (GTask *task,
+                    gpointer source_object,
+                    gpointer task_data,
+                    GCancellable *cancellable)
 {
-	LDIFImporter *gci = d;
+	LDIFImporter *gci = task_data;
 	EContact *contact;
-	GSList *iter;
-	gint count = 0;
+	GSList *batch = NULL, *iter;
+	guint batch_len = 0;
+	gboolean success = TRUE;
+	GError *local_error = NULL;
 
 	/* We process all normal cards immediately and keep the list
-	 * ones till the end */
-
-	if (gci->state == 0) {
-		while (count < 50 && (contact = getNextLDIFEntry (
-			gci->dn_contact_hash, gci->file))) {
-			if (e_contact_get (contact, E_CONTACT_IS_LIST)) {
-				gci->list_contacts = g_slist_prepend (
-					gci->list_contacts, contact);
-			} else {
-				gchar *uid = NULL;
-
-				add_to_notes (contact, E_CONTACT_OFFICE);
-				add_to_notes (contact, E_CONTACT_SPOUSE);
-				add_to_notes (contact, E_CONTACT_BLOG_URL);
-
-				e_book_client_add_contact_sync (
-					gci->book_client,
-					contact, E_BOOK_OPERATION_FLAG_NONE, &uid, NULL, NULL);
-				if (uid != NULL) {
-					e_contact_set (contact, E_CONTACT_UID, uid);
-					g_free (uid);
-				}
-				gci->contacts = g_slist_prepend (gci->contacts, contact);
-			}
-			count++;
-		}
-		if (contact == NULL) {
-			gci->state = 1;
-			gci->list_iterator = gci->list_contacts;
-		}
-	}
-	if (gci->state == 1) {
-		for (iter = gci->list_iterator; count < 50 && iter; iter = iter->next) {
-			gchar *uid = NULL;
-
-			contact = iter->data;
-			resolve_list_card (gci, contact);
-			e_book_client_add_contact_sync (
-				gci->book_client, contact, E_BOOK_OPERATION_FLAG_NONE, &uid, NULL, NULL);
-			if (uid != NULL) {
-				e_contact_set (contact, E_CONTACT_UID, uid);
-				g_free (uid);
-			}
-			count++;
+	 * ones till the end, when all the members have their UID.  The
+	 * dn_contact_hash keeps the cards the lists can refer to. */
+
+	while (success && !g_cancellable_set_error_if_cancelled (cancellable, &local_error) &&
+	       (contact = getNextLDIFEntry (gci->dn_contact_hash, gci->file))) {
+		if (e_contact_get (contact, E_CONTACT_IS_LIST)) {
+			gci->list_contacts = g_slist_prepend (
+				gci->list_contacts, contact);
+		} else {
+			add_to_notes (contact, E_CONTACT_OFFICE);
+			add_to_notes (contact, E_CONTACT_SPOUSE);
+			add_to_notes (contact, E_CONTACT_BLOG_URL);
+
+			batch = g_slist_prepend (batch, contact);
+			batch_len++;
+
+			if (batch_len >= EVOLUTION_CONTACT_IMPORTER_BATCH_SIZE)
+				success = ldif_import_flush_batch (gci, &batch, &batch_len, cancellable, &local_error);
 		}
-		gci->list_iterator = iter;
-		if (iter == NULL)
-			gci->state = 2;
+
+		if (gci->size > 0)
+			g_atomic_int_set (&gci->progress, ftell (gci->file) * 100 / gci->size);
 	}
-	if (gci->state == 2) {
-		ldif_import_done (gci);
-		return FALSE;
-	} else {
-		e_import_status (
-			gci->import, gci->target, _("Importing…"),
-			ftell (gci->file) * 100 / gci->size);
-		return TRUE;
+
+	if (batch && !local_error)
+		ldif_import_flush_batch (gci, &batch, &batch_len, cancellable, &local_error);
+
+	for (iter = gci->list_contacts; iter && !local_error; iter = iter->next) {
+		contact = iter->data;
+		resolve_list_card (gci, contact);
+
+		batch = g_slist_prepend (batch, g_object_ref (contact));
+		batch_len++;
+
+		if (batch_len >= EVOLUTION_CONTACT_IMPORTER_BATCH_SIZE || !iter->next)
+			ldif_import_flush_batch (gci, &batch, &batch_len, cancellable, &local_error);
 	}
+
+	g_slist_free_full (batch, g_object_unref);
+
+	if (local_error)
+		g_task_return_error (task, local_error);
+	else
+		g_task_return_boolean (task, TRUE);
+}
+
+static void
+ldif_import_thread_done_cb (GObject *source_object,
+                            GAsyncResult *result,
+                            gpointer user_data)
+{
+	LDIFImporter *gci = user_data;
+	GError *local_error = NULL;
+
+	g_task_propagate_boolean (G_TASK (result), &local_error);
+
+	ldif_import_done (gci, local_error);
+
+	g_clear_error (&local_error);
+}
+
+static gboolean
+ldif_import_progress_cb (gpointer user_data)
+{
+	LDIFImporter *gci = user_data;
+
+	e_import_status (
+		gci->import, gci->target, _("Importing…"),
+		g_atomic_int_get (&gci->progress));
+
+	return TRUE;
 }
 
 static void
@@ -655,20 +694,23 @@ ldif_supported (EImport *ei,
 }
 
 static void
-ldif_import_done (LDIFImporter *gci)
+ldif_import_done (LDIFImporter *gci,
+                  const GError *error)
 {
 	if (gci->idle_id)
 		g_source_remove (gci->idle_id);
 
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		error = NULL;
+
 	fclose (gci->file);
-	g_object_unref (gci->book_client);
-	g_slist_foreach (gci->contacts, (GFunc) g_object_unref, NULL);
+	g_clear_object (&gci->book_client);
+	g_clear_object (&gci->cancellable);
 	g_slist_foreach (gci->list_contacts, (GFunc) g_object_unref, NULL);
-	g_slist_free (gci->contacts);
 	g_slist_free (gci->list_contacts);
 	g_hash_table_destroy (gci->dn_contact_hash);
 
-	e_import_complete (gci->import, gci->target, NULL);
+	e_import_complete (gci->import, gci->target, error);
 	g_object_unref (gci->import);
 
 	g_free (gci);
@@ -681,16 +723,27 @@ book_client_connect_cb (GObject *source_object,
 {
 	LDIFImporter *gci = user_data;
 	EClient *client;
+	GTask *task;
+	GError *local_error = NULL;
 
-	client = e_book_client_connect_finish (result, NULL);
+	client = e_book_client_connect_finish (result, &local_error);
 
 	if (client == NULL) {
-		ldif_import_done (gci);
+		ldif_import_done (gci, local_error);
+		g_clear_error (&local_error);
 		return;
 	}
 
 	gci->book_client = E_BOOK_CLIENT (client);
-	gci->idle_id = g_idle_add (ldif_import_contacts, gci);
+
+	/* Parse and add the contacts in a dedicated thread, the main
+	 * thread only shows the progress. */
+	gci->idle_id = e_named_timeout_add (250, ldif_import_progress_cb, gci);
+
+	task = g_task_new (NULL, gci->cancellable, ldif_import_thread_done_cb, gci);
+	g_task_set_task_data (task, gci, NULL);
+	g_task_run_in_thread (task, ldif_import_thread);
+	g_object_unref (task);
 }
 
 static void
@@ -726,17 +779,18 @@ ldif_import (EImport *ei,
 	gci->import = g_object_ref (ei);
 	gci->target = target;
 	gci->file = file;
+	gci->cancellable = g_cancellable_new ();
 	fseek (file, 0, SEEK_END);
 	gci->size = ftell (file);
 	fseek (file, 0, SEEK_SET);
 	gci->dn_contact_hash = g_hash_table_new_full (
 		g_str_hash, g_str_equal,
 		(GDestroyNotify) g_free,
-		(GDestroyNotify) NULL);
+		(GDestroyNotify) g_object_unref);
 
 	source = g_datalist_get_data (&target->data, "ldif-source");
 
-	e_book_client_connect (source, 30, NULL, book_client_connect_cb, gci);
+	e_book_client_connect (source, 30, gci->cancellable, book_client_connect_cb, gci);
 }
 
 static void
@@ -747,7 +801,7 @@ ldif_cancel (EImport *ei,
 	LDIFImporter *gci = g_datalist_get_data (&target->data, "ldif-data");
 
 	if (gci)
-		gci->state = 2;
+		g_cancellable_cancel (gci->cancellable);
 }
 
 static GtkWidget *
@@ -780,7 +834,7 @@ ldif_get_preview (EImport *ei,
 	dn_contact_hash = g_hash_table_new_full (
 		g_str_hash, g_str_equal,
 		(GDestroyNotify) g_free,
-		(GDestroyNotify) NULL);
+		(GDestroyNotify) g_object_unref);
 
 	while (contact = getNextLDIFEntry (dn_contact_hash, file), contact != NULL) {
 		if (!e_contact_get (contact, E_CONTACT_IS_LIST)) {
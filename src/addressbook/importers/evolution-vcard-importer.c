@@ -55,30 +55,25 @@ typedef struct {
 
 	guint idle_id;
 
-	gint state;		/* 0 - importing, 1 - cancelled/complete */
-	gint total;
-	gint count;
+	GCancellable *cancellable;
+	gint progress;		/* percent, updated by the import thread */
 
-	ESource *primary;
-
-	GSList *contactlist;
-	GSList *iterator;
 	EBookClient *book_client;
 
-	/* when opening book */
-	gchar *contents;
+	GFile *file;
 	VCardEncoding encoding;
+
+	/* line read ahead by vcard_read_contact () */
+	gchar *pending_line;
 } VCardImporter;
 
-static void vcard_import_done (VCardImporter *gci);
+static void vcard_import_done (VCardImporter *gci, const GError *error);
 
 static void
-vcard_import_contact (VCardImporter *gci,
-                      EContact *contact)
+vcard_prepare_contact (EContact *contact)
 {
 	EContactPhoto *photo;
 	GList *attrs, *attr;
-	gchar *uid = NULL;
 
 	/* Apple's addressbook.app exports PHOTO's without a TYPE
 	 * param, so let's figure out the format here if there's a
@@ -211,43 +206,200 @@ vcard_import_contact (VCardImporter *gci,
 								"OTHER");
 		}
 	}
+}
+
+/* Reads the next vCard from the stream. The outer END:VCARD is the one
+ * followed by another BEGIN:VCARD or by the end of the file, the same as
+ * eab_contact_list_from_string () does it, thus embedded vCards are kept
+ * in the card. Returns %NULL at the end of the file or on error. */
+static EContact *
+vcard_read_contact (VCardImporter *gci,
+                    GDataInputStream *data_stream,
+                    GCancellable *cancellable,
+                    GError **error)
+{
+	EContact *contact;
+	GString *card = NULL;
+	gboolean ended = FALSE;
+
+	while (TRUE) {
+		gchar *line;
+		gsize len;
+
+		if (gci->pending_line) {
+			line = gci->pending_line;
+			gci->pending_line = NULL;
+		} else {
+			line = g_data_input_stream_read_line (data_stream, NULL, cancellable, error);
+			if (!line)
+				break;
+		}
+
+		len = strlen (line);
+		if (len > 0 && line[len - 1] == '\r')
+			line[len - 1] = '\0';
+
+		if (!card) {
+			if (g_ascii_strncasecmp (line, "BEGIN:VCARD", 11) == 0)
+				card = g_string_new ("");
+		} else if (ended) {
+			if (!line[strspn (line, "\t ")]) {
+				g_free (line);
+				continue;
+			}
 
-	/* FIXME Error checking */
-	e_book_client_add_contact_sync (
-		gci->book_client, contact, E_BOOK_OPERATION_FLAG_NONE, &uid, NULL, NULL);
-	if (uid != NULL) {
-		e_contact_set (contact, E_CONTACT_UID, uid);
-		g_free (uid);
+			if (g_ascii_strncasecmp (line, "BEGIN:VCARD", 11) == 0) {
+				gci->pending_line = line;
+				break;
+			}
+
+			ended = FALSE;
+		}
+
+		if (card) {
+			g_string_append (card, line);
+			g_string_append_c (card, '\n');
+
+			if (g_ascii_strncasecmp (line, "END:VCARD", 9) == 0)
+				ended = TRUE;
+		}
+
+		g_free (line);
 	}
+
+	if (!card)
+		return NULL;
+
+	/* an unfinished card at the end of the file is skipped */
+	if (!ended || (error && *error)) {
+		g_string_free (card, TRUE);
+		return NULL;
+	}
+
+	contact = e_contact_new_from_vcard (card->str);
+
+	g_string_free (card, TRUE);
+
+	return contact;
 }
 
-static gboolean
-vcard_import_contacts (gpointer data)
+static void
+vcard_import_thread (GTask *task,
+                     gpointer source_object,
+                     gpointer task_data,
+                     GCancellable *cancellable)
 {
-	VCardImporter *gci = data;
-	gint count = 0;
-	GSList *iterator = gci->iterator;
-
-	if (gci->state == 0) {
-		while (count < 50 && iterator) {
-			vcard_import_contact (gci, iterator->data);
-			count++;
-			iterator = iterator->next;
-		}
-		gci->count += count;
-		gci->iterator = iterator;
-		if (iterator == NULL)
-			gci->state = 1;
+	VCardImporter *gci = task_data;
+	GFileInputStream *file_stream;
+	GInputStream *stream;
+	GDataInputStream *data_stream;
+	GFileInfo *info;
+	EContact *contact;
+	GSList *batch = NULL;
+	guint batch_len = 0;
+	goffset size = 0;
+	gboolean success = TRUE;
+	GError *local_error = NULL;
+
+	file_stream = g_file_read (gci->file, cancellable, &local_error);
+	if (!file_stream) {
+		g_task_return_error (task, local_error);
+		return;
 	}
-	if (gci->state == 1) {
-		vcard_import_done (gci);
-		return FALSE;
+
+	info = g_file_input_stream_query_info (file_stream, G_FILE_ATTRIBUTE_STANDARD_SIZE, cancellable, NULL);
+	if (info) {
+		size = g_file_info_get_size (info);
+		g_object_unref (info);
+	}
+
+	if (gci->encoding == VCARD_ENCODING_UTF16 ||
+	    gci->encoding == VCARD_ENCODING_LOCALE) {
+		GCharsetConverter *converter;
+		const gchar *charset = "UTF-16";
+
+		if (gci->encoding == VCARD_ENCODING_LOCALE)
+			g_get_charset (&charset);
+
+		converter = g_charset_converter_new ("UTF-8", charset, &local_error);
+		if (!converter) {
+			g_object_unref (file_stream);
+			g_task_return_error (task, local_error);
+			return;
+		}
+
+		stream = g_converter_input_stream_new (G_INPUT_STREAM (file_stream), G_CONVERTER (converter));
+		g_object_unref (converter);
 	} else {
-		e_import_status (
-			gci->import, gci->target, _("Importing…"),
-			gci->count * 100 / gci->total);
-		return TRUE;
+		stream = g_object_ref (G_INPUT_STREAM (file_stream));
 	}
+
+	data_stream = g_data_input_stream_new (stream);
+
+	while (contact = vcard_read_contact (gci, data_stream, cancellable, &local_error), contact) {
+		vcard_prepare_contact (contact);
+
+		batch = g_slist_prepend (batch, contact);
+		batch_len++;
+
+		if (batch_len >= EVOLUTION_CONTACT_IMPORTER_BATCH_SIZE) {
+			batch = g_slist_reverse (batch);
+			success = evolution_contact_importer_add_contacts_sync (
+				gci->book_client, batch, cancellable, &local_error);
+			g_slist_free_full (batch, g_object_unref);
+			batch = NULL;
+			batch_len = 0;
+
+			if (!success)
+				break;
+		}
+
+		if (size > 0)
+			g_atomic_int_set (&gci->progress, g_seekable_tell (G_SEEKABLE (file_stream)) * 100 / size);
+	}
+
+	if (batch && !local_error) {
+		batch = g_slist_reverse (batch);
+		evolution_contact_importer_add_contacts_sync (
+			gci->book_client, batch, cancellable, &local_error);
+	}
+
+	g_slist_free_full (batch, g_object_unref);
+	g_object_unref (data_stream);
+	g_object_unref (stream);
+	g_object_unref (file_stream);
+
+	if (local_error)
+		g_task_return_error (task, local_error);
+	else
+		g_task_return_boolean (task, TRUE);
+}
+
+static void
+vcard_import_thread_done_cb (GObject *source_object,
+                             GAsyncResult *result,
+                             gpointer user_data)
+{
+	VCardImporter *gci = user_data;
+	GError *local_error = NULL;
+
+	g_task_propagate_boolean (G_TASK (result), &local_error);
+
+	vcard_import_done (gci, local_error);
+
+	g_clear_error (&local_error);
+}
+
+static gboolean
+vcard_import_progress_cb (gpointer user_data)
+{
+	VCardImporter *gci = user_data;
+
+	e_import_status (
+		gci->import, gci->target, _("Importing…"),
+		g_atomic_int_get (&gci->progress));
+
+	return TRUE;
 }
 
 #define BOM (gunichar2)0xFEFF
@@ -452,16 +604,21 @@ vcard_supported (EImport *ei,
 }
 
 static void
-vcard_import_done (VCardImporter *gci)
+vcard_import_done (VCardImporter *gci,
+                   const GError *error)
 {
 	if (gci->idle_id)
 		g_source_remove (gci->idle_id);
 
-	g_free (gci->contents);
-	g_object_unref (gci->book_client);
-	g_slist_free_full (gci->contactlist, (GDestroyNotify) g_object_unref);
+	if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+		error = NULL;
+
+	g_clear_object (&gci->book_client);
+	g_clear_object (&gci->cancellable);
+	g_clear_object (&gci->file);
+	g_free (gci->pending_line);
 
-	e_import_complete (gci->import, gci->target, NULL);
+	e_import_complete (gci->import, gci->target, error);
 	g_object_unref (gci->import);
 	g_free (gci);
 }
@@ -473,41 +630,27 @@ book_client_connect_cb (GObject *source_object,
 {
 	VCardImporter *gci = user_data;
 	EClient *client;
+	GTask *task;
+	GError *local_error = NULL;
 
-	client = e_book_client_connect_finish (result, NULL);
+	client = e_book_client_connect_finish (result, &local_error);
 
 	if (client == NULL) {
-		vcard_import_done (gci);
+		vcard_import_done (gci, local_error);
+		g_clear_error (&local_error);
 		return;
 	}
 
 	gci->book_client = E_BOOK_CLIENT (client);
 
-	if (gci->encoding == VCARD_ENCODING_UTF16) {
-		gchar *tmp;
+	/* Parse and add the contacts in a dedicated thread, the main
+	 * thread only shows the progress. */
+	gci->idle_id = e_named_timeout_add (250, vcard_import_progress_cb, gci);
 
-		gunichar2 *contents_utf16 = (gunichar2 *) gci->contents;
-		tmp = utf16_to_utf8 (contents_utf16);
-		g_free (gci->contents);
-		gci->contents = tmp;
-
-	} else if (gci->encoding == VCARD_ENCODING_LOCALE) {
-		gchar *tmp;
-		tmp = g_locale_to_utf8 (gci->contents, -1, NULL, NULL, NULL);
-		g_free (gci->contents);
-		gci->contents = tmp;
-	}
-
-	gci->contactlist = eab_contact_list_from_string (gci->contents);
-	g_free (gci->contents);
-	gci->contents = NULL;
-	gci->iterator = gci->contactlist;
-	gci->total = g_slist_length (gci->contactlist);
-
-	if (gci->iterator)
-		gci->idle_id = g_idle_add (vcard_import_contacts, gci);
-	else
-		vcard_import_done (gci);
+	task = g_task_new (NULL, gci->cancellable, vcard_import_thread_done_cb, gci);
+	g_task_set_task_data (task, gci, NULL);
+	g_task_run_in_thread (task, vcard_import_thread);
+	g_object_unref (task);
 }
 
 static void
@@ -519,7 +662,6 @@ vcard_import (EImport *ei,
 	ESource *source;
 	EImportTargetURI *s = (EImportTargetURI *) target;
 	gchar *filename;
-	gchar *contents;
 	VCardEncoding encoding;
 	GError *error = NULL;
 
@@ -540,25 +682,19 @@ vcard_import (EImport *ei,
 		return;
 	}
 
-	if (!g_file_get_contents (filename, &contents, NULL, &error)) {
-		g_free (filename);
-		e_import_complete (ei, target, error);
-		g_clear_error (&error);
-
-		return;
-	}
-
-	g_free (filename);
 	gci = g_malloc0 (sizeof (*gci));
 	g_datalist_set_data (&target->data, "vcard-data", gci);
 	gci->import = g_object_ref (ei);
 	gci->target = target;
 	gci->encoding = encoding;
-	gci->contents = contents;
+	gci->file = g_file_new_for_path (filename);
+	gci->cancellable = g_cancellable_new ();
+
+	g_free (filename);
 
 	source = g_datalist_get_data (&target->data, "vcard-source");
 
-	e_book_client_connect (source, 30, NULL, book_client_connect_cb, gci);
+	e_book_client_connect (source, 30, gci->cancellable, book_client_connect_cb, gci);
 }
 
 static void
@@ -569,7 +705,7 @@ vcard_cancel (EImport *ei,
 	VCardImporter *gci = g_datalist_get_data (&target->data, "vcard-data");
 
 	if (gci)
-		gci->state = 1;
+		g_cancellable_cancel (gci->cancellable);
 }
 
 static GtkWidget *
@@ -648,6 +784,67 @@ evolution_vcard_importer_peek (void)
 }
 
 /* utility functions shared between all contact importers */
+
+/* Adds the @contacts in one call and sets the UIDs assigned by the book
+ * to them. When the book refuses the batch, the contacts are added one by
+ * one, thus a broken contact does not prevent the others from being
+ * imported; the contacts the book refuses are skipped with a warning.
+ * Fails only when cancelled. */
+gboolean
+evolution_contact_importer_add_contacts_sync (EBookClient *book_client,
+                                              GSList *contacts,
+                                              GCancellable *cancellable,
+                                              GError **error)
+{
+	GSList *uids = NULL, *link, *uid_link;
+	GError *local_error = NULL;
+
+	if (!contacts)
+		return TRUE;
+
+	if (e_book_client_add_contacts_sync (book_client, contacts, E_BOOK_OPERATION_FLAG_NONE, &uids, cancellable, &local_error)) {
+		for (link = contacts, uid_link = uids; link && uid_link; link = g_slist_next (link), uid_link = g_slist_next (uid_link)) {
+			e_contact_set (link->data, E_CONTACT_UID, uid_link->data);
+		}
+
+		g_slist_free_full (uids, g_free);
+
+		return TRUE;
+	}
+
+	if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+		g_propagate_error (error, local_error);
+		return FALSE;
+	}
+
+	g_clear_error (&local_error);
+
+	for (link = contacts; link; link = g_slist_next (link)) {
+		gchar *uid = NULL;
+
+		if (g_cancellable_set_error_if_cancelled (cancellable, error))
+			return FALSE;
+
+		if (e_book_client_add_contact_sync (book_client, link->data, E_BOOK_OPERATION_FLAG_NONE, &uid, cancellable, &local_error)) {
+			e_contact_set (link->data, E_CONTACT_UID, uid);
+			g_free (uid);
+		} else if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			g_propagate_error (error, local_error);
+			return FALSE;
+		} else {
+			const gchar *file_as = e_contact_get_const (link->data, E_CONTACT_FILE_AS);
+
+			g_warning (
+				"%s: Failed to add contact '%s': %s", G_STRFUNC,
+				file_as ? file_as : "",
+				local_error ? local_error->message : "Unknown error");
+			g_clear_error (&local_error);
+		}
+	}
+
+	return TRUE;
+}
+
 static void
 preview_contact (EWebViewPreview *preview,
                  EContact *contact)
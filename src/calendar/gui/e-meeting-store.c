@@ -62,13 +62,21 @@ struct _EMeetingStorePrivate {
 	guint refresh_idle_id;
 
 	guint num_threads;
-	guint num_queries;
+	gint num_queries; /* atomic, updated from the free/busy threads */
 
 	gboolean show_address;
 };
 
 #define BUF_SIZE 1024
 
+/* At most this many attendees are asked for in one free/busy query,
+ * and at most FREE_BUSY_MAX_THREADS such queries run at once. */
+#define FREE_BUSY_BATCH_SIZE 32
+#define FREE_BUSY_MAX_THREADS 4
+
+/* How long fetched free/busy information is reused, in seconds */
+#define FREE_BUSY_CACHE_TTL 300
+
 typedef struct _EMeetingStoreQueueData EMeetingStoreQueueData;
 struct _EMeetingStoreQueueData {
 	EMeetingStore *store;
@@ -79,6 +87,9 @@ struct _EMeetingStoreQueueData {
 	EMeetingTime start;
 	EMeetingTime end;
 
+	time_t startt;
+	time_t endt;
+
 	gchar buffer[BUF_SIZE];
 	GString *string;
 
@@ -1602,6 +1613,123 @@ process_free_busy (EMeetingStoreQueueData *qdata,
 	process_callbacks (qdata);
 }
 
+/* Free/busy information is cached for the whole session, keyed by
+ * the lowercased attendee address, so that reopening a meeting or
+ * moving it around within the fetched range does not query again. */
+
+typedef struct _FreeBusyCacheEntry {
+	gchar *text;
+	time_t startt;
+	time_t endt;
+	gint64 fetched;
+} FreeBusyCacheEntry;
+
+G_LOCK_DEFINE_STATIC (free_busy_cache);
+static GHashTable *free_busy_cache = NULL;
+
+static void
+free_busy_cache_entry_free (gpointer ptr)
+{
+	FreeBusyCacheEntry *entry = ptr;
+
+	if (entry) {
+		g_free (entry->text);
+		g_free (entry);
+	}
+}
+
+static gboolean
+free_busy_cache_entry_expired (const FreeBusyCacheEntry *entry,
+			       gint64 now)
+{
+	return now - entry->fetched > (gint64) FREE_BUSY_CACHE_TTL * G_USEC_PER_SEC;
+}
+
+static gboolean
+free_busy_cache_prune_cb (gpointer key,
+			  gpointer value,
+			  gpointer user_data)
+{
+	return free_busy_cache_entry_expired (value, *((gint64 *) user_data));
+}
+
+/* Returns a newly allocated free/busy text covering the given range,
+ * or NULL when nothing usable is cached. An empty string means the
+ * attendee is known to have no free/busy information. */
+static gchar *
+free_busy_cache_lookup (const gchar *email,
+			time_t startt,
+			time_t endt)
+{
+	FreeBusyCacheEntry *entry;
+	gchar *key, *text = NULL;
+
+	if (!email || !*email)
+		return NULL;
+
+	key = g_utf8_strdown (email, -1);
+
+	G_LOCK (free_busy_cache);
+
+	entry = free_busy_cache ? g_hash_table_lookup (free_busy_cache, key) : NULL;
+	if (entry) {
+		if (free_busy_cache_entry_expired (entry, g_get_monotonic_time ()))
+			g_hash_table_remove (free_busy_cache, key);
+		else if (entry->startt <= startt && entry->endt >= endt)
+			text = g_strdup (entry->text);
+	}
+
+	G_UNLOCK (free_busy_cache);
+
+	g_free (key);
+
+	return text;
+}
+
+static void
+free_busy_cache_store (const gchar *email,
+		       time_t startt,
+		       time_t endt,
+		       const gchar *text)
+{
+	FreeBusyCacheEntry *entry;
+	gint64 now;
+
+	if (!email || !*email || !text)
+		return;
+
+	now = g_get_monotonic_time ();
+
+	entry = g_new0 (FreeBusyCacheEntry, 1);
+	entry->text = g_strdup (text);
+	entry->startt = startt;
+	entry->endt = endt;
+	entry->fetched = now;
+
+	G_LOCK (free_busy_cache);
+
+	if (!free_busy_cache)
+		free_busy_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, free_busy_cache_entry_free);
+	else
+		g_hash_table_foreach_remove (free_busy_cache, free_busy_cache_prune_cb, &now);
+
+	g_hash_table_insert (free_busy_cache, g_utf8_strdown (email, -1), entry);
+
+	G_UNLOCK (free_busy_cache);
+}
+
+/* Used for data received from a free/busy URL */
+static void
+process_fetched_free_busy (EMeetingStoreQueueData *qdata,
+			   const gchar *text)
+{
+	free_busy_cache_store (
+		itip_strip_mailto (e_meeting_attendee_get_address (qdata->attendee)),
+		qdata->startt, qdata->endt, text);
+
+	process_free_busy (qdata, text);
+}
+
 /*
  * Replace all instances of from_value in string with to_value
  * In the returned newly allocated string.
@@ -1627,206 +1755,313 @@ typedef struct {
 	ECalClient *client;
 	time_t startt;
 	time_t endt;
-	GSList *users;
-	GSList *fb_data;
+	GPtrArray *qdatas; /* EMeetingStoreQueueData * */
+	GPtrArray *emails; /* gchar *, in the same order as qdatas */
 	gchar *fb_uri;
-	gchar *email;
-	EMeetingAttendee *attendee;
-	EMeetingStoreQueueData *qdata;
 	EMeetingStore *store;
 } FreeBusyAsyncData;
 
 #define USER_SUB   "%u"
 #define DOMAIN_SUB "%d"
 
+static void
+free_busy_async_data_free (FreeBusyAsyncData *fbd)
+{
+	if (fbd) {
+		g_clear_object (&fbd->client);
+		g_ptr_array_unref (fbd->qdatas);
+		g_ptr_array_unref (fbd->emails);
+		g_free (fbd->fb_uri);
+		g_free (fbd);
+	}
+}
+
 static gboolean
-freebusy_async (gpointer data)
+free_busy_comp_has_address (ICalComponent *icomp,
+			    const gchar *email)
 {
-	FreeBusyAsyncData *fbd = data;
-	EMeetingAttendee *attendee = fbd->attendee;
-	gchar *default_fb_uri = NULL;
-	gchar *fburi = NULL;
-	static GMutex mutex;
-	EMeetingStorePrivate *priv = fbd->store->priv;
-
-	if (fbd->client) {
-		/* FIXME This a workaround for getting all the free busy
-		 *       information for the users.  We should be able to
-		 *       get free busy asynchronously. */
-		g_mutex_lock (&mutex);
-		priv->num_queries++;
-		e_cal_client_get_free_busy_sync (
-			fbd->client, fbd->startt,
-			fbd->endt, fbd->users, &fbd->fb_data, NULL, NULL);
-		priv->num_queries--;
-		g_mutex_unlock (&mutex);
+	ICalPropertyKind kinds[] = { I_CAL_ORGANIZER_PROPERTY, I_CAL_ATTENDEE_PROPERTY };
+	gboolean found = FALSE;
+	guint ii;
 
-		g_slist_foreach (fbd->users, (GFunc) g_free, NULL);
-		g_slist_free (fbd->users);
+	for (ii = 0; ii < G_N_ELEMENTS (kinds) && !found; ii++) {
+		ICalProperty *prop;
 
-		if (fbd->fb_data != NULL) {
-			ECalComponent *comp = fbd->fb_data->data;
-			gchar *comp_str;
+		for (prop = i_cal_component_get_first_property (icomp, kinds[ii]);
+		     prop && !found;
+		     g_object_unref (prop), prop = i_cal_component_get_next_property (icomp, kinds[ii])) {
+			const gchar *value;
 
-			comp_str = e_cal_component_get_as_string (comp);
-			process_free_busy (fbd->qdata, comp_str);
-			g_free (comp_str);
+			if (kinds[ii] == I_CAL_ORGANIZER_PROPERTY)
+				value = i_cal_property_get_organizer (prop);
+			else
+				value = i_cal_property_get_attendee (prop);
 
-			return TRUE;
+			found = value && g_ascii_strcasecmp (itip_strip_mailto (value), email) == 0;
 		}
+
+		g_clear_object (&prop);
 	}
 
+	return found;
+}
+
+/* Falls back to the attendee's own free/busy URL, or to the
+ * template URL, when the server has nothing for the attendee. */
+static void
+freebusy_fetch_from_url (EMeetingStoreQueueData *qdata,
+			 const gchar *fb_uri,
+			 const gchar *email,
+			 gboolean queried_server)
+{
+	EMeetingAttendee *attendee = qdata->attendee;
+	EMeetingStorePrivate *priv = qdata->store->priv;
+	const gchar *fburi;
+
 	/* Look for fburl's of attendee with no free busy info on server */
 	if (!e_meeting_attendee_is_set_address (attendee)) {
-		process_callbacks (fbd->qdata);
-		return TRUE;
+		process_callbacks (qdata);
+		return;
 	}
 
-	/* Check for free busy info on the default server */
-	default_fb_uri = g_strdup (fbd->fb_uri);
-	fburi = g_strdup (e_meeting_attendee_get_fburi (attendee));
-
-	if (fburi && !*fburi) {
-		g_free (fburi);
-		fburi = NULL;
-	}
+	fburi = e_meeting_attendee_get_fburi (attendee);
 
-	if (fburi) {
-		priv->num_queries++;
-		start_async_read (fburi, fbd->qdata);
-		g_free (fburi);
-	} else if (default_fb_uri != NULL && !g_str_equal (default_fb_uri, "")) {
-		gchar *tmp_fb_uri;
+	if (fburi && *fburi) {
+		g_atomic_int_inc (&priv->num_queries);
+		start_async_read (fburi, qdata);
+	} else if (fb_uri != NULL && *fb_uri && strchr (email, '@')) {
+		gchar *tmp_fb_uri, *default_fb_uri;
 		gchar **split_email;
 
-		split_email = g_strsplit (fbd->email, "@", 2);
+		/* Check for free busy info on the default server */
+		split_email = g_strsplit (email, "@", 2);
 
-		tmp_fb_uri = replace_string (default_fb_uri, USER_SUB, split_email[0]);
-		g_free (default_fb_uri);
+		tmp_fb_uri = replace_string ((gchar *) fb_uri, USER_SUB, split_email[0]);
 		default_fb_uri = replace_string (tmp_fb_uri, DOMAIN_SUB, split_email[1]);
 
-		priv->num_queries++;
-		start_async_read (default_fb_uri, fbd->qdata);
+		g_atomic_int_inc (&priv->num_queries);
+		start_async_read (default_fb_uri, qdata);
 		g_free (tmp_fb_uri);
 		g_strfreev (split_email);
 		g_free (default_fb_uri);
 	} else {
-		process_callbacks (fbd->qdata);
+		/* Remember there is nothing to be found for this attendee */
+		if (queried_server)
+			free_busy_cache_store (email, qdata->startt, qdata->endt, "");
+
+		process_callbacks (qdata);
+	}
+}
+
+static void
+freebusy_async (gpointer data,
+		gpointer user_data)
+{
+	FreeBusyAsyncData *fbd = data;
+	ICalComponent **found;
+	guint ii;
+
+	found = g_new0 (ICalComponent *, fbd->qdatas->len);
+
+	if (fbd->client) {
+		EMeetingStorePrivate *priv = fbd->store->priv;
+		GSList *users = NULL, *fb_data = NULL, *link;
+
+		for (ii = fbd->emails->len; ii > 0; ii--)
+			users = g_slist_prepend (users, g_ptr_array_index (fbd->emails, ii - 1));
+
+		/* The store is kept alive by the queued attendees until
+		 * their callbacks are processed below. */
+		g_atomic_int_inc (&priv->num_queries);
+		e_cal_client_get_free_busy_sync (
+			fbd->client, fbd->startt,
+			fbd->endt, users, &fb_data, NULL, NULL);
+		g_atomic_int_dec_and_test (&priv->num_queries);
+
+		g_slist_free (users);
+
+		/* Split the answer by attendee; a lone attendee gets
+		 * everything, in case the backend does not say whose
+		 * information it is. */
+		for (link = fb_data; link; link = g_slist_next (link)) {
+			ICalComponent *icomp;
+
+			icomp = e_cal_component_get_icalcomponent (link->data);
+			if (!icomp)
+				continue;
+
+			for (ii = 0; ii < fbd->qdatas->len; ii++) {
+				if (fbd->qdatas->len == 1 ||
+				    free_busy_comp_has_address (icomp, g_ptr_array_index (fbd->emails, ii))) {
+					if (!found[ii])
+						found[ii] = e_cal_util_new_top_level ();
+
+					i_cal_component_take_component (found[ii], i_cal_component_clone (icomp));
+				}
+			}
+		}
+
+		g_slist_free_full (fb_data, g_object_unref);
 	}
 
-	return TRUE;
+	for (ii = 0; ii < fbd->qdatas->len; ii++) {
+		EMeetingStoreQueueData *qdata = g_ptr_array_index (fbd->qdatas, ii);
+		const gchar *email = g_ptr_array_index (fbd->emails, ii);
+
+		if (found[ii]) {
+			gchar *text;
+
+			text = i_cal_component_as_ical_string (found[ii]);
+			free_busy_cache_store (email, fbd->startt, fbd->endt, text);
+			process_free_busy (qdata, text);
+
+			g_object_unref (found[ii]);
+			g_free (text);
+		} else {
+			freebusy_fetch_from_url (qdata, fbd->fb_uri, email, fbd->client != NULL);
+		}
+	}
+
+	g_free (found);
+	free_busy_async_data_free (fbd);
 }
 
 #undef USER_SUB
 #undef DOMAIN_SUB
 
+static void
+freebusy_push (FreeBusyAsyncData *fbd)
+{
+	static GThreadPool *thread_pool = NULL;
+	static GMutex thread_pool_mutex;
+
+	g_mutex_lock (&thread_pool_mutex);
+
+	if (!thread_pool)
+		thread_pool = g_thread_pool_new (freebusy_async, NULL, FREE_BUSY_MAX_THREADS, FALSE, NULL);
+
+	g_thread_pool_push (thread_pool, fbd, NULL);
+
+	g_mutex_unlock (&thread_pool_mutex);
+}
+
+static time_t
+meeting_time_to_timet (const EMeetingTime *mtime,
+		       ICalTimezone *zone)
+{
+	ICalTime *itt;
+	time_t tt;
+
+	itt = i_cal_time_new_null_time ();
+	i_cal_time_set_date (itt,
+		g_date_get_year (&mtime->date),
+		g_date_get_month (&mtime->date),
+		g_date_get_day (&mtime->date));
+	i_cal_time_set_time (itt,
+		mtime->hour,
+		mtime->minute,
+		0);
+	tt = i_cal_time_as_timet_with_zone (itt, zone);
+	g_clear_object (&itt);
+
+	return tt;
+}
+
 static gboolean
 refresh_busy_periods (gpointer data)
 {
 	EMeetingStore *store = E_MEETING_STORE (data);
 	EMeetingStorePrivate *priv;
-	EMeetingAttendee *attendee = NULL;
-	EMeetingStoreQueueData *qdata = NULL;
+	FreeBusyAsyncData *fbd = NULL;
+	GPtrArray *cached_qdatas, *cached_texts;
 	gint i;
-	GThread *thread;
-	GError *error = NULL;
-	FreeBusyAsyncData *fbd;
 
 	priv = store->priv;
+	priv->refresh_idle_id = 0;
+
+	cached_qdatas = g_ptr_array_new ();
+	cached_texts = g_ptr_array_new_with_free_func (g_free);
 
-	/* Check to see if there are any remaining attendees in the queue */
+	/* Pick up everything in the queue which is not being refreshed yet */
 	for (i = 0; i < priv->refresh_queue->len; i++) {
+		EMeetingAttendee *attendee;
+		EMeetingStoreQueueData *qdata;
+		const gchar *email;
+		gchar *text;
+
 		attendee = g_ptr_array_index (priv->refresh_queue, i);
-		g_return_val_if_fail (attendee != NULL, FALSE);
+		g_warn_if_fail (attendee != NULL);
+		if (!attendee)
+			continue;
 
-		qdata = g_hash_table_lookup (
-			priv->refresh_data, itip_strip_mailto (
-			e_meeting_attendee_get_address (attendee)));
-		if (!qdata)
+		email = itip_strip_mailto (e_meeting_attendee_get_address (attendee));
+
+		qdata = g_hash_table_lookup (priv->refresh_data, email);
+		if (!qdata || qdata->refreshing)
 			continue;
 
-		if (!qdata->refreshing)
-			break;
-	}
+		/* Indicate we are trying to refresh it */
+		qdata->refreshing = TRUE;
 
-	/* The everything in the queue is being refreshed */
-	if (i >= priv->refresh_queue->len) {
-		priv->refresh_idle_id = 0;
-		return FALSE;
-	}
+		/* We take a ref in case we get destroyed in the gui during a callback */
+		g_object_ref (qdata->store);
 
-	/* Indicate we are trying to refresh it */
-	qdata->refreshing = TRUE;
-
-	/* We take a ref in case we get destroyed in the gui during a callback */
-	g_object_ref (qdata->store);
-
-	fbd = g_new0 (FreeBusyAsyncData, 1);
-	fbd->client = priv->client;
-	fbd->attendee = attendee;
-	fbd->users = NULL;
-	fbd->fb_data = NULL;
-	fbd->qdata = qdata;
-	fbd->fb_uri = priv->fb_uri;
-	fbd->store = store;
-	fbd->email = g_strdup (itip_strip_mailto (
-		e_meeting_attendee_get_address (attendee)));
+		g_mutex_lock (&priv->mutex);
+		priv->num_threads++;
+		g_mutex_unlock (&priv->mutex);
 
-	/* Check the server for free busy data */
-	if (priv->client) {
-		ICalTime *itt;
-
-		itt = i_cal_time_new_null_time ();
-		i_cal_time_set_date (itt,
-			g_date_get_year (&qdata->start.date),
-			g_date_get_month (&qdata->start.date),
-			g_date_get_day (&qdata->start.date));
-		i_cal_time_set_time (itt,
-			qdata->start.hour,
-			qdata->start.minute,
-			0);
-		fbd->startt = i_cal_time_as_timet_with_zone (itt, priv->zone);
-		g_clear_object (&itt);
-
-		itt = i_cal_time_new_null_time ();
-		i_cal_time_set_date (itt,
-			g_date_get_year (&qdata->end.date),
-			g_date_get_month (&qdata->end.date),
-			g_date_get_day (&qdata->end.date));
-		i_cal_time_set_time (itt,
-			qdata->end.hour,
-			qdata->end.minute,
-			0);
-		fbd->endt = i_cal_time_as_timet_with_zone (itt, priv->zone);
-		g_clear_object (&itt);
-
-		fbd->qdata = qdata;
-		fbd->users = g_slist_append (fbd->users, g_strdup (fbd->email));
+		qdata->startt = meeting_time_to_timet (&qdata->start, priv->zone);
+		qdata->endt = meeting_time_to_timet (&qdata->end, priv->zone);
 
-	}
+		text = free_busy_cache_lookup (email, qdata->startt, qdata->endt);
+		if (text) {
+			g_ptr_array_add (cached_qdatas, qdata);
+			g_ptr_array_add (cached_texts, text);
+			continue;
+		}
 
-	g_mutex_lock (&store->priv->mutex);
-	store->priv->num_threads++;
-	g_mutex_unlock (&store->priv->mutex);
+		if (!fbd) {
+			fbd = g_new0 (FreeBusyAsyncData, 1);
+			fbd->client = priv->client ? g_object_ref (priv->client) : NULL;
+			fbd->startt = qdata->startt;
+			fbd->endt = qdata->endt;
+			fbd->qdatas = g_ptr_array_new ();
+			fbd->emails = g_ptr_array_new_with_free_func (g_free);
+			fbd->fb_uri = g_strdup (priv->fb_uri);
+			fbd->store = store;
+		} else {
+			fbd->startt = MIN (fbd->startt, qdata->startt);
+			fbd->endt = MAX (fbd->endt, qdata->endt);
+		}
+
+		g_ptr_array_add (fbd->qdatas, qdata);
+		g_ptr_array_add (fbd->emails, g_strdup (email));
 
-	thread = g_thread_try_new (NULL, (GThreadFunc) freebusy_async, fbd, &error);
-	if (!thread) {
-		/* do clean up stuff here */
-		g_slist_foreach (fbd->users, (GFunc) g_free, NULL);
-		g_slist_free (fbd->users);
-		g_free (fbd->email);
-		priv->refresh_idle_id = 0;
+		if (fbd->qdatas->len >= FREE_BUSY_BATCH_SIZE) {
+			freebusy_push (fbd);
+			fbd = NULL;
+		}
+	}
 
-		g_mutex_lock (&store->priv->mutex);
-		store->priv->num_threads--;
-		g_mutex_unlock (&store->priv->mutex);
+	if (fbd)
+		freebusy_push (fbd);
 
-		return FALSE;
+	/* Processing removes the attendees from the refresh queue,
+	 * thus it cannot be done while traversing it above. */
+	for (i = 0; i < cached_qdatas->len; i++) {
+		EMeetingStoreQueueData *qdata = g_ptr_array_index (cached_qdatas, i);
+		const gchar *text = g_ptr_array_index (cached_texts, i);
+
+		if (*text)
+			process_free_busy (qdata, text);
+		else
+			process_callbacks (qdata);
 	}
 
-	g_thread_unref (thread);
+	g_ptr_array_unref (cached_qdatas);
+	g_ptr_array_unref (cached_texts);
 
-	return TRUE;
+	return FALSE;
 }
 
 static void
@@ -1934,7 +2169,7 @@ async_read (GObject *source_object,
 	if (read == 0) {
 		g_input_stream_close (istream, NULL, NULL);
 		g_object_unref (istream);
-		process_free_busy (qdata, qdata->string->str);
+		process_fetched_free_busy (qdata, qdata->string->str);
 	} else {
 		qdata->buffer[read] = '\0';
 		g_string_append (qdata->string, qdata->buffer);
@@ -2078,7 +2313,7 @@ soup_msg_ready_cb (SoupSession *session,
 		qdata->string = g_string_new_len (
 			msg->response_body->data,
 			msg->response_body->length);
-		process_free_busy (qdata, qdata->string->str);
+		process_fetched_free_busy (qdata, qdata->string->str);
 	} else {
 		g_warning (
 			"Unable to access free/busy url: %s",
@@ -2135,7 +2370,7 @@ start_async_read (const gchar *uri,
 	g_return_if_fail (uri != NULL);
 	g_return_if_fail (data != NULL);
 
-	qdata->store->priv->num_queries--;
+	g_atomic_int_dec_and_test (&qdata->store->priv->num_queries);
 	file = g_file_new_for_uri (uri);
 
 	g_return_if_fail (file != NULL);
@@ -2203,5 +2438,24 @@ e_meeting_store_get_num_queries (EMeetingStore *store)
 {
 	g_return_val_if_fail (E_IS_MEETING_STORE (store), 0);
 
-	return store->priv->num_queries;
+	return g_atomic_int_get (&store->priv->num_queries);
+}
+
+/**
+ * e_meeting_store_clear_free_busy_cache:
+ *
+ * Forgets all free/busy information fetched so far in this session,
+ * thus the next refresh of busy periods asks the servers again.
+ *
+ * Since: 3.38
+ **/
+void
+e_meeting_store_clear_free_busy_cache (void)
+{
+	G_LOCK (free_busy_cache);
+
+	if (free_busy_cache)
+		g_hash_table_remove_all (free_busy_cache);
+
+	G_UNLOCK (free_busy_cache);
 }
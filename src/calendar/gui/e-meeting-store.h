@@ -153,6 +153,8 @@ void		e_meeting_store_refresh_busy_periods
 						 gpointer data);
 
 guint		e_meeting_store_get_num_queries	(EMeetingStore *meeting_store);
+void		e_meeting_store_clear_free_busy_cache
+						(void);
 
 G_END_DECLS
 
@@ -46,6 +46,13 @@
 struct _EMeetingTimeSelectorPrivate {
 	gboolean use_24_hour_format;
 	gulong notify_free_busy_template_id;
+
+	/* Merged busy periods used by autopick */
+	GArray *busy_index;
+	GPtrArray *resource_busy_index;
+	gboolean busy_index_valid;
+	gboolean busy_index_skip_optional;
+	gboolean busy_index_need_one_resource;
 };
 
 /* An array of hour strings for 24 hour time, "0:00" .. "23:00". */
@@ -148,10 +155,7 @@ static void e_meeting_time_selector_find_nearest_interval_backward (EMeetingTime
 								    gint days, gint hours, gint mins);
 static void e_meeting_time_selector_adjust_time (EMeetingTime *mtstime,
 						 gint days, gint hours, gint minutes);
-static EMeetingFreeBusyPeriod * e_meeting_time_selector_find_time_clash (EMeetingTimeSelector *mts,
-									EMeetingAttendee *attendee,
-									EMeetingTime *start_time,
-									EMeetingTime *end_time);
+static void e_meeting_time_selector_invalidate_busy_index (EMeetingTimeSelector *mts);
 
 static void e_meeting_time_selector_recalc_grid (EMeetingTimeSelector *mts);
 static void e_meeting_time_selector_recalc_date_format (EMeetingTimeSelector *mts);
@@ -258,6 +262,10 @@ meeting_time_selector_dispose (GObject *object)
 		mts->style_change_idle_id = 0;
 	}
 
+	g_clear_pointer (&mts->priv->busy_index, g_array_unref);
+	g_clear_pointer (&mts->priv->resource_busy_index, g_ptr_array_unref);
+	mts->priv->busy_index_valid = FALSE;
+
 	/* Chain up to parent's dispose() method. */
 	G_OBJECT_CLASS (e_meeting_time_selector_parent_class)->dispose (object);
 }
@@ -1421,6 +1429,9 @@ e_meeting_time_selector_refresh_cb (gpointer data)
 		return FALSE;
 	}
 
+	/* New free/busy information arrived */
+	e_meeting_time_selector_invalidate_busy_index (mts);
+
 	if (e_meeting_store_get_num_queries (mts->model) == 0) {
 		GdkCursor *cursor;
 		GdkWindow *window;
@@ -1454,6 +1465,9 @@ e_meeting_time_selector_refresh_free_busy (EMeetingTimeSelector *mts,
 {
 	EMeetingTime start, end;
 
+	/* The busy periods are cleared when they are refreshed */
+	e_meeting_time_selector_invalidate_busy_index (mts);
+
 	/* nothing to refresh, lets not leak a busy cursor */
 	if (e_meeting_store_count_actual_attendees (mts->model) <= 0)
 		return;
@@ -1599,6 +1613,9 @@ e_meeting_time_selector_on_update_free_busy (GtkWidget *button,
 	if (gtk_widget_get_visible (mts->options_menu))
 		gtk_menu_popdown (GTK_MENU (mts->options_menu));
 
+	/* An explicit update should not be answered from the cache */
+	e_meeting_store_clear_free_busy_cache ();
+
 	e_meeting_time_selector_refresh_free_busy (mts, 0, TRUE);
 }
 
@@ -1643,6 +1660,193 @@ e_meeting_time_selector_on_next_button_clicked (GtkWidget *button,
 	e_meeting_time_selector_autopick (mts, TRUE);
 }
 
+/* The busy periods of the attendees are merged into sorted, disjoint
+ * blocks, so autopick can skip each clash in one step instead of probing
+ * every attendee for every candidate time. The times are also kept as
+ * minutes since 1/1/1 for cheap comparisons. */
+typedef struct _EMeetingTimeSelectorBusy {
+	gint64 start_key;
+	gint64 end_key;
+	EMeetingTime start;
+	EMeetingTime end;
+} EMeetingTimeSelectorBusy;
+
+static gint64
+e_meeting_time_selector_time_to_minutes (const EMeetingTime *mtstime)
+{
+	return ((gint64) g_date_get_julian (&mtstime->date)) * 24 * 60 +
+		mtstime->hour * 60 + mtstime->minute;
+}
+
+static gint
+e_meeting_time_selector_busy_compare (gconstpointer a,
+                                      gconstpointer b)
+{
+	const EMeetingTimeSelectorBusy *busy1 = a, *busy2 = b;
+
+	if (busy1->start_key != busy2->start_key)
+		return busy1->start_key < busy2->start_key ? -1 : 1;
+
+	if (busy1->end_key != busy2->end_key)
+		return busy1->end_key < busy2->end_key ? -1 : 1;
+
+	return 0;
+}
+
+static void
+e_meeting_time_selector_add_busy_periods (GArray *busy_index,
+                                          EMeetingAttendee *attendee)
+{
+	const GArray *busy_periods;
+	guint ii;
+
+	busy_periods = e_meeting_attendee_get_busy_periods (attendee);
+	if (!busy_periods)
+		return;
+
+	for (ii = 0; ii < busy_periods->len; ii++) {
+		EMeetingFreeBusyPeriod *period;
+		EMeetingTimeSelectorBusy busy;
+
+		period = &g_array_index (busy_periods, EMeetingFreeBusyPeriod, ii);
+
+		busy.start = period->start;
+		busy.end = period->end;
+		busy.start_key = e_meeting_time_selector_time_to_minutes (&busy.start);
+		busy.end_key = e_meeting_time_selector_time_to_minutes (&busy.end);
+
+		g_array_append_val (busy_index, busy);
+	}
+}
+
+/* Sorts the busy periods and joins the overlapping ones. Periods which
+ * only touch are kept apart, thus a meeting clashes with a block exactly
+ * when it clashed with one of the periods the block was made of. */
+static void
+e_meeting_time_selector_merge_busy_periods (GArray *busy_index)
+{
+	EMeetingTimeSelectorBusy *last = NULL;
+	guint ii, len = 0;
+
+	g_array_sort (busy_index, e_meeting_time_selector_busy_compare);
+
+	for (ii = 0; ii < busy_index->len; ii++) {
+		EMeetingTimeSelectorBusy *busy;
+
+		busy = &g_array_index (busy_index, EMeetingTimeSelectorBusy, ii);
+
+		if (last && busy->start_key < last->end_key) {
+			if (busy->end_key > last->end_key) {
+				last->end_key = busy->end_key;
+				last->end = busy->end;
+			}
+		} else {
+			last = &g_array_index (busy_index, EMeetingTimeSelectorBusy, len);
+			if (last != busy)
+				*last = *busy;
+			len++;
+		}
+	}
+
+	g_array_set_size (busy_index, len);
+}
+
+static void
+e_meeting_time_selector_invalidate_busy_index (EMeetingTimeSelector *mts)
+{
+	mts->priv->busy_index_valid = FALSE;
+}
+
+/* Builds the busy blocks of the people who all have to be free and,
+ * when only one of the resources is needed, separate blocks for each
+ * resource. They are reused until the free/busy data or the attendees
+ * change. */
+static void
+e_meeting_time_selector_ensure_busy_index (EMeetingTimeSelector *mts,
+                                           gboolean skip_optional,
+                                           gboolean need_one_resource)
+{
+	EMeetingTimeSelectorPrivate *priv = mts->priv;
+	gint row, n_rows;
+
+	if (priv->busy_index_valid &&
+	    priv->busy_index_skip_optional == skip_optional &&
+	    priv->busy_index_need_one_resource == need_one_resource)
+		return;
+
+	if (priv->busy_index)
+		g_array_set_size (priv->busy_index, 0);
+	else
+		priv->busy_index = g_array_new (FALSE, FALSE, sizeof (EMeetingTimeSelectorBusy));
+
+	if (priv->resource_busy_index)
+		g_ptr_array_set_size (priv->resource_busy_index, 0);
+	else
+		priv->resource_busy_index = g_ptr_array_new_with_free_func ((GDestroyNotify) g_array_unref);
+
+	n_rows = e_meeting_store_count_actual_attendees (mts->model);
+
+	for (row = 0; row < n_rows; row++) {
+		EMeetingAttendee *attendee;
+		EMeetingAttendeeType atype;
+
+		attendee = e_meeting_store_find_attendee_at_row (mts->model, row);
+		atype = e_meeting_attendee_get_atype (attendee);
+
+		/* Skip optional people if they don't matter. */
+		if (skip_optional && atype == E_MEETING_ATTENDEE_OPTIONAL_PERSON)
+			continue;
+
+		if (need_one_resource && atype == E_MEETING_ATTENDEE_RESOURCE) {
+			GArray *resource_index;
+
+			resource_index = g_array_new (FALSE, FALSE, sizeof (EMeetingTimeSelectorBusy));
+			e_meeting_time_selector_add_busy_periods (resource_index, attendee);
+			e_meeting_time_selector_merge_busy_periods (resource_index);
+
+			g_ptr_array_add (priv->resource_busy_index, resource_index);
+		} else {
+			e_meeting_time_selector_add_busy_periods (priv->busy_index, attendee);
+		}
+	}
+
+	e_meeting_time_selector_merge_busy_periods (priv->busy_index);
+
+	priv->busy_index_valid = TRUE;
+	priv->busy_index_skip_optional = skip_optional;
+	priv->busy_index_need_one_resource = need_one_resource;
+}
+
+/* Returns the busy block which clashes with the given time span, or NULL.
+ * The blocks are disjoint and sorted, so the only candidate is the first
+ * one which ends after the start, found with a binary search. */
+static EMeetingTimeSelectorBusy *
+e_meeting_time_selector_find_busy_clash (GArray *busy_index,
+                                         gint64 start_key,
+                                         gint64 end_key)
+{
+	EMeetingTimeSelectorBusy *busy;
+	guint lower = 0, upper = busy_index->len;
+
+	while (lower < upper) {
+		guint middle = (lower + upper) >> 1;
+
+		busy = &g_array_index (busy_index, EMeetingTimeSelectorBusy, middle);
+
+		if (busy->end_key > start_key)
+			upper = middle;
+		else
+			lower = middle + 1;
+	}
+
+	if (lower >= busy_index->len)
+		return NULL;
+
+	busy = &g_array_index (busy_index, EMeetingTimeSelectorBusy, lower);
+
+	return busy->start_key < end_key ? busy : NULL;
+}
+
 /* This tries to find the previous or next meeting time for which all
  * attendees will be available. */
 static void
@@ -1650,12 +1854,12 @@ e_meeting_time_selector_autopick (EMeetingTimeSelector *mts,
                                   gboolean forward)
 {
 	EMeetingTime start_time, end_time, *resource_free;
-	EMeetingAttendee *attendee;
-	EMeetingFreeBusyPeriod *period;
 	EMeetingTimeSelectorAutopickOption autopick_option;
-	gint duration_days, duration_hours, duration_minutes, row;
+	EMeetingTimeSelectorBusy *busy;
+	gint duration_days, duration_hours, duration_minutes;
 	gboolean meeting_time_ok, skip_optional = FALSE;
 	gboolean need_one_resource = FALSE, found_resource;
+	guint ii;
 
 	/* Get the current meeting duration in days + hours + minutes. */
 	e_meeting_time_selector_calculate_time_difference (&mts->meeting_start_time, &mts->meeting_end_time, &duration_days, &duration_hours, &duration_minutes);
@@ -1677,67 +1881,66 @@ e_meeting_time_selector_autopick (EMeetingTimeSelector *mts,
 	    || autopick_option == E_MEETING_TIME_SELECTOR_REQUIRED_PEOPLE_AND_ONE_RESOURCE)
 		need_one_resource = TRUE;
 
+	e_meeting_time_selector_ensure_busy_index (mts, skip_optional, need_one_resource);
+
 	/* Keep moving forward or backward until we find a possible meeting
 	 * time. */
 	for (;;) {
+		gint64 start_key, end_key;
+
 		meeting_time_ok = TRUE;
 		found_resource = FALSE;
 		resource_free = NULL;
 
-		/* Step through each attendee, checking if the meeting time
-		 * intersects one of the attendees busy periods. */
-		for (row = 0; row < e_meeting_store_count_actual_attendees (mts->model); row++) {
-			attendee = e_meeting_store_find_attendee_at_row (mts->model, row);
-
-			/* Skip optional people if they don't matter. */
-			if (skip_optional && e_meeting_attendee_get_atype (attendee) == E_MEETING_ATTENDEE_OPTIONAL_PERSON)
-				continue;
-
-			period = e_meeting_time_selector_find_time_clash (mts, attendee, &start_time, &end_time);
-
-			if (need_one_resource && e_meeting_attendee_get_atype (attendee) == E_MEETING_ATTENDEE_RESOURCE) {
-				if (period) {
-					/* We want to remember the closest
-					 * prev/next time that one resource is
-					 * available, in case we don't find any
-					 * free resources. */
-					if (forward) {
-						if (!resource_free || e_meeting_time_compare_times (resource_free, &period->end) > 0)
-							resource_free = &period->end;
-					} else {
-						if (!resource_free || e_meeting_time_compare_times (resource_free, &period->start) < 0)
-							resource_free = &period->start;
-					}
+		start_key = e_meeting_time_selector_time_to_minutes (&start_time);
+		end_key = e_meeting_time_selector_time_to_minutes (&end_time);
 
-				} else {
+		/* Check if the meeting time intersects the busy periods of
+		 * the attendees who all have to be free. */
+		busy = e_meeting_time_selector_find_busy_clash (mts->priv->busy_index, start_key, end_key);
+
+		if (busy) {
+			/* Skip the whole busy block which clashed. */
+			if (forward) {
+				start_time = busy->end;
+			} else {
+				start_time = busy->start;
+				e_meeting_time_selector_adjust_time (&start_time, -duration_days, -duration_hours, -duration_minutes);
+			}
+			meeting_time_ok = FALSE;
+		} else if (need_one_resource) {
+			for (ii = 0; ii < mts->priv->resource_busy_index->len; ii++) {
+				busy = e_meeting_time_selector_find_busy_clash (
+					g_ptr_array_index (mts->priv->resource_busy_index, ii),
+					start_key, end_key);
+
+				if (!busy) {
 					found_resource = TRUE;
+					break;
 				}
-			} else if (period) {
-				/* Skip the period which clashed. */
+
+				/* We want to remember the closest prev/next
+				 * time that one resource is available, in case
+				 * we don't find any free resources. */
 				if (forward) {
-					start_time = period->end;
+					if (!resource_free || e_meeting_time_compare_times (resource_free, &busy->end) > 0)
+						resource_free = &busy->end;
 				} else {
-					start_time = period->start;
-					e_meeting_time_selector_adjust_time (&start_time, -duration_days, -duration_hours, -duration_minutes);
+					if (!resource_free || e_meeting_time_compare_times (resource_free, &busy->start) < 0)
+						resource_free = &busy->start;
 				}
-				meeting_time_ok = FALSE;
-				break;
 			}
-		}
 
-		/* Check that we found one resource if necessary. If not, skip
-		 * to the closest time that a resource is free. Note that if
-		 * there are no resources, resource_free will never get set,
-		 * so we assume the meeting time is OK. */
-		if (meeting_time_ok && need_one_resource && !found_resource
-		    && resource_free) {
-			if (forward) {
+			/* If no resource is free, skip to the closest time
+			 * that one is. Note that if there are no resources,
+			 * resource_free will never get set, so we assume the
+			 * meeting time is OK. */
+			if (!found_resource && resource_free) {
 				start_time = *resource_free;
-			} else {
-				start_time = *resource_free;
-				e_meeting_time_selector_adjust_time (&start_time, -duration_days, -duration_hours, -duration_minutes);
+				if (!forward)
+					e_meeting_time_selector_adjust_time (&start_time, -duration_days, -duration_hours, -duration_minutes);
+				meeting_time_ok = FALSE;
 			}
-			meeting_time_ok = FALSE;
 		}
 
 		if (meeting_time_ok) {
@@ -2011,47 +2214,6 @@ e_meeting_time_selector_adjust_time (EMeetingTime *mtstime,
 	e_meeting_time_selector_fix_time_overflows (mtstime);
 }
 
-/* This looks for any busy period of the given attendee which clashes with
- * the start and end time. It uses a binary search. */
-static EMeetingFreeBusyPeriod *
-e_meeting_time_selector_find_time_clash (EMeetingTimeSelector *mts,
-                                         EMeetingAttendee *attendee,
-                                         EMeetingTime *start_time,
-                                         EMeetingTime *end_time)
-{
-	EMeetingFreeBusyPeriod *period;
-	const GArray *busy_periods;
-	gint period_num;
-
-	busy_periods = e_meeting_attendee_get_busy_periods (attendee);
-	period_num = e_meeting_attendee_find_first_busy_period (attendee, &start_time->date);
-
-	if (period_num == -1)
-		return NULL;
-
-	/* Step forward through the busy periods until we find a clash or we
-	 * go past the end_time. */
-	while (period_num < busy_periods->len) {
-		period = &g_array_index (busy_periods,  EMeetingFreeBusyPeriod, period_num);
-
-		/* If the period starts at or after the end time, there is no
-		 * clash and we are finished. The busy periods are sorted by
-		 * their start times, so all the rest will be later. */
-		if (e_meeting_time_compare_times (&period->start, end_time) >= 0)
-			return NULL;
-
-		/* If the period ends after the start time, we have found a
-		 * clash. From the above test we already know the busy period
-		 * isn't completely after the meeting time. */
-		if (e_meeting_time_compare_times (&period->end, start_time) > 0)
-			return period;
-
-		period_num++;
-	}
-
-	return NULL;
-}
-
 static void
 e_meeting_time_selector_on_zoomed_out_toggled (GtkCheckMenuItem *menuitem,
                                                EMeetingTimeSelector *mts)
@@ -3184,6 +3346,8 @@ row_deleted_cb (GtkTreeModel *model,
 {
 	EMeetingTimeSelector *mts = E_MEETING_TIME_SELECTOR (data);
 
+	e_meeting_time_selector_invalidate_busy_index (mts);
+
 	/* Update the scroll region. */
 	e_meeting_time_selector_update_main_canvas_scroll_region (mts);
 
@@ -3200,6 +3364,7 @@ free_busy_timeout_refresh (gpointer data)
 	EMeetingTimeSelector *mts = E_MEETING_TIME_SELECTOR (data);
 
 	/* Update all free/busy info, so we use the new template uri */
+	e_meeting_store_clear_free_busy_cache ();
 	e_meeting_time_selector_refresh_free_busy (mts, 0, TRUE);
 
 	mts->fb_refresh_not = 0;
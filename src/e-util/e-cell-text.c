@@ -110,6 +110,17 @@ G_DEFINE_TYPE (ECellText, e_cell_text, E_TYPE_CELL)
 
 #define TEXT_PAD 4
 
+/* Number of shaped layouts kept per view, enough
+ * for all visible rows of a column on large screens */
+#define LAYOUT_CACHE_SIZE 256
+
+enum {
+	TEXT_ATTR_BOLD = 1 << 0,
+	TEXT_ATTR_STRIKEOUT = 1 << 1,
+	TEXT_ATTR_UNDERLINE = 1 << 2,
+	TEXT_ATTR_ITALIC = 1 << 3
+};
+
 typedef struct {
 	gpointer lines;			/* Text split into lines (private field) */
 	gint num_lines;			/* Number of lines of text */
@@ -133,8 +144,20 @@ typedef struct {
 	gint xofs, yofs;                 /* This gets added to the x
                                            and y for the cell text. */
 	gdouble ellipsis_width[2];      /* The width of the ellipsis. */
+
+	/* Recently shaped layouts, keyed by the text, width and
+	 * attributes; the queue references the keys, most recent first. */
+	GHashTable *layout_cache;
+	GQueue layout_cache_keys;
+	guint layout_cache_serial;	/* of the canvas PangoContext */
+	gulong style_updated_handler_id;
 } ECellTextView;
 
+typedef struct {
+	PangoLayout *layout;
+	GList *link;			/* in layout_cache_keys */
+} LayoutCacheEntry;
+
 struct _CellEdit {
 
 	ECellTextView *text_view;
@@ -205,7 +228,8 @@ static gboolean e_cell_text_retrieve_surrounding_cb (GtkIMContext *context, ECel
 static gboolean e_cell_text_delete_surrounding_cb   (GtkIMContext *context, gint          offset, gint          n_chars, ECellTextView        *text_view);
 static void _insert (ECellTextView *text_view, const gchar *string, gint value);
 static void _delete_selection (ECellTextView *text_view);
-static PangoAttrList * build_attr_list (ECellTextView *text_view, gint row, gint text_length);
+static guint get_text_attrs (ECellTextView *text_view, gint row, guint *strikeout_color);
+static PangoAttrList * build_attr_list (guint text_attrs, guint strikeout_color, gint text_length);
 static void update_im_cursor_location (ECellTextView *tv);
 
 static gchar *
@@ -329,6 +353,29 @@ ect_cancel_edit (ECellTextView *text_view)
 	e_table_item_leave_edit_ (text_view->cell_view.e_table_item_view);
 }
 
+static void
+layout_cache_entry_free (gpointer data)
+{
+	LayoutCacheEntry *entry = data;
+
+	g_object_unref (entry->layout);
+	g_slice_free (LayoutCacheEntry, entry);
+}
+
+static void
+layout_cache_clear (ECellTextView *text_view)
+{
+	g_hash_table_remove_all (text_view->layout_cache);
+	g_queue_clear (&text_view->layout_cache_keys);
+}
+
+static void
+ect_style_updated_cb (GtkWidget *canvas,
+                      ECellTextView *text_view)
+{
+	layout_cache_clear (text_view);
+}
+
 /*
  * ECell::new_view method
  */
@@ -351,6 +398,12 @@ ect_new_view (ECell *ecell,
 	text_view->xofs = 0.0;
 	text_view->yofs = 0.0;
 
+	text_view->layout_cache = g_hash_table_new_full (
+		g_str_hash, g_str_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) layout_cache_entry_free);
+	g_queue_init (&text_view->layout_cache_keys);
+
 	return (ECellView *) text_view;
 }
 
@@ -368,6 +421,9 @@ ect_kill_view (ECellView *ecv)
 	if (text_view->cell_view.kill_view_cb_data)
 	    g_list_free (text_view->cell_view.kill_view_cb_data);
 
+	layout_cache_clear (text_view);
+	g_hash_table_destroy (text_view->layout_cache);
+
 	g_free (text_view);
 }
 
@@ -381,6 +437,10 @@ ect_realize (ECellView *ecell_view)
 
 	text_view->i_cursor = gdk_cursor_new (GDK_XTERM);
 
+	text_view->style_updated_handler_id = g_signal_connect (
+		text_view->canvas, "style-updated",
+		G_CALLBACK (ect_style_updated_cb), text_view);
+
 	if (E_CELL_CLASS (e_cell_text_parent_class)->realize)
 		(* E_CELL_CLASS (e_cell_text_parent_class)->realize) (ecell_view);
 }
@@ -399,61 +459,80 @@ ect_unrealize (ECellView *ecv)
 
 	g_object_unref (text_view->i_cursor);
 
+	if (text_view->style_updated_handler_id) {
+		g_signal_handler_disconnect (text_view->canvas, text_view->style_updated_handler_id);
+		text_view->style_updated_handler_id = 0;
+	}
+
+	layout_cache_clear (text_view);
+
 	if (E_CELL_CLASS (e_cell_text_parent_class)->unrealize)
 		(* E_CELL_CLASS (e_cell_text_parent_class)->unrealize) (ecv);
 
 }
 
-static PangoAttrList *
-build_attr_list (ECellTextView *text_view,
-                 gint row,
-                 gint text_length)
+static guint
+get_text_attrs (ECellTextView *text_view,
+                gint row,
+                guint *strikeout_color)
 {
-
 	ECellView *ecell_view = (ECellView *) text_view;
 	ECellText *ect = E_CELL_TEXT (ecell_view->ecell);
-	PangoAttrList *attrs = pango_attr_list_new ();
-	gboolean bold, strikeout, underline, italic;
-	gint strikeout_color = 0;
-
-	bold = ect->bold_column >= 0 &&
-		row >= 0 &&
-		e_table_model_value_at (ecell_view->e_table_model, ect->bold_column, row);
-	strikeout = ect->strikeout_column >= 0 &&
-		row >= 0 &&
-		e_table_model_value_at (ecell_view->e_table_model, ect->strikeout_column, row);
-	underline = ect->underline_column >= 0 &&
-		row >= 0 &&
-		e_table_model_value_at (ecell_view->e_table_model, ect->underline_column, row);
-	italic = ect->italic_column >= 0 &&
-		row >= 0 &&
-		e_table_model_value_at (ecell_view->e_table_model, ect->italic_column, row);
+	guint text_attrs = 0;
+
+	*strikeout_color = 0;
+
+	if (row < 0)
+		return 0;
+
+	if (ect->bold_column >= 0 &&
+	    e_table_model_value_at (ecell_view->e_table_model, ect->bold_column, row))
+		text_attrs |= TEXT_ATTR_BOLD;
+	if (ect->strikeout_column >= 0 &&
+	    e_table_model_value_at (ecell_view->e_table_model, ect->strikeout_column, row))
+		text_attrs |= TEXT_ATTR_STRIKEOUT;
+	if (ect->underline_column >= 0 &&
+	    e_table_model_value_at (ecell_view->e_table_model, ect->underline_column, row))
+		text_attrs |= TEXT_ATTR_UNDERLINE;
+	if (ect->italic_column >= 0 &&
+	    e_table_model_value_at (ecell_view->e_table_model, ect->italic_column, row))
+		text_attrs |= TEXT_ATTR_ITALIC;
 
-	if (ect->strikeout_color_column >= 0 && row >= 0)
-		strikeout_color = GPOINTER_TO_UINT (e_table_model_value_at (ecell_view->e_table_model, ect->strikeout_color_column, row));
+	if (ect->strikeout_color_column >= 0)
+		*strikeout_color = GPOINTER_TO_UINT (e_table_model_value_at (ecell_view->e_table_model, ect->strikeout_color_column, row));
 
-	if (bold) {
+	return text_attrs;
+}
+
+static PangoAttrList *
+build_attr_list (guint text_attrs,
+                 guint strikeout_color,
+                 gint text_length)
+{
+	PangoAttrList *attrs = pango_attr_list_new ();
+
+	if ((text_attrs & TEXT_ATTR_BOLD) != 0) {
 		PangoAttribute *attr = pango_attr_weight_new (PANGO_WEIGHT_BOLD);
 		attr->start_index = 0;
 		attr->end_index = text_length;
 
 		pango_attr_list_insert_before (attrs, attr);
 	}
-	if (strikeout) {
+	if ((text_attrs & TEXT_ATTR_STRIKEOUT) != 0) {
 		PangoAttribute *attr = pango_attr_strikethrough_new (TRUE);
 		attr->start_index = 0;
 		attr->end_index = text_length;
 
 		pango_attr_list_insert_before (attrs, attr);
 	}
-	if (underline) {
+	if ((text_attrs & TEXT_ATTR_UNDERLINE) != 0) {
 		PangoAttribute *attr = pango_attr_underline_new (TRUE);
 		attr->start_index = 0;
 		attr->end_index = text_length;
 
 		pango_attr_list_insert_before (attrs, attr);
 	}
-	if (italic) {
+	if ((text_attrs & TEXT_ATTR_ITALIC) != 0) {
 		PangoAttribute *attr = pango_attr_style_new (PANGO_STYLE_ITALIC);
 		attr->start_index = 0;
 		attr->end_index = text_length;
@@ -485,6 +564,7 @@ layout_with_preedit (ECellTextView *text_view,
 	PangoAttrList *attrs;
 	PangoLayout *layout;
 	GString *tmp_string = g_string_new (NULL);
+	guint text_attrs, strikeout_color;
 	PangoAttrList *preedit_attrs = NULL;
 	gchar *preedit_string = NULL;
 	gint preedit_length = 0;
@@ -523,7 +603,8 @@ layout_with_preedit (ECellTextView *text_view,
 
 	pango_layout_set_text (layout, tmp_string->str, tmp_string->len);
 
-	attrs = (PangoAttrList *) build_attr_list (text_view, row, text_length);
+	text_attrs = get_text_attrs (text_view, row, &strikeout_color);
+	attrs = build_attr_list (text_attrs, strikeout_color, text_length);
 
 	if (preedit_length)
 		pango_attr_list_splice (attrs, preedit_attrs, mlen, preedit_length);
@@ -542,9 +623,10 @@ layout_with_preedit (ECellTextView *text_view,
 
 static PangoLayout *
 build_layout (ECellTextView *text_view,
-              gint row,
               const gchar *text,
-              gint width)
+              gint width,
+              guint text_attrs,
+              guint strikeout_color)
 {
 	ECellView *ecell_view = (ECellView *) text_view;
 	ECellText *ect = E_CELL_TEXT (ecell_view->ecell);
@@ -553,7 +635,7 @@ build_layout (ECellTextView *text_view,
 
 	layout = gtk_widget_create_pango_layout (GTK_WIDGET (((GnomeCanvasItem *) ecell_view->e_table_item_view)->canvas), text);
 
-	attrs = (PangoAttrList *) build_attr_list (text_view, row, text ? strlen (text) : 0);
+	attrs = build_attr_list (text_attrs, strikeout_color, text ? strlen (text) : 0);
 
 	pango_layout_set_attributes (layout, attrs);
 	pango_attr_list_unref (attrs);
@@ -619,7 +701,12 @@ generate_layout (ECellTextView *text_view,
 	ECellView *ecell_view = (ECellView *) text_view;
 	ECellText *ect = E_CELL_TEXT (ecell_view->ecell);
 	PangoLayout *layout;
+	PangoContext *pango_context;
+	LayoutCacheEntry *entry;
 	CellEdit *edit = text_view->edit;
+	gchar *temp = NULL, *key;
+	const gchar *text;
+	guint text_attrs, strikeout_color;
 
 	if (edit && edit->layout && edit->model_col == model_col && edit->row == row) {
 		g_object_ref (edit->layout);
@@ -627,13 +714,54 @@ generate_layout (ECellTextView *text_view,
 	}
 
 	if (row >= 0) {
-		gchar *temp = e_cell_text_get_text (ect, ecell_view->e_table_model, model_col, row);
-		layout = build_layout (text_view, row, temp ? temp : "", width);
-		e_cell_text_free_text (ect, ecell_view->e_table_model, model_col, temp);
+		temp = e_cell_text_get_text (ect, ecell_view->e_table_model, model_col, row);
+		text = temp ? temp : "";
 	} else
-		layout = build_layout (text_view, row, "Mumbo Jumbo", width);
+		text = "Mumbo Jumbo";
 
-	return layout;
+	text_attrs = get_text_attrs (text_view, row, &strikeout_color);
+
+	/* The edited layout is modified in place, thus do not share it */
+	if (edit) {
+		layout = build_layout (text_view, text, width, text_attrs, strikeout_color);
+		if (row >= 0)
+			e_cell_text_free_text (ect, ecell_view->e_table_model, model_col, temp);
+		return layout;
+	}
+
+	/* Font or resolution changes without a style update also
+	 * change the context serial, the shapes are stale then */
+	pango_context = gtk_widget_get_pango_context (GTK_WIDGET (text_view->canvas));
+	if (text_view->layout_cache_serial != pango_context_get_serial (pango_context)) {
+		layout_cache_clear (text_view);
+		text_view->layout_cache_serial = pango_context_get_serial (pango_context);
+	}
+
+	key = g_strdup_printf ("%d:%x:%x:%s", width, text_attrs, strikeout_color, text);
+
+	entry = g_hash_table_lookup (text_view->layout_cache, key);
+	if (entry) {
+		g_queue_unlink (&text_view->layout_cache_keys, entry->link);
+		g_queue_push_head_link (&text_view->layout_cache_keys, entry->link);
+		g_free (key);
+	} else {
+		if (g_queue_get_length (&text_view->layout_cache_keys) >= LAYOUT_CACHE_SIZE) {
+			gchar *oldest = g_queue_pop_tail (&text_view->layout_cache_keys);
+
+			g_hash_table_remove (text_view->layout_cache, oldest);
+		}
+
+		entry = g_slice_new (LayoutCacheEntry);
+		entry->layout = build_layout (text_view, text, width, text_attrs, strikeout_color);
+		g_queue_push_head (&text_view->layout_cache_keys, key);
+		entry->link = g_queue_peek_head_link (&text_view->layout_cache_keys);
+		g_hash_table_insert (text_view->layout_cache, key, entry);
+	}
+
+	if (row >= 0)
+		e_cell_text_free_text (ect, ecell_view->e_table_model, model_col, temp);
+
+	return g_object_ref (entry->layout);
 }
 
 static void
@@ -27,20 +27,78 @@
 
 #include "e-html-utils.h"
 
-static gchar *
-check_size (gchar **buffer,
-            gint *buffer_size,
-            gchar *out,
-            gint len)
+/* Byte classes for the plain-text fast path in e_text_to_html_full().
+ * A byte whose class intersects the stop mask for the given flags needs
+ * the slow path; anything else is copied to the output verbatim. */
+#define TEXT_CLASS_STOP  (1 << 0)	/* NUL, controls, 8-bit, <>&" and \n */
+#define TEXT_CLASS_SPACE (1 << 1)	/* space */
+#define TEXT_CLASS_TAB   (1 << 2)	/* tab */
+#define TEXT_CLASS_URL   (1 << 3)	/* first letter of a recognized URL */
+#define TEXT_CLASS_AT    (1 << 4)	/* @ */
+
+static guint8 text_class[256];
+
+static void
+text_class_init (void)
 {
-	if (out + len + 1> *buffer + *buffer_size) {
-		gint index = out - *buffer;
+	static gsize initialized = 0;
+
+	if (g_once_init_enter (&initialized)) {
+		const gchar *url_starts = "cfhmnstwCFHMNSTW";
+		gint ii;
+
+		for (ii = 0; ii < 256; ii++) {
+			if ((ii < 0x20 && ii != '\r' && ii != '\t') || ii >= 0x80)
+				text_class[ii] = TEXT_CLASS_STOP;
+		}
 
-		*buffer_size = MAX (index + len + 1, *buffer_size * 2);
-		*buffer = g_realloc (*buffer, *buffer_size);
-		out = *buffer + index;
+		text_class['<'] = TEXT_CLASS_STOP;
+		text_class['>'] = TEXT_CLASS_STOP;
+		text_class['&'] = TEXT_CLASS_STOP;
+		text_class['"'] = TEXT_CLASS_STOP;
+		text_class[' '] = TEXT_CLASS_SPACE;
+		text_class['\t'] = TEXT_CLASS_TAB;
+		text_class['@'] = TEXT_CLASS_AT;
+
+		for (ii = 0; url_starts[ii]; ii++)
+			text_class[(guchar) url_starts[ii]] = TEXT_CLASS_URL;
+
+		g_once_init_leave (&initialized, 1);
 	}
-	return out;
+}
+
+static guint8
+text_class_stop_mask (guint flags)
+{
+	guint8 mask = TEXT_CLASS_STOP;
+
+	if (flags & (E_TEXT_TO_HTML_CONVERT_SPACES | E_TEXT_TO_HTML_CONVERT_ALL_SPACES))
+		mask |= TEXT_CLASS_SPACE | TEXT_CLASS_TAB;
+	if (flags & E_TEXT_TO_HTML_CONVERT_NL)
+		mask |= TEXT_CLASS_TAB;
+	if (flags & E_TEXT_TO_HTML_CONVERT_URLS)
+		mask |= TEXT_CLASS_URL;
+	if (flags & E_TEXT_TO_HTML_CONVERT_ADDRESSES)
+		mask |= TEXT_CLASS_AT;
+
+	return mask;
+}
+
+static void
+html_append_char_ref (GString *out,
+                      gunichar u)
+{
+	gchar digits[12];
+	gint pos = G_N_ELEMENTS (digits);
+
+	do {
+		digits[--pos] = '0' + (u % 10);
+		u /= 10;
+	} while (u && pos > 0);
+
+	g_string_append_len (out, "&#", 2);
+	g_string_append_len (out, digits + pos, G_N_ELEMENTS (digits) - pos);
+	g_string_append_c (out, ';');
 }
 
 /* auto-urlification hints: the goal is not to be strictly RFC-compliant,
@@ -110,9 +168,44 @@ url_extract (const guchar **text,
 	return out;
 }
 
+/* Matches the URL schemes recognized by e_text_to_html_full(),
+ * branching on the first letter instead of probing each scheme. */
+static gboolean
+url_has_scheme (const guchar *text)
+{
+	const gchar *str = (const gchar *) text;
+
+	switch (*text) {
+	case 'c': case 'C':
+		return !g_ascii_strncasecmp (str, "callto:", 7);
+	case 'f': case 'F':
+		return !g_ascii_strncasecmp (str, "ftp://", 6) ||
+		       !g_ascii_strncasecmp (str, "file:", 5);
+	case 'h': case 'H':
+		return !g_ascii_strncasecmp (str, "http://", 7) ||
+		       !g_ascii_strncasecmp (str, "https://", 8) ||
+		       !g_ascii_strncasecmp (str, "h323:", 5);
+	case 'm': case 'M':
+		return !g_ascii_strncasecmp (str, "mailto:", 7);
+	case 'n': case 'N':
+		return !g_ascii_strncasecmp (str, "nntp://", 7) ||
+		       !g_ascii_strncasecmp (str, "news:", 5);
+	case 's': case 'S':
+		return !g_ascii_strncasecmp (str, "sip:", 4);
+	case 't': case 'T':
+		return !g_ascii_strncasecmp (str, "tel:", 4);
+	case 'w': case 'W':
+		return !g_ascii_strncasecmp (str, "webcal:", 7);
+	default:
+		break;
+	}
+
+	return FALSE;
+}
+
 static gchar *
 email_address_extract (const guchar **cur,
-                       gchar **out,
+                       GString *out,
                        const guchar *linestart)
 {
 	const guchar *start, *end, *dot;
@@ -142,7 +235,7 @@ email_address_extract (const guchar **cur,
 		return NULL;
 
 	addr = g_strndup ((gchar *) start, end - start);
-	*out -= *cur - start;
+	g_string_truncate (out, out->len - (*cur - start));
 	*cur = end;
 
 	return addr;
@@ -242,18 +335,19 @@ e_text_to_html_full (const gchar *input,
                      guint32 color)
 {
 	const guchar *cur, *next, *linestart;
-	gchar *buffer = NULL;
-	gchar *out = NULL;
-	gint buffer_size = 0, col;
+	GString *out;
+	gint col;
+	guint8 stop_mask;
 	gboolean colored = FALSE, saw_citation = FALSE;
 
+	text_class_init ();
+	stop_mask = text_class_stop_mask (flags);
+
 	/* Allocate a translation buffer.  */
-	buffer_size = strlen (input) * 2 + 5;
-	buffer = g_malloc (buffer_size);
+	out = g_string_sized_new (strlen (input) * 2 + 5);
 
-	out = buffer;
 	if (flags & E_TEXT_TO_HTML_PRE)
-		out += sprintf (out, "<PRE>");
+		g_string_append_len (out, "<PRE>", 5);
 
 	col = 0;
 
@@ -264,19 +358,11 @@ e_text_to_html_full (const gchar *input,
 			saw_citation = is_citation (cur, saw_citation);
 			if (saw_citation) {
 				if (!colored) {
-					gchar font[25];
-
-					g_snprintf (font, 25, "<FONT COLOR=\"#%06x\">", color);
-
-					out = check_size (&buffer, &buffer_size, out, 25);
-					out += sprintf (out, "%s", font);
+					g_string_append_printf (out, "<FONT COLOR=\"#%06x\">", color);
 					colored = TRUE;
 				}
 			} else if (colored) {
-				const gchar *no_font = "</FONT>";
-
-				out = check_size (&buffer, &buffer_size, out, 9);
-				out += sprintf (out, "%s", no_font);
+				g_string_append_len (out, "</FONT>", 7);
 				colored = FALSE;
 			}
 
@@ -284,8 +370,19 @@ e_text_to_html_full (const gchar *input,
 			if (*cur == '>' && !saw_citation)
 				cur++;
 		} else if (flags & E_TEXT_TO_HTML_CITE && col == 0) {
-			out = check_size (&buffer, &buffer_size, out, 5);
-			out += sprintf (out, "&gt; ");
+			g_string_append_len (out, "&gt; ", 5);
+		}
+
+		/* Copy a run of bytes which need no escaping and cannot
+		 * start a URL or an address in one go. */
+		if (!(text_class[*cur] & stop_mask)) {
+			next = cur + 1;
+			while (!(text_class[*next] & stop_mask))
+				next++;
+
+			g_string_append_len (out, (const gchar *) cur, next - cur);
+			col += next - cur;
+			continue;
 		}
 
 		u = g_utf8_get_char ((gchar *) cur);
@@ -293,18 +390,7 @@ e_text_to_html_full (const gchar *input,
 		    (flags & E_TEXT_TO_HTML_CONVERT_URLS)) {
 			gchar *tmpurl = NULL, *refurl = NULL, *dispurl = NULL;
 
-			if (!g_ascii_strncasecmp ((gchar *) cur, "http://", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "https://", 8) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "ftp://", 6) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "nntp://", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "mailto:", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "news:", 5) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "file:", 5) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "callto:", 7) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "h323:", 5) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "sip:", 4) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "tel:", 4) ||
-			    !g_ascii_strncasecmp ((gchar *) cur, "webcal:", 7)) {
+			if (url_has_scheme (cur)) {
 				tmpurl = url_extract (&cur, TRUE, (flags & E_TEXT_TO_HTML_URL_IS_WHOLE_TEXT) != 0);
 				if (tmpurl) {
 					refurl = e_text_to_html (tmpurl, 0);
@@ -349,13 +435,11 @@ e_text_to_html_full (const gchar *input,
 					refurl = replaced;
 				}
 
-				out = check_size (
-					&buffer, &buffer_size, out,
-					strlen (refurl) +
-					strlen (dispurl) + 15);
-				out += sprintf (out,
-						"<a href=\"%s\">%s</a>",
-						refurl, dispurl);
+				g_string_append_len (out, "<a href=\"", 9);
+				g_string_append (out, refurl);
+				g_string_append_len (out, "\">", 2);
+				g_string_append (out, dispurl);
+				g_string_append_len (out, "</a>", 4);
 				col += strlen (tmpurl);
 				g_free (tmpurl);
 				g_free (refurl);
@@ -368,20 +452,19 @@ e_text_to_html_full (const gchar *input,
 		}
 
 		if (u == '@' && (flags & E_TEXT_TO_HTML_CONVERT_ADDRESSES)) {
-			gchar *addr, *dispaddr, *outaddr;
+			gchar *addr, *dispaddr;
 
-			addr = email_address_extract (&cur, &out, linestart);
+			addr = email_address_extract (&cur, out, linestart);
 			if (addr) {
 				dispaddr = e_text_to_html (addr, 0);
-				outaddr = g_strdup_printf (
-					"<a href=\"mailto:%s\">%s</a>",
-					addr, dispaddr);
-				out = check_size (&buffer, &buffer_size, out, strlen (outaddr));
-				out += sprintf (out, "%s", outaddr);
+				g_string_append_len (out, "<a href=\"mailto:", 16);
+				g_string_append (out, addr);
+				g_string_append_len (out, "\">", 2);
+				g_string_append (out, dispaddr);
+				g_string_append_len (out, "</a>", 4);
 				col += strlen (addr);
 				g_free (addr);
 				g_free (dispaddr);
-				g_free (outaddr);
 
 				if (!*cur)
 					break;
@@ -398,39 +481,31 @@ e_text_to_html_full (const gchar *input,
 		} else
 			next = (const guchar *) g_utf8_next_char (cur);
 
-		out = check_size (&buffer, &buffer_size, out, 10);
-
 		switch (u) {
 		case '<':
-			strcpy (out, "&lt;");
-			out += 4;
+			g_string_append_len (out, "&lt;", 4);
 			col++;
 			break;
 
 		case '>':
-			strcpy (out, "&gt;");
-			out += 4;
+			g_string_append_len (out, "&gt;", 4);
 			col++;
 			break;
 
 		case '&':
-			strcpy (out, "&amp;");
-			out += 5;
+			g_string_append_len (out, "&amp;", 5);
 			col++;
 			break;
 
 		case '"':
-			strcpy (out, "&quot;");
-			out += 6;
+			g_string_append_len (out, "&quot;", 6);
 			col++;
 			break;
 
 		case '\n':
-			if (flags & E_TEXT_TO_HTML_CONVERT_NL) {
-				strcpy (out, "<br>");
-				out += 4;
-			}
-			*out++ = *cur;
+			if (flags & E_TEXT_TO_HTML_CONVERT_NL)
+				g_string_append_len (out, "<br>", 4);
+			g_string_append_c (out, *cur);
 			linestart = cur;
 			col = 0;
 			break;
@@ -439,10 +514,7 @@ e_text_to_html_full (const gchar *input,
 			if (flags & (E_TEXT_TO_HTML_CONVERT_SPACES |
 				     E_TEXT_TO_HTML_CONVERT_NL)) {
 				do {
-					out = check_size (
-						&buffer, &buffer_size, out, 7);
-					strcpy (out, "&nbsp;");
-					out += 6;
+					g_string_append_len (out, "&nbsp;", 6);
 					col++;
 				} while (col % 8);
 				break;
@@ -455,8 +527,7 @@ e_text_to_html_full (const gchar *input,
 				    cur == (const guchar *) input ||
 				    *(cur + 1) == ' ' || *(cur + 1) == '\t' ||
 				    *(cur - 1) == '\n') {
-					strcpy (out, "&nbsp;");
-					out += 6;
+					g_string_append_len (out, "&nbsp;", 6);
 					col++;
 					break;
 				}
@@ -467,25 +538,22 @@ e_text_to_html_full (const gchar *input,
 			if ((u >= 0x20 && u < 0x80) ||
 			    (u == '\r' || u == '\t')) {
 				/* Default case, just copy. */
-				*out++ = u;
+				g_string_append_c (out, u);
 			} else {
 				if (flags & E_TEXT_TO_HTML_ESCAPE_8BIT)
-					*out++ = '?';
+					g_string_append_c (out, '?');
 				else
-					out += g_snprintf (out, 9, "&#%d;", u);
+					html_append_char_ref (out, u);
 			}
 			col++;
 			break;
 		}
 	}
 
-	out = check_size (&buffer, &buffer_size, out, 7);
 	if (flags & E_TEXT_TO_HTML_PRE)
-		strcpy (out, "</PRE>");
-	else
-		*out = '\0';
+		g_string_append_len (out, "</PRE>", 6);
 
-	return buffer;
+	return g_string_free (out, FALSE);
 }
 
 gchar *
@@ -1331,6 +1331,19 @@ e_int_compare (gconstpointer x,
 	return (nx == ny) ? 0 : (nx < ny) ? -1 : 1;
 }
 
+gint
+e_int64ptr_compare (gconstpointer x,
+                    gconstpointer y)
+{
+	const gint64 *px = x, *py = y;
+
+	if (px && py)
+		return (*px == *py) ? 0 : (*px < *py) ? -1 : 1;
+
+	/* sort unset values before set */
+	return (!px && !py) ? 0 : (px ? 1 : -1);
+}
+
 /**
  * e_color_to_value:
  * @color: a #GdkColor
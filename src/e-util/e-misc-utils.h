@@ -110,6 +110,8 @@ gint		e_collate_compare		(gconstpointer x,
 						 gconstpointer y);
 gint		e_int_compare                   (gconstpointer x,
 						 gconstpointer y);
+gint		e_int64ptr_compare		(gconstpointer x,
+						 gconstpointer y);
 guint32		e_color_to_value		(const GdkColor *color);
 
 guint32		e_rgba_to_value			(const GdkRGBA *rgba);
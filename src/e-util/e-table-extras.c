@@ -106,19 +106,6 @@ e_strint_compare (gconstpointer data1,
 	return e_int_compare (GINT_TO_POINTER (int1), GINT_TO_POINTER (int2));
 }
 
-static gint
-e_int64ptr_compare (gconstpointer data1,
-		    gconstpointer data2)
-{
-	const gint64 *pa = data1, *pb = data2;
-
-	if (pa && pb)
-		return (*pa == *pb) ? 0 : (*pa < *pb) ? -1 : 1;
-
-	/* sort unset values before set */
-	return (!pa && !pb) ? 0 : (pa ? 1 : -1);
-}
-
 /* UTF-8 strncasecmp - not optimized */
 
 static gint
@@ -713,6 +713,86 @@ eti_row_height_real (ETableItem *eti,
 	return max_h;
 }
 
+static void
+free_height_index (ETableItem *eti)
+{
+	g_free (eti->height_index);
+	g_free (eti->height_index_unknown);
+	eti->height_index = NULL;
+	eti->height_index_unknown = NULL;
+	eti->height_index_dirty = FALSE;
+}
+
+static void
+height_index_add (gint *tree,
+                  gint n_rows,
+                  gint row,
+                  gint delta)
+{
+	for (row++; row <= n_rows; row += row & (-row))
+		tree[row] += delta;
+}
+
+/* Sum of the first n_rows entries */
+static gint
+height_index_sum (const gint *tree,
+                  gint n_rows)
+{
+	gint sum = 0;
+
+	for (; n_rows > 0; n_rows -= n_rows & (-n_rows))
+		sum += tree[n_rows];
+
+	return sum;
+}
+
+/* Returns the first row at which the running sum, with the extra
+ * added for each row, reaches the value, or n_rows if it never does */
+static gint
+height_index_lower_bound (const gint *tree,
+                          gint n_rows,
+                          gint extra,
+                          gint value)
+{
+	gint pos = 0, step = 1;
+
+	while (step * 2 <= n_rows)
+		step *= 2;
+
+	for (; step > 0; step /= 2) {
+		if (pos + step <= n_rows && tree[pos + step] + step * extra < value) {
+			pos += step;
+			value -= tree[pos] + step * extra;
+		}
+	}
+
+	return pos;
+}
+
+static void
+rebuild_height_index (ETableItem *eti)
+{
+	gint ii, jj;
+
+	free_height_index (eti);
+
+	eti->height_index = g_new0 (gint, eti->rows + 1);
+	eti->height_index_unknown = g_new0 (gint, eti->rows + 1);
+
+	for (ii = 1; ii <= eti->rows; ii++) {
+		if (eti->height_cache[ii - 1] == -1)
+			eti->height_index_unknown[ii]++;
+		else
+			eti->height_index[ii] += eti->height_cache[ii - 1];
+
+		jj = ii + (ii & (-ii));
+		if (jj <= eti->rows) {
+			eti->height_index[jj] += eti->height_index[ii];
+			eti->height_index_unknown[jj] += eti->height_index_unknown[ii];
+		}
+	}
+}
+
 static void
 confirm_height_cache (ETableItem *eti)
 {
@@ -761,6 +841,7 @@ free_height_cache (ETableItem *eti)
 		eti->height_cache = NULL;
 		eti->height_cache_idle_count = 0;
 		eti->uniform_row_height_cache = -1;
+		free_height_index (eti);
 
 		if (eti->uniform_row_height && eti->height_cache_idle_id != 0) {
 			g_source_remove (eti->height_cache_idle_id);
@@ -798,6 +879,10 @@ eti_row_height (ETableItem *eti,
 		}
 		if (eti->height_cache[row] == -1) {
 			eti->height_cache[row] = eti_row_height_real (eti, row);
+			if (eti->height_index && !eti->height_index_dirty) {
+				height_index_add (eti->height_index, eti->rows, row, eti->height_cache[row]);
+				height_index_add (eti->height_index_unknown, eti->rows, row, -1);
+			}
 			if (row > 0 &&
 			    eti->length_threshold != -1 &&
 			    eti->rows > eti->length_threshold &&
@@ -810,6 +895,66 @@ eti_row_height (ETableItem *eti,
 	}
 }
 
+static void
+confirm_height_index (ETableItem *eti)
+{
+	if (!eti->height_cache)
+		calculate_height_cache (eti);
+
+	if (!eti->height_index || eti->height_index_dirty)
+		rebuild_height_index (eti);
+}
+
+/* Measures the rows in the range, which are not in the height cache yet */
+static void
+eti_measure_rows (ETableItem *eti,
+                  gint start_row,
+                  gint end_row)
+{
+	gint n_unknown_before;
+
+	confirm_height_index (eti);
+
+	n_unknown_before = height_index_sum (eti->height_index_unknown, start_row);
+
+	while (height_index_sum (eti->height_index_unknown, end_row) > n_unknown_before) {
+		gint row;
+
+		row = height_index_lower_bound (eti->height_index_unknown, eti->rows, 0, n_unknown_before + 1);
+		eti_row_height (eti, row);
+	}
+}
+
+/*
+ * eti_row_at_offset:
+ *
+ * Returns the first row whose bottom edge, measured from the top
+ * of the first row, is at or below @offset, or the number of rows.
+ * Only for the variable row height.
+ */
+static gint
+eti_row_at_offset (ETableItem *eti,
+                   gint offset)
+{
+	gint height_extra = eti->horizontal_draw_grid ? 1 : 0;
+	gint row;
+
+	confirm_height_index (eti);
+
+	/* The rows not measured yet count as zero height, thus measure
+	 * them from the top until none is left above the found row */
+	while (TRUE) {
+		row = height_index_lower_bound (eti->height_index, eti->rows, height_extra, offset);
+
+		if (height_index_sum (eti->height_index_unknown, MIN (row + 1, eti->rows)) == 0)
+			break;
+
+		eti_row_height (eti, height_index_lower_bound (eti->height_index_unknown, eti->rows, 0, 1));
+	}
+
+	return row;
+}
+
 /*
  * eti_get_height:
  *
@@ -841,15 +986,13 @@ eti_get_height (ETableItem *eti)
 			if (rows > eti->length_threshold) {
 				gint row_height = ETI_ROW_HEIGHT (eti, 0);
 				if (eti->height_cache) {
-					height = 0;
-					for (row = 0; row < rows; row++) {
-						if (eti->height_cache[row] == -1) {
-							height += (row_height + height_extra) * (rows - row);
-							break;
-						}
-						else
-							height += eti->height_cache[row] + height_extra;
-					}
+					confirm_height_index (eti);
+
+					/* Measured height up to the first unknown row,
+					 * then estimated from the first row */
+					row = height_index_lower_bound (eti->height_index_unknown, rows, 0, 1);
+					height = height_index_sum (eti->height_index, row) + height_extra * row;
+					height += (row_height + height_extra) * (rows - row);
 				} else
 					height = (ETI_ROW_HEIGHT (eti, 0) + height_extra) * rows;
 
@@ -860,11 +1003,7 @@ eti_get_height (ETableItem *eti)
 			}
 		}
 
-		height = height_extra;
-		for (row = 0; row < rows; row++)
-			height += ETI_ROW_HEIGHT (eti, row) + height_extra;
-
-		return height;
+		return height_extra + e_table_item_row_diff (eti, 0, rows);
 	}
 }
 
@@ -908,12 +1047,14 @@ e_table_item_row_diff (ETableItem *eti,
 	if (eti->uniform_row_height) {
 		return ((end_row - start_row) * (ETI_ROW_HEIGHT (eti, -1) + height_extra));
 	} else {
-		gint row, total;
-		total = 0;
-		for (row = start_row; row < end_row; row++)
-			total += ETI_ROW_HEIGHT (eti, row) + height_extra;
+		if (start_row >= end_row)
+			return 0;
+
+		eti_measure_rows (eti, start_row, end_row);
 
-		return total;
+		return height_index_sum (eti->height_index, end_row) -
+			height_index_sum (eti->height_index, start_row) +
+			(end_row - start_row) * height_extra;
 	}
 }
 
@@ -1313,6 +1454,9 @@ eti_table_model_rows_inserted (ETableModel *table_model,
 		memmove (eti->height_cache + row + count, eti->height_cache + row, (eti->rows - count - row) * sizeof (gint));
 		for (i = row; i < row + count; i++)
 			eti->height_cache[i] = -1;
+
+		/* Rebuilt on the next use, once for a burst of changes */
+		eti->height_index_dirty = TRUE;
 	}
 
 	eti_unfreeze (eti);
@@ -1344,6 +1488,9 @@ eti_table_model_rows_deleted (ETableModel *table_model,
 		memmove (eti->height_cache + row, eti->height_cache + row + count, (eti->rows - row) * sizeof (gint));
 	}
 
+	if (eti->height_cache)
+		eti->height_index_dirty = TRUE;
+
 	eti_unfreeze (eti);
 
 	eti_idle_maybe_show_cursor (eti);
@@ -1597,6 +1744,7 @@ eti_dispose (GObject *object)
 	if (eti->height_cache)
 		g_free (eti->height_cache);
 	eti->height_cache = NULL;
+	free_height_index (eti);
 
 	/* Chain up to parent's dispose() method. */
 	G_OBJECT_CLASS (e_table_item_parent_class)->dispose (object);
@@ -1874,6 +2022,7 @@ eti_unrealize (GnomeCanvasItem *item)
 		g_free (eti->height_cache);
 	eti->height_cache = NULL;
 	eti->height_cache_idle_count = 0;
+	free_height_index (eti);
 
 	eti_unrealize_cell_views (eti);
 
@@ -1984,31 +2133,20 @@ eti_draw (GnomeCanvasItem *item,
 		if (last_row > eti->rows)
 			last_row = eti->rows;
 	} else {
-		gint y1, y2;
-
-		y_offset = 0;
-		first_row = -1;
+		gint y1, last_offset;
 
-		y1 = y2 = floor (eti_base_y) + height_extra;
-		for (row = 0; row < rows; row++, y1 = y2) {
+		y1 = floor (eti_base_y) + height_extra;
 
-			y2 += ETI_ROW_HEIGHT (eti, row) + height_extra;
-
-			if (y1 > y + height)
-				break;
-
-			if (y2 < y)
-				continue;
-
-			if (first_row == -1) {
-				y_offset = y1 - y;
-				first_row = row;
-			}
-		}
-		last_row = row;
+		first_row = eti_row_at_offset (eti, y - y1);
+		if (first_row >= rows)
+			return;
 
-		if (first_row == -1)
+		y_offset = y1 + e_table_item_row_diff (eti, 0, first_row) - y;
+		if (y_offset > height)
 			return;
+
+		last_offset = y + height - y1;
+		last_row = MIN (eti_row_at_offset (eti, last_offset + 1) + 1, rows);
 	}
 
 	if (first_row == -1)
@@ -2239,7 +2377,7 @@ find_cell (ETableItem *eti,
 {
 	const gint cols = eti->cols;
 	const gint rows = eti->rows;
-	gdouble x1, y1, x2, y2;
+	gdouble x1, y1, x2;
 	gint col, row;
 
 	gint height_extra = eti->horizontal_draw_grid ? 1 : 0;
@@ -2278,18 +2416,14 @@ find_cell (ETableItem *eti,
 		if (row >= eti->rows)
 			return FALSE;
 	} else {
-		y1 = y2 = height_extra;
 		if (y < height_extra)
 			return FALSE;
-		for (row = 0; row < rows; row++, y1 = y2) {
-			y2 += ETI_ROW_HEIGHT (eti, row) + height_extra;
-
-			if (y <= y2)
-				break;
-		}
 
+		row = eti_row_at_offset (eti, ceil (y - height_extra));
 		if (row == rows)
 			return FALSE;
+
+		y1 = height_extra + e_table_item_row_diff (eti, 0, row);
 	}
 	*view_col_res = col;
 	if (x1_res)
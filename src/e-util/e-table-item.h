@@ -149,6 +149,12 @@ struct _ETableItem {
 	gint height_cache_idle_id;
 	gint height_cache_idle_count;
 
+	/* Fenwick trees over the height_cache, summing the known
+	 * heights and counting the rows not measured yet */
+	gint *height_index;
+	gint *height_index_unknown;
+	gboolean height_index_dirty;
+
 	/*
 	 * Lengh Threshold: above this, we stop computing correctly
 	 * the size
@@ -135,6 +135,248 @@ e_sort_callback (gconstpointer data1,
 	return comp_val;
 }
 
+/* Sorting of large models extracts a compact key of the first sort column
+ * for each row and sorts the keys with a merge sort, which runs on more
+ * threads for large enough models.  The compare functions are only called
+ * when the keys are equal, which for integer columns means a tie. */
+
+#define ETSU_KEY_SORT_MIN_ROWS		1024
+#define ETSU_PARALLEL_MIN_ROWS		32768
+#define ETSU_INSERTION_SORT_ROWS	16
+
+typedef enum {
+	ETSU_KEY_NONE,
+	ETSU_KEY_INT,
+	ETSU_KEY_INT64PTR,
+	ETSU_KEY_STRING
+} ETableSortKeyKind;
+
+typedef struct {
+	guint64 key;
+	gint rank; /* orders unset values, before comparing the key */
+	gint row;
+} ETableSortKey;
+
+typedef struct {
+	ETableSortClosure *closure;
+	gboolean descending;
+	ETableSortKey *keys;
+	ETableSortKey *tmp;
+	gsize n_keys;
+	gint depth;
+} ETableSortKeyJob;
+
+static ETableSortKeyKind
+etsu_get_key_kind (GCompareDataFunc compare)
+{
+	if (compare == (GCompareDataFunc) e_int_compare)
+		return ETSU_KEY_INT;
+
+	if (compare == (GCompareDataFunc) e_int64ptr_compare)
+		return ETSU_KEY_INT64PTR;
+
+	/* The collate keys of the mail's message list use this */
+	if (compare == (GCompareDataFunc) e_str_compare)
+		return ETSU_KEY_STRING;
+
+	return ETSU_KEY_NONE;
+}
+
+static void
+etsu_fill_key (ETableSortKey *key,
+               ETableSortKeyKind kind,
+               gconstpointer value,
+               gint row)
+{
+	key->row = row;
+	key->rank = 0;
+	key->key = 0;
+
+	switch (kind) {
+	case ETSU_KEY_INT:
+		/* Flip the sign bit, to compare the values as unsigned */
+		key->key = ((guint64) (gint64) GPOINTER_TO_INT (value)) ^ G_GUINT64_CONSTANT (0x8000000000000000);
+		break;
+	case ETSU_KEY_INT64PTR:
+		/* Unset values sort before set */
+		if (value) {
+			key->rank = 1;
+			key->key = ((guint64) *((const gint64 *) value)) ^ G_GUINT64_CONSTANT (0x8000000000000000);
+		}
+		break;
+	case ETSU_KEY_STRING:
+		/* NULL strings sort after set; the key is the string
+		 * prefix in the byte order used by strcmp() */
+		if (value) {
+			const guchar *str = value;
+			gint ii;
+
+			for (ii = 0; ii < 8 && str[ii]; ii++)
+				key->key |= ((guint64) str[ii]) << (8 * (7 - ii));
+		} else {
+			key->rank = 1;
+		}
+		break;
+	case ETSU_KEY_NONE:
+		g_warn_if_reached ();
+		break;
+	}
+}
+
+static gint
+etsu_key_compare (const ETableSortKey *key1,
+                  const ETableSortKey *key2,
+                  ETableSortKeyJob *job)
+{
+	gint comp_val;
+
+	if (key1->rank != key2->rank)
+		comp_val = key1->rank < key2->rank ? -1 : 1;
+	else if (key1->key != key2->key)
+		comp_val = key1->key < key2->key ? -1 : 1;
+	else
+		return e_sort_callback (&key1->row, &key2->row, job->closure);
+
+	return job->descending ? -comp_val : comp_val;
+}
+
+static gpointer etsu_key_sort_thread (gpointer user_data);
+
+static void
+etsu_key_merge_sort (ETableSortKeyJob *job)
+{
+	ETableSortKey *keys = job->keys, *tmp = job->tmp;
+	gsize n_keys = job->n_keys, mid, ii, jj, kk;
+
+	if (n_keys <= ETSU_INSERTION_SORT_ROWS) {
+		for (ii = 1; ii < n_keys; ii++) {
+			ETableSortKey key = keys[ii];
+
+			for (jj = ii; jj > 0 && etsu_key_compare (&keys[jj - 1], &key, job) > 0; jj--) {
+				keys[jj] = keys[jj - 1];
+			}
+
+			keys[jj] = key;
+		}
+
+		return;
+	}
+
+	mid = n_keys / 2;
+
+	if (job->depth > 0 && n_keys >= ETSU_PARALLEL_MIN_ROWS) {
+		ETableSortKeyJob left_job = *job, right_job = *job;
+		ETableSortClosure left_closure = *job->closure;
+		GThread *thread;
+
+		/* The compare cache is not thread safe */
+		left_closure.cmp_cache = e_table_sorting_utils_create_cmp_cache ();
+
+		left_job.closure = &left_closure;
+		left_job.n_keys = mid;
+		left_job.depth = job->depth - 1;
+
+		right_job.keys = keys + mid;
+		right_job.tmp = tmp + mid;
+		right_job.n_keys = n_keys - mid;
+		right_job.depth = job->depth - 1;
+
+		thread = g_thread_try_new (NULL, etsu_key_sort_thread, &left_job, NULL);
+		if (!thread)
+			etsu_key_merge_sort (&left_job);
+
+		etsu_key_merge_sort (&right_job);
+
+		if (thread)
+			g_thread_join (thread);
+
+		e_table_sorting_utils_free_cmp_cache (left_closure.cmp_cache);
+	} else {
+		ETableSortKeyJob half_job = *job;
+
+		half_job.n_keys = mid;
+		etsu_key_merge_sort (&half_job);
+
+		half_job.keys = keys + mid;
+		half_job.tmp = tmp + mid;
+		half_job.n_keys = n_keys - mid;
+		etsu_key_merge_sort (&half_job);
+	}
+
+	/* Already in order */
+	if (etsu_key_compare (&keys[mid - 1], &keys[mid], job) <= 0)
+		return;
+
+	for (ii = 0, jj = mid, kk = 0; ii < mid && jj < n_keys; kk++) {
+		if (etsu_key_compare (&keys[jj], &keys[ii], job) < 0)
+			tmp[kk] = keys[jj++];
+		else
+			tmp[kk] = keys[ii++];
+	}
+
+	if (ii < mid)
+		memcpy (tmp + kk, keys + ii, (mid - ii) * sizeof (ETableSortKey));
+	else
+		memcpy (tmp + kk, keys + jj, (n_keys - jj) * sizeof (ETableSortKey));
+
+	memcpy (keys, tmp, n_keys * sizeof (ETableSortKey));
+}
+
+static gpointer
+etsu_key_sort_thread (gpointer user_data)
+{
+	etsu_key_merge_sort (user_data);
+
+	return NULL;
+}
+
+/* Sorts @map, which contains row indexes into the @closure's vals, the same
+ * way as g_qsort_with_data() with e_sort_callback() would do.  Returns FALSE
+ * when the first sort column is not suitable for it; the @map is untouched
+ * in that case. */
+static gboolean
+etsu_sort_by_keys (ETableSortClosure *closure,
+                   gint *map,
+                   gint rows)
+{
+	ETableSortKeyKind kind;
+	ETableSortKeyJob job;
+	guint n_threads;
+	gint ii;
+
+	if (rows < ETSU_KEY_SORT_MIN_ROWS || closure->cols < 1)
+		return FALSE;
+
+	kind = etsu_get_key_kind (closure->compare[0]);
+	if (kind == ETSU_KEY_NONE)
+		return FALSE;
+
+	job.closure = closure;
+	job.descending = closure->sort_type[0] == GTK_SORT_DESCENDING;
+	job.keys = g_new (ETableSortKey, rows);
+	job.tmp = g_new (ETableSortKey, rows);
+	job.n_keys = rows;
+	job.depth = 0;
+
+	for (n_threads = g_get_num_processors (); n_threads > 1 && job.depth < 3; n_threads /= 2)
+		job.depth++;
+
+	for (ii = 0; ii < rows; ii++) {
+		etsu_fill_key (&job.keys[ii], kind, closure->vals[closure->cols * map[ii]], map[ii]);
+	}
+
+	etsu_key_merge_sort (&job);
+
+	for (ii = 0; ii < rows; ii++) {
+		map[ii] = job.keys[ii].row;
+	}
+
+	g_free (job.keys);
+	g_free (job.tmp);
+
+	return TRUE;
+}
+
 void
 e_table_sorting_utils_sort (ETableModel *source,
                             ETableSortInfo *sort_info,
@@ -180,8 +422,9 @@ e_table_sorting_utils_sort (ETableModel *source,
 		closure.compare[j] = col->compare;
 	}
 
-	g_qsort_with_data (
-		map_table, rows, sizeof (gint), e_sort_callback, &closure);
+	if (!etsu_sort_by_keys (&closure, map_table, rows))
+		g_qsort_with_data (
+			map_table, rows, sizeof (gint), e_sort_callback, &closure);
 
 	for (j = 0; j < cols; j++) {
 		ETableColumnSpecification *spec;
@@ -399,8 +642,9 @@ e_table_sorting_utils_tree_sort (ETreeModel *source,
 		map[i] = i;
 	}
 
-	g_qsort_with_data (
-		map, count, sizeof (gint), e_sort_callback, &closure);
+	if (!etsu_sort_by_keys (&closure, map, count))
+		g_qsort_with_data (
+			map, count, sizeof (gint), e_sort_callback, &closure);
 
 	map_copy = g_new (ETreePath, count);
 	for (i = 0; i < count; i++) {
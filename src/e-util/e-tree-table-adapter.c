@@ -42,17 +42,24 @@
 
 #define d(x)
 
-#define INCREMENT_AMOUNT 100
+typedef struct _node_t node_t;
 
-typedef struct {
+struct _node_t {
 	ETreePath path;
 	guint32 num_visible_children;
-	guint32 index;
 
 	guint expanded : 1;
 	guint expandable : 1;
 	guint expandable_set : 1;
-} node_t;
+
+	/* Position in the row map, which is a randomized binary search
+	 * tree ordered by row, with each node knowing its subtree size.
+	 * The map_size is 0 when the node is not shown in any row. */
+	node_t *map_parent;
+	node_t *map_left;
+	node_t *map_right;
+	guint32 map_size;
+};
 
 struct _ETreeTableAdapterPrivate {
 	ETreeModel *source_model;
@@ -67,17 +74,15 @@ struct _ETreeTableAdapterPrivate {
 	gulong sort_info_changed_handler_id;
 	ETableSortInfo *children_sort_info;
 	gboolean sort_children_ascending;
+	gboolean presorted;
 
 	ETableHeader *header;
 
-	gint n_map;
-	gint n_vals_allocated;
-	node_t **map_table;
+	node_t *map_root;
 	GHashTable *nodes;
 	GNode *root;
 
 	guint root_visible : 1;
-	guint remap_needed : 1;
 
 	gint last_access;
 
@@ -91,7 +96,8 @@ enum {
 	PROP_HEADER,
 	PROP_SORT_INFO,
 	PROP_SOURCE_MODEL,
-	PROP_SORT_CHILDREN_ASCENDING
+	PROP_SORT_CHILDREN_ASCENDING,
+	PROP_PRESORTED
 };
 
 enum {
@@ -127,54 +133,199 @@ lookup_gnode (ETreeTableAdapter *etta,
 	return gnode;
 }
 
+static inline gint
+map_size (node_t *tree)
+{
+	return tree ? tree->map_size : 0;
+}
+
 static void
-resize_map (ETreeTableAdapter *etta,
-            gint size)
+map_update (node_t *tree)
 {
-	if (size > etta->priv->n_vals_allocated) {
-		etta->priv->n_vals_allocated = MAX (etta->priv->n_vals_allocated + INCREMENT_AMOUNT, size);
-		etta->priv->map_table = g_renew (node_t *, etta->priv->map_table, etta->priv->n_vals_allocated);
+	tree->map_size = 1;
+
+	if (tree->map_left) {
+		tree->map_size += tree->map_left->map_size;
+		tree->map_left->map_parent = tree;
 	}
 
-	etta->priv->n_map = size;
+	if (tree->map_right) {
+		tree->map_size += tree->map_right->map_size;
+		tree->map_right->map_parent = tree;
+	}
 }
 
+/* Splits the tree after its first n_rows rows. Parents of the returned
+ * roots are left for the caller to reset. */
 static void
-move_map_elements (ETreeTableAdapter *etta,
-                   gint to,
-                   gint from,
-                   gint count)
-{
-	if (count <= 0 || from >= etta->priv->n_map)
+map_split (node_t *tree,
+           gint n_rows,
+           node_t **left,
+           node_t **right)
+{
+	if (!tree) {
+		*left = NULL;
+		*right = NULL;
 		return;
-	memmove (etta->priv->map_table + to, etta->priv->map_table + from, count * sizeof (node_t *));
-	etta->priv->remap_needed = TRUE;
+	}
+
+	if (map_size (tree->map_left) >= n_rows) {
+		map_split (tree->map_left, n_rows, left, &tree->map_left);
+		*right = tree;
+	} else {
+		map_split (tree->map_right, n_rows - map_size (tree->map_left) - 1, &tree->map_right, right);
+		*left = tree;
+	}
+
+	map_update (tree);
+}
+
+/* Picks the root with a probability proportional to the subtree size,
+ * which keeps the expected depth logarithmic without storing priorities. */
+static node_t *
+map_merge (node_t *left,
+           node_t *right)
+{
+	if (!left)
+		return right;
+	if (!right)
+		return left;
+
+	if (g_random_int_range (0, left->map_size + right->map_size) < left->map_size) {
+		left->map_right = map_merge (left->map_right, right);
+		map_update (left);
+		return left;
+	}
+
+	right->map_left = map_merge (left, right->map_left);
+	map_update (right);
+	return right;
+}
+
+static node_t *
+map_build (node_t **nodes,
+           gint n_nodes)
+{
+	node_t *tree;
+	gint middle;
+
+	if (n_nodes <= 0)
+		return NULL;
+
+	middle = n_nodes / 2;
+	tree = nodes[middle];
+	tree->map_parent = NULL;
+	tree->map_left = map_build (nodes, middle);
+	tree->map_right = map_build (nodes + middle + 1, n_nodes - middle - 1);
+	map_update (tree);
+
+	return tree;
+}
+
+static void
+map_forget (node_t *tree)
+{
+	while (tree) {
+		node_t *right = tree->map_right;
+
+		map_forget (tree->map_left);
+
+		tree->map_parent = NULL;
+		tree->map_left = NULL;
+		tree->map_right = NULL;
+		tree->map_size = 0;
+
+		tree = right;
+	}
+}
+
+static node_t *
+map_nth (node_t *tree,
+         gint row)
+{
+	while (tree) {
+		gint n_left = map_size (tree->map_left);
+
+		if (row < n_left) {
+			tree = tree->map_left;
+		} else if (row == n_left) {
+			return tree;
+		} else {
+			row -= n_left + 1;
+			tree = tree->map_right;
+		}
+	}
+
+	return NULL;
 }
 
 static gint
-fill_map (ETreeTableAdapter *etta,
-          gint index,
-          GNode *gnode)
+map_row (node_t *node)
+{
+	gint row = map_size (node->map_left);
+
+	while (node->map_parent) {
+		if (node == node->map_parent->map_right)
+			row += map_size (node->map_parent->map_left) + 1;
+		node = node->map_parent;
+	}
+
+	return row;
+}
+
+static void
+collect_map_nodes (ETreeTableAdapter *etta,
+                   GPtrArray *nodes,
+                   GNode *gnode)
 {
 	GNode *p;
 
 	if ((gnode != etta->priv->root) || etta->priv->root_visible)
-		etta->priv->map_table[index++] = gnode->data;
+		g_ptr_array_add (nodes, gnode->data);
 
 	for (p = gnode->children; p; p = p->next)
-		index = fill_map (etta, index, p);
+		collect_map_nodes (etta, nodes, p);
+}
+
+/* Replaces n_replace rows starting at index with the visible rows
+ * of the gnode subtree, or removes them when the gnode is NULL. */
+static void
+fill_map (ETreeTableAdapter *etta,
+          gint index,
+          gint n_replace,
+          GNode *gnode)
+{
+	GPtrArray *nodes;
+	node_t *left, *middle, *right;
+
+	nodes = g_ptr_array_new ();
+	if (gnode)
+		collect_map_nodes (etta, nodes, gnode);
+
+	map_split (etta->priv->map_root, index, &left, &right);
+	map_split (right, n_replace, &middle, &right);
 
-	etta->priv->remap_needed = TRUE;
-	return index;
+	map_forget (middle);
+	middle = map_build ((node_t **) nodes->pdata, nodes->len);
+
+	etta->priv->map_root = map_merge (map_merge (left, middle), right);
+	if (etta->priv->map_root)
+		etta->priv->map_root->map_parent = NULL;
+
+	g_ptr_array_free (nodes, TRUE);
 }
 
 static void
-remap_indices (ETreeTableAdapter *etta)
+fill_map_all (ETreeTableAdapter *etta)
 {
-	gint i;
-	for (i = 0; i < etta->priv->n_map; i++)
-		etta->priv->map_table[i]->index = i;
-	etta->priv->remap_needed = FALSE;
+	fill_map (etta, 0, map_size (etta->priv->map_root), etta->priv->root);
+}
+
+static void
+clear_map (ETreeTableAdapter *etta)
+{
+	/* The nodes are freed by kill_gnode() */
+	etta->priv->map_root = NULL;
 }
 
 static node_t *
@@ -205,7 +356,7 @@ resort_node (ETreeTableAdapter *etta,
 	if (node->num_visible_children == 0)
 		return;
 
-	sort_needed = etta->priv->sort_info && e_table_sort_info_sorting_get_count (etta->priv->sort_info) > 0;
+	sort_needed = !etta->priv->presorted && etta->priv->sort_info && e_table_sort_info_sorting_get_count (etta->priv->sort_info) > 0;
 
 	for (i = 0, path = e_tree_model_node_get_first_child (etta->priv->source_model, node->path); path;
 	     path = e_tree_model_node_get_next (etta->priv->source_model, path), i++);
@@ -338,11 +489,13 @@ delete_node (ETreeTableAdapter *etta,
 		return;
 	}
 
-	to_remove += delete_children (etta, gnode);
-	kill_gnode (gnode, etta);
+	to_remove += ((node_t *) gnode->data)->num_visible_children;
 
-	move_map_elements (etta, row, row + to_remove, etta->priv->n_map - row - to_remove);
-	resize_map (etta, etta->priv->n_map - to_remove);
+	/* Remove the rows first, the map walks the nodes being freed */
+	fill_map (etta, row, to_remove, NULL);
+
+	delete_children (etta, gnode);
+	kill_gnode (gnode, etta);
 
 	if (parent_gnode != NULL) {
 		node_t *parent_node = parent_gnode->data;
@@ -370,7 +523,6 @@ create_gnode (ETreeTableAdapter *etta,
 
 	node = g_new0 (node_t, 1);
 	node->path = path;
-	node->index = -1;
 	node->expanded = etta->priv->force_expanded_state == 0 ? e_tree_model_get_expanded_default (etta->priv->source_model) : etta->priv->force_expanded_state > 0;
 	node->expandable = e_tree_model_node_is_expandable (etta->priv->source_model, path);
 	node->expandable_set = 1;
@@ -409,15 +561,14 @@ generate_tree (ETreeTableAdapter *etta,
 {
 	GNode *gnode;
 	node_t *node;
-	gint size;
 
 	e_table_model_pre_change (E_TABLE_MODEL (etta));
 
 	g_return_if_fail (e_tree_model_node_is_root (etta->priv->source_model, path));
 
+	clear_map (etta);
 	if (etta->priv->root)
 		kill_gnode (etta->priv->root, etta);
-	resize_map (etta, 0);
 
 	gnode = create_gnode (etta, path);
 	node = (node_t *) gnode->data;
@@ -427,9 +578,7 @@ generate_tree (ETreeTableAdapter *etta,
 		resort_node (etta, gnode, TRUE);
 
 	etta->priv->root = gnode;
-	size = etta->priv->root_visible ? node->num_visible_children + 1 : node->num_visible_children;
-	resize_map (etta, size);
-	fill_map (etta, 0, gnode);
+	fill_map (etta, 0, 0, gnode);
 	e_table_model_changed (E_TABLE_MODEL (etta));
 }
 
@@ -469,7 +618,9 @@ insert_node (ETreeTableAdapter *etta,
 			e_table_model_pre_change (E_TABLE_MODEL (etta));
 			parent_node->expandable = expandable;
 			parent_node->expandable_set = 1;
-			e_table_model_row_changed (E_TABLE_MODEL (etta), parent_node->index);
+			e_table_model_row_changed (
+				E_TABLE_MODEL (etta),
+				e_tree_table_adapter_row_of_node (etta, parent));
 		}
 	}
 
@@ -490,16 +641,13 @@ insert_node (ETreeTableAdapter *etta,
 	resort_node (etta, gnode, TRUE);
 
 	size = node->num_visible_children + 1;
-	resize_map (etta, etta->priv->n_map + size);
 	if (parent_gnode == etta->priv->root)
-		row = 0;
+		fill_map_all (etta);
 	else {
-		gint new_size = parent_node->num_visible_children + 1;
-		gint old_size = new_size - size;
-		row = parent_node->index;
-		move_map_elements (etta, row + new_size, row + old_size, etta->priv->n_map - row - new_size);
+		gint old_size = parent_node->num_visible_children + 1 - size;
+		row = e_tree_table_adapter_row_of_node (etta, parent);
+		fill_map (etta, row, old_size, parent_gnode);
 	}
-	fill_map (etta, row, parent_gnode);
 	e_table_model_rows_inserted (
 		E_TABLE_MODEL (etta),
 		e_tree_table_adapter_row_of_node (etta, path), size);
@@ -574,7 +722,7 @@ tree_table_adapter_sort_info_changed_cb (ETableSortInfo *sort_info,
 
 	e_table_model_pre_change (E_TABLE_MODEL (etta));
 	resort_node (etta, etta->priv->root, TRUE);
-	fill_map (etta, 0, etta->priv->root);
+	fill_map_all (etta);
 	e_table_model_changed (E_TABLE_MODEL (etta));
 }
 
@@ -592,6 +740,7 @@ tree_table_adapter_source_model_rebuilt_cb (ETreeModel *source_model,
 	if (!etta->priv->root)
 		return;
 
+	clear_map (etta);
 	kill_gnode (etta->priv->root, etta);
 	etta->priv->root = NULL;
 
@@ -719,6 +868,12 @@ tree_table_adapter_set_property (GObject *object,
 				E_TREE_TABLE_ADAPTER (object),
 				g_value_get_boolean (value));
 			return;
+
+		case PROP_PRESORTED:
+			e_tree_table_adapter_set_presorted (
+				E_TREE_TABLE_ADAPTER (object),
+				g_value_get_boolean (value));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -758,6 +913,13 @@ tree_table_adapter_get_property (GObject *object,
 				e_tree_table_adapter_get_sort_children_ascending (
 				E_TREE_TABLE_ADAPTER (object)));
 			return;
+
+		case PROP_PRESORTED:
+			g_value_set_boolean (
+				value,
+				e_tree_table_adapter_get_presorted (
+				E_TREE_TABLE_ADAPTER (object)));
+			return;
 	}
 
 	G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
@@ -847,8 +1009,6 @@ tree_table_adapter_finalize (GObject *object)
 
 	g_hash_table_destroy (priv->nodes);
 
-	g_free (priv->map_table);
-
 	/* Chain up to parent's finalize() method. */
 	G_OBJECT_CLASS (e_tree_table_adapter_parent_class)->finalize (object);
 }
@@ -939,7 +1099,7 @@ tree_table_adapter_row_count (ETableModel *etm)
 {
 	ETreeTableAdapter *etta = (ETreeTableAdapter *) etm;
 
-	return etta->priv->n_map;
+	return map_size (etta->priv->map_root);
 }
 
 static gpointer
@@ -1103,6 +1263,17 @@ e_tree_table_adapter_class_init (ETreeTableAdapterClass *class)
 			G_PARAM_CONSTRUCT |
 			G_PARAM_STATIC_STRINGS));
 
+	g_object_class_install_property (
+		object_class,
+		PROP_PRESORTED,
+		g_param_spec_boolean (
+			"presorted",
+			"Presorted",
+			NULL,
+			FALSE,
+			G_PARAM_READWRITE |
+			G_PARAM_STATIC_STRINGS));
+
 	signals[SORTING_CHANGED] = g_signal_new (
 		"sorting_changed",
 		G_OBJECT_CLASS_TYPE (object_class),
@@ -1143,7 +1314,6 @@ e_tree_table_adapter_init (ETreeTableAdapter *etta)
 	etta->priv->nodes = g_hash_table_new (NULL, NULL);
 
 	etta->priv->root_visible = TRUE;
-	etta->priv->remap_needed = TRUE;
 }
 
 ETableModel *
@@ -1224,7 +1394,7 @@ e_tree_table_adapter_set_sort_info (ETreeTableAdapter *etta,
 
 	e_table_model_pre_change (E_TABLE_MODEL (etta));
 	resort_node (etta, etta->priv->root, TRUE);
-	fill_map (etta, 0, etta->priv->root);
+	fill_map_all (etta);
 	e_table_model_changed (E_TABLE_MODEL (etta));
 }
 
@@ -1255,7 +1425,40 @@ e_tree_table_adapter_set_sort_children_ascending (ETreeTableAdapter *etta,
 
 	e_table_model_pre_change (E_TABLE_MODEL (etta));
 	resort_node (etta, etta->priv->root, TRUE);
-	fill_map (etta, 0, etta->priv->root);
+	fill_map_all (etta);
+	e_table_model_changed (E_TABLE_MODEL (etta));
+}
+
+gboolean
+e_tree_table_adapter_get_presorted (ETreeTableAdapter *etta)
+{
+	g_return_val_if_fail (E_IS_TREE_TABLE_ADAPTER (etta), FALSE);
+
+	return etta->priv->presorted;
+}
+
+/* A presorted adapter shows the nodes in the source model order and never
+ * sorts them itself, the source model keeps them ordered by the sort info.
+ * That lets the model avoid providing values for rows which are not shown. */
+void
+e_tree_table_adapter_set_presorted (ETreeTableAdapter *etta,
+                                    gboolean presorted)
+{
+	g_return_if_fail (E_IS_TREE_TABLE_ADAPTER (etta));
+
+	if ((etta->priv->presorted ? 1 : 0) == (presorted ? 1 : 0))
+		return;
+
+	etta->priv->presorted = presorted;
+
+	g_object_notify (G_OBJECT (etta), "presorted");
+
+	if (!etta->priv->root)
+		return;
+
+	e_table_model_pre_change (E_TABLE_MODEL (etta));
+	resort_node (etta, etta->priv->root, TRUE);
+	fill_map_all (etta);
 	e_table_model_changed (E_TABLE_MODEL (etta));
 }
 
@@ -1469,8 +1672,6 @@ void
 e_tree_table_adapter_root_node_set_visible (ETreeTableAdapter *etta,
                                             gboolean visible)
 {
-	gint size;
-
 	g_return_if_fail (E_IS_TREE_TABLE_ADAPTER (etta));
 
 	if (etta->priv->root_visible == visible)
@@ -1484,10 +1685,7 @@ e_tree_table_adapter_root_node_set_visible (ETreeTableAdapter *etta,
 		if (root)
 			e_tree_table_adapter_node_set_expanded (etta, root, TRUE);
 	}
-	size = (visible ? 1 : 0) + (etta->priv->root ? ((node_t *) etta->priv->root->data)->num_visible_children : 0);
-	resize_map (etta, size);
-	if (etta->priv->root)
-		fill_map (etta, 0, etta->priv->root);
+	fill_map_all (etta);
 	e_table_model_changed (E_TABLE_MODEL (etta));
 }
 
@@ -1535,22 +1733,20 @@ e_tree_table_adapter_node_set_expanded (ETreeTableAdapter *etta,
 		update_child_counts (gnode, num_children);
 		if (etta->priv->sort_info && e_table_sort_info_sorting_get_count (etta->priv->sort_info) > 0)
 			resort_node (etta, gnode, TRUE);
-		resize_map (etta, etta->priv->n_map + num_children);
-		move_map_elements (etta, row + 1 + num_children, row + 1, etta->priv->n_map - row - 1 - num_children);
-		fill_map (etta, row, gnode);
+		fill_map (etta, row, 1, gnode);
 		if (num_children != 0) {
 			e_table_model_rows_inserted (E_TABLE_MODEL (etta), row + 1, num_children);
 		} else
 			e_table_model_no_change (E_TABLE_MODEL (etta));
 	} else {
-		gint num_children = delete_children (etta, gnode);
+		gint num_children = node->num_visible_children;
 		if (num_children == 0) {
 			e_table_model_no_change (E_TABLE_MODEL (etta));
 			return;
 		}
-		move_map_elements (etta, row + 1, row + 1 + num_children, etta->priv->n_map - row - 1 - num_children);
+		fill_map (etta, row + 1, num_children, NULL);
+		delete_children (etta, gnode);
 		update_child_counts (gnode, - num_children);
-		resize_map (etta, etta->priv->n_map - num_children);
 		e_table_model_rows_deleted (E_TABLE_MODEL (etta), row + 1, num_children);
 	}
 }
@@ -1577,14 +1773,18 @@ ETreePath
 e_tree_table_adapter_node_at_row (ETreeTableAdapter *etta,
                                   gint row)
 {
+	gint n_rows;
+
 	g_return_val_if_fail (E_IS_TREE_TABLE_ADAPTER (etta), NULL);
 
-	if (row == -1 && etta->priv->n_map > 0)
-		row = etta->priv->n_map - 1;
-	else if (row < 0 || row >= etta->priv->n_map)
+	n_rows = map_size (etta->priv->map_root);
+
+	if (row == -1 && n_rows > 0)
+		row = n_rows - 1;
+	else if (row < 0 || row >= n_rows)
 		return NULL;
 
-	return etta->priv->map_table[row]->path;
+	return map_nth (etta->priv->map_root, row)->path;
 }
 
 gint
@@ -1596,13 +1796,10 @@ e_tree_table_adapter_row_of_node (ETreeTableAdapter *etta,
 	g_return_val_if_fail (E_IS_TREE_TABLE_ADAPTER (etta), -1);
 
 	node = get_node (etta, path);
-	if (node == NULL)
+	if (node == NULL || node->map_size == 0)
 		return -1;
 
-	if (etta->priv->remap_needed)
-		remap_indices (etta);
-
-	return node->index;
+	return map_row (node);
 }
 
 gboolean
@@ -1665,7 +1862,7 @@ e_tree_table_adapter_clear_nodes_silent (ETreeTableAdapter *etta)
 {
 	g_return_if_fail (E_IS_TREE_TABLE_ADAPTER (etta));
 
+	clear_map (etta);
 	if (etta->priv->root)
 		kill_gnode (etta->priv->root, etta);
-	resize_map (etta, 0);
 }
@@ -86,6 +86,11 @@ gboolean	e_tree_table_adapter_get_sort_children_ascending
 void		e_tree_table_adapter_set_sort_children_ascending
 						(ETreeTableAdapter *etta,
 						 gboolean sort_children_ascending);
+gboolean	e_tree_table_adapter_get_presorted
+						(ETreeTableAdapter *etta);
+void		e_tree_table_adapter_set_presorted
+						(ETreeTableAdapter *etta,
+						 gboolean presorted);
 ETreeModel *	e_tree_table_adapter_get_source_model
 						(ETreeTableAdapter *etta);
 
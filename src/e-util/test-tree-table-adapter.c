@@ -0,0 +1,234 @@
+/* -*- Mode: C; indent-tabs-mode: t; c-basic-offset: 8; tab-width: 8 -*- */
+/* test-tree-table-adapter.c - Benchmark for the ETreeTableAdapter row map.
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdlib.h>
+
+#include <e-util/e-util.h>
+
+/* The tree looks like a threaded folder: N_THREADS collapsed threads,
+ * each with N_REPLIES replies, which is 100k nodes with the defaults. */
+#define N_THREADS 20000
+#define N_REPLIES 4
+#define N_INSERTS 10000
+
+typedef struct _TestNode TestNode;
+
+struct _TestNode {
+	TestNode *parent;
+	TestNode *first_child;
+	TestNode *last_child;
+	TestNode *next;
+};
+
+typedef struct _TestTreeModel {
+	GObject parent;
+
+	TestNode root;
+} TestTreeModel;
+
+typedef struct _TestTreeModelClass {
+	GObjectClass parent_class;
+} TestTreeModelClass;
+
+static void test_tree_model_tree_model_init (ETreeModelInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (
+	TestTreeModel,
+	test_tree_model,
+	G_TYPE_OBJECT,
+	G_IMPLEMENT_INTERFACE (
+		E_TYPE_TREE_MODEL,
+		test_tree_model_tree_model_init))
+
+static ETreePath
+test_tree_model_get_root (ETreeModel *tree_model)
+{
+	return &((TestTreeModel *) tree_model)->root;
+}
+
+static ETreePath
+test_tree_model_get_parent (ETreeModel *tree_model,
+                            ETreePath path)
+{
+	return ((TestNode *) path)->parent;
+}
+
+static ETreePath
+test_tree_model_get_first_child (ETreeModel *tree_model,
+                                 ETreePath path)
+{
+	return ((TestNode *) path)->first_child;
+}
+
+static ETreePath
+test_tree_model_get_next (ETreeModel *tree_model,
+                          ETreePath path)
+{
+	return ((TestNode *) path)->next;
+}
+
+static gboolean
+test_tree_model_is_root (ETreeModel *tree_model,
+                         ETreePath path)
+{
+	return path == test_tree_model_get_root (tree_model);
+}
+
+static gboolean
+test_tree_model_is_expandable (ETreeModel *tree_model,
+                               ETreePath path)
+{
+	return ((TestNode *) path)->first_child != NULL;
+}
+
+static gboolean
+test_tree_model_get_expanded_default (ETreeModel *tree_model)
+{
+	return FALSE;
+}
+
+static gint
+test_tree_model_column_count (ETreeModel *tree_model)
+{
+	return 1;
+}
+
+static void
+test_tree_model_class_init (TestTreeModelClass *class)
+{
+}
+
+static void
+test_tree_model_tree_model_init (ETreeModelInterface *iface)
+{
+	iface->get_root = test_tree_model_get_root;
+	iface->get_parent = test_tree_model_get_parent;
+	iface->get_first_child = test_tree_model_get_first_child;
+	iface->get_next = test_tree_model_get_next;
+	iface->is_root = test_tree_model_is_root;
+	iface->is_expandable = test_tree_model_is_expandable;
+	iface->get_expanded_default = test_tree_model_get_expanded_default;
+	iface->column_count = test_tree_model_column_count;
+}
+
+static void
+test_tree_model_init (TestTreeModel *model)
+{
+}
+
+static void
+test_node_append (TestNode *parent,
+                  TestNode *node)
+{
+	node->parent = parent;
+
+	if (parent->last_child)
+		parent->last_child->next = node;
+	else
+		parent->first_child = node;
+
+	parent->last_child = node;
+}
+
+static void
+report (GTimer *timer,
+        const gchar *what,
+        gint count)
+{
+	gdouble elapsed = g_timer_elapsed (timer, NULL);
+
+	g_print (
+		"%-32s %8d in %8.3f s (%.3f us each)\n",
+		what, count, elapsed, count > 0 ? elapsed * 1000000.0 / count : 0.0);
+
+	g_timer_start (timer);
+}
+
+gint
+main (gint argc,
+      gchar **argv)
+{
+	TestTreeModel *model;
+	ETreeModel *tree_model;
+	ETableModel *table_model;
+	ETreeTableAdapter *etta;
+	TestNode *nodes, *inserted;
+	GTimer *timer;
+	gint ii, jj, n_rows;
+
+	model = g_object_new (test_tree_model_get_type (), NULL);
+	tree_model = E_TREE_MODEL (model);
+
+	nodes = g_new0 (TestNode, N_THREADS * (N_REPLIES + 1));
+	inserted = g_new0 (TestNode, N_INSERTS);
+
+	for (ii = 0; ii < N_THREADS; ii++) {
+		TestNode *thread = &nodes[ii * (N_REPLIES + 1)];
+
+		test_node_append (&model->root, thread);
+
+		for (jj = 1; jj <= N_REPLIES; jj++)
+			test_node_append (thread, thread + jj);
+	}
+
+	timer = g_timer_new ();
+
+	table_model = e_tree_table_adapter_new (tree_model, NULL, NULL);
+	etta = E_TREE_TABLE_ADAPTER (table_model);
+	e_tree_table_adapter_root_node_set_visible (etta, FALSE);
+	report (timer, "Generate collapsed tree", N_THREADS * (N_REPLIES + 1));
+
+	for (ii = 0; ii < N_THREADS; ii++)
+		e_tree_table_adapter_node_set_expanded (etta, &nodes[ii * (N_REPLIES + 1)], TRUE);
+	report (timer, "Expand threads", N_THREADS);
+
+	n_rows = e_table_model_row_count (table_model);
+	g_assert_cmpint (n_rows, ==, N_THREADS * (N_REPLIES + 1));
+
+	for (ii = 0; ii < n_rows; ii++)
+		g_assert (e_tree_table_adapter_row_of_node (etta, &nodes[ii]) == ii);
+	report (timer, "Row of node", n_rows);
+
+	for (ii = 0; ii < n_rows; ii++)
+		g_assert (e_tree_table_adapter_node_at_row (etta, ii) == &nodes[ii]);
+	report (timer, "Node at row", n_rows);
+
+	for (ii = 0; ii < N_INSERTS; ii++) {
+		TestNode *thread = &nodes[(rand () % N_THREADS) * (N_REPLIES + 1)];
+
+		test_node_append (thread, &inserted[ii]);
+		e_tree_model_node_inserted (tree_model, thread, &inserted[ii]);
+		e_tree_table_adapter_row_of_node (etta, &inserted[ii]);
+	}
+	report (timer, "Insert into threads", N_INSERTS);
+
+	n_rows = e_table_model_row_count (table_model);
+	g_assert_cmpint (n_rows, ==, N_THREADS * (N_REPLIES + 1) + N_INSERTS);
+
+	for (ii = 0; ii < N_THREADS; ii++)
+		e_tree_table_adapter_node_set_expanded (etta, &nodes[ii * (N_REPLIES + 1)], FALSE);
+	report (timer, "Collapse threads", N_THREADS);
+
+	g_assert_cmpint (e_table_model_row_count (table_model), ==, N_THREADS);
+
+	g_timer_destroy (timer);
+	g_object_unref (table_model);
+	g_object_unref (model);
+	g_free (inserted);
+	g_free (nodes);
+
+	return 0;
+}
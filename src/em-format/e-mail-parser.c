@@ -211,6 +211,11 @@ mail_parser_run (EMailParser *parser,
 		g_object_unref (mail_part);
 	}
 
+	/* No more parts will be added, which speeds up lookups; a cancelled
+	 * parse can miss some parts, thus it's not complete */
+	if (!g_cancellable_is_cancelled (cancellable))
+		e_mail_part_list_set_complete (part_list);
+
 	g_mutex_lock (&parser->priv->mutex);
 	g_hash_table_remove (parser->priv->ongoing_part_lists, cancellable);
 	g_mutex_unlock (&parser->priv->mutex);
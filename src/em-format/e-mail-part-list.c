@@ -30,6 +30,15 @@ struct _EMailPartListPrivate {
 
 	GQueue queue;
 	GMutex queue_lock;
+
+	/* Both point to the first link of a part with the given
+	 * ID or CID in the queue; guarded by the queue_lock. */
+	GHashTable *id_index; /* gchar *part_id ~> GList * */
+	GHashTable *cid_index; /* gchar *cid ~> GList * */
+
+	/* Once set, no parts are added, thus the queue and
+	 * the indexes can be read without the queue_lock. */
+	gint complete;
 };
 
 enum {
@@ -159,6 +168,8 @@ mail_part_list_dispose (GObject *object)
 	}
 
 	g_mutex_lock (&priv->queue_lock);
+	g_hash_table_remove_all (priv->id_index);
+	g_hash_table_remove_all (priv->cid_index);
 	while (!g_queue_is_empty (&priv->queue))
 		g_object_unref (g_queue_pop_head (&priv->queue));
 	g_mutex_unlock (&priv->queue_lock);
@@ -177,6 +188,8 @@ mail_part_list_finalize (GObject *object)
 	g_free (priv->message_uid);
 
 	g_warn_if_fail (g_queue_is_empty (&priv->queue));
+	g_hash_table_destroy (priv->id_index);
+	g_hash_table_destroy (priv->cid_index);
 	g_mutex_clear (&priv->queue_lock);
 
 	/* Chain up to parent's finalize() method. */
@@ -239,6 +252,9 @@ e_mail_part_list_init (EMailPartList *part_list)
 	part_list->priv = E_MAIL_PART_LIST_GET_PRIVATE (part_list);
 
 	g_mutex_init (&part_list->priv->queue_lock);
+
+	part_list->priv->id_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	part_list->priv->cid_index = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 }
 
 EMailPartList *
@@ -287,8 +303,12 @@ void
 e_mail_part_list_add_part (EMailPartList *part_list,
                            EMailPart *part)
 {
+	const gchar *id, *cid;
+	GList *link;
+
 	g_return_if_fail (E_IS_MAIL_PART_LIST (part_list));
 	g_return_if_fail (E_IS_MAIL_PART (part));
+	g_return_if_fail (!g_atomic_int_get (&part_list->priv->complete));
 
 	g_mutex_lock (&part_list->priv->queue_lock);
 
@@ -296,44 +316,112 @@ e_mail_part_list_add_part (EMailPartList *part_list,
 		&part_list->priv->queue,
 		g_object_ref (part));
 
+	link = g_queue_peek_tail_link (&part_list->priv->queue);
+
+	/* The first part with the ID or CID wins, as with the list walk */
+	id = e_mail_part_get_id (part);
+	if (id && !g_hash_table_contains (part_list->priv->id_index, id))
+		g_hash_table_insert (part_list->priv->id_index, g_strdup (id), link);
+
+	cid = e_mail_part_get_cid (part);
+	if (cid && !g_hash_table_contains (part_list->priv->cid_index, cid))
+		g_hash_table_insert (part_list->priv->cid_index, g_strdup (cid), link);
+
 	g_mutex_unlock (&part_list->priv->queue_lock);
 
 	e_mail_part_set_part_list (part, part_list);
 }
 
+/**
+ * e_mail_part_list_set_complete:
+ * @part_list: an #EMailPartList
+ *
+ * Marks the @part_list as complete, after which no more parts can
+ * be added to it.  Lookups in a complete @part_list do not need
+ * to lock it.
+ *
+ * Since: 3.38
+ **/
+void
+e_mail_part_list_set_complete (EMailPartList *part_list)
+{
+	g_return_if_fail (E_IS_MAIL_PART_LIST (part_list));
+
+	/* Taking the lock makes sure all parts are added */
+	g_mutex_lock (&part_list->priv->queue_lock);
+	g_atomic_int_set (&part_list->priv->complete, 1);
+	g_mutex_unlock (&part_list->priv->queue_lock);
+}
+
+/**
+ * e_mail_part_list_get_complete:
+ * @part_list: an #EMailPartList
+ *
+ * Returns: whether e_mail_part_list_set_complete() had been called
+ *
+ * Since: 3.38
+ **/
+gboolean
+e_mail_part_list_get_complete (EMailPartList *part_list)
+{
+	g_return_val_if_fail (E_IS_MAIL_PART_LIST (part_list), FALSE);
+
+	return g_atomic_int_get (&part_list->priv->complete) != 0;
+}
+
+/* Returns the first link with the part of the given ID or CID */
+static GList *
+mail_part_list_lookup_link (EMailPartList *part_list,
+                            const gchar *part_id,
+                            gboolean by_cid)
+{
+	GList *link;
+
+	link = g_hash_table_lookup (by_cid ? part_list->priv->cid_index : part_list->priv->id_index, part_id);
+
+	/* The ID or CID could be changed after the part was added,
+	 * which is not possible once the part list is complete. */
+	if (!link && !g_atomic_int_get (&part_list->priv->complete)) {
+		for (link = g_queue_peek_head_link (&part_list->priv->queue); link; link = g_list_next (link)) {
+			EMailPart *candidate = E_MAIL_PART (link->data);
+			const gchar *candidate_id;
+
+			if (by_cid)
+				candidate_id = e_mail_part_get_cid (candidate);
+			else
+				candidate_id = e_mail_part_get_id (candidate);
+
+			if (g_strcmp0 (candidate_id, part_id) == 0)
+				break;
+		}
+	}
+
+	return link;
+}
+
 EMailPart *
 e_mail_part_list_ref_part (EMailPartList *part_list,
                            const gchar *part_id)
 {
 	EMailPart *match = NULL;
-	GList *head, *link;
-	gboolean by_cid;
+	GList *link;
+	gboolean by_cid, locked;
 
 	g_return_val_if_fail (E_IS_MAIL_PART_LIST (part_list), NULL);
 	g_return_val_if_fail (part_id != NULL, NULL);
 
 	by_cid = (g_ascii_strncasecmp (part_id, "cid:", 4) == 0);
 
-	g_mutex_lock (&part_list->priv->queue_lock);
-
-	head = g_queue_peek_head_link (&part_list->priv->queue);
+	locked = !g_atomic_int_get (&part_list->priv->complete);
+	if (locked)
+		g_mutex_lock (&part_list->priv->queue_lock);
 
-	for (link = head; link != NULL; link = g_list_next (link)) {
-		EMailPart *candidate = E_MAIL_PART (link->data);
-		const gchar *candidate_id;
+	link = mail_part_list_lookup_link (part_list, part_id, by_cid);
+	if (link)
+		match = g_object_ref (link->data);
 
-		if (by_cid)
-			candidate_id = e_mail_part_get_cid (candidate);
-		else
-			candidate_id = e_mail_part_get_id (candidate);
-
-		if (g_strcmp0 (candidate_id, part_id) == 0) {
-			match = g_object_ref (candidate);
-			break;
-		}
-	}
-
-	g_mutex_unlock (&part_list->priv->queue_lock);
+	if (locked)
+		g_mutex_unlock (&part_list->priv->queue_lock);
 
 	return match;
 }
@@ -360,25 +448,19 @@ e_mail_part_list_queue_parts (EMailPartList *part_list,
 {
 	GList *link;
 	guint parts_queued = 0;
+	gboolean locked;
 
 	g_return_val_if_fail (E_IS_MAIL_PART_LIST (part_list), FALSE);
 	g_return_val_if_fail (result_queue != NULL, FALSE);
 
-	g_mutex_lock (&part_list->priv->queue_lock);
+	locked = !g_atomic_int_get (&part_list->priv->complete);
+	if (locked)
+		g_mutex_lock (&part_list->priv->queue_lock);
 
-	link = g_queue_peek_head_link (&part_list->priv->queue);
-
-	if (part_id != NULL) {
-		for (; link != NULL; link = g_list_next (link)) {
-			EMailPart *candidate = E_MAIL_PART (link->data);
-			const gchar *candidate_id;
-
-			candidate_id = e_mail_part_get_id (candidate);
-
-			if (g_strcmp0 (candidate_id, part_id) == 0)
-				break;
-		}
-	}
+	if (part_id != NULL)
+		link = mail_part_list_lookup_link (part_list, part_id, FALSE);
+	else
+		link = g_queue_peek_head_link (&part_list->priv->queue);
 
 	/* We skip the loop entirely if link is NULL. */
 	for (; link != NULL; link = g_list_next (link)) {
@@ -391,7 +473,8 @@ e_mail_part_list_queue_parts (EMailPartList *part_list,
 		parts_queued++;
 	}
 
-	g_mutex_unlock (&part_list->priv->queue_lock);
+	if (locked)
+		g_mutex_unlock (&part_list->priv->queue_lock);
 
 	return parts_queued;
 }
@@ -434,3 +517,421 @@ e_mail_part_list_get_registry (void)
 
 	return registry;
 }
+
+/* The registry keeps part lists only while they are used; the cache below
+ * holds the recently used ones, thus the message is not parsed again when
+ * it's shown in another window or when replying to it. */
+
+#define PART_LIST_CACHE_MAX_ITEMS	16
+#define PART_LIST_CACHE_MAX_BYTES	(64 * 1024 * 1024)
+/* Size estimate of a part list without a message info */
+#define PART_LIST_CACHE_DEFAULT_BYTES	(64 * 1024)
+
+typedef struct _CacheItem {
+	EMailPartList *part_list;
+	gsize n_bytes;
+} CacheItem;
+
+static GQueue cache_items = G_QUEUE_INIT; /* CacheItem *, most recent first */
+static gsize cache_n_bytes = 0;
+static guint cache_hits = 0;
+static guint cache_misses = 0;
+G_LOCK_DEFINE_STATIC (cache);
+
+static gsize
+mail_part_list_estimate_size (EMailPartList *part_list)
+{
+	CamelMessageInfo *info = NULL;
+	gsize n_bytes = 0;
+
+	if (part_list->priv->folder && part_list->priv->message_uid)
+		info = camel_folder_get_message_info (part_list->priv->folder, part_list->priv->message_uid);
+
+	if (info) {
+		/* Parts hold the message and its decoded content */
+		n_bytes = 2 * camel_message_info_get_size (info);
+		g_object_unref (info);
+	}
+
+	return n_bytes > 0 ? n_bytes : PART_LIST_CACHE_DEFAULT_BYTES;
+}
+
+/* Moves the part list to the front of the cache; returns FALSE when not cached */
+static gboolean
+mail_part_list_cache_touch_locked (EMailPartList *part_list)
+{
+	GList *link;
+
+	for (link = g_queue_peek_head_link (&cache_items); link; link = g_list_next (link)) {
+		CacheItem *item = link->data;
+
+		if (item->part_list == part_list) {
+			g_queue_unlink (&cache_items, link);
+			g_queue_push_head_link (&cache_items, link);
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+/* Each folder with a cached part list is watched, thus the part lists
+ * of removed messages and of deleted or disposed folders are dropped. */
+typedef struct _CacheFolder {
+	CamelFolder *folder; /* not referenced */
+	gulong changed_handler_id;
+	gulong deleted_handler_id;
+	guint n_items;
+} CacheFolder;
+
+static GHashTable *cache_folders = NULL; /* CamelFolder * ~> CacheFolder * */
+
+static void	mail_part_list_cache_folder_changed_cb
+						(CamelFolder *folder,
+						 CamelFolderChangeInfo *changes,
+						 gpointer user_data);
+static void	mail_part_list_cache_folder_deleted_cb
+						(CamelFolder *folder,
+						 gpointer user_data);
+static void	mail_part_list_cache_folder_disposed_cb
+						(gpointer user_data,
+						 GObject *folder);
+
+static void
+mail_part_list_cache_watch_folder_locked (CamelFolder *folder)
+{
+	CacheFolder *cache_folder;
+
+	if (!folder)
+		return;
+
+	if (!cache_folders)
+		cache_folders = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	cache_folder = g_hash_table_lookup (cache_folders, folder);
+	if (!cache_folder) {
+		cache_folder = g_slice_new0 (CacheFolder);
+		cache_folder->folder = folder;
+		cache_folder->changed_handler_id = g_signal_connect (
+			folder, "changed",
+			G_CALLBACK (mail_part_list_cache_folder_changed_cb), NULL);
+		cache_folder->deleted_handler_id = g_signal_connect (
+			folder, "deleted",
+			G_CALLBACK (mail_part_list_cache_folder_deleted_cb), NULL);
+		g_object_weak_ref (G_OBJECT (folder), mail_part_list_cache_folder_disposed_cb, NULL);
+
+		g_hash_table_insert (cache_folders, folder, cache_folder);
+	}
+
+	cache_folder->n_items++;
+}
+
+static void
+mail_part_list_cache_forget_folder_locked (CacheFolder *cache_folder,
+                                           gboolean is_disposed)
+{
+	g_signal_handler_disconnect (cache_folder->folder, cache_folder->changed_handler_id);
+	g_signal_handler_disconnect (cache_folder->folder, cache_folder->deleted_handler_id);
+
+	/* The weak reference is gone already after its notification */
+	if (!is_disposed)
+		g_object_weak_unref (G_OBJECT (cache_folder->folder), mail_part_list_cache_folder_disposed_cb, NULL);
+
+	g_hash_table_remove (cache_folders, cache_folder->folder);
+	g_slice_free (CacheFolder, cache_folder);
+}
+
+static void
+mail_part_list_cache_unwatch_folder_locked (CamelFolder *folder)
+{
+	CacheFolder *cache_folder;
+
+	if (!folder || !cache_folders)
+		return;
+
+	cache_folder = g_hash_table_lookup (cache_folders, folder);
+	if (!cache_folder)
+		return;
+
+	cache_folder->n_items--;
+
+	if (!cache_folder->n_items)
+		mail_part_list_cache_forget_folder_locked (cache_folder, FALSE);
+}
+
+/* Removes the cached part lists of the @folder, of all its messages when
+ * the @message_uid is NULL, and prepends them to the @removed list */
+static GSList *
+mail_part_list_cache_remove_locked (CamelFolder *folder,
+                                    const gchar *message_uid,
+                                    GSList *removed)
+{
+	GList *link, *next;
+
+	for (link = g_queue_peek_head_link (&cache_items); link; link = next) {
+		CacheItem *item = link->data;
+
+		next = g_list_next (link);
+
+		if (item->part_list->priv->folder == folder &&
+		    (!message_uid || g_strcmp0 (item->part_list->priv->message_uid, message_uid) == 0)) {
+			g_queue_delete_link (&cache_items, link);
+			cache_n_bytes -= item->n_bytes;
+
+			mail_part_list_cache_unwatch_folder_locked (folder);
+
+			removed = g_slist_prepend (removed, item);
+		}
+	}
+
+	return removed;
+}
+
+/* Call out of the lock, the part lists can be freed here */
+static void
+mail_part_list_cache_free_items (GSList *items)
+{
+	while (items) {
+		CacheItem *item = items->data;
+
+		items = g_slist_remove (items, item);
+
+		g_object_unref (item->part_list);
+		g_slice_free (CacheItem, item);
+	}
+}
+
+static void
+mail_part_list_cache_folder_changed_cb (CamelFolder *folder,
+                                        CamelFolderChangeInfo *changes,
+                                        gpointer user_data)
+{
+	GSList *removed = NULL;
+	guint ii;
+
+	if (!changes || !changes->uid_removed || !changes->uid_removed->len)
+		return;
+
+	G_LOCK (cache);
+
+	for (ii = 0; ii < changes->uid_removed->len; ii++) {
+		removed = mail_part_list_cache_remove_locked (
+			folder, changes->uid_removed->pdata[ii], removed);
+	}
+
+	G_UNLOCK (cache);
+
+	mail_part_list_cache_free_items (removed);
+}
+
+static void
+mail_part_list_cache_folder_deleted_cb (CamelFolder *folder,
+                                        gpointer user_data)
+{
+	GSList *removed;
+
+	G_LOCK (cache);
+	removed = mail_part_list_cache_remove_locked (folder, NULL, NULL);
+	G_UNLOCK (cache);
+
+	mail_part_list_cache_free_items (removed);
+}
+
+static void
+mail_part_list_cache_folder_disposed_cb (gpointer user_data,
+                                         GObject *folder)
+{
+	CacheFolder *cache_folder;
+	GSList *removed;
+
+	G_LOCK (cache);
+
+	cache_folder = cache_folders ? g_hash_table_lookup (cache_folders, folder) : NULL;
+	if (cache_folder)
+		mail_part_list_cache_forget_folder_locked (cache_folder, TRUE);
+
+	removed = mail_part_list_cache_remove_locked (CAMEL_FOLDER (folder), NULL, NULL);
+
+	G_UNLOCK (cache);
+
+	mail_part_list_cache_free_items (removed);
+}
+
+/**
+ * e_mail_part_list_cache_add:
+ * @part_list: an #EMailPartList
+ *
+ * Keeps a reference to the @part_list, which had been added to the registry
+ * returned by e_mail_part_list_get_registry(), thus it can be reused by
+ * e_mail_part_list_cache_ref() after its other users are gone.  The least
+ * recently used part lists are dropped from the cache when it holds too many
+ * of them or their messages are too large.  Part lists of messages removed
+ * from their folder, and of deleted or disposed folders, are dropped as well.
+ *
+ * Since: 3.38
+ **/
+void
+e_mail_part_list_cache_add (EMailPartList *part_list)
+{
+	GSList *evicted = NULL;
+	CacheItem *item;
+
+	g_return_if_fail (E_IS_MAIL_PART_LIST (part_list));
+
+	G_LOCK (cache);
+
+	if (mail_part_list_cache_touch_locked (part_list)) {
+		G_UNLOCK (cache);
+		return;
+	}
+
+	G_UNLOCK (cache);
+
+	item = g_slice_new (CacheItem);
+	item->part_list = g_object_ref (part_list);
+	item->n_bytes = mail_part_list_estimate_size (part_list);
+
+	G_LOCK (cache);
+
+	if (mail_part_list_cache_touch_locked (part_list)) {
+		G_UNLOCK (cache);
+		g_object_unref (item->part_list);
+		g_slice_free (CacheItem, item);
+		return;
+	}
+
+	g_queue_push_head (&cache_items, item);
+	cache_n_bytes += item->n_bytes;
+
+	mail_part_list_cache_watch_folder_locked (part_list->priv->folder);
+
+	/* Always keep the just added part list */
+	while (cache_items.length > 1 &&
+	       (cache_items.length > PART_LIST_CACHE_MAX_ITEMS ||
+		cache_n_bytes > PART_LIST_CACHE_MAX_BYTES)) {
+		item = g_queue_pop_tail (&cache_items);
+		cache_n_bytes -= item->n_bytes;
+
+		mail_part_list_cache_unwatch_folder_locked (item->part_list->priv->folder);
+
+		evicted = g_slist_prepend (evicted, item);
+	}
+
+	G_UNLOCK (cache);
+
+	mail_part_list_cache_free_items (evicted);
+}
+
+/**
+ * e_mail_part_list_cache_ref:
+ * @mail_uri: a mail URI, as returned by e_mail_part_build_uri()
+ *
+ * Looks up an already parsed #EMailPartList for the @mail_uri in the registry
+ * returned by e_mail_part_list_get_registry() and marks it as recently used
+ * in the cache.  The lookup is counted as a hit or a miss of the cache.
+ *
+ * Returns: (transfer full) (nullable): the #EMailPartList for the @mail_uri,
+ *    or %NULL when not found; free it with g_object_unref(), when no longer
+ *    needed
+ *
+ * Since: 3.38
+ **/
+EMailPartList *
+e_mail_part_list_cache_ref (const gchar *mail_uri)
+{
+	EMailPartList *part_list;
+
+	g_return_val_if_fail (mail_uri != NULL, NULL);
+
+	part_list = camel_object_bag_get (e_mail_part_list_get_registry (), mail_uri);
+
+	G_LOCK (cache);
+
+	if (part_list) {
+		cache_hits++;
+		mail_part_list_cache_touch_locked (part_list);
+	} else {
+		cache_misses++;
+	}
+
+	G_UNLOCK (cache);
+
+	return part_list;
+}
+
+/**
+ * e_mail_part_list_cache_peek:
+ * @folder: a #CamelFolder
+ * @message_uid: a message UID in the @folder
+ *
+ * Looks up an already parsed #EMailPartList for the @message_uid
+ * of the @folder in the cache only, like e_mail_part_list_cache_ref()
+ * does, except it does not wait for a part list being just parsed,
+ * thus it can be called from the main thread.  The lookup is counted
+ * as a hit or a miss of the cache.
+ *
+ * Returns: (transfer full) (nullable): the cached #EMailPartList, or %NULL
+ *    when not found; free it with g_object_unref(), when no longer needed
+ *
+ * Since: 3.38
+ **/
+EMailPartList *
+e_mail_part_list_cache_peek (CamelFolder *folder,
+                             const gchar *message_uid)
+{
+	EMailPartList *part_list = NULL;
+	GList *link;
+
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
+	g_return_val_if_fail (message_uid != NULL, NULL);
+
+	G_LOCK (cache);
+
+	for (link = g_queue_peek_head_link (&cache_items); link; link = g_list_next (link)) {
+		CacheItem *item = link->data;
+
+		if (item->part_list->priv->folder == folder &&
+		    g_strcmp0 (item->part_list->priv->message_uid, message_uid) == 0) {
+			part_list = g_object_ref (item->part_list);
+
+			g_queue_unlink (&cache_items, link);
+			g_queue_push_head_link (&cache_items, link);
+			break;
+		}
+	}
+
+	if (part_list)
+		cache_hits++;
+	else
+		cache_misses++;
+
+	G_UNLOCK (cache);
+
+	return part_list;
+}
+
+/**
+ * e_mail_part_list_cache_get_stats:
+ * @out_hits: (out) (optional): return location for the number of hits, or %NULL
+ * @out_misses: (out) (optional): return location for the number of misses, or %NULL
+ *
+ * Returns how many lookups by e_mail_part_list_cache_ref() and
+ * e_mail_part_list_cache_peek() found
+ * an already parsed part list and how many did not.
+ *
+ * Since: 3.38
+ **/
+void
+e_mail_part_list_cache_get_stats (guint *out_hits,
+                                  guint *out_misses)
+{
+	G_LOCK (cache);
+
+	if (out_hits)
+		*out_hits = cache_hits;
+
+	if (out_misses)
+		*out_misses = cache_misses;
+
+	G_UNLOCK (cache);
+}
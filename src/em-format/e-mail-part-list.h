@@ -66,6 +66,8 @@ const gchar *	e_mail_part_list_get_message_uid
 						(EMailPartList *part_list);
 void		e_mail_part_list_add_part	(EMailPartList *part_list,
 						 EMailPart *part);
+void		e_mail_part_list_set_complete	(EMailPartList *part_list);
+gboolean	e_mail_part_list_get_complete	(EMailPartList *part_list);
 EMailPart *	e_mail_part_list_ref_part	(EMailPartList *part_list,
 						 const gchar *part_id);
 guint		e_mail_part_list_queue_parts	(EMailPartList *part_list,
@@ -75,6 +77,13 @@ gboolean	e_mail_part_list_is_empty	(EMailPartList *part_list);
 
 CamelObjectBag *
 		e_mail_part_list_get_registry	(void);
+void		e_mail_part_list_cache_add	(EMailPartList *part_list);
+EMailPartList *	e_mail_part_list_cache_ref	(const gchar *mail_uri);
+EMailPartList *	e_mail_part_list_cache_peek	(CamelFolder *folder,
+						 const gchar *message_uid);
+void		e_mail_part_list_cache_get_stats
+						(guint *out_hits,
+						 guint *out_misses);
 
 G_END_DECLS
 
@@ -658,99 +658,335 @@ mail_folder_find_duplicate_messages_thread (GSimpleAsyncResult *simple,
 		g_simple_async_result_take_error (simple, error);
 }
 
-static GHashTable *
-emfu_get_messages_hash_sync (CamelFolder *folder,
-                             GPtrArray *message_uids,
-                             GCancellable *cancellable,
-                             GError **error)
+/* How many messages e_mail_folder_foreach_message_sync()
+ * requests at once, unless the caller says otherwise. */
+#define EMFU_MESSAGES_IN_FLIGHT 4
+
+typedef struct _ForeachMessageData {
+	CamelFolder *folder;
+	GPtrArray *message_uids;
+	GCancellable *cancellable;
+
+	GMutex lock;
+	GCond cond;
+	CamelMimeMessage **messages;
+	GError **errors;
+	gboolean *done;
+	gboolean abort;
+} ForeachMessageData;
+
+static void
+emfu_foreach_message_fetch_thread (gpointer data,
+                                   gpointer user_data)
 {
-	GHashTable *hash_table;
-	CamelMimeMessage *message;
-	guint ii;
+	ForeachMessageData *fmd = user_data;
+	CamelMimeMessage *message = NULL;
+	GError *local_error = NULL;
+	guint index = GPOINTER_TO_UINT (data) - 1;
+	gboolean abort;
 
-	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
-	g_return_val_if_fail (message_uids != NULL, NULL);
+	g_mutex_lock (&fmd->lock);
+	abort = fmd->abort;
+	g_mutex_unlock (&fmd->lock);
 
-	camel_operation_push_message (
-		cancellable,
-		ngettext (
-			"Retrieving %d message",
-			"Retrieving %d messages",
-			message_uids->len),
-		message_uids->len);
+	if (!abort) {
+		message = camel_folder_get_message_sync (
+			fmd->folder, g_ptr_array_index (fmd->message_uids, index),
+			fmd->cancellable, &local_error);
 
-	hash_table = g_hash_table_new_full (
-		(GHashFunc) g_str_hash,
-		(GEqualFunc) g_str_equal,
-		(GDestroyNotify) g_free,
-		(GDestroyNotify) g_free);
+		if (!message && !local_error)
+			local_error = g_error_new_literal (CAMEL_ERROR, CAMEL_ERROR_GENERIC, _("Failed to retrieve message"));
+	}
 
-	/* This is an all or nothing operation.  Destroy the
-	 * hash table if we fail to retrieve any message. */
+	g_mutex_lock (&fmd->lock);
+	fmd->messages[index] = message;
+	fmd->errors[index] = local_error;
+	fmd->done[index] = TRUE;
+	g_cond_broadcast (&fmd->cond);
+	g_mutex_unlock (&fmd->lock);
+}
 
-	for (ii = 0; ii < message_uids->len; ii++) {
-		const gchar *uid;
+/**
+ * e_mail_folder_foreach_message_sync:
+ * @folder: a #CamelFolder
+ * @message_uids: UIDs of the messages to retrieve
+ * @max_in_flight: how many messages to request at once, or 0 for a default
+ * @stop_on_error: whether to stop on the first message which cannot be retrieved
+ * @func: (scope call): an #EMailFolderMessageFunc to call for each message
+ * @user_data: user data for @func
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Retrieves the messages identified by @message_uids and passes them to @func
+ * in the order of @message_uids, as soon as they are available. Up to
+ * @max_in_flight messages are being retrieved at the same time, which hides
+ * the round-trip time of remote stores. Messages are not kept after @func
+ * returns, thus it's up to @func to reference those it wants to keep.
+ *
+ * When @stop_on_error is %TRUE, the first message which cannot be retrieved
+ * stops the operation and its error is propagated to @error. Otherwise such
+ * messages are passed to @func with a %NULL message and the @fetch_error set.
+ * The @func can stop the operation by returning %FALSE with its @error set.
+ *
+ * Returns: %TRUE when all messages had been processed, %FALSE otherwise
+ *
+ * Since: 3.38
+ **/
+gboolean
+e_mail_folder_foreach_message_sync (CamelFolder *folder,
+                                    GPtrArray *message_uids,
+                                    guint max_in_flight,
+                                    gboolean stop_on_error,
+                                    EMailFolderMessageFunc func,
+                                    gpointer user_data,
+                                    GCancellable *cancellable,
+                                    GError **error)
+{
+	ForeachMessageData fmd;
+	GThreadPool *pool;
+	guint ii, n_pushed = 0;
+	gboolean success = TRUE;
+
+	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), FALSE);
+	g_return_val_if_fail (message_uids != NULL, FALSE);
+	g_return_val_if_fail (func != NULL, FALSE);
+
+	if (!message_uids->len)
+		return TRUE;
+
+	if (!max_in_flight)
+		max_in_flight = EMFU_MESSAGES_IN_FLIGHT;
+
+	fmd.folder = folder;
+	fmd.message_uids = message_uids;
+	fmd.cancellable = cancellable;
+	fmd.messages = g_new0 (CamelMimeMessage *, message_uids->len);
+	fmd.errors = g_new0 (GError *, message_uids->len);
+	fmd.done = g_new0 (gboolean, message_uids->len);
+	fmd.abort = FALSE;
+
+	g_mutex_init (&fmd.lock);
+	g_cond_init (&fmd.cond);
+
+	pool = g_thread_pool_new (emfu_foreach_message_fetch_thread, &fmd, max_in_flight, FALSE, NULL);
+
+	for (ii = 0; ii < message_uids->len && success; ii++) {
+		CamelMimeMessage *message;
+		GError *fetch_error;
 		gint percent;
 
-		uid = g_ptr_array_index (message_uids, ii);
-		percent = ((ii + 1) * 100) / message_uids->len;
+		/* Keep up to max_in_flight messages being retrieved ahead */
+		while (n_pushed < message_uids->len && n_pushed < ii + max_in_flight) {
+			g_thread_pool_push (pool, GUINT_TO_POINTER (n_pushed + 1), NULL);
+			n_pushed++;
+		}
 
-		message = camel_folder_get_message_sync (
-			folder, uid, cancellable, error);
+		g_mutex_lock (&fmd.lock);
+		while (!fmd.done[ii])
+			g_cond_wait (&fmd.cond, &fmd.lock);
+		message = fmd.messages[ii];
+		fmd.messages[ii] = NULL;
+		fetch_error = fmd.errors[ii];
+		fmd.errors[ii] = NULL;
+		g_mutex_unlock (&fmd.lock);
 
+		percent = ((ii + 1) * 100) / message_uids->len;
 		camel_operation_progress (cancellable, percent);
 
-		if (CAMEL_IS_MIME_MESSAGE (message)) {
-			CamelDataWrapper *content;
-			gchar *digest = NULL;
+		if (!message && (stop_on_error || g_cancellable_is_cancelled (cancellable))) {
+			g_propagate_error (error, fetch_error);
+			success = FALSE;
+			break;
+		}
 
-			/* Generate a digest string from the message's content. */
-			content = camel_medium_get_content (CAMEL_MEDIUM (message));
+		success = func (folder, g_ptr_array_index (message_uids, ii), message, fetch_error, user_data, cancellable, error);
 
-			if (content != NULL) {
-				CamelStream *stream;
-				GByteArray *buffer;
-				gssize n_bytes;
+		g_clear_object (&message);
+		g_clear_error (&fetch_error);
+	}
 
-				stream = camel_stream_mem_new ();
+	g_mutex_lock (&fmd.lock);
+	fmd.abort = TRUE;
+	g_mutex_unlock (&fmd.lock);
 
-				n_bytes = camel_data_wrapper_decode_to_stream_sync (
-					content, stream, cancellable, error);
+	/* Wait for messages still being retrieved */
+	g_thread_pool_free (pool, FALSE, TRUE);
 
-				if (n_bytes >= 0) {
-					guint data_len;
+	for (ii = 0; ii < message_uids->len; ii++) {
+		g_clear_object (&fmd.messages[ii]);
+		g_clear_error (&fmd.errors[ii]);
+	}
 
-					/* The CamelStreamMem owns the buffer. */
-					buffer = camel_stream_mem_get_byte_array (
-						CAMEL_STREAM_MEM (stream));
-					g_return_val_if_fail (buffer != NULL, NULL);
+	g_mutex_clear (&fmd.lock);
+	g_cond_clear (&fmd.cond);
+	g_free (fmd.messages);
+	g_free (fmd.errors);
+	g_free (fmd.done);
 
-					data_len = buffer->len;
+	return success;
+}
 
-					/* Strip trailing white-spaces and empty lines */
-					while (data_len > 0 && g_ascii_isspace (buffer->data[data_len - 1]))
-						data_len--;
+/* An output stream which only computes a checksum of the data written
+ * to it, ignoring trailing white-spaces and empty lines. */
 
-					if (data_len > 0)
-						digest = g_compute_checksum_for_data (G_CHECKSUM_SHA256, buffer->data, data_len);
-				}
+typedef struct _EMFUDigestStream {
+	GOutputStream parent;
 
-				g_object_unref (stream);
-			}
+	GChecksum *checksum;
+	GByteArray *pending_spaces;
+	gboolean has_data;
+} EMFUDigestStream;
 
-			g_hash_table_insert (
-				hash_table, g_strdup (uid), digest);
-			g_object_unref (message);
-		} else {
-			g_hash_table_destroy (hash_table);
-			hash_table = NULL;
-			break;
+typedef struct _EMFUDigestStreamClass {
+	GOutputStreamClass parent_class;
+} EMFUDigestStreamClass;
+
+GType emfu_digest_stream_get_type (void);
+
+G_DEFINE_TYPE (EMFUDigestStream, emfu_digest_stream, G_TYPE_OUTPUT_STREAM)
+
+static gssize
+emfu_digest_stream_write_fn (GOutputStream *stream,
+                             gconstpointer buffer,
+                             gsize count,
+                             GCancellable *cancellable,
+                             GError **error)
+{
+	EMFUDigestStream *digest_stream = (EMFUDigestStream *) stream;
+	const guchar *data = buffer;
+	gsize data_len = count;
+
+	/* Find the last non-white-space character */
+	while (data_len > 0 && g_ascii_isspace (data[data_len - 1]))
+		data_len--;
+
+	/* White-spaces are used only when followed by other characters */
+	if (data_len > 0) {
+		if (digest_stream->pending_spaces->len > 0) {
+			g_checksum_update (digest_stream->checksum, digest_stream->pending_spaces->data, digest_stream->pending_spaces->len);
+			g_byte_array_set_size (digest_stream->pending_spaces, 0);
 		}
+
+		g_checksum_update (digest_stream->checksum, data, data_len);
+		digest_stream->has_data = TRUE;
 	}
 
-	camel_operation_pop_message (cancellable);
+	if (data_len < count)
+		g_byte_array_append (digest_stream->pending_spaces, data + data_len, count - data_len);
 
-	return hash_table;
+	return count;
+}
+
+static void
+emfu_digest_stream_finalize (GObject *object)
+{
+	EMFUDigestStream *digest_stream = (EMFUDigestStream *) object;
+
+	g_checksum_free (digest_stream->checksum);
+	g_byte_array_unref (digest_stream->pending_spaces);
+
+	/* Chain up to parent's finalize() method. */
+	G_OBJECT_CLASS (emfu_digest_stream_parent_class)->finalize (object);
+}
+
+static void
+emfu_digest_stream_class_init (EMFUDigestStreamClass *class)
+{
+	GObjectClass *object_class;
+	GOutputStreamClass *stream_class;
+
+	object_class = G_OBJECT_CLASS (class);
+	object_class->finalize = emfu_digest_stream_finalize;
+
+	stream_class = G_OUTPUT_STREAM_CLASS (class);
+	stream_class->write_fn = emfu_digest_stream_write_fn;
+}
+
+static void
+emfu_digest_stream_init (EMFUDigestStream *digest_stream)
+{
+	digest_stream->checksum = g_checksum_new (G_CHECKSUM_SHA256);
+	digest_stream->pending_spaces = g_byte_array_new ();
+}
+
+/* Returns a digest string of the message's decoded content,
+ * or %NULL when the message has no content. */
+static gchar *
+emfu_compute_message_digest (CamelMimeMessage *message,
+                             GCancellable *cancellable)
+{
+	EMFUDigestStream *digest_stream;
+	CamelDataWrapper *content;
+	gchar *digest = NULL;
+
+	content = camel_medium_get_content (CAMEL_MEDIUM (message));
+
+	if (content == NULL)
+		return NULL;
+
+	digest_stream = g_object_new (emfu_digest_stream_get_type (), NULL);
+
+	if (camel_data_wrapper_decode_to_output_stream_sync (content, G_OUTPUT_STREAM (digest_stream), cancellable, NULL) >= 0 &&
+	    digest_stream->has_data)
+		digest = g_strdup (g_checksum_get_string (digest_stream->checksum));
+
+	g_object_unref (digest_stream);
+
+	return digest;
+}
+
+typedef struct _DuplicatesData {
+	GThreadPool *digest_pool;
+	GCancellable *cancellable;
+
+	GMutex lock;
+	GHashTable *digests; /* gchar *uid ~> gchar *digest */
+} DuplicatesData;
+
+typedef struct _DuplicatesDigestJob {
+	gchar *uid;
+	CamelMimeMessage *message;
+} DuplicatesDigestJob;
+
+static void
+emfu_duplicates_digest_thread (gpointer data,
+                               gpointer user_data)
+{
+	DuplicatesDigestJob *job = data;
+	DuplicatesData *dd = user_data;
+	gchar *digest;
+
+	digest = emfu_compute_message_digest (job->message, dd->cancellable);
+
+	g_mutex_lock (&dd->lock);
+	g_hash_table_insert (dd->digests, job->uid, digest);
+	g_mutex_unlock (&dd->lock);
+
+	g_object_unref (job->message);
+	g_slice_free (DuplicatesDigestJob, job);
+}
+
+static gboolean
+emfu_duplicates_message_cb (CamelFolder *folder,
+                            const gchar *message_uid,
+                            CamelMimeMessage *message,
+                            const GError *fetch_error,
+                            gpointer user_data,
+                            GCancellable *cancellable,
+                            GError **error)
+{
+	DuplicatesData *dd = user_data;
+	DuplicatesDigestJob *job;
+
+	/* Hash the content in the pool, while the next
+	 * messages are being retrieved. */
+	job = g_slice_new (DuplicatesDigestJob);
+	job->uid = g_strdup (message_uid);
+	job->message = g_object_ref (message);
+
+	g_thread_pool_push (dd->digest_pool, job, NULL);
+
+	return TRUE;
 }
 
 GHashTable *
@@ -759,90 +995,152 @@ e_mail_folder_find_duplicate_messages_sync (CamelFolder *folder,
                                             GCancellable *cancellable,
                                             GError **error)
 {
-	GQueue trash = G_QUEUE_INIT;
+	DuplicatesData dd;
 	GHashTable *hash_table;
+	GHashTable *groups;
 	GHashTable *unique_ids;
-	GHashTableIter iter;
-	gpointer key, value;
+	GPtrArray *candidates;
+	gint64 *message_ids;
+	gboolean *skip;
+	gboolean success;
+	guint ii;
 
 	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
 	g_return_val_if_fail (message_uids != NULL, NULL);
 
-	/* hash_table = { MessageUID : digest-as-string } */
-	hash_table = emfu_get_messages_hash_sync (
-		folder, message_uids, cancellable, error);
+	/* Messages can be duplicates only when they share the Message-ID,
+	 * which is known from the summary, thus retrieve and hash only
+	 * messages whose Message-ID is used more than once. */
 
-	if (hash_table == NULL)
+	/* groups = { message-id : number of messages } */
+	groups = g_hash_table_new (g_int64_hash, g_int64_equal);
+	message_ids = g_new0 (gint64, message_uids->len);
+	skip = g_new0 (gboolean, message_uids->len);
+
+	for (ii = 0; ii < message_uids->len; ii++) {
+		CamelMessageInfo *info;
+		guint n_messages;
+
+		info = camel_folder_get_message_info (folder, g_ptr_array_index (message_uids, ii));
+
+		/* Skip messages marked for deletion. */
+		if (!info || (camel_message_info_get_flags (info) & CAMEL_MESSAGE_DELETED)) {
+			skip[ii] = TRUE;
+			g_clear_object (&info);
+			continue;
+		}
+
+		/* The keys point into the message_ids array */
+		message_ids[ii] = (gint64) camel_message_info_get_message_id (info);
+		n_messages = GPOINTER_TO_UINT (g_hash_table_lookup (groups, &message_ids[ii]));
+
+		g_hash_table_insert (groups, &message_ids[ii], GUINT_TO_POINTER (n_messages + 1));
+
+		g_clear_object (&info);
+	}
+
+	candidates = g_ptr_array_new ();
+
+	for (ii = 0; ii < message_uids->len; ii++) {
+		if (!skip[ii] && GPOINTER_TO_UINT (g_hash_table_lookup (groups, &message_ids[ii])) > 1)
+			g_ptr_array_add (candidates, g_ptr_array_index (message_uids, ii));
+	}
+
+	g_hash_table_destroy (groups);
+	g_free (message_ids);
+	g_free (skip);
+
+	dd.cancellable = cancellable;
+	dd.digests = g_hash_table_new_full (
+		(GHashFunc) g_str_hash,
+		(GEqualFunc) g_str_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) g_free);
+	dd.digest_pool = g_thread_pool_new (emfu_duplicates_digest_thread, &dd, g_get_num_processors (), FALSE, NULL);
+	g_mutex_init (&dd.lock);
+
+	camel_operation_push_message (
+		cancellable,
+		ngettext (
+			"Retrieving %d message",
+			"Retrieving %d messages",
+			candidates->len),
+		candidates->len);
+
+	/* This is an all or nothing operation, fail
+	 * if we fail to retrieve any message. */
+	success = e_mail_folder_foreach_message_sync (
+		folder, candidates, 0, TRUE,
+		emfu_duplicates_message_cb, &dd,
+		cancellable, error);
+
+	camel_operation_pop_message (cancellable);
+
+	/* Wait for the pending digests */
+	g_thread_pool_free (dd.digest_pool, FALSE, TRUE);
+	g_mutex_clear (&dd.lock);
+
+	if (!success) {
+		g_hash_table_destroy (dd.digests);
+		g_ptr_array_free (candidates, TRUE);
 		return NULL;
+	}
 
 	camel_operation_push_message (
 		cancellable, _("Scanning messages for duplicates"));
 
+	/* hash_table = { MessageUID : digest-as-string } */
+	hash_table = dd.digests;
+
 	unique_ids = g_hash_table_new_full (
 		(GHashFunc) g_int64_hash,
 		(GEqualFunc) g_int64_equal,
 		(GDestroyNotify) g_free,
 		(GDestroyNotify) g_free);
 
-	g_hash_table_iter_init (&iter, hash_table);
-
-	while (g_hash_table_iter_next (&iter, &key, &value)) {
-		CamelSummaryMessageID message_id;
-		CamelMessageFlags flags;
+	/* The first message of each Message-ID and content is the original,
+	 * thus keep only the other ones in the hash_table. */
+	for (ii = 0; ii < candidates->len; ii++) {
 		CamelMessageInfo *info;
-		gboolean duplicate;
-		const gchar *digest;
-
-		info = camel_folder_get_message_info (folder, key);
-		if (!info)
-			continue;
+		const gchar *uid, *digest, *original_digest;
+		gint64 message_id;
 
-		message_id.id.id = camel_message_info_get_message_id (info);
-		flags = camel_message_info_get_flags (info);
+		uid = g_ptr_array_index (candidates, ii);
+		digest = g_hash_table_lookup (hash_table, uid);
 
-		/* Skip messages marked for deletion. */
-		if (flags & CAMEL_MESSAGE_DELETED) {
-			g_queue_push_tail (&trash, key);
-			g_clear_object (&info);
+		if (digest == NULL) {
+			g_hash_table_remove (hash_table, uid);
 			continue;
 		}
 
-		digest = value;
-
-		if (digest == NULL) {
-			g_queue_push_tail (&trash, key);
-			g_clear_object (&info);
+		info = camel_folder_get_message_info (folder, uid);
+		if (!info) {
+			g_hash_table_remove (hash_table, uid);
 			continue;
 		}
 
-		/* Determine if the message a duplicate. */
-
-		value = g_hash_table_lookup (unique_ids, &message_id.id.id);
-		duplicate = (value != NULL) && g_str_equal (digest, value);
+		message_id = (gint64) camel_message_info_get_message_id (info);
+		original_digest = g_hash_table_lookup (unique_ids, &message_id);
 
-		if (!duplicate) {
+		if (original_digest == NULL) {
 			gint64 *v_int64;
 
-			/* XXX Might be better to create a GArray
-			 *     of 64-bit integers and have the hash
-			 *     table keys point to array elements. */
 			v_int64 = g_new0 (gint64, 1);
-			*v_int64 = (gint64) message_id.id.id;
+			*v_int64 = message_id;
 
 			g_hash_table_insert (unique_ids, v_int64, g_strdup (digest));
-			g_queue_push_tail (&trash, key);
+			g_hash_table_remove (hash_table, uid);
+		} else if (!g_str_equal (digest, original_digest)) {
+			g_hash_table_remove (hash_table, uid);
 		}
 
 		g_clear_object (&info);
 	}
 
-	/* Delete all non-duplicate messages from the hash table. */
-	while ((key = g_queue_pop_head (&trash)) != NULL)
-		g_hash_table_remove (hash_table, key);
-
 	camel_operation_pop_message (cancellable);
 
 	g_hash_table_destroy (unique_ids);
+	g_ptr_array_free (candidates, TRUE);
 
 	return hash_table;
 }
@@ -920,6 +1218,23 @@ mail_folder_get_multiple_messages_thread (GSimpleAsyncResult *simple,
 		g_simple_async_result_take_error (simple, error);
 }
 
+static gboolean
+mail_folder_get_multiple_messages_cb (CamelFolder *folder,
+                                      const gchar *message_uid,
+                                      CamelMimeMessage *message,
+                                      const GError *fetch_error,
+                                      gpointer user_data,
+                                      GCancellable *cancellable,
+                                      GError **error)
+{
+	GHashTable *hash_table = user_data;
+
+	g_hash_table_insert (
+		hash_table, g_strdup (message_uid), g_object_ref (message));
+
+	return TRUE;
+}
+
 GHashTable *
 e_mail_folder_get_multiple_messages_sync (CamelFolder *folder,
                                           GPtrArray *message_uids,
@@ -927,8 +1242,6 @@ e_mail_folder_get_multiple_messages_sync (CamelFolder *folder,
                                           GError **error)
 {
 	GHashTable *hash_table;
-	CamelMimeMessage *message;
-	guint ii;
 
 	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), NULL);
 	g_return_val_if_fail (message_uids != NULL, NULL);
@@ -950,26 +1263,10 @@ e_mail_folder_get_multiple_messages_sync (CamelFolder *folder,
 	/* This is an all or nothing operation.  Destroy the
 	 * hash table if we fail to retrieve any message. */
 
-	for (ii = 0; ii < message_uids->len; ii++) {
-		const gchar *uid;
-		gint percent;
-
-		uid = g_ptr_array_index (message_uids, ii);
-		percent = ((ii + 1) * 100) / message_uids->len;
-
-		message = camel_folder_get_message_sync (
-			folder, uid, cancellable, error);
-
-		camel_operation_progress (cancellable, percent);
-
-		if (CAMEL_IS_MIME_MESSAGE (message)) {
-			g_hash_table_insert (
-				hash_table, g_strdup (uid), message);
-		} else {
-			g_hash_table_destroy (hash_table);
-			hash_table = NULL;
-			break;
-		}
+	if (!e_mail_folder_foreach_message_sync (folder, message_uids, 0, TRUE,
+		mail_folder_get_multiple_messages_cb, hash_table, cancellable, error)) {
+		g_hash_table_destroy (hash_table);
+		hash_table = NULL;
 	}
 
 	camel_operation_pop_message (cancellable);
@@ -1560,6 +1857,81 @@ mail_folder_save_prepare_part (CamelMimePart *mime_part)
 	}
 }
 
+typedef struct _SaveMessagesData {
+	GFileOutputStream *file_output_stream;
+	GByteArray *byte_array;
+} SaveMessagesData;
+
+static gboolean
+mail_folder_save_messages_cb (CamelFolder *folder,
+                              const gchar *message_uid,
+                              CamelMimeMessage *message,
+                              const GError *fetch_error,
+                              gpointer user_data,
+                              GCancellable *cancellable,
+                              GError **error)
+{
+	SaveMessagesData *smd = user_data;
+	CamelMimeFilter *filter;
+	CamelStream *base_stream;
+	CamelStream *stream;
+	gchar *from_line;
+	gint retval;
+	gboolean success;
+
+	/* CamelStreamMem does NOT take ownership of the byte
+	 * array when set with camel_stream_mem_set_byte_array().
+	 * This allows us to reuse the same memory slab for each
+	 * message, which is slightly more efficient. */
+	base_stream = camel_stream_mem_new ();
+	camel_stream_mem_set_byte_array (
+		CAMEL_STREAM_MEM (base_stream), smd->byte_array);
+
+	mail_folder_save_prepare_part (CAMEL_MIME_PART (message));
+
+	from_line = camel_mime_message_build_mbox_from (message);
+	g_return_val_if_fail (from_line != NULL, FALSE);
+
+	success = g_output_stream_write_all (
+		G_OUTPUT_STREAM (smd->file_output_stream),
+		from_line, strlen (from_line), NULL,
+		cancellable, error);
+
+	g_free (from_line);
+
+	if (!success) {
+		g_object_unref (base_stream);
+		return FALSE;
+	}
+
+	filter = camel_mime_filter_from_new ();
+	stream = camel_stream_filter_new (base_stream);
+	camel_stream_filter_add (CAMEL_STREAM_FILTER (stream), filter);
+
+	retval = camel_data_wrapper_write_to_stream_sync (
+		CAMEL_DATA_WRAPPER (message),
+		stream, cancellable, error);
+
+	g_object_unref (filter);
+	g_object_unref (stream);
+	g_object_unref (base_stream);
+
+	if (retval == -1)
+		return FALSE;
+
+	g_byte_array_append (smd->byte_array, (guint8 *) "\n", 1);
+
+	success = g_output_stream_write_all (
+		G_OUTPUT_STREAM (smd->file_output_stream),
+		smd->byte_array->data, smd->byte_array->len,
+		NULL, cancellable, error);
+
+	/* Reset the byte array for the next message. */
+	g_byte_array_set_size (smd->byte_array, 0);
+
+	return success;
+}
+
 gboolean
 e_mail_folder_save_messages_sync (CamelFolder *folder,
                                   GPtrArray *message_uids,
@@ -1567,11 +1939,8 @@ e_mail_folder_save_messages_sync (CamelFolder *folder,
                                   GCancellable *cancellable,
                                   GError **error)
 {
-	GFileOutputStream *file_output_stream;
-	CamelStream *base_stream = NULL;
-	GByteArray *byte_array;
-	gboolean success = TRUE;
-	guint ii;
+	SaveMessagesData smd;
+	gboolean success;
 
 	g_return_val_if_fail (CAMEL_IS_FOLDER (folder), FALSE);
 	g_return_val_if_fail (message_uids != NULL, FALSE);
@@ -1587,109 +1956,29 @@ e_mail_folder_save_messages_sync (CamelFolder *folder,
 			message_uids->len),
 		message_uids->len);
 
-	file_output_stream = g_file_replace (
+	smd.file_output_stream = g_file_replace (
 		destination, NULL, FALSE,
 		G_FILE_CREATE_PRIVATE |
 		G_FILE_CREATE_REPLACE_DESTINATION,
 		cancellable, error);
 
-	if (file_output_stream == NULL) {
+	if (smd.file_output_stream == NULL) {
 		camel_operation_pop_message (cancellable);
 		return FALSE;
 	}
 
-	byte_array = g_byte_array_new ();
-
-	for (ii = 0; ii < message_uids->len; ii++) {
-		CamelMimeMessage *message;
-		CamelMimeFilter *filter;
-		CamelStream *stream;
-		const gchar *uid;
-		gchar *from_line;
-		gint percent;
-		gint retval;
-
-		if (base_stream != NULL)
-			g_object_unref (base_stream);
-
-		/* CamelStreamMem does NOT take ownership of the byte
-		 * array when set with camel_stream_mem_set_byte_array().
-		 * This allows us to reuse the same memory slab for each
-		 * message, which is slightly more efficient. */
-		base_stream = camel_stream_mem_new ();
-		camel_stream_mem_set_byte_array (
-			CAMEL_STREAM_MEM (base_stream), byte_array);
-
-		uid = g_ptr_array_index (message_uids, ii);
+	smd.byte_array = g_byte_array_new ();
 
-		message = camel_folder_get_message_sync (
-			folder, uid, cancellable, error);
-		if (message == NULL) {
-			success = FALSE;
-			goto exit;
-		}
-
-		mail_folder_save_prepare_part (CAMEL_MIME_PART (message));
-
-		from_line = camel_mime_message_build_mbox_from (message);
-		g_return_val_if_fail (from_line != NULL, FALSE);
-
-		success = g_output_stream_write_all (
-			G_OUTPUT_STREAM (file_output_stream),
-			from_line, strlen (from_line), NULL,
-			cancellable, error);
-
-		g_free (from_line);
-
-		if (!success) {
-			g_object_unref (message);
-			goto exit;
-		}
-
-		filter = camel_mime_filter_from_new ();
-		stream = camel_stream_filter_new (base_stream);
-		camel_stream_filter_add (CAMEL_STREAM_FILTER (stream), filter);
-
-		retval = camel_data_wrapper_write_to_stream_sync (
-			CAMEL_DATA_WRAPPER (message),
-			stream, cancellable, error);
-
-		g_object_unref (filter);
-		g_object_unref (stream);
-
-		if (retval == -1) {
-			g_object_unref (message);
-			goto exit;
-		}
-
-		g_byte_array_append (byte_array, (guint8 *) "\n", 1);
-
-		success = g_output_stream_write_all (
-			G_OUTPUT_STREAM (file_output_stream),
-			byte_array->data, byte_array->len,
-			NULL, cancellable, error);
-
-		if (!success) {
-			g_object_unref (message);
-			goto exit;
-		}
-
-		percent = ((ii + 1) * 100) / message_uids->len;
-		camel_operation_progress (cancellable, percent);
-
-		/* Reset the byte array for the next message. */
-		g_byte_array_set_size (byte_array, 0);
-
-		g_object_unref (message);
-	}
-
-exit:
-	if (base_stream != NULL)
-		g_object_unref (base_stream);
+	/* Messages are written as they arrive, while
+	 * the following ones are being retrieved. */
+	success = e_mail_folder_foreach_message_sync (
+		folder, message_uids, 0, TRUE,
+		mail_folder_save_messages_cb, &smd,
+		cancellable, error);
 
-	g_byte_array_free (byte_array, TRUE);
+	g_byte_array_free (smd.byte_array, TRUE);
 
-	g_object_unref (file_output_stream);
+	g_object_unref (smd.file_output_stream);
 
 	camel_operation_pop_message (cancellable);
 
@@ -95,6 +95,24 @@ GHashTable *	e_mail_folder_find_duplicate_messages_finish
 						 GAsyncResult *result,
 						 GError **error);
 
+typedef gboolean (* EMailFolderMessageFunc)	(CamelFolder *folder,
+						 const gchar *message_uid,
+						 CamelMimeMessage *message,
+						 const GError *fetch_error,
+						 gpointer user_data,
+						 GCancellable *cancellable,
+						 GError **error);
+
+gboolean	e_mail_folder_foreach_message_sync
+						(CamelFolder *folder,
+						 GPtrArray *message_uids,
+						 guint max_in_flight,
+						 gboolean stop_on_error,
+						 EMailFolderMessageFunc func,
+						 gpointer user_data,
+						 GCancellable *cancellable,
+						 GError **error);
+
 GHashTable *	e_mail_folder_get_multiple_messages_sync
 						(CamelFolder *folder,
 						 GPtrArray *message_uids,
@@ -19,23 +19,136 @@
 
 #include <libemail-engine/e-mail-session.h>
 
+#define E_MAIL_JUNK_FILTER_GET_PRIVATE(obj) \
+	(G_TYPE_INSTANCE_GET_PRIVATE \
+	((obj), E_TYPE_MAIL_JUNK_FILTER, EMailJunkFilterPrivate))
+
+/* How many messages to collect before learning them in one go */
+#define LEARN_BATCH_SIZE 64
+
+struct _EMailJunkFilterPrivate {
+	GMutex learn_lock;
+	GPtrArray *learn_pending; /* CamelMimeMessage * */
+	gboolean learn_pending_is_junk;
+};
+
 G_DEFINE_ABSTRACT_TYPE (
 	EMailJunkFilter,
 	e_mail_junk_filter,
 	E_TYPE_EXTENSION)
 
+static gboolean
+mail_junk_filter_flush_learn_locked (EMailJunkFilter *junk_filter,
+                                     GCancellable *cancellable,
+                                     GError **error)
+{
+	GPtrArray *pending = junk_filter->priv->learn_pending;
+	gboolean success;
+
+	if (!pending->len)
+		return TRUE;
+
+	success = e_mail_junk_filter_learn_messages_sync (
+		junk_filter, pending,
+		junk_filter->priv->learn_pending_is_junk,
+		cancellable, error);
+
+	g_ptr_array_set_size (pending, 0);
+
+	return success;
+}
+
+static void
+mail_junk_filter_dispose (GObject *object)
+{
+	EMailJunkFilter *junk_filter = E_MAIL_JUNK_FILTER (object);
+	GError *local_error = NULL;
+
+	/* Camel synchronizes the filter after learning a set of messages,
+	 * thus this is rarely anything, but learn_junk() and learn_not_junk()
+	 * reported the queued messages as learnt already. */
+	g_mutex_lock (&junk_filter->priv->learn_lock);
+	if (!mail_junk_filter_flush_learn_locked (junk_filter, NULL, &local_error))
+		g_warning (
+			"%s: Failed to learn queued messages: %s", G_STRFUNC,
+			local_error ? local_error->message : "Unknown error");
+	g_mutex_unlock (&junk_filter->priv->learn_lock);
+
+	g_clear_error (&local_error);
+
+	/* Chain up to parent's dispose() method. */
+	G_OBJECT_CLASS (e_mail_junk_filter_parent_class)->dispose (object);
+}
+
+static void
+mail_junk_filter_finalize (GObject *object)
+{
+	EMailJunkFilterPrivate *priv;
+
+	priv = E_MAIL_JUNK_FILTER_GET_PRIVATE (object);
+
+	g_ptr_array_unref (priv->learn_pending);
+	g_mutex_clear (&priv->learn_lock);
+
+	/* Chain up to parent's finalize() method. */
+	G_OBJECT_CLASS (e_mail_junk_filter_parent_class)->finalize (object);
+}
+
+static gboolean
+mail_junk_filter_learn_messages_sync (EMailJunkFilter *junk_filter,
+                                      GPtrArray *messages,
+                                      gboolean is_junk,
+                                      GCancellable *cancellable,
+                                      GError **error)
+{
+	guint ii;
+
+	g_return_val_if_fail (CAMEL_IS_JUNK_FILTER (junk_filter), FALSE);
+
+	for (ii = 0; ii < messages->len; ii++) {
+		gboolean success;
+
+		if (is_junk)
+			success = camel_junk_filter_learn_junk (
+				CAMEL_JUNK_FILTER (junk_filter),
+				messages->pdata[ii], cancellable, error);
+		else
+			success = camel_junk_filter_learn_not_junk (
+				CAMEL_JUNK_FILTER (junk_filter),
+				messages->pdata[ii], cancellable, error);
+
+		if (!success)
+			return FALSE;
+	}
+
+	return TRUE;
+}
+
 static void
 e_mail_junk_filter_class_init (EMailJunkFilterClass *class)
 {
+	GObjectClass *object_class;
 	EExtensionClass *extension_class;
 
+	g_type_class_add_private (class, sizeof (EMailJunkFilterPrivate));
+
+	object_class = G_OBJECT_CLASS (class);
+	object_class->dispose = mail_junk_filter_dispose;
+	object_class->finalize = mail_junk_filter_finalize;
+
 	extension_class = E_EXTENSION_CLASS (class);
 	extension_class->extensible_type = E_TYPE_MAIL_SESSION;
+
+	class->learn_messages_sync = mail_junk_filter_learn_messages_sync;
 }
 
 static void
 e_mail_junk_filter_init (EMailJunkFilter *junk_filter)
 {
+	junk_filter->priv = E_MAIL_JUNK_FILTER_GET_PRIVATE (junk_filter);
+
+	g_mutex_init (&junk_filter->priv->learn_lock);
+	junk_filter->priv->learn_pending = g_ptr_array_new_with_free_func (g_object_unref);
 }
 
 gboolean
@@ -84,3 +197,179 @@ e_mail_junk_filter_compare (EMailJunkFilter *junk_filter_a,
 
 	return g_utf8_collate (class_a->display_name, class_b->display_name);
 }
+
+/**
+ * e_mail_junk_filter_learn_messages_sync:
+ * @junk_filter: an #EMailJunkFilter
+ * @messages: (element-type CamelMimeMessage): messages to learn
+ * @is_junk: whether the @messages are junk
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Teaches the @junk_filter that all the @messages are junk or not junk,
+ * according to @is_junk, in one call.
+ *
+ * Returns: %TRUE on success, %FALSE on error
+ *
+ * Since: 3.38
+ **/
+gboolean
+e_mail_junk_filter_learn_messages_sync (EMailJunkFilter *junk_filter,
+                                        GPtrArray *messages,
+                                        gboolean is_junk,
+                                        GCancellable *cancellable,
+                                        GError **error)
+{
+	EMailJunkFilterClass *class;
+
+	g_return_val_if_fail (E_IS_MAIL_JUNK_FILTER (junk_filter), FALSE);
+	g_return_val_if_fail (messages != NULL, FALSE);
+
+	class = E_MAIL_JUNK_FILTER_GET_CLASS (junk_filter);
+	g_return_val_if_fail (class != NULL, FALSE);
+	g_return_val_if_fail (class->learn_messages_sync != NULL, FALSE);
+
+	if (!messages->len)
+		return TRUE;
+
+	if (g_cancellable_set_error_if_cancelled (cancellable, error))
+		return FALSE;
+
+	return class->learn_messages_sync (junk_filter, messages, is_junk, cancellable, error);
+}
+
+/**
+ * e_mail_junk_filter_queue_learn_sync:
+ * @junk_filter: an #EMailJunkFilter
+ * @message: a #CamelMimeMessage
+ * @is_junk: whether the @message is junk
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Adds the @message to the set of messages to be learnt. The set is
+ * passed to e_mail_junk_filter_learn_messages_sync() once it is large
+ * enough, when a message of the other kind is queued, or when
+ * e_mail_junk_filter_flush_learn_sync() is called. Filters implementing
+ * #EMailJunkFilterClass.learn_messages_sync use it from their
+ * #CamelJunkFilter learn functions and flush the queue in their
+ * synchronize function, which Camel calls after learning a set of
+ * messages.
+ *
+ * Returns: %TRUE on success, %FALSE when learning the queued messages failed
+ *
+ * Since: 3.38
+ **/
+gboolean
+e_mail_junk_filter_queue_learn_sync (EMailJunkFilter *junk_filter,
+                                     CamelMimeMessage *message,
+                                     gboolean is_junk,
+                                     GCancellable *cancellable,
+                                     GError **error)
+{
+	EMailJunkFilterPrivate *priv;
+	gboolean success = TRUE;
+
+	g_return_val_if_fail (E_IS_MAIL_JUNK_FILTER (junk_filter), FALSE);
+	g_return_val_if_fail (CAMEL_IS_MIME_MESSAGE (message), FALSE);
+
+	priv = junk_filter->priv;
+
+	g_mutex_lock (&priv->learn_lock);
+
+	if (priv->learn_pending->len && (!priv->learn_pending_is_junk) != (!is_junk))
+		success = mail_junk_filter_flush_learn_locked (junk_filter, cancellable, error);
+
+	if (success) {
+		g_ptr_array_add (priv->learn_pending, g_object_ref (message));
+		priv->learn_pending_is_junk = is_junk;
+
+		if (priv->learn_pending->len >= LEARN_BATCH_SIZE)
+			success = mail_junk_filter_flush_learn_locked (junk_filter, cancellable, error);
+	}
+
+	g_mutex_unlock (&priv->learn_lock);
+
+	return success;
+}
+
+/**
+ * e_mail_junk_filter_flush_learn_sync:
+ * @junk_filter: an #EMailJunkFilter
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Learns all the messages queued by e_mail_junk_filter_queue_learn_sync().
+ *
+ * Returns: %TRUE on success, %FALSE on error
+ *
+ * Since: 3.38
+ **/
+gboolean
+e_mail_junk_filter_flush_learn_sync (EMailJunkFilter *junk_filter,
+                                     GCancellable *cancellable,
+                                     GError **error)
+{
+	gboolean success;
+
+	g_return_val_if_fail (E_IS_MAIL_JUNK_FILTER (junk_filter), FALSE);
+
+	g_mutex_lock (&junk_filter->priv->learn_lock);
+	success = mail_junk_filter_flush_learn_locked (junk_filter, cancellable, error);
+	g_mutex_unlock (&junk_filter->priv->learn_lock);
+
+	return success;
+}
+
+/**
+ * e_mail_junk_filter_write_mbox_sync:
+ * @messages: (element-type CamelMimeMessage): messages to write
+ * @stream: a #CamelStream to write to
+ * @cancellable: optional #GCancellable object, or %NULL
+ * @error: return location for a #GError, or %NULL
+ *
+ * Writes the @messages into the @stream in the mbox format, which
+ * is the usual input format of the junk tools' bulk modes.
+ *
+ * Returns: %TRUE on success, %FALSE on error
+ *
+ * Since: 3.38
+ **/
+gboolean
+e_mail_junk_filter_write_mbox_sync (GPtrArray *messages,
+                                    CamelStream *stream,
+                                    GCancellable *cancellable,
+                                    GError **error)
+{
+	CamelMimeFilter *filter;
+	CamelStream *filtered_stream;
+	gboolean success = TRUE;
+	guint ii;
+
+	g_return_val_if_fail (messages != NULL, FALSE);
+	g_return_val_if_fail (CAMEL_IS_STREAM (stream), FALSE);
+
+	filter = camel_mime_filter_from_new ();
+	filtered_stream = camel_stream_filter_new (stream);
+	camel_stream_filter_add (CAMEL_STREAM_FILTER (filtered_stream), filter);
+	g_object_unref (filter);
+
+	for (ii = 0; success && ii < messages->len; ii++) {
+		CamelMimeMessage *message = messages->pdata[ii];
+		gchar *from_line;
+
+		from_line = camel_mime_message_build_mbox_from (message);
+
+		/* Flush after each write, both streams write to the same place */
+		success = camel_stream_write_string (stream, from_line, cancellable, error) != -1 &&
+			camel_stream_flush (stream, cancellable, error) != -1 &&
+			camel_data_wrapper_write_to_stream_sync (CAMEL_DATA_WRAPPER (message), filtered_stream, cancellable, error) != -1 &&
+			camel_stream_flush (filtered_stream, cancellable, error) != -1 &&
+			camel_stream_write_string (stream, "\n", cancellable, error) != -1;
+
+		g_free (from_line);
+	}
+
+	g_object_unref (filtered_stream);
+
+	return success;
+}
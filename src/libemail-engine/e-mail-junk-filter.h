@@ -23,6 +23,7 @@
 #define E_MAIL_JUNK_FILTER_H
 
 #include <gtk/gtk.h>
+#include <camel/camel.h>
 #include <libebackend/libebackend.h>
 
 /* Standard GObject macros */
@@ -63,6 +64,13 @@ struct _EMailJunkFilterClass {
 
 	gboolean	(*available)		(EMailJunkFilter *junk_filter);
 	GtkWidget *	(*new_config_widget)	(EMailJunkFilter *junk_filter);
+
+	/* Optional, for filters able to process many messages at once */
+	gboolean	(*learn_messages_sync)	(EMailJunkFilter *junk_filter,
+						 GPtrArray *messages,
+						 gboolean is_junk,
+						 GCancellable *cancellable,
+						 GError **error);
 };
 
 GType		e_mail_junk_filter_get_type	(void) G_GNUC_CONST;
@@ -71,6 +79,27 @@ GtkWidget *	e_mail_junk_filter_new_config_widget
 						(EMailJunkFilter *junk_filter);
 gint		e_mail_junk_filter_compare	(EMailJunkFilter *junk_filter_a,
 						 EMailJunkFilter *junk_filter_b);
+gboolean	e_mail_junk_filter_learn_messages_sync
+						(EMailJunkFilter *junk_filter,
+						 GPtrArray *messages,
+						 gboolean is_junk,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_mail_junk_filter_queue_learn_sync
+						(EMailJunkFilter *junk_filter,
+						 CamelMimeMessage *message,
+						 gboolean is_junk,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_mail_junk_filter_flush_learn_sync
+						(EMailJunkFilter *junk_filter,
+						 GCancellable *cancellable,
+						 GError **error);
+gboolean	e_mail_junk_filter_write_mbox_sync
+						(GPtrArray *messages,
+						 CamelStream *stream,
+						 GCancellable *cancellable,
+						 GError **error);
 
 G_END_DECLS
 
@@ -319,6 +319,30 @@ static GAsyncQueue *main_loop_queue = NULL;
 static GAsyncQueue *msg_reply_queue = NULL;
 static GThread *main_thread = NULL;
 
+static gboolean mail_msg_idle_cb (void);
+
+/* Makes sure the main loop processes the queued messages */
+static void
+mail_msg_schedule_idle (void)
+{
+	G_LOCK (idle_source_id);
+	if (idle_source_id == 0)
+		/* Prioritize ahead of GTK+ redraws. */
+		idle_source_id = g_idle_add_full (
+			G_PRIORITY_HIGH_IDLE,
+			(GSourceFunc) mail_msg_idle_cb, NULL, NULL);
+	G_UNLOCK (idle_source_id);
+}
+
+/* Passes the executed @msg to the main loop, which calls its done function */
+static void
+mail_msg_push_reply (MailMsg *msg)
+{
+	g_async_queue_push (msg_reply_queue, msg);
+
+	mail_msg_schedule_idle ();
+}
+
 static gboolean
 mail_msg_idle_cb (void)
 {
@@ -383,15 +407,7 @@ mail_msg_proxy (MailMsg *msg)
 	if (msg->info->desc != NULL)
 		camel_operation_pop_message (cancellable);
 
-	g_async_queue_push (msg_reply_queue, msg);
-
-	G_LOCK (idle_source_id);
-	if (idle_source_id == 0)
-		/* Prioritize ahead of GTK+ redraws. */
-		idle_source_id = g_idle_add_full (
-			G_PRIORITY_HIGH_IDLE,
-			(GSourceFunc) mail_msg_idle_cb, NULL, NULL);
-	G_UNLOCK (idle_source_id);
+	mail_msg_push_reply (msg);
 }
 
 void
@@ -420,65 +436,386 @@ mail_msg_compare (const MailMsg *msg1,
 	return (priority1 < priority2) ? 1 : -1;
 }
 
+void
+mail_msg_main_loop_push (gpointer msg)
+{
+	g_async_queue_push_sorted (
+		main_loop_queue, msg,
+		(GCompareDataFunc) mail_msg_compare, NULL);
+
+	mail_msg_schedule_idle ();
+}
+
+/* Messages are queued in lanes and executed by a shared set of worker
+ * threads.  The unordered lane runs up to MAIL_MSG_UNORDERED_MAX_RUNNING
+ * messages at once; every ordered lane runs one message at a time, in the
+ * order of priority and then of the push.  A message can be queued in two
+ * ordered lanes, then it runs only when it is the first in both of them and
+ * neither of them runs anything.  An idle worker takes the best runnable
+ * message from any lane, thus a slow message in one ordered lane does not
+ * block the others.  Each lane has a worker reserved: the unordered lane
+ * runs fewer messages as ordered lanes are added, and there can be more
+ * than MAIL_MSG_MAX_WORKERS workers when there are too many lanes. */
+
+#define MAIL_MSG_UNORDERED_MAX_RUNNING	10
+#define MAIL_MSG_MAX_WORKERS		16
+#define MAIL_MSG_WORKER_IDLE_TIMEOUT	(30 * G_TIME_SPAN_SECOND)
+
+typedef struct _MailMsgLane {
+	gconstpointer key; /* NULL for the unordered lane */
+	GQueue queue; /* MailMsgQueued * */
+	guint n_running;
+} MailMsgLane;
+
+typedef struct _MailMsgQueued {
+	MailMsg *msg;
+	guint64 push_index;
+	MailMsgLane *lanes[2]; /* the second is NULL when in one lane */
+} MailMsgQueued;
+
+static GMutex sched_lock;
+static GCond sched_cond;
+static MailMsgLane unordered_lane = { NULL, G_QUEUE_INIT, 0 };
+static GHashTable *ordered_lanes; /* gconstpointer key ~> MailMsgLane * */
+static guint64 n_pushed;
+static guint n_workers;
+static guint n_idle_workers;
+static guint n_wakeups; /* signalled idle workers, which did not wake yet */
+
+/* Keys of the lanes used by the global ordered pushes */
+static gint fast_ordered_lane_key;
+static gint slow_ordered_lane_key;
+
+static guint
+mail_msg_n_ordered_lanes_locked (void)
+{
+	return ordered_lanes ? g_hash_table_size (ordered_lanes) : 0;
+}
+
+/* Ordered lanes with no message are removed, thus every ordered lane
+ * can run a message at any time, as can the unordered lane. */
+static guint
+mail_msg_max_workers_locked (void)
+{
+	return MAX (MAIL_MSG_MAX_WORKERS, mail_msg_n_ordered_lanes_locked () + MAX (unordered_lane.n_running, 1));
+}
+
+static guint
+mail_msg_lane_max_running_locked (MailMsgLane *lane)
+{
+	guint n_ordered;
+
+	if (lane != &unordered_lane)
+		return 1;
+
+	n_ordered = mail_msg_n_ordered_lanes_locked ();
+
+	if (n_ordered >= MAIL_MSG_MAX_WORKERS)
+		return 1;
+
+	return MIN (MAIL_MSG_UNORDERED_MAX_RUNNING, MAIL_MSG_MAX_WORKERS - n_ordered);
+}
+
+/* Returns the first message of the lane when it can run now, or NULL */
+static MailMsgQueued *
+mail_msg_lane_peek_runnable_locked (MailMsgLane *lane)
+{
+	MailMsgQueued *queued;
+	guint ii;
+
+	queued = g_queue_peek_head (&lane->queue);
+	if (!queued)
+		return NULL;
+
+	for (ii = 0; ii < G_N_ELEMENTS (queued->lanes) && queued->lanes[ii]; ii++) {
+		MailMsgLane *other = queued->lanes[ii];
+
+		if (g_queue_peek_head (&other->queue) != queued ||
+		    other->n_running >= mail_msg_lane_max_running_locked (other))
+			return NULL;
+	}
+
+	return queued;
+}
+
+/* Returns the best runnable message, or NULL.  Every lane is sorted in the
+ * same order, thus the best queued message is always first in its lanes. */
+static MailMsgQueued *
+mail_msg_pick_locked (void)
+{
+	MailMsgQueued *best;
+
+	best = mail_msg_lane_peek_runnable_locked (&unordered_lane);
+
+	if (ordered_lanes) {
+		GHashTableIter iter;
+		gpointer value;
+
+		g_hash_table_iter_init (&iter, ordered_lanes);
+		while (g_hash_table_iter_next (&iter, NULL, &value)) {
+			MailMsgQueued *queued;
+
+			queued = mail_msg_lane_peek_runnable_locked (value);
+			if (!queued)
+				continue;
+
+			if (!best ||
+			    queued->msg->priority > best->msg->priority ||
+			    (queued->msg->priority == best->msg->priority &&
+			     queued->push_index < best->push_index))
+				best = queued;
+		}
+	}
+
+	return best;
+}
+
+static gpointer mail_msg_worker_thread (gpointer user_data);
+
+/* Makes sure there is a worker for a newly runnable message */
+static void
+mail_msg_wake_worker_locked (void)
+{
+	if (n_idle_workers > n_wakeups) {
+		n_wakeups++;
+		g_cond_signal (&sched_cond);
+	} else if (n_workers < mail_msg_max_workers_locked ()) {
+		GThread *thread;
+
+		thread = g_thread_try_new ("mail-msg-worker", mail_msg_worker_thread, NULL, NULL);
+		if (thread) {
+			n_workers++;
+			g_thread_unref (thread);
+		}
+	}
+}
+
+static void
+mail_msg_run (MailMsg *msg)
+{
+	/* Do not execute messages cancelled while they were waiting
+	 * in the queue; they finish with the cancelled error instead. */
+	if (g_cancellable_set_error_if_cancelled (msg->cancellable, &msg->error)) {
+		g_idle_add_full (
+			G_PRIORITY_DEFAULT,
+			(GSourceFunc) mail_msg_submit,
+			g_object_ref (msg->cancellable),
+			(GDestroyNotify) g_object_unref);
+
+		mail_msg_push_reply (msg);
+	} else {
+		mail_msg_proxy (msg);
+	}
+}
+
 static gpointer
-create_thread_pool (gpointer data)
+mail_msg_worker_thread (gpointer user_data)
 {
-	GThreadPool *thread_pool;
-	gint max_threads = GPOINTER_TO_INT (data);
+	g_mutex_lock (&sched_lock);
+
+	while (TRUE) {
+		MailMsgQueued *queued;
+		guint ii;
+
+		queued = mail_msg_pick_locked ();
+
+		if (!queued) {
+			gint64 end_time;
+
+			end_time = g_get_monotonic_time () + MAIL_MSG_WORKER_IDLE_TIMEOUT;
+
+			n_idle_workers++;
+
+			if (!g_cond_wait_until (&sched_cond, &sched_lock, end_time) &&
+			    !mail_msg_pick_locked ()) {
+				n_idle_workers--;
+				if (n_wakeups > n_idle_workers)
+					n_wakeups = n_idle_workers;
+				break;
+			}
+
+			n_idle_workers--;
+			if (n_wakeups > 0)
+				n_wakeups--;
+
+			continue;
+		}
+
+		for (ii = 0; ii < G_N_ELEMENTS (queued->lanes) && queued->lanes[ii]; ii++) {
+			g_queue_pop_head (&queued->lanes[ii]->queue);
+			queued->lanes[ii]->n_running++;
+		}
+
+		/* Let another worker take the next runnable message */
+		if (mail_msg_pick_locked ())
+			mail_msg_wake_worker_locked ();
+
+		g_mutex_unlock (&sched_lock);
+
+		mail_msg_run (queued->msg);
+
+		g_mutex_lock (&sched_lock);
+
+		for (ii = 0; ii < G_N_ELEMENTS (queued->lanes) && queued->lanes[ii]; ii++) {
+			MailMsgLane *lane = queued->lanes[ii];
+
+			lane->n_running--;
 
-	/* once created, run forever */
-	thread_pool = g_thread_pool_new (
-		(GFunc) mail_msg_proxy, NULL, max_threads, FALSE, NULL);
-	g_thread_pool_set_sort_function (
-		thread_pool, (GCompareDataFunc) mail_msg_compare, NULL);
+			if (lane != &unordered_lane && !lane->n_running && g_queue_is_empty (&lane->queue))
+				g_hash_table_remove (ordered_lanes, lane->key);
+		}
+
+		g_slice_free (MailMsgQueued, queued);
+
+		/* The message can unblock one queued in two lanes */
+		if (mail_msg_pick_locked ())
+			mail_msg_wake_worker_locked ();
+	}
+
+	n_workers--;
+
+	g_mutex_unlock (&sched_lock);
 
-	return thread_pool;
+	return NULL;
 }
 
-void
-mail_msg_main_loop_push (gpointer msg)
+static void
+mail_msg_lane_free (gpointer ptr)
 {
-	g_async_queue_push_sorted (
-		main_loop_queue, msg,
-		(GCompareDataFunc) mail_msg_compare, NULL);
+	MailMsgLane *lane = ptr;
 
-	G_LOCK (idle_source_id);
-	if (idle_source_id == 0)
-		/* Prioritize ahead of GTK+ redraws. */
-		idle_source_id = g_idle_add_full (
-			G_PRIORITY_HIGH_IDLE,
-			(GSourceFunc) mail_msg_idle_cb, NULL, NULL);
-	G_UNLOCK (idle_source_id);
+	g_warn_if_fail (g_queue_is_empty (&lane->queue));
+	g_slice_free (MailMsgLane, lane);
 }
 
-void
-mail_msg_unordered_push (gpointer msg)
+static MailMsgLane *
+mail_msg_ref_lane_locked (gconstpointer lane_key)
 {
-	static GOnce once = G_ONCE_INIT;
+	MailMsgLane *lane;
+
+	if (!lane_key)
+		return &unordered_lane;
+
+	if (!ordered_lanes)
+		ordered_lanes = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, mail_msg_lane_free);
 
-	g_once (&once, (GThreadFunc) create_thread_pool, GINT_TO_POINTER (10));
+	lane = g_hash_table_lookup (ordered_lanes, lane_key);
+	if (!lane) {
+		lane = g_slice_new0 (MailMsgLane);
+		lane->key = lane_key;
 
-	g_thread_pool_push ((GThreadPool *) once.retval, msg, NULL);
+		g_hash_table_insert (ordered_lanes, (gpointer) lane_key, lane);
+	}
+
+	return lane;
 }
 
-void
-mail_msg_fast_ordered_push (gpointer msg)
+static void
+mail_msg_lane_insert_locked (MailMsgLane *lane,
+                             MailMsgQueued *queued)
 {
-	static GOnce once = G_ONCE_INIT;
+	GList *link;
+
+	/* Higher priority first, the same priority in the push order */
+	for (link = g_queue_peek_tail_link (&lane->queue); link; link = g_list_previous (link)) {
+		MailMsgQueued *other = link->data;
+
+		if (other->msg->priority >= queued->msg->priority)
+			break;
+	}
+
+	if (link)
+		g_queue_insert_after (&lane->queue, link, queued);
+	else
+		g_queue_push_head (&lane->queue, queued);
+}
+
+/* The @other_lane_key is an ordered lane to queue the @msg in as well,
+ * or NULL to queue it only in the @lane_key lane. */
+static void
+mail_msg_lane_push (gconstpointer lane_key,
+                    gconstpointer other_lane_key,
+                    MailMsg *msg)
+{
+	MailMsgQueued *queued;
+	guint ii;
+
+	g_mutex_lock (&sched_lock);
+
+	queued = g_slice_new0 (MailMsgQueued);
+	queued->msg = msg;
+	queued->push_index = n_pushed++;
+	queued->lanes[0] = mail_msg_ref_lane_locked (lane_key);
+
+	if (lane_key && other_lane_key && other_lane_key != lane_key)
+		queued->lanes[1] = mail_msg_ref_lane_locked (other_lane_key);
+
+	for (ii = 0; ii < G_N_ELEMENTS (queued->lanes) && queued->lanes[ii]; ii++)
+		mail_msg_lane_insert_locked (queued->lanes[ii], queued);
 
-	g_once (&once, (GThreadFunc) create_thread_pool, GINT_TO_POINTER (1));
+	if (mail_msg_pick_locked ())
+		mail_msg_wake_worker_locked ();
 
-	g_thread_pool_push ((GThreadPool *) once.retval, msg, NULL);
+	g_mutex_unlock (&sched_lock);
+}
+
+void
+mail_msg_unordered_push (gpointer msg)
+{
+	mail_msg_lane_push (NULL, NULL, msg);
+}
+
+void
+mail_msg_fast_ordered_push (gpointer msg)
+{
+	mail_msg_lane_push (&fast_ordered_lane_key, NULL, msg);
 }
 
 void
 mail_msg_slow_ordered_push (gpointer msg)
 {
-	static GOnce once = G_ONCE_INIT;
+	mail_msg_lane_push (&slow_ordered_lane_key, NULL, msg);
+}
 
-	g_once (&once, (GThreadFunc) create_thread_pool, GINT_TO_POINTER (1));
+/**
+ * mail_msg_store_ordered_push:
+ * @msg: a #MailMsg
+ * @store: a #CamelStore the @msg operates on
+ *
+ * Queues @msg for execution after all the messages previously pushed
+ * for the @store.  Messages of different stores run independently.
+ * A %NULL @store queues the @msg as mail_msg_slow_ordered_push() does.
+ **/
+void
+mail_msg_store_ordered_push (gpointer msg,
+                             CamelStore *store)
+{
+	if (store)
+		mail_msg_lane_push (store, NULL, msg);
+	else
+		mail_msg_slow_ordered_push (msg);
+}
 
-	g_thread_pool_push ((GThreadPool *) once.retval, msg, NULL);
+/**
+ * mail_msg_stores_ordered_push:
+ * @msg: a #MailMsg
+ * @store: a #CamelStore the @msg operates on
+ * @other_store: (nullable): another #CamelStore the @msg operates on
+ *
+ * Like mail_msg_store_ordered_push(), only the @msg runs also after all
+ * the messages previously pushed for the @other_store, and the messages
+ * pushed for either of the stores later run after the @msg.  This is
+ * meant for operations like transfers between two stores.
+ **/
+void
+mail_msg_stores_ordered_push (gpointer msg,
+                              CamelStore *store,
+                              CamelStore *other_store)
+{
+	if (store)
+		mail_msg_lane_push (store, other_store, msg);
+	else
+		mail_msg_store_ordered_push (msg, other_store);
 }
 
 gboolean
@@ -99,6 +99,11 @@ void mail_msg_main_loop_push (gpointer msg);
 void mail_msg_unordered_push (gpointer msg);
 void mail_msg_fast_ordered_push (gpointer msg);
 void mail_msg_slow_ordered_push (gpointer msg);
+void mail_msg_store_ordered_push (gpointer msg,
+				  CamelStore *store);
+void mail_msg_stores_ordered_push (gpointer msg,
+				   CamelStore *store,
+				   CamelStore *other_store);
 
 /* Call a function in the GUI thread, wait for it to return, type is
  * the marshaller to use.  FIXME This thing is horrible, please put
@@ -1305,6 +1305,7 @@ mail_transfer_messages (EMailSession *session,
                         gpointer data)
 {
 	struct _transfer_msg *m;
+	CamelStore *dest_store = NULL;
 
 	g_return_if_fail (CAMEL_IS_FOLDER (source));
 	g_return_if_fail (uids != NULL);
@@ -1320,7 +1321,14 @@ mail_transfer_messages (EMailSession *session,
 	m->done = done;
 	m->data = data;
 
-	mail_msg_slow_ordered_push (m);
+	/* Order the transfer with the operations of both stores; when
+	 * the destination cannot be resolved, keep it in the global lane */
+	if (e_mail_folder_uri_parse (CAMEL_SESSION (session), dest_uri, &dest_store, NULL, NULL)) {
+		mail_msg_stores_ordered_push (m, camel_folder_get_parent_store (source), dest_store);
+		g_object_unref (dest_store);
+	} else {
+		mail_msg_slow_ordered_push (m);
+	}
 }
 
 /* ** SYNC FOLDER ********************************************************* */
@@ -1440,7 +1448,7 @@ mail_sync_folder (CamelFolder *folder,
 	m->data = data;
 	m->done = done;
 
-	mail_msg_slow_ordered_push (m);
+	mail_msg_store_ordered_push (m, camel_folder_get_parent_store (folder));
 }
 
 /* ** SYNC STORE ********************************************************* */
@@ -1521,7 +1529,7 @@ mail_sync_store (CamelStore *store,
 	m->data = data;
 	m->done = done;
 
-	mail_msg_slow_ordered_push (m);
+	mail_msg_store_ordered_push (m, store);
 }
 
 /* ******************************************************************************** */
@@ -1597,7 +1605,7 @@ mail_empty_trash (CamelStore *store)
 	m = mail_msg_new (&empty_trash_info);
 	m->store = g_object_ref (store);
 
-	mail_msg_slow_ordered_push (m);
+	mail_msg_store_ordered_push (m, store);
 }
 
 /* ** Execute Shell Command ************************************************ */
@@ -3388,7 +3388,13 @@ mail_reader_parse_message_run (GSimpleAsyncResult *simple,
 		async_context->folder,
 		async_context->message_uid, NULL, NULL);
 
-	part_list = camel_object_bag_reserve (registry, mail_uri);
+	/* Reuse the message parsed for another view or recently shown */
+	part_list = e_mail_part_list_cache_ref (mail_uri);
+
+	if (part_list)
+		e_mail_part_list_cache_add (part_list);
+	else
+		part_list = camel_object_bag_reserve (registry, mail_uri);
 
 	if (!part_list && is_source) {
 		EMailPart *mail_part;
@@ -3421,10 +3427,13 @@ mail_reader_parse_message_run (GSimpleAsyncResult *simple,
 
 		g_object_unref (parser);
 
-		if (part_list == NULL)
+		/* Do not store a partially parsed message */
+		if (part_list == NULL || g_cancellable_is_cancelled (cancellable)) {
 			camel_object_bag_abort (registry, mail_uri);
-		else
+		} else {
 			camel_object_bag_add (registry, mail_uri, part_list);
+			e_mail_part_list_cache_add (part_list);
+		}
 	}
 
 	g_free (mail_uri);
@@ -75,6 +75,11 @@ struct _EMailUISessionPrivate {
 
 	GSList *address_cache; /* data is AddressCacheData struct */
 	GMutex address_cache_mutex;
+
+	/* Compiled user filter rules, shared by the filter drivers */
+	GMutex filter_rules_lock;
+	GHashTable *filter_rules; /* gchar *source ~> GPtrArray { FilterRuleCode * } */
+	gchar *filter_rules_stamp;
 };
 
 enum {
@@ -103,6 +108,12 @@ struct _SourceContext {
 	CamelService *service;
 };
 
+typedef struct _FilterRuleCode {
+	gchar *name;
+	gchar *code;
+	gchar *action;
+} FilterRuleCode;
+
 typedef struct _AddressCacheData {
 	gchar *email_address;
 	gint64 stamp; /* when it was added to cache, in microseconds */
@@ -220,19 +231,134 @@ session_folder_can_filter_junk (CamelFolder *folder)
 	return (camel_folder_get_flags (folder) & CAMEL_FOLDER_FILTER_JUNK) != 0;
 }
 
+static void
+filter_rule_code_free (gpointer ptr)
+{
+	FilterRuleCode *rule_code = ptr;
+
+	if (rule_code) {
+		g_free (rule_code->name);
+		g_free (rule_code->code);
+		g_free (rule_code->action);
+		g_slice_free (FilterRuleCode, rule_code);
+	}
+}
+
+static void
+mail_ui_session_append_file_stamp (GString *stamp,
+                                   const gchar *filename)
+{
+	GStatBuf st;
+
+	if (g_stat (filename, &st) != 0)
+		memset (&st, 0, sizeof (GStatBuf));
+
+	/* The inode catches files saved by renaming a new file over them */
+	g_string_append_printf (
+		stamp, "%" G_GINT64_FORMAT ":%" G_GINT64_FORMAT ":%" G_GUINT64_FORMAT ";",
+		(gint64) st.st_mtime, (gint64) st.st_size, (guint64) st.st_ino);
+}
+
+/* Returns the compiled enabled rules for the source, in the filters.xml
+ * order, or NULL when there are none. The filter files are parsed and
+ * compiled only when they changed since the last call. Free the returned
+ * array with g_ptr_array_unref(). */
+static GPtrArray *
+mail_ui_session_ref_filter_rules (EMailUISession *session,
+                                  const gchar *source)
+{
+	GPtrArray *rules;
+	GString *stamp;
+	gchar *user, *system;
+
+	user = g_build_filename (mail_session_get_config_dir (), "filters.xml", NULL);
+	system = g_build_filename (EVOLUTION_PRIVDATADIR, "filtertypes.xml", NULL);
+
+	stamp = g_string_new ("");
+	mail_ui_session_append_file_stamp (stamp, system);
+	mail_ui_session_append_file_stamp (stamp, user);
+
+	g_mutex_lock (&session->priv->filter_rules_lock);
+
+	if (!session->priv->filter_rules ||
+	    g_strcmp0 (stamp->str, session->priv->filter_rules_stamp) != 0) {
+		GHashTable *filter_rules;
+		GString *fsearch, *faction;
+		ERuleContext *fc;
+		GList *link;
+
+		filter_rules = g_hash_table_new_full (
+			g_str_hash, g_str_equal,
+			(GDestroyNotify) g_free,
+			(GDestroyNotify) g_ptr_array_unref);
+
+		fc = (ERuleContext *) em_filter_context_new (E_MAIL_SESSION (session));
+		e_rule_context_load (fc, system, user);
+
+		fsearch = g_string_new ("");
+		faction = g_string_new ("");
+
+		for (link = fc->rules; link; link = g_list_next (link)) {
+			EFilterRule *rule = link->data;
+			FilterRuleCode *rule_code;
+
+			/* skip disabled rules and rules without a source */
+			if (!rule->enabled || !rule->source)
+				continue;
+
+			g_string_truncate (fsearch, 0);
+			g_string_truncate (faction, 0);
+
+			e_filter_rule_build_code (rule, fsearch);
+			em_filter_rule_build_action (EM_FILTER_RULE (rule), faction);
+
+			rule_code = g_slice_new (FilterRuleCode);
+			rule_code->name = g_strdup (rule->name);
+			rule_code->code = g_strdup (fsearch->str);
+			rule_code->action = g_strdup (faction->str);
+
+			rules = g_hash_table_lookup (filter_rules, rule->source);
+			if (!rules) {
+				rules = g_ptr_array_new_with_free_func (filter_rule_code_free);
+				g_hash_table_insert (filter_rules, g_strdup (rule->source), rules);
+			}
+
+			g_ptr_array_add (rules, rule_code);
+		}
+
+		g_string_free (fsearch, TRUE);
+		g_string_free (faction, TRUE);
+		g_object_unref (fc);
+
+		if (session->priv->filter_rules)
+			g_hash_table_destroy (session->priv->filter_rules);
+		session->priv->filter_rules = filter_rules;
+
+		g_free (session->priv->filter_rules_stamp);
+		session->priv->filter_rules_stamp = g_strdup (stamp->str);
+	}
+
+	rules = g_hash_table_lookup (session->priv->filter_rules, source);
+	if (rules)
+		g_ptr_array_ref (rules);
+
+	g_mutex_unlock (&session->priv->filter_rules_lock);
+
+	g_string_free (stamp, TRUE);
+	g_free (system);
+	g_free (user);
+
+	return rules;
+}
+
 static CamelFilterDriver *
 main_get_filter_driver (CamelSession *session,
 			const gchar *type,
 			CamelFolder *for_folder,
 			GError **error)
 {
-	EMailSession *ms = E_MAIL_SESSION (session);
 	CamelFilterDriver *driver;
-	EFilterRule *rule = NULL;
-	const gchar *config_dir;
-	gchar *user, *system;
 	GSettings *settings;
-	ERuleContext *fc;
 	EMailUISessionPrivate *priv;
 	gboolean add_junk_test;
 
@@ -240,14 +366,6 @@ main_get_filter_driver (CamelSession *session,
 
 	settings = e_util_ref_settings ("org.gnome.evolution.mail");
 
-	config_dir = mail_session_get_config_dir ();
-	user = g_build_filename (config_dir, "filters.xml", NULL);
-	system = g_build_filename (EVOLUTION_PRIVDATADIR, "filtertypes.xml", NULL);
-	fc = (ERuleContext *) em_filter_context_new (ms);
-	e_rule_context_load (fc, system, user);
-	g_free (system);
-	g_free (user);
-
 	driver = camel_filter_driver_new (session);
 	camel_filter_driver_set_folder_func (driver, get_folder, session);
 
@@ -291,37 +409,28 @@ main_get_filter_driver (CamelSession *session,
 	}
 
 	if (strcmp (type, E_FILTER_SOURCE_JUNKTEST) != 0) {
-		GString *fsearch, *faction;
-
-		fsearch = g_string_new ("");
-		faction = g_string_new ("");
+		GPtrArray *rules;
 
 		if (!strcmp (type, E_FILTER_SOURCE_DEMAND))
 			type = E_FILTER_SOURCE_INCOMING;
 
 		/* add the user-defined rules next */
-		while ((rule = e_rule_context_next_rule (fc, rule, type))) {
-			g_string_truncate (fsearch, 0);
-			g_string_truncate (faction, 0);
+		rules = mail_ui_session_ref_filter_rules (E_MAIL_UI_SESSION (session), type);
+		if (rules) {
+			guint ii;
 
-			/* skip disabled rules */
-			if (!rule->enabled)
-				continue;
+			for (ii = 0; ii < rules->len; ii++) {
+				FilterRuleCode *rule_code = g_ptr_array_index (rules, ii);
 
-			e_filter_rule_build_code (rule, fsearch);
-			em_filter_rule_build_action (
-				EM_FILTER_RULE (rule), faction);
-			camel_filter_driver_add_rule (
-				driver, rule->name,
-				fsearch->str, faction->str);
-		}
+				camel_filter_driver_add_rule (
+					driver, rule_code->name,
+					rule_code->code, rule_code->action);
+			}
 
-		g_string_free (fsearch, TRUE);
-		g_string_free (faction, TRUE);
+			g_ptr_array_unref (rules);
+		}
 	}
 
-	g_object_unref (fc);
-
 	g_object_unref (settings);
 
 	return driver;
@@ -440,6 +549,10 @@ mail_ui_session_dispose (GObject *object)
 	priv->address_cache = NULL;
 	g_mutex_unlock (&priv->address_cache_mutex);
 
+	g_mutex_lock (&priv->filter_rules_lock);
+	g_clear_pointer (&priv->filter_rules, g_hash_table_destroy);
+	g_mutex_unlock (&priv->filter_rules_lock);
+
 	/* Chain up to parent's dispose() method. */
 	G_OBJECT_CLASS (e_mail_ui_session_parent_class)->dispose (object);
 }
@@ -452,6 +565,8 @@ mail_ui_session_finalize (GObject *object)
 	priv = E_MAIL_UI_SESSION_GET_PRIVATE (object);
 
 	g_mutex_clear (&priv->address_cache_mutex);
+	g_mutex_clear (&priv->filter_rules_lock);
+	g_free (priv->filter_rules_stamp);
 
 	/* Chain up to parent's method. */
 	G_OBJECT_CLASS (e_mail_ui_session_parent_class)->finalize (object);
@@ -998,6 +1113,7 @@ e_mail_ui_session_init (EMailUISession *session)
 {
 	session->priv = E_MAIL_UI_SESSION_GET_PRIVATE (session);
 	g_mutex_init (&session->priv->address_cache_mutex);
+	g_mutex_init (&session->priv->filter_rules_lock);
 	session->priv->label_store = e_mail_label_list_store_new ();
 }
 
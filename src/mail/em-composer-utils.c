@@ -4457,6 +4457,7 @@ em_utils_reply_to_message (EMsgComposer *composer,
 	ESourceRegistry *registry;
 	CamelInternetAddress *to, *cc;
 	CamelNNTPAddress *postto = NULL;
+	EMailPartList *cached_parts_list = NULL;
 	EShell *shell;
 	ESourceMailCompositionReplyStyle prefer_reply_style = E_SOURCE_MAIL_COMPOSITION_REPLY_STYLE_DEFAULT;
 	ESource *source;
@@ -4591,8 +4592,21 @@ em_utils_reply_to_message (EMsgComposer *composer,
 			break;
 	}
 
+	/* Quote from the already parsed message, when available */
+	if (!parts_list && folder && message_uid) {
+		/* Only peek, this runs in the main thread */
+		cached_parts_list = e_mail_part_list_cache_peek (folder, message_uid);
+
+		/* The message can be a different one, like the reply
+		 * to a selection, which quotes only the selected text */
+		if (cached_parts_list && e_mail_part_list_get_message (cached_parts_list) == message)
+			parts_list = cached_parts_list;
+	}
+
 	composer_set_body (composer, message, style, parts_list);
 
+	g_clear_object (&cached_parts_list);
+
 	if (folder)
 		emu_set_source_headers (composer, folder, message_uid, flags);
 
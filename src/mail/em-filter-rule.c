@@ -49,19 +49,139 @@ static GtkWidget *get_widget (EFilterRule *fr, ERuleContext *rc);
 
 G_DEFINE_TYPE (EMFilterRule, em_filter_rule, E_TYPE_FILTER_RULE)
 
+/* What a rule part needs from the message to be evaluated, cheapest first */
+typedef enum {
+	PART_NEEDS_EXACT_HEADER,	/* only exact header comparisons */
+	PART_NEEDS_SUMMARY,		/* headers and flags from the summary */
+	PART_NEEDS_BODY			/* the whole message */
+} PartNeeds;
+
+typedef struct _PartCost {
+	EFilterPart *part;
+	PartNeeds needs;
+} PartCost;
+
+static PartNeeds
+filter_part_get_needs (EFilterPart *part)
+{
+	const gchar *body_functions[] = {
+		"(body-contains",
+		"(body-regex",
+		"(header-full-regex",
+		"(pipe-message",
+		"(junk-test"
+	};
+	const gchar *header_functions[] = {
+		"(header-contains",
+		"(header-has-words",
+		"(header-starts-with",
+		"(header-ends-with",
+		"(header-exists",
+		"(header-soundex",
+		"(header-regex"
+	};
+	PartNeeds needs = PART_NEEDS_SUMMARY;
+	GString *code;
+	guint ii;
+
+	code = g_string_new ("");
+	e_filter_part_build_code (part, code);
+
+	for (ii = 0; ii < G_N_ELEMENTS (body_functions); ii++) {
+		if (strstr (code->str, body_functions[ii])) {
+			needs = PART_NEEDS_BODY;
+			break;
+		}
+	}
+
+	if (needs == PART_NEEDS_SUMMARY && (
+	    strstr (code->str, "(header-matches") ||
+	    strstr (code->str, "(header-source"))) {
+		needs = PART_NEEDS_EXACT_HEADER;
+
+		for (ii = 0; ii < G_N_ELEMENTS (header_functions); ii++) {
+			if (strstr (code->str, header_functions[ii])) {
+				needs = PART_NEEDS_SUMMARY;
+				break;
+			}
+		}
+	}
+
+	g_string_free (code, TRUE);
+
+	return needs;
+}
+
+static gint
+part_cost_compare (gconstpointer a,
+                   gconstpointer b)
+{
+	const PartCost *pca = a, *pcb = b;
+
+	return (gint) pca->needs - (gint) pcb->needs;
+}
+
+/* Returns a copy of the parts list, stable-sorted so that exact header
+ * comparisons come first and anything requiring the message body comes
+ * last.  The filter driver short-circuits both "and" and "or", thus a rule
+ * which cannot match is rejected on its cheapest test, and the message body
+ * is downloaded only when all the header conditions of the rule passed. */
+static GList *
+filter_rule_sort_parts (GList *parts)
+{
+	GList *costs = NULL, *sorted = NULL, *link;
+	gboolean any_body = FALSE;
+
+	for (link = parts; link; link = g_list_next (link)) {
+		PartCost *pc = g_slice_new (PartCost);
+
+		pc->part = link->data;
+		pc->needs = filter_part_get_needs (pc->part);
+		any_body = any_body || pc->needs == PART_NEEDS_BODY;
+
+		costs = g_list_prepend (costs, pc);
+	}
+
+	costs = g_list_reverse (costs);
+
+	/* Header-only rules are cheap however they are ordered */
+	if (any_body)
+		costs = g_list_sort (costs, part_cost_compare);
+
+	for (link = costs; link; link = g_list_next (link)) {
+		PartCost *pc = link->data;
+
+		sorted = g_list_prepend (sorted, pc->part);
+		g_slice_free (PartCost, pc);
+	}
+
+	g_list_free (costs);
+
+	return g_list_reverse (sorted);
+}
+
 static void
 em_filter_rule_build_code (EFilterRule *rule,
 			   GString *out)
 {
 	EMFilterRule *ff;
+	GList *parts;
 
 	g_return_if_fail (EM_IS_FILTER_RULE (rule));
 	g_return_if_fail (out != NULL);
 
 	ff = EM_FILTER_RULE (rule);
 
+	/* Evaluate the parts cheapest first; the order of the parts does not
+	 * change the result, only how much of the message is needed for it. */
+	parts = rule->parts;
+	rule->parts = filter_rule_sort_parts (parts);
+
 	E_FILTER_RULE_CLASS (em_filter_rule_parent_class)->build_code (rule, out);
 
+	g_list_free (rule->parts);
+	rule->parts = parts;
+
 	if (ff->priv->account_uid && *ff->priv->account_uid) {
 		if (out->len) {
 			gchar *prefix;
@@ -137,6 +137,321 @@ import_mbox_add_message (CamelFolder *folder,
 	g_clear_object (&info);
 }
 
+/* How many messages are constructed ahead of the appends */
+#define IMPORT_MBOX_MAX_IN_FLIGHT 64
+
+/* How many messages are appended between two folder synchronizations;
+ * the offset after each synchronized batch is where a broken import
+ * of the same file continues. */
+#define IMPORT_MBOX_BATCH_SIZE 500
+
+#define IMPORT_MBOX_RESUME_FILE "mbox-import-resume.ini"
+
+G_LOCK_DEFINE_STATIC (import_mbox_resume);
+
+typedef struct _ImportMboxSlice {
+	const gchar *data;	/* points into the mapped file */
+	gsize len;
+	goffset end_offset;
+
+	/* set by the construct pool */
+	CamelMimeMessage *message;
+	gboolean done;
+} ImportMboxSlice;
+
+typedef struct _ImportMboxPipeline {
+	GMutex lock;
+	GCond cond;
+} ImportMboxPipeline;
+
+static gchar *
+import_mbox_dup_resume_filename (void)
+{
+	return g_build_filename (e_get_user_cache_dir (), "mail", IMPORT_MBOX_RESUME_FILE, NULL);
+}
+
+/* Returns where to continue an import of @path into @uri, which had
+ * been interrupted before, or 0, when the file changed since then. */
+static goffset
+import_mbox_load_resume_offset (const gchar *path,
+                                const gchar *uri,
+                                const struct stat *st)
+{
+	GKeyFile *key_file;
+	gchar *filename, *stored_uri;
+	goffset offset = 0;
+
+	G_LOCK (import_mbox_resume);
+
+	filename = import_mbox_dup_resume_filename ();
+	key_file = g_key_file_new ();
+
+	if (g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL)) {
+		stored_uri = g_key_file_get_string (key_file, path, "uri", NULL);
+
+		if (g_strcmp0 (stored_uri, uri ? uri : "") == 0 &&
+		    g_key_file_get_int64 (key_file, path, "size", NULL) == (gint64) st->st_size &&
+		    g_key_file_get_int64 (key_file, path, "mtime", NULL) == (gint64) st->st_mtime)
+			offset = g_key_file_get_int64 (key_file, path, "offset", NULL);
+
+		g_free (stored_uri);
+	}
+
+	g_key_file_free (key_file);
+	g_free (filename);
+
+	G_UNLOCK (import_mbox_resume);
+
+	if (offset < 0 || offset > st->st_size)
+		offset = 0;
+
+	return offset;
+}
+
+/* Stores the @offset up to which the @path had been imported into @uri;
+ * an @offset of -1 forgets the file, once it had been fully imported. */
+static void
+import_mbox_save_resume_offset (const gchar *path,
+                                const gchar *uri,
+                                const struct stat *st,
+                                goffset offset)
+{
+	GKeyFile *key_file;
+	gchar *filename;
+	GError *local_error = NULL;
+
+	G_LOCK (import_mbox_resume);
+
+	filename = import_mbox_dup_resume_filename ();
+	key_file = g_key_file_new ();
+
+	g_key_file_load_from_file (key_file, filename, G_KEY_FILE_NONE, NULL);
+
+	if (offset < 0) {
+		g_key_file_remove_group (key_file, path, NULL);
+	} else {
+		g_key_file_set_string (key_file, path, "uri", uri ? uri : "");
+		g_key_file_set_int64 (key_file, path, "size", st->st_size);
+		g_key_file_set_int64 (key_file, path, "mtime", st->st_mtime);
+		g_key_file_set_int64 (key_file, path, "offset", offset);
+	}
+
+	if (offset >= 0 || g_file_test (filename, G_FILE_TEST_EXISTS)) {
+		gchar *dirname = g_path_get_dirname (filename);
+
+		g_mkdir_with_parents (dirname, 0700);
+		g_free (dirname);
+
+		if (!g_key_file_save_to_file (key_file, filename, &local_error)) {
+			g_warning ("%s: Failed to save '%s': %s", G_STRFUNC, filename, local_error ? local_error->message : "Unknown error");
+			g_clear_error (&local_error);
+		}
+	}
+
+	g_key_file_free (key_file);
+	g_free (filename);
+
+	G_UNLOCK (import_mbox_resume);
+}
+
+/* Returns the offset of the first line starting with "From " at
+ * or after the @offset, the same as CamelMimeParser splits an mbox,
+ * or the @size when there is none. */
+static goffset
+import_mbox_find_from_line (const gchar *data,
+                            goffset size,
+                            goffset offset)
+{
+	while (offset < size) {
+		const gchar *eol;
+
+		if ((offset == 0 || data[offset - 1] == '\n') &&
+		    size - offset >= 5 && strncmp (data + offset, "From ", 5) == 0)
+			return offset;
+
+		eol = memchr (data + offset, '\n', size - offset);
+		if (!eol)
+			break;
+
+		offset = eol - data + 1;
+	}
+
+	return size;
+}
+
+static void
+import_mbox_construct_thread (gpointer data,
+                              gpointer user_data)
+{
+	ImportMboxSlice *slice = data;
+	ImportMboxPipeline *pipeline = user_data;
+	CamelMimeMessage *msg = NULL;
+	CamelMimeParser *mp;
+	CamelStream *stream;
+
+	stream = camel_stream_mem_new_with_buffer (slice->data, slice->len);
+
+	mp = camel_mime_parser_new ();
+	camel_mime_parser_scan_from (mp, TRUE);
+	camel_mime_parser_init_with_stream (mp, stream, NULL);
+
+	if (camel_mime_parser_step (mp, NULL, NULL) == CAMEL_MIME_PARSER_STATE_FROM) {
+		msg = camel_mime_message_new ();
+
+		if (!camel_mime_part_construct_from_parser_sync (
+			(CamelMimePart *) msg, mp, NULL, NULL))
+			g_clear_object (&msg);
+	}
+
+	g_object_unref (mp);
+	g_object_unref (stream);
+
+	g_mutex_lock (&pipeline->lock);
+	slice->message = msg;
+	slice->done = TRUE;
+	g_cond_broadcast (&pipeline->cond);
+	g_mutex_unlock (&pipeline->lock);
+}
+
+static void
+import_mbox_slice_free (gpointer ptr)
+{
+	ImportMboxSlice *slice = ptr;
+
+	if (slice) {
+		g_clear_object (&slice->message);
+		g_slice_free (ImportMboxSlice, slice);
+	}
+}
+
+/* Imports the mbox in three stages: this thread splits the mapped
+ * file by the From lines, a pool of threads constructs the messages,
+ * and this thread appends them in the file order. Returns whether
+ * any message had been found. */
+static gboolean
+import_mbox_pipelined (struct _import_mbox_msg *m,
+                       CamelFolder *folder,
+                       GMappedFile *mapped_file,
+                       const struct stat *st,
+                       GCancellable *cancellable,
+                       GError **error)
+{
+	ImportMboxPipeline pipeline;
+	GThreadPool *pool;
+	GQueue slices = G_QUEUE_INIT;
+	const gchar *data;
+	goffset size, offset, committed_offset, appended_offset;
+	gboolean any_read = FALSE;
+	gboolean success = TRUE;
+	guint n_uncommitted = 0;
+
+	data = g_mapped_file_get_contents (mapped_file);
+	size = g_mapped_file_get_length (mapped_file);
+
+	committed_offset = import_mbox_load_resume_offset (m->path, m->uri, st);
+	offset = import_mbox_find_from_line (data, size, committed_offset);
+	appended_offset = committed_offset;
+
+	/* continuing an interrupted import, the messages are there */
+	any_read = committed_offset > 0;
+
+	g_mutex_init (&pipeline.lock);
+	g_cond_init (&pipeline.cond);
+
+	pool = g_thread_pool_new (
+		import_mbox_construct_thread, &pipeline,
+		MAX (1, MIN (g_get_num_processors (), 8)), FALSE, NULL);
+
+	while (success && !g_cancellable_is_cancelled (cancellable)) {
+		ImportMboxSlice *slice;
+
+		while (offset < size && g_queue_get_length (&slices) < IMPORT_MBOX_MAX_IN_FLIGHT) {
+			goffset next_offset;
+
+			next_offset = import_mbox_find_from_line (data, size, offset + 1);
+
+			slice = g_slice_new0 (ImportMboxSlice);
+			slice->data = data + offset;
+			slice->len = next_offset - offset;
+			slice->end_offset = next_offset;
+
+			g_queue_push_tail (&slices, slice);
+			g_thread_pool_push (pool, slice, NULL);
+
+			offset = next_offset;
+		}
+
+		slice = g_queue_peek_head (&slices);
+		if (!slice)
+			break;
+
+		g_mutex_lock (&pipeline.lock);
+		while (!slice->done)
+			g_cond_wait (&pipeline.cond, &pipeline.lock);
+		g_mutex_unlock (&pipeline.lock);
+
+		g_queue_pop_head (&slices);
+
+		any_read = TRUE;
+
+		if (!slice->message) {
+			/* set exception? */
+			import_mbox_slice_free (slice);
+			break;
+		}
+
+		import_mbox_add_message (folder, slice->message, cancellable, error);
+
+		success = !error || !*error;
+
+		if (success) {
+			if (size > 0)
+				camel_operation_progress (cancellable, (gint) (100.0 * slice->end_offset / size));
+
+			appended_offset = slice->end_offset;
+			n_uncommitted++;
+
+			if (n_uncommitted >= IMPORT_MBOX_BATCH_SIZE) {
+				/* Not passing a GCancellable or GError here. */
+				if (camel_folder_synchronize_sync (folder, FALSE, NULL, NULL)) {
+					committed_offset = appended_offset;
+					import_mbox_save_resume_offset (m->path, m->uri, st, committed_offset);
+				}
+
+				n_uncommitted = 0;
+			}
+		}
+
+		import_mbox_slice_free (slice);
+	}
+
+	/* let the pool finish what it started before the data is unmapped */
+	g_thread_pool_free (pool, FALSE, TRUE);
+
+	/* The caller synchronizes the folder on any exit, thus also store
+	 * the messages appended since the last batch and remember them,
+	 * otherwise continuing the import would add them once again. */
+	if (n_uncommitted > 0) {
+		/* Not passing a GCancellable or GError here. */
+		if (camel_folder_synchronize_sync (folder, FALSE, NULL, NULL))
+			import_mbox_save_resume_offset (m->path, m->uri, st, appended_offset);
+	}
+
+	if (g_queue_is_empty (&slices) && offset >= size && success &&
+	    !g_cancellable_is_cancelled (cancellable)) {
+		/* the whole file is in, nothing to continue with */
+		import_mbox_save_resume_offset (m->path, m->uri, st, -1);
+	}
+
+	while (!g_queue_is_empty (&slices))
+		import_mbox_slice_free (g_queue_pop_head (&slices));
+
+	g_cond_clear (&pipeline.cond);
+	g_mutex_clear (&pipeline.lock);
+
+	return any_read;
+}
+
 static void
 import_mbox_exec (struct _import_mbox_msg *m,
                   GCancellable *cancellable,
@@ -169,57 +484,73 @@ import_mbox_exec (struct _import_mbox_msg *m,
 		return;
 
 	if (S_ISREG (st.st_mode)) {
+		GMappedFile *mapped_file;
 		gboolean any_read = FALSE;
 
-		fd = g_open (m->path, O_RDONLY | O_BINARY, 0);
-		if (fd == -1) {
-			g_warning (
-				"cannot find source file to import '%s': %s",
-				m->path, g_strerror (errno));
-			goto fail1;
-		}
-
-		mp = camel_mime_parser_new ();
-		camel_mime_parser_scan_from (mp, TRUE);
-		if (camel_mime_parser_init_with_fd (mp, fd) == -1) {
-			/* will never happen - 0 is unconditionally returned */
-			goto fail2;
-		}
-
 		camel_operation_push_message (
 			cancellable, _("Importing “%s”"),
 			camel_folder_get_display_name (folder));
 		camel_folder_freeze (folder);
-		while (camel_mime_parser_step (mp, NULL, NULL) == CAMEL_MIME_PARSER_STATE_FROM &&
-		       !g_cancellable_is_cancelled (cancellable)) {
-
-			CamelMimeMessage *msg;
-			gint pc = 0;
 
-			any_read = TRUE;
+		mapped_file = g_mapped_file_new (m->path, FALSE, NULL);
 
-			if (st.st_size > 0)
-				pc = (gint) (100.0 * ((gdouble)
-					camel_mime_parser_tell (mp) /
-					(gdouble) st.st_size));
-			camel_operation_progress (cancellable, pc);
+		if (mapped_file) {
+			any_read = import_mbox_pipelined (
+				m, folder, mapped_file, &st, cancellable, error);
+			g_mapped_file_unref (mapped_file);
+		} else {
+			/* Cannot map it (it's too large for the address
+			 * space, for example), read it sequentially. */
+			fd = g_open (m->path, O_RDONLY | O_BINARY, 0);
+			if (fd == -1) {
+				g_warning (
+					"cannot find source file to import '%s': %s",
+					m->path, g_strerror (errno));
+				camel_folder_thaw (folder);
+				camel_operation_pop_message (cancellable);
+				goto fail1;
+			}
 
-			msg = camel_mime_message_new ();
-			if (!camel_mime_part_construct_from_parser_sync (
-				(CamelMimePart *) msg, mp, NULL, NULL)) {
-				/* set exception? */
-				g_object_unref (msg);
-				break;
+			mp = camel_mime_parser_new ();
+			camel_mime_parser_scan_from (mp, TRUE);
+			if (camel_mime_parser_init_with_fd (mp, fd) == -1) {
+				/* will never happen - 0 is unconditionally returned */
+				camel_folder_thaw (folder);
+				camel_operation_pop_message (cancellable);
+				goto fail2;
 			}
 
-			import_mbox_add_message (folder, msg, cancellable, error);
+			while (camel_mime_parser_step (mp, NULL, NULL) == CAMEL_MIME_PARSER_STATE_FROM &&
+			       !g_cancellable_is_cancelled (cancellable)) {
+
+				CamelMimeMessage *msg;
+				gint pc = 0;
+
+				any_read = TRUE;
+
+				if (st.st_size > 0)
+					pc = (gint) (100.0 * ((gdouble)
+						camel_mime_parser_tell (mp) /
+						(gdouble) st.st_size));
+				camel_operation_progress (cancellable, pc);
+
+				msg = camel_mime_message_new ();
+				if (!camel_mime_part_construct_from_parser_sync (
+					(CamelMimePart *) msg, mp, NULL, NULL)) {
+					/* set exception? */
+					g_object_unref (msg);
+					break;
+				}
+
+				import_mbox_add_message (folder, msg, cancellable, error);
 
-			g_object_unref (msg);
+				g_object_unref (msg);
 
-			if (error && *error != NULL)
-				break;
+				if (error && *error != NULL)
+					break;
 
-			camel_mime_parser_step (mp, NULL, NULL);
+				camel_mime_parser_step (mp, NULL, NULL);
+			}
 		}
 
 		if (!any_read && !g_cancellable_is_cancelled (cancellable)) {
@@ -243,7 +574,7 @@ import_mbox_exec (struct _import_mbox_msg *m,
 		camel_folder_thaw (folder);
 		camel_operation_pop_message (cancellable);
 	fail2:
-		g_object_unref (mp);
+		g_clear_object (&mp);
 	}
 fail1:
 	/* Not passing a GCancellable or GError here. */
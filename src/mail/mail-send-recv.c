@@ -1390,9 +1390,11 @@ test_should_delete_junk_or_expunge (CamelStore *store,
 }
 
 static void
-get_folders (CamelStore *store,
-             GPtrArray *folders,
-             CamelFolderInfo *info)
+get_folders_tiered (CamelStore *store,
+                    GPtrArray *inbox_folders,
+                    GPtrArray *unread_folders,
+                    GPtrArray *other_folders,
+                    CamelFolderInfo *info)
 {
 	while (info) {
 		if (camel_store_can_refresh_folder (store, info, NULL)) {
@@ -1401,15 +1403,46 @@ get_folders (CamelStore *store,
 
 				folder_uri = e_mail_folder_uri_build (
 					store, info->full_name);
-				g_ptr_array_add (folders, folder_uri);
+
+				if ((info->flags & CAMEL_FOLDER_TYPE_MASK) == CAMEL_FOLDER_TYPE_INBOX)
+					g_ptr_array_add (inbox_folders, folder_uri);
+				else if (info->unread > 0)
+					g_ptr_array_add (unread_folders, folder_uri);
+				else
+					g_ptr_array_add (other_folders, folder_uri);
 			}
 		}
 
-		get_folders (store, folders, info->child);
+		get_folders_tiered (store, inbox_folders, unread_folders, other_folders, info->child);
 		info = info->next;
 	}
 }
 
+/* Fills the @folders with URIs of folders to refresh; the Inbox goes
+ * first, then folders with unread messages and then the rest. */
+static void
+get_folders (CamelStore *store,
+             GPtrArray *folders,
+             CamelFolderInfo *info)
+{
+	GPtrArray *unread_folders, *other_folders;
+	guint ii;
+
+	unread_folders = g_ptr_array_new ();
+	other_folders = g_ptr_array_new ();
+
+	get_folders_tiered (store, folders, unread_folders, other_folders, info);
+
+	for (ii = 0; ii < unread_folders->len; ii++)
+		g_ptr_array_add (folders, g_ptr_array_index (unread_folders, ii));
+
+	for (ii = 0; ii < other_folders->len; ii++)
+		g_ptr_array_add (folders, g_ptr_array_index (other_folders, ii));
+
+	g_ptr_array_free (unread_folders, TRUE);
+	g_ptr_array_free (other_folders, TRUE);
+}
+
 static void
 main_op_cancelled_cb (GCancellable *main_op,
                       GCancellable *refresh_op)
@@ -1434,17 +1467,124 @@ refresh_folders_desc (struct _refresh_folders_msg *m)
 		camel_service_get_display_name (CAMEL_SERVICE (m->store)));
 }
 
+/* How many folders of the @store can be refreshed at once; stores with
+ * multiple connections to the server refresh them concurrently. */
+static guint
+refresh_folders_get_max_concurrent (CamelStore *store)
+{
+	CamelSettings *settings;
+	guint max_concurrent = 1;
+
+	settings = camel_service_ref_settings (CAMEL_SERVICE (store));
+
+	if (settings && g_object_class_find_property (G_OBJECT_GET_CLASS (settings), "concurrent-connections")) {
+		guint concurrent_connections = 0;
+
+		g_object_get (settings, "concurrent-connections", &concurrent_connections, NULL);
+
+		max_concurrent = MAX (concurrent_connections, 1);
+	}
+
+	g_clear_object (&settings);
+
+	return max_concurrent;
+}
+
+typedef struct _RefreshFoldersData {
+	struct _refresh_folders_msg *m;
+	EMailBackend *mail_backend;
+	GCancellable *cancellable;
+	gboolean expunge;
+
+	GMutex lock;
+	GHashTable *known_errors;
+	gboolean skip_rest;
+	guint n_done;
+} RefreshFoldersData;
+
+static void
+refresh_folders_refresh_one (gpointer data,
+                             gpointer user_data)
+{
+	const gchar *folder_uri = data;
+	RefreshFoldersData *rfd = user_data;
+	struct _refresh_folders_msg *m = rfd->m;
+	CamelFolder *folder;
+	GCancellable *cancellable = rfd->cancellable;
+	GError *local_error = NULL;
+	gboolean skip;
+
+	g_mutex_lock (&rfd->lock);
+	skip = rfd->skip_rest;
+	g_mutex_unlock (&rfd->lock);
+
+	if (skip ||
+	    g_cancellable_is_cancelled (m->info->cancellable) ||
+	    g_cancellable_is_cancelled (cancellable))
+		return;
+
+	folder = e_mail_session_uri_to_folder_sync (
+		E_MAIL_SESSION (m->info->session),
+		folder_uri, 0,
+		cancellable, &local_error);
+	if (folder && camel_folder_synchronize_sync (folder, rfd->expunge, cancellable, &local_error))
+		camel_folder_refresh_info_sync (folder, cancellable, &local_error);
+
+	if (folder && !local_error && rfd->mail_backend) {
+		em_utils_process_autoarchive_sync (rfd->mail_backend, folder, folder_uri, cancellable, &local_error);
+	}
+
+	g_mutex_lock (&rfd->lock);
+
+	if (local_error != NULL) {
+		const gchar *error_message = local_error->message ? local_error->message : _("Unknown error");
+
+		if (g_hash_table_contains (rfd->known_errors, error_message)) {
+			/* Received the same error message multiple times; there can be some
+			   connection issue probably, thus skip the rest folder updates for now */
+			rfd->skip_rest = TRUE;
+		} else if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+			CamelStore *store;
+			const gchar *full_name;
+
+			if (folder) {
+				store = camel_folder_get_parent_store (folder);
+				full_name = camel_folder_get_full_name (folder);
+			} else {
+				store = m->store;
+				full_name = folder_uri;
+			}
+
+			report_error_to_ui (CAMEL_SERVICE (store), full_name, local_error, NULL);
+
+			/* To not report one error for multiple folders multiple times */
+			g_hash_table_insert (rfd->known_errors, g_strdup (error_message), GINT_TO_POINTER (1));
+		}
+
+		g_clear_error (&local_error);
+	}
+
+	rfd->n_done++;
+
+	if (m->info->state != SEND_CANCELLED)
+		camel_operation_progress (
+			m->info->cancellable, 100 * rfd->n_done / m->folders->len);
+
+	g_mutex_unlock (&rfd->lock);
+
+	g_clear_object (&folder);
+}
+
 static void
 refresh_folders_exec (struct _refresh_folders_msg *m,
                       GCancellable *cancellable,
                       GError **error)
 {
-	CamelFolder *folder;
+	RefreshFoldersData rfd;
+	guint max_concurrent;
 	gint i;
 	gboolean success;
 	gboolean delete_junk = FALSE, expunge = FALSE;
-	GHashTable *known_errors;
-	EMailBackend *mail_backend;
 	GError *local_error = NULL;
 	gulong handler_id = 0;
 
@@ -1473,66 +1613,36 @@ refresh_folders_exec (struct _refresh_folders_msg *m,
 		goto exit;
 	}
 
-	mail_backend = E_MAIL_BACKEND (e_shell_get_backend_by_name (e_shell_get_default (), "mail"));
-
-	known_errors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	rfd.m = m;
+	rfd.mail_backend = E_MAIL_BACKEND (e_shell_get_backend_by_name (e_shell_get_default (), "mail"));
+	rfd.cancellable = cancellable;
+	rfd.expunge = expunge;
+	rfd.known_errors = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+	rfd.skip_rest = FALSE;
+	rfd.n_done = 0;
+	g_mutex_init (&rfd.lock);
 
-	for (i = 0; i < m->folders->len; i++) {
-		folder = e_mail_session_uri_to_folder_sync (
-			E_MAIL_SESSION (m->info->session),
-			m->folders->pdata[i], 0,
-			cancellable, &local_error);
-		if (folder && camel_folder_synchronize_sync (folder, expunge, cancellable, &local_error))
-			camel_folder_refresh_info_sync (folder, cancellable, &local_error);
+	max_concurrent = refresh_folders_get_max_concurrent (m->store);
 
-		if (folder && !local_error && mail_backend) {
-			em_utils_process_autoarchive_sync (mail_backend, folder, m->folders->pdata[i], cancellable, &local_error);
-		}
+	if (max_concurrent > 1 && m->folders->len > 1) {
+		GThreadPool *pool;
 
-		if (local_error != NULL) {
-			const gchar *error_message = local_error->message ? local_error->message : _("Unknown error");
-
-			if (g_hash_table_contains (known_errors, error_message)) {
-				/* Received the same error message multiple times; there can be some
-				   connection issue probably, thus skip the rest folder updates for now */
-				g_clear_object (&folder);
-				g_clear_error (&local_error);
-				break;
-			} else if (!g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
-				CamelStore *store;
-				const gchar *full_name;
-
-				if (folder) {
-					store = camel_folder_get_parent_store (folder);
-					full_name = camel_folder_get_full_name (folder);
-				} else {
-					store = m->store;
-					full_name = (const gchar *) m->folders->pdata[i];
-				}
+		pool = g_thread_pool_new (refresh_folders_refresh_one, &rfd, max_concurrent, FALSE, NULL);
 
-				report_error_to_ui (CAMEL_SERVICE (store), full_name, local_error, NULL);
+		/* The folders are taken in the order they were pushed */
+		for (i = 0; i < m->folders->len; i++)
+			g_thread_pool_push (pool, m->folders->pdata[i], NULL);
 
-				/* To not report one error for multiple folders multiple times */
-				g_hash_table_insert (known_errors, g_strdup (error_message), GINT_TO_POINTER (1));
-			}
-
-			g_clear_error (&local_error);
+		g_thread_pool_free (pool, FALSE, TRUE);
+	} else {
+		for (i = 0; i < m->folders->len && !rfd.skip_rest; i++) {
+			refresh_folders_refresh_one (m->folders->pdata[i], &rfd);
 		}
-
-		if (folder)
-			g_object_unref (folder);
-
-		if (g_cancellable_is_cancelled (m->info->cancellable) ||
-		    g_cancellable_is_cancelled (cancellable))
-			break;
-
-		if (m->info->state != SEND_CANCELLED)
-			camel_operation_progress (
-				m->info->cancellable, 100 * i / m->folders->len);
 	}
 
 	camel_operation_pop_message (m->info->cancellable);
-	g_hash_table_destroy (known_errors);
+	g_hash_table_destroy (rfd.known_errors);
+	g_mutex_clear (&rfd.lock);
 
 exit:
 	if (handler_id > 0)
@@ -28,6 +28,7 @@
 #include <unistd.h>
 #include <string.h>
 #include <ctype.h>
+#include <locale.h>
 
 #include <glib/gi18n.h>
 #include <glib/gstdio.h>
@@ -71,6 +72,14 @@
 #define EXCLUDE_DELETED_MESSAGES_EXPR	"(not (system-flag \"deleted\"))"
 #define EXCLUDE_JUNK_MESSAGES_EXPR	"(not (system-flag \"junk\"))"
 
+/* Flat lists with at least this many messages are shown in windowed
+ * mode, which keeps message infos loaded only around the shown rows. */
+#define ML_WINDOWED_MIN_MESSAGES	50000
+/* How many rows around a missing one are fetched at once. */
+#define ML_WINDOWED_PREFETCH		64
+/* How many message infos are kept loaded in windowed mode. */
+#define ML_WINDOWED_MAX_INFOS		2048
+
 typedef struct _ExtendedGNode ExtendedGNode;
 typedef struct _RegenData RegenData;
 
@@ -97,6 +106,19 @@ struct _MessageListPrivate {
 	GMutex thread_tree_lock;
 	CamelFolderThread *thread_tree;
 
+	/* Used to thread folder changes into the existing tree,
+	 * built on demand and dropped whenever the tree is cleared. */
+	GHashTable *thread_msgid_index; /* guint64 * ~> GNode * */
+	GHashTable *thread_refs_index; /* guint64 * ~> GPtrArray * of GNode * */
+
+	/* Windowed mode nodes with a loaded message info, oldest first. */
+	GQueue window_infos; /* GNode * */
+
+	/* Normalised strings read from disk, moved into the
+	 * normalised_hash once verified against the message. */
+	GHashTable *stored_sort_keys; /* gchar *uid ~> EPoolv * */
+	gboolean sort_keys_changed;
+
 	struct _MLSelection clipboard;
 	gboolean destroyed;
 
@@ -142,6 +164,10 @@ struct _MessageListPrivate {
 struct _ExtendedGNode {
 	GNode gnode;
 	GNode *last_child;
+
+	/* Set only in windowed mode, where the message info
+	 * is loaded on demand.  Lives in Camel's string pool. */
+	const gchar *uid;
 };
 
 struct _RegenData {
@@ -157,6 +183,8 @@ struct _RegenData {
 	gboolean group_by_threads;
 	gboolean thread_subject;
 	gboolean select_unread;
+	gboolean load_sort_keys;
+	GHashTable *stored_sort_keys;
 
 	CamelFolderThread *thread_tree;
 
@@ -167,6 +195,14 @@ struct _RegenData {
 
 	CamelFolder *folder;
 	GPtrArray *summary;
+	GPtrArray *window_uids; /* sorted UIDs for the windowed mode */
+
+	/* Fallback selection candidates for the windowed mode, which
+	 * has no message infos to track them while building the list. */
+	const gchar *window_oldest_unread_uid; /* camel_pstring */
+	time_t window_oldest_unread_date;
+	const gchar *window_newest_read_uid; /* camel_pstring */
+	time_t window_newest_read_date;
 
 	gint last_row; /* last selected (cursor) row */
 
@@ -274,9 +310,15 @@ enum {
 	NORMALISED_SUBJECT,
 	NORMALISED_FROM,
 	NORMALISED_TO,
+	NORMALISED_STAMP, /* date sent and received the keys were made for */
 	NORMALISED_LAST
 };
 
+/* The normalised strings are stored on disk for folders with
+ * at least this many of them, to not recompute them next time. */
+#define ML_SORT_KEYS_MIN_MESSAGES	1000
+#define ML_SORT_KEYS_MAGIC		"evolution-message-list-sort-keys-1"
+
 static void	on_cursor_activated_cmd		(ETree *tree,
 						 gint row,
 						 GNode *node,
@@ -294,6 +336,7 @@ static void	mail_regen_list			(MessageList *message_list,
 						 const gchar *search,
 						 CamelFolderChangeInfo *folder_changes);
 static void	mail_regen_cancel		(MessageList *message_list);
+static void	ml_thread_index_clear		(MessageList *message_list);
 
 static void	clear_info			(gchar *key,
 						 GNode *node,
@@ -402,6 +445,8 @@ extended_g_nodes_free (GNode *node)
 		GNode *next = node->next;
 		if (node->children != NULL)
 			extended_g_nodes_free (node->children);
+		if (((ExtendedGNode *) node)->uid != NULL)
+			camel_pstring_free (((ExtendedGNode *) node)->uid);
 		g_slice_free (ExtendedGNode, (ExtendedGNode *) node);
 		node = next;
 	}
@@ -501,8 +546,10 @@ regen_data_new (MessageList *message_list,
 			g_object_ref (regen_data->full_header);
 	}
 
-	if (message_list->just_set_folder)
+	if (message_list->just_set_folder) {
 		regen_data->select_uid = g_strdup (message_list->cursor_uid);
+		regen_data->load_sort_keys = TRUE;
+	}
 
 	g_mutex_init (&regen_data->select_lock);
 
@@ -555,6 +602,15 @@ regen_data_unref (RegenData *regen_data)
 			g_ptr_array_free (regen_data->summary, TRUE);
 		}
 
+		if (regen_data->window_uids != NULL)
+			g_ptr_array_unref (regen_data->window_uids);
+
+		camel_pstring_free (regen_data->window_oldest_unread_uid);
+		camel_pstring_free (regen_data->window_newest_read_uid);
+
+		if (regen_data->stored_sort_keys != NULL)
+			g_hash_table_destroy (regen_data->stored_sort_keys);
+
 		if (regen_data->removed_uids)
 			g_hash_table_destroy (regen_data->removed_uids);
 		g_clear_object (&regen_data->folder);
@@ -733,11 +789,56 @@ get_message_uid (MessageList *message_list,
                  GNode *node)
 {
 	g_return_val_if_fail (node != NULL, NULL);
+
+	if (((ExtendedGNode *) node)->uid != NULL)
+		return ((ExtendedGNode *) node)->uid;
+
 	g_return_val_if_fail (node->data != NULL, NULL);
 
 	return camel_message_info_get_uid (node->data);
 }
 
+/* Loads message infos for windowed mode nodes around @node, which are
+ * likely to be shown next, and releases the least recently loaded ones. */
+static void
+message_list_window_fetch (MessageList *message_list,
+                           GNode *node)
+{
+	CamelFolder *folder;
+	GNode *iter;
+	gint ii;
+
+	folder = message_list_ref_folder (message_list);
+	if (folder == NULL)
+		return;
+
+	for (iter = node, ii = 0; iter->prev && ii < ML_WINDOWED_PREFETCH / 2; ii++)
+		iter = iter->prev;
+
+	for (ii = 0; iter && ii < ML_WINDOWED_PREFETCH; iter = iter->next, ii++) {
+		const gchar *uid = ((ExtendedGNode *) iter)->uid;
+
+		if (iter->data != NULL || uid == NULL)
+			continue;
+
+		iter->data = camel_folder_get_message_info (folder, uid);
+		if (iter->data != NULL)
+			g_queue_push_tail (&message_list->priv->window_infos, iter);
+	}
+
+	while (g_queue_get_length (&message_list->priv->window_infos) > ML_WINDOWED_MAX_INFOS) {
+		iter = g_queue_pop_head (&message_list->priv->window_infos);
+
+		/* The requested node can be among the oldest on a wrap-around. */
+		if (iter == node)
+			g_queue_push_tail (&message_list->priv->window_infos, iter);
+		else
+			g_clear_object (&iter->data);
+	}
+
+	g_object_unref (folder);
+}
+
 /* Gets the CamelMessageInfo for the message displayed at the given
  * view row.
  */
@@ -746,11 +847,284 @@ get_message_info (MessageList *message_list,
                   GNode *node)
 {
 	g_return_val_if_fail (node != NULL, NULL);
+
+	if (node->data == NULL && ((ExtendedGNode *) node)->uid != NULL)
+		message_list_window_fetch (message_list, node);
+
 	g_return_val_if_fail (node->data != NULL, NULL);
 
 	return node->data;
 }
 
+static gchar *
+ml_sort_keys_stamp (CamelMessageInfo *info)
+{
+	return g_strdup_printf (
+		"%" G_GINT64_FORMAT " %" G_GINT64_FORMAT,
+		(gint64) camel_message_info_get_date_sent (info),
+		(gint64) camel_message_info_get_date_received (info));
+}
+
+/* The normalised strings depend on the collation
+ * and on the configured "Re:" prefixes as well. */
+static gchar *
+message_list_dup_sort_keys_fingerprint (MessageList *message_list)
+{
+	GString *fingerprint;
+	gint ii;
+
+	fingerprint = g_string_new (setlocale (LC_COLLATE, NULL));
+
+	g_mutex_lock (&message_list->priv->re_prefixes_lock);
+
+	for (ii = 0; message_list->priv->re_prefixes && message_list->priv->re_prefixes[ii]; ii++) {
+		g_string_append_c (fingerprint, '\n');
+		g_string_append (fingerprint, message_list->priv->re_prefixes[ii]);
+	}
+
+	g_string_append_c (fingerprint, '\n');
+
+	for (ii = 0; message_list->priv->re_separators && message_list->priv->re_separators[ii]; ii++) {
+		g_string_append_c (fingerprint, '\n');
+		g_string_append (fingerprint, message_list->priv->re_separators[ii]);
+	}
+
+	g_mutex_unlock (&message_list->priv->re_prefixes_lock);
+
+	return g_string_free (fingerprint, FALSE);
+}
+
+/* The file consists of the magic line, the fingerprint and then the UID
+ * and the NORMALISED_LAST strings for each message.  Each string is stored
+ * with its length first, because collate keys can contain any byte. */
+
+static void
+ml_sort_keys_append_string (GString *buffer,
+                            const gchar *str)
+{
+	guint32 len, len_be;
+
+	len = str ? strlen (str) : 0;
+	len_be = GUINT32_TO_BE (len);
+
+	g_string_append_len (buffer, (const gchar *) &len_be, sizeof (guint32));
+
+	if (len > 0)
+		g_string_append_len (buffer, str, len);
+}
+
+static gchar *
+ml_sort_keys_read_string (const gchar **pdata,
+                          const gchar *data_end)
+{
+	guint32 len_be, len;
+
+	if (data_end - *pdata < (gssize) sizeof (guint32))
+		return NULL;
+
+	memcpy (&len_be, *pdata, sizeof (guint32));
+	len = GUINT32_FROM_BE (len_be);
+	*pdata += sizeof (guint32);
+
+	if (data_end - *pdata < (gssize) len)
+		return NULL;
+
+	*pdata += len;
+
+	return g_strndup (*pdata - len, len);
+}
+
+static GHashTable *
+message_list_load_sort_keys (MessageList *message_list,
+                             CamelFolder *folder)
+{
+	GHashTable *stored_sort_keys = NULL;
+	gchar *filename, *contents = NULL, *fingerprint, *stored_fingerprint;
+	const gchar *data, *data_end;
+	gsize length = 0;
+
+	filename = mail_config_folder_to_cachename (folder, "sort-keys-");
+
+	if (!g_file_get_contents (filename, &contents, &length, NULL) ||
+	    length < sizeof (ML_SORT_KEYS_MAGIC) ||
+	    memcmp (contents, ML_SORT_KEYS_MAGIC, sizeof (ML_SORT_KEYS_MAGIC)) != 0) {
+		g_free (contents);
+		g_free (filename);
+		return NULL;
+	}
+
+	g_free (filename);
+
+	data = contents + sizeof (ML_SORT_KEYS_MAGIC);
+	data_end = contents + length;
+
+	fingerprint = message_list_dup_sort_keys_fingerprint (message_list);
+	stored_fingerprint = ml_sort_keys_read_string (&data, data_end);
+
+	if (g_strcmp0 (fingerprint, stored_fingerprint) == 0) {
+		stored_sort_keys = g_hash_table_new_full (
+			g_str_hash, g_str_equal,
+			(GDestroyNotify) camel_pstring_free,
+			(GDestroyNotify) e_poolv_destroy);
+
+		while (data < data_end) {
+			EPoolv *poolv;
+			gchar *uid;
+			gint ii;
+
+			uid = ml_sort_keys_read_string (&data, data_end);
+			if (!uid)
+				break;
+
+			poolv = e_poolv_new (NORMALISED_LAST);
+
+			for (ii = 0; ii < NORMALISED_LAST; ii++) {
+				gchar *str;
+
+				str = ml_sort_keys_read_string (&data, data_end);
+				if (!str)
+					break;
+
+				if (*str)
+					e_poolv_set (poolv, ii, str, TRUE);
+				else
+					g_free (str);
+			}
+
+			/* Truncated file, keep what was read completely */
+			if (ii < NORMALISED_LAST) {
+				e_poolv_destroy (poolv);
+				g_free (uid);
+				break;
+			}
+
+			g_hash_table_insert (stored_sort_keys, (gpointer) camel_pstring_add (uid, TRUE), poolv);
+		}
+	}
+
+	g_free (stored_fingerprint);
+	g_free (fingerprint);
+	g_free (contents);
+
+	return stored_sort_keys;
+}
+
+typedef struct _SaveSortKeysData {
+	gchar *filename;
+	GString *buffer;
+} SaveSortKeysData;
+
+static gpointer
+message_list_save_sort_keys_thread (gpointer user_data)
+{
+	SaveSortKeysData *sskd = user_data;
+	GError *local_error = NULL;
+
+	if (!g_file_set_contents (sskd->filename, sskd->buffer->str, sskd->buffer->len, &local_error)) {
+		g_warning ("%s: Failed to save '%s': %s", G_STRFUNC, sskd->filename, local_error ? local_error->message : "Unknown error");
+		g_clear_error (&local_error);
+	}
+
+	g_string_free (sskd->buffer, TRUE);
+	g_free (sskd->filename);
+	g_slice_free (SaveSortKeysData, sskd);
+
+	return NULL;
+}
+
+static void
+ml_sort_keys_append_entry (GString *buffer,
+                           const gchar *uid,
+                           EPoolv *poolv)
+{
+	gint ii;
+
+	ml_sort_keys_append_string (buffer, uid);
+
+	for (ii = 0; ii < NORMALISED_LAST; ii++)
+		ml_sort_keys_append_string (buffer, e_poolv_get (poolv, ii));
+}
+
+static void
+message_list_save_sort_keys (MessageList *message_list,
+                             CamelFolder *folder)
+{
+	SaveSortKeysData *sskd;
+	GHashTableIter iter;
+	gpointer key, value;
+	gchar *fingerprint;
+	guint n_entries;
+
+	if (!message_list->priv->sort_keys_changed || folder == NULL)
+		return;
+
+	message_list->priv->sort_keys_changed = FALSE;
+
+	n_entries = g_hash_table_size (message_list->normalised_hash);
+	if (message_list->priv->stored_sort_keys != NULL)
+		n_entries += g_hash_table_size (message_list->priv->stored_sort_keys);
+
+	if (n_entries < ML_SORT_KEYS_MIN_MESSAGES)
+		return;
+
+	sskd = g_slice_new0 (SaveSortKeysData);
+	sskd->filename = mail_config_folder_to_cachename (folder, "sort-keys-");
+	sskd->buffer = g_string_sized_new (n_entries * 128);
+
+	fingerprint = message_list_dup_sort_keys_fingerprint (message_list);
+
+	g_string_append_len (sskd->buffer, ML_SORT_KEYS_MAGIC, sizeof (ML_SORT_KEYS_MAGIC));
+	ml_sort_keys_append_string (sskd->buffer, fingerprint);
+
+	g_free (fingerprint);
+
+	g_hash_table_iter_init (&iter, message_list->normalised_hash);
+	while (g_hash_table_iter_next (&iter, &key, &value)) {
+		ml_sort_keys_append_entry (sskd->buffer, key, value);
+	}
+
+	/* Keep stored entries not used in this session, unless
+	 * their message is not in the folder anymore. */
+	if (message_list->priv->stored_sort_keys != NULL) {
+		g_hash_table_iter_init (&iter, message_list->priv->stored_sort_keys);
+		while (g_hash_table_iter_next (&iter, &key, &value)) {
+			if (g_hash_table_contains (message_list->uid_nodemap, key))
+				ml_sort_keys_append_entry (sskd->buffer, key, value);
+		}
+	}
+
+	g_thread_unref (g_thread_new (NULL, message_list_save_sort_keys_thread, sskd));
+}
+
+/* Returns the stored normalised strings for @info, if they
+ * were made for the current version of the message. */
+static EPoolv *
+message_list_take_stored_sort_keys (MessageList *message_list,
+                                    CamelMessageInfo *info)
+{
+	EPoolv *poolv = NULL;
+	gpointer key = NULL, value = NULL;
+	gchar *stamp;
+
+	if (message_list->priv->stored_sort_keys == NULL ||
+	    !g_hash_table_lookup_extended (message_list->priv->stored_sort_keys, camel_message_info_get_uid (info), &key, &value))
+		return NULL;
+
+	g_hash_table_steal (message_list->priv->stored_sort_keys, key);
+	camel_pstring_free (key);
+
+	stamp = ml_sort_keys_stamp (info);
+
+	if (g_strcmp0 (stamp, e_poolv_get (value, NORMALISED_STAMP)) == 0)
+		poolv = value;
+	else
+		e_poolv_destroy (value);
+
+	g_free (stamp);
+
+	return poolv;
+}
+
 static const gchar *
 get_normalised_string (MessageList *message_list,
                        CamelMessageInfo *info,
@@ -786,14 +1160,20 @@ get_normalised_string (MessageList *message_list,
 
 	poolv = g_hash_table_lookup (message_list->normalised_hash, camel_message_info_get_uid (info));
 	if (poolv == NULL) {
-		poolv = e_poolv_new (NORMALISED_LAST);
+		poolv = message_list_take_stored_sort_keys (message_list, info);
+		if (poolv == NULL) {
+			poolv = e_poolv_new (NORMALISED_LAST);
+			e_poolv_set (poolv, NORMALISED_STAMP, ml_sort_keys_stamp (info), TRUE);
+		}
 		g_hash_table_insert (message_list->normalised_hash, (gchar *) camel_message_info_get_uid (info), poolv);
-	} else {
-		str = e_poolv_get (poolv, index);
-		if (*str)
-			return str;
 	}
 
+	str = e_poolv_get (poolv, index);
+	if (*str)
+		return str;
+
+	message_list->priv->sort_keys_changed = TRUE;
+
 	if (col == COL_SUBJECT_NORM) {
 		gint skip_len;
 		const gchar *subject;
@@ -1567,7 +1947,7 @@ unread_foreach (ETreeModel *etm,
 	if (!etm)
 		info = (CamelMessageInfo *) path;
 	else
-		info = ((GNode *) path)->data;
+		info = get_message_info (MESSAGE_LIST (etm), path);
 	g_return_val_if_fail (info != NULL, FALSE);
 
 	if (!(camel_message_info_get_flags (info) & CAMEL_MESSAGE_SEEN))
@@ -1593,7 +1973,7 @@ latest_foreach (ETreeModel *etm,
 	if (!etm)
 		info = (CamelMessageInfo *) path;
 	else
-		info = ((GNode *) path)->data;
+		info = get_message_info (MESSAGE_LIST (etm), path);
 	g_return_val_if_fail (info != NULL, FALSE);
 
 	date = ld->sent ? camel_message_info_get_date_sent (info)
@@ -1714,7 +2094,7 @@ add_all_labels_foreach (ETreeModel *etm,
 	if (!etm)
 		msg_info = (CamelMessageInfo *) path;
 	else
-		msg_info = ((GNode *) path)->data;
+		msg_info = get_message_info (MESSAGE_LIST (etm), path);
 	g_return_val_if_fail (msg_info != NULL, FALSE);
 
 	camel_message_info_property_lock (msg_info);
@@ -2907,6 +3287,16 @@ ml_tree_sorting_changed (ETreeTableAdapter *adapter,
 
 	group_by_threads = message_list_get_group_by_threads (message_list);
 
+	/* The windowed mode sorts its UIDs itself. */
+	if (!group_by_threads && e_tree_table_adapter_get_presorted (adapter)) {
+		if (message_list->frozen == 0) {
+			mail_regen_list (message_list, NULL, NULL);
+			return TRUE;
+		}
+
+		message_list->priv->thaw_needs_regen = TRUE;
+	}
+
 	if (group_by_threads && message_list->frozen == 0) {
 
 		/* Invalidate the thread tree. */
@@ -2943,7 +3333,7 @@ ml_get_new_mail_bg_color (ETableItem *item,
 		return FALSE;
 
 	/* retrieve the message information array */
-	msg_info = ((GNode *) path)->data;
+	msg_info = get_message_info (message_list, path);
 	g_return_val_if_fail (msg_info != NULL, FALSE);
 
 	if (!(camel_message_info_get_flags (msg_info) & CAMEL_MESSAGE_SEEN)) {
@@ -3218,6 +3608,11 @@ message_list_dispose (GObject *object)
 
 	g_mutex_unlock (&message_list->priv->regen_lock);
 
+	if (priv->folder != NULL && message_list->uid_nodemap != NULL)
+		message_list_save_sort_keys (message_list, priv->folder);
+
+	g_clear_pointer (&priv->stored_sort_keys, g_hash_table_destroy);
+
 	if (message_list->uid_nodemap) {
 		g_hash_table_foreach (
 			message_list->uid_nodemap,
@@ -3275,6 +3670,9 @@ message_list_finalize (GObject *object)
 
 	clear_selection (message_list, &message_list->priv->clipboard);
 
+	ml_thread_index_clear (message_list);
+	g_queue_clear (&message_list->priv->window_infos);
+
 	if (message_list->priv->tree_model_root != NULL)
 		extended_g_node_destroy (message_list->priv->tree_model_root);
 
@@ -3414,6 +3812,9 @@ message_list_get_save_id (ETreeModel *tree_model,
 	if (G_NODE_IS_ROOT ((GNode *) path))
 		return g_strdup ("root");
 
+	if (((ExtendedGNode *) path)->uid != NULL)
+		return g_strdup (((ExtendedGNode *) path)->uid);
+
 	/* Note: ETable can ask for the save_id while we're clearing
 	 *       it, which is the only time info should be NULL. */
 	info = ((GNode *) path)->data;
@@ -3487,7 +3888,7 @@ message_list_value_at (ETreeModel *tree_model,
 		return NULL;
 
 	/* retrieve the message information array */
-	msg_info = ((GNode *) path)->data;
+	msg_info = get_message_info (message_list, path);
 	g_return_val_if_fail (msg_info != NULL, NULL);
 
 	camel_message_info_property_lock (msg_info);
@@ -4171,6 +4572,17 @@ clear_info (gchar *key,
 	g_clear_object (&node->data);
 }
 
+static void
+ml_thread_index_clear (MessageList *message_list)
+{
+	g_clear_pointer (
+		&message_list->priv->thread_msgid_index,
+		g_hash_table_destroy);
+	g_clear_pointer (
+		&message_list->priv->thread_refs_index,
+		g_hash_table_destroy);
+}
+
 static void
 clear_tree (MessageList *message_list,
             gboolean tfree)
@@ -4203,6 +4615,10 @@ clear_tree (MessageList *message_list,
 	message_list->priv->oldest_unread_date = 0;
 	message_list->priv->oldest_unread_uid = NULL;
 
+	/* The thread index points to the nodes being removed. */
+	ml_thread_index_clear (message_list);
+	g_queue_clear (&message_list->priv->window_infos);
+
 	if (message_list->priv->tree_model_root != NULL) {
 		/* we should be frozen already */
 		message_list_tree_model_remove (
@@ -4471,6 +4887,30 @@ find_next_selectable (MessageList *message_list,
 	return NULL;
 }
 
+/* Track the latest seen and unseen messages shown, used in
+ * fallback heuristics for automatic message selection. */
+static void
+ml_uid_nodemap_track_uid (MessageList *message_list,
+                          const gchar *uid,
+                          guint flags,
+                          time_t date)
+{
+	if (flags & CAMEL_MESSAGE_SEEN) {
+		if (date > message_list->priv->newest_read_date) {
+			message_list->priv->newest_read_date = date;
+			message_list->priv->newest_read_uid = uid;
+		}
+	} else {
+		if (message_list->priv->oldest_unread_date == 0) {
+			message_list->priv->oldest_unread_date = date;
+			message_list->priv->oldest_unread_uid = uid;
+		} else if (date < message_list->priv->oldest_unread_date) {
+			message_list->priv->oldest_unread_date = date;
+			message_list->priv->oldest_unread_uid = uid;
+		}
+	}
+}
+
 static GNode *
 ml_uid_nodemap_insert (MessageList *message_list,
                        CamelMessageInfo *info,
@@ -4499,28 +4939,47 @@ ml_uid_nodemap_insert (MessageList *message_list,
 	g_object_ref (info);
 	g_hash_table_insert (message_list->uid_nodemap, (gpointer) uid, node);
 
-	/* Track the latest seen and unseen messages shown, used in
-	 * fallback heuristics for automatic message selection. */
-	if (flags & CAMEL_MESSAGE_SEEN) {
-		if (date > message_list->priv->newest_read_date) {
-			message_list->priv->newest_read_date = date;
-			message_list->priv->newest_read_uid = uid;
-		}
-	} else {
-		if (message_list->priv->oldest_unread_date == 0) {
-			message_list->priv->oldest_unread_date = date;
-			message_list->priv->oldest_unread_uid = uid;
-		} else if (date < message_list->priv->oldest_unread_date) {
-			message_list->priv->oldest_unread_date = date;
-			message_list->priv->oldest_unread_uid = uid;
-		}
-	}
+	ml_uid_nodemap_track_uid (message_list, uid, flags, date);
 
 	g_object_unref (folder);
 
 	return node;
 }
 
+/* Adds a windowed mode node, its message info is loaded on demand. */
+static GNode *
+ml_uid_nodemap_insert_uid (MessageList *message_list,
+                           const gchar *uid,
+                           RegenData *regen_data)
+{
+	ExtendedGNode *ext_node;
+	GNode *node;
+
+	node = message_list_tree_model_insert (
+		message_list, message_list->priv->tree_model_root, -1, NULL);
+
+	ext_node = (ExtendedGNode *) node;
+	ext_node->uid = camel_pstring_strdup (uid);
+
+	g_hash_table_insert (
+		message_list->uid_nodemap,
+		(gpointer) ext_node->uid, node);
+
+	/* The regen thread found the fallback candidates already;
+	 * both UIDs live in Camel's string pool, as ext_node->uid. */
+	if (ext_node->uid == regen_data->window_oldest_unread_uid)
+		ml_uid_nodemap_track_uid (
+			message_list, ext_node->uid, 0,
+			regen_data->window_oldest_unread_date);
+
+	if (ext_node->uid == regen_data->window_newest_read_uid)
+		ml_uid_nodemap_track_uid (
+			message_list, ext_node->uid, CAMEL_MESSAGE_SEEN,
+			regen_data->window_newest_read_date);
+
+	return node;
+}
+
 static void
 ml_uid_nodemap_remove (MessageList *message_list,
                        CamelMessageInfo *info)
@@ -4597,6 +5056,9 @@ build_tree (MessageList *message_list,
 
 	clear_tree (message_list, FALSE);
 
+	e_tree_table_adapter_set_presorted (
+		e_tree_get_table_adapter (E_TREE (message_list)), FALSE);
+
 	build_subtree (
 		message_list,
 		message_list->priv->tree_model_root,
@@ -4827,6 +5289,7 @@ build_subtree_diff (MessageList *message_list,
 static void
 build_flat (MessageList *message_list,
             GPtrArray *summary,
+            RegenData *regen_data,
             gboolean folder_changed,
 	    GHashTable *removed_uids)
 {
@@ -4850,10 +5313,23 @@ build_flat (MessageList *message_list,
 
 	clear_tree (message_list, FALSE);
 
-	for (i = 0; i < summary->len; i++) {
-		CamelMessageInfo *info = summary->pdata[i];
+	/* The windowed mode UIDs are sorted already, the adapter
+	 * would load every message info to sort them again. */
+	e_tree_table_adapter_set_presorted (
+		e_tree_get_table_adapter (E_TREE (message_list)),
+		regen_data->window_uids != NULL);
+
+	if (regen_data->window_uids != NULL) {
+		GPtrArray *window_uids = regen_data->window_uids;
+
+		for (i = 0; i < window_uids->len; i++)
+			ml_uid_nodemap_insert_uid (message_list, window_uids->pdata[i], regen_data);
+	} else {
+		for (i = 0; i < summary->len; i++) {
+			CamelMessageInfo *info = summary->pdata[i];
 
-		ml_uid_nodemap_insert (message_list, info, NULL, -1);
+			ml_uid_nodemap_insert (message_list, info, NULL, -1);
+		}
 	}
 
 	message_list_tree_model_thaw (message_list);
@@ -4910,6 +5386,349 @@ message_list_change_first_visible_parent (MessageList *message_list,
 	}
 }
 
+/* Incremental threading.
+ *
+ * Rebuilding a CamelFolderThread from the complete UID list for every
+ * "folder-changed" signal is too expensive for large folders, thus small
+ * batches of added and removed messages are threaded directly into the
+ * existing tree instead.  A message is placed under the nearest message
+ * it references which is present in the tree, the same rule the thread
+ * tree uses once it prunes its empty containers.  Anything this can't
+ * handle, like subject threading or duplicate Message-IDs, makes the
+ * caller fall back to a full regen. */
+
+#define ML_THREAD_MAX_INCREMENTAL_CHANGES 100
+
+static void
+ml_thread_index_add_node (MessageList *message_list,
+                          GNode *node)
+{
+	CamelMessageInfo *info = node->data;
+	GArray *references;
+	guint64 msgid;
+
+	msgid = camel_message_info_get_message_id (info);
+	if (msgid != 0 && !g_hash_table_contains (message_list->priv->thread_msgid_index, &msgid))
+		g_hash_table_insert (
+			message_list->priv->thread_msgid_index,
+			g_memdup (&msgid, sizeof (guint64)), node);
+
+	references = camel_message_info_dup_references (info);
+	if (references) {
+		guint ii;
+
+		for (ii = 0; ii < references->len; ii++) {
+			GPtrArray *referrers;
+			guint64 ref = g_array_index (references, guint64, ii);
+
+			if (!ref)
+				continue;
+
+			referrers = g_hash_table_lookup (message_list->priv->thread_refs_index, &ref);
+			if (!referrers) {
+				referrers = g_ptr_array_new ();
+				g_hash_table_insert (
+					message_list->priv->thread_refs_index,
+					g_memdup (&ref, sizeof (guint64)), referrers);
+			}
+
+			g_ptr_array_add (referrers, node);
+		}
+
+		g_array_unref (references);
+	}
+}
+
+static void
+ml_thread_index_remove_node (MessageList *message_list,
+                             GNode *node)
+{
+	CamelMessageInfo *info = node->data;
+	GArray *references;
+	guint64 msgid;
+
+	msgid = camel_message_info_get_message_id (info);
+	if (msgid != 0 && g_hash_table_lookup (message_list->priv->thread_msgid_index, &msgid) == node)
+		g_hash_table_remove (message_list->priv->thread_msgid_index, &msgid);
+
+	references = camel_message_info_dup_references (info);
+	if (references) {
+		guint ii;
+
+		for (ii = 0; ii < references->len; ii++) {
+			GPtrArray *referrers;
+			guint64 ref = g_array_index (references, guint64, ii);
+
+			if (!ref)
+				continue;
+
+			referrers = g_hash_table_lookup (message_list->priv->thread_refs_index, &ref);
+			if (referrers) {
+				g_ptr_array_remove_fast (referrers, node);
+
+				if (referrers->len == 0)
+					g_hash_table_remove (message_list->priv->thread_refs_index, &ref);
+			}
+		}
+
+		g_array_unref (references);
+	}
+}
+
+static gboolean
+ml_thread_index_build_cb (GNode *node,
+                          gpointer user_data)
+{
+	MessageList *message_list = user_data;
+
+	/* Skip the placeholder root node. */
+	if (node->data != NULL)
+		ml_thread_index_add_node (message_list, node);
+
+	return FALSE;
+}
+
+static void
+ml_thread_index_ensure (MessageList *message_list)
+{
+	if (message_list->priv->thread_msgid_index != NULL)
+		return;
+
+	message_list->priv->thread_msgid_index = g_hash_table_new_full (
+		g_int64_hash, g_int64_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) NULL);
+
+	message_list->priv->thread_refs_index = g_hash_table_new_full (
+		g_int64_hash, g_int64_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) g_ptr_array_unref);
+
+	g_node_traverse (
+		message_list->priv->tree_model_root,
+		G_PRE_ORDER, G_TRAVERSE_ALL, -1,
+		ml_thread_index_build_cb, message_list);
+}
+
+/* Returns the node the message should be threaded under, which is the
+ * nearest referenced message present in the tree, or the tree root.
+ * Nodes from the @self subtree are skipped, to not create loops. */
+static GNode *
+ml_thread_find_parent (MessageList *message_list,
+                       CamelMessageInfo *info,
+                       GNode *self)
+{
+	GArray *references;
+	GNode *parent = NULL;
+
+	references = camel_message_info_dup_references (info);
+	if (references) {
+		gint ii;
+
+		for (ii = references->len - 1; ii >= 0 && !parent; ii--) {
+			GNode *candidate;
+			guint64 ref = g_array_index (references, guint64, ii);
+
+			if (!ref)
+				continue;
+
+			candidate = g_hash_table_lookup (message_list->priv->thread_msgid_index, &ref);
+
+			if (candidate && (!self || (candidate != self && !g_node_is_ancestor (self, candidate))))
+				parent = candidate;
+		}
+
+		g_array_unref (references);
+	}
+
+	return parent ? parent : message_list->priv->tree_model_root;
+}
+
+static void
+ml_thread_move_node (MessageList *message_list,
+                     GNode *node,
+                     GNode *new_parent)
+{
+	ETreeModel *tree_model;
+	ETreeTableAdapter *adapter;
+	GNode *old_parent = node->parent;
+	gboolean expanded;
+	gint old_position;
+
+	if (old_parent == new_parent)
+		return;
+
+	tree_model = E_TREE_MODEL (message_list);
+	adapter = e_tree_get_table_adapter (E_TREE (message_list));
+
+	expanded = e_tree_table_adapter_node_is_expanded (adapter, node);
+
+	e_tree_model_pre_change (tree_model);
+	old_position = g_node_child_position (old_parent, node);
+	extended_g_node_unlink (node);
+	e_tree_model_node_removed (tree_model, old_parent, node, old_position);
+
+	e_tree_model_pre_change (tree_model);
+	extended_g_node_insert (new_parent, -1, node);
+	e_tree_model_node_inserted (tree_model, new_parent, node);
+
+	/* Keep the thread expanded or collapsed as it was before the move. */
+	if (e_tree_table_adapter_row_of_node (adapter, node) != -1 &&
+	    e_tree_table_adapter_node_is_expanded (adapter, node) != expanded)
+		e_tree_table_adapter_node_set_expanded (adapter, node, expanded);
+}
+
+/* Applies added and removed messages from @changes to the existing
+ * thread tree.  Returns FALSE without touching the tree when a full
+ * regen is needed instead. */
+static gboolean
+message_list_thread_folder_changes (MessageList *message_list,
+                                    CamelFolder *folder,
+                                    CamelFolderChangeInfo *changes,
+                                    gboolean hide_junk,
+                                    gboolean hide_deleted)
+{
+	GPtrArray *added_infos;
+	GHashTable *added_msgids;
+	gboolean can_apply;
+	guint ii, jj;
+
+	if (!message_list_get_group_by_threads (message_list) ||
+	    message_list_get_thread_subject (message_list) ||
+	    message_list_is_searching (message_list) ||
+	    message_list->just_set_folder ||
+	    message_list->frozen != 0 ||
+	    message_list->priv->tree_model_frozen > 0 ||
+	    message_list->priv->tree_model_root == NULL)
+		return FALSE;
+
+	if (changes->uid_added->len + changes->uid_removed->len > ML_THREAD_MAX_INCREMENTAL_CHANGES)
+		return FALSE;
+
+	/* The thread tree is invalidated when the tree content
+	 * depends on more than the folder content, like sorting. */
+	g_mutex_lock (&message_list->priv->thread_tree_lock);
+	can_apply = message_list->priv->thread_tree != NULL;
+	g_mutex_unlock (&message_list->priv->thread_tree_lock);
+
+	if (!can_apply)
+		return FALSE;
+
+	/* Leave the cursor fallback heuristics to the full regen. */
+	if (message_list->cursor_uid != NULL) {
+		for (ii = 0; ii < changes->uid_removed->len; ii++) {
+			if (g_strcmp0 (message_list->cursor_uid, changes->uid_removed->pdata[ii]) == 0)
+				return FALSE;
+		}
+	}
+
+	ml_thread_index_ensure (message_list);
+
+	added_infos = g_ptr_array_new_with_free_func (g_object_unref);
+	added_msgids = g_hash_table_new_full (
+		g_int64_hash, g_int64_equal,
+		(GDestroyNotify) g_free,
+		(GDestroyNotify) NULL);
+
+	for (ii = 0; ii < changes->uid_added->len && can_apply; ii++) {
+		CamelMessageInfo *info;
+		const gchar *uid = changes->uid_added->pdata[ii];
+		guint32 flags;
+		guint64 msgid;
+
+		if (g_hash_table_contains (message_list->uid_nodemap, uid))
+			continue;
+
+		info = camel_folder_get_message_info (folder, uid);
+		if (!info)
+			continue;
+
+		flags = camel_message_info_get_flags (info);
+
+		if ((hide_deleted && (flags & CAMEL_MESSAGE_DELETED) != 0) ||
+		    (hide_junk && (flags & CAMEL_MESSAGE_JUNK) != 0)) {
+			g_object_unref (info);
+			continue;
+		}
+
+		/* Duplicate Message-IDs need the thread tree logic. */
+		msgid = camel_message_info_get_message_id (info);
+		if (msgid != 0) {
+			if (g_hash_table_contains (message_list->priv->thread_msgid_index, &msgid) ||
+			    g_hash_table_contains (added_msgids, &msgid))
+				can_apply = FALSE;
+			else
+				g_hash_table_add (added_msgids, g_memdup (&msgid, sizeof (guint64)));
+		}
+
+		g_ptr_array_add (added_infos, info);
+	}
+
+	g_hash_table_destroy (added_msgids);
+
+	if (!can_apply) {
+		g_ptr_array_unref (added_infos);
+		return FALSE;
+	}
+
+	for (ii = 0; ii < changes->uid_removed->len; ii++) {
+		CamelMessageInfo *info;
+		GNode *node, *child;
+
+		node = g_hash_table_lookup (
+			message_list->uid_nodemap,
+			changes->uid_removed->pdata[ii]);
+		if (!node)
+			continue;
+
+		ml_thread_index_remove_node (message_list, node);
+
+		/* Re-thread the children before their parent goes away. */
+		while ((child = g_node_first_child (node)) != NULL) {
+			ml_thread_move_node (
+				message_list, child,
+				ml_thread_find_parent (message_list, child->data, child));
+		}
+
+		message_list_change_first_visible_parent (message_list, node);
+
+		info = node->data;
+		message_list_tree_model_remove (message_list, node);
+		ml_uid_nodemap_remove (message_list, info);
+	}
+
+	for (ii = 0; ii < added_infos->len; ii++) {
+		CamelMessageInfo *info = added_infos->pdata[ii];
+		GPtrArray *referrers;
+		GNode *node;
+		guint64 msgid;
+
+		node = ml_uid_nodemap_insert (
+			message_list, info,
+			ml_thread_find_parent (message_list, info, NULL), -1);
+		ml_thread_index_add_node (message_list, node);
+
+		/* Adopt messages which reference this one and
+		 * were threaded under a more distant ancestor. */
+		msgid = camel_message_info_get_message_id (info);
+		referrers = msgid != 0 ? g_hash_table_lookup (message_list->priv->thread_refs_index, &msgid) : NULL;
+
+		for (jj = 0; referrers && jj < referrers->len; jj++) {
+			GNode *referrer = referrers->pdata[jj];
+
+			if (referrer != node &&
+			    ml_thread_find_parent (message_list, referrer->data, referrer) == node)
+				ml_thread_move_node (message_list, referrer, node);
+		}
+
+		message_list_change_first_visible_parent (message_list, node);
+	}
+
+	g_ptr_array_unref (added_infos);
+
+	return TRUE;
+}
+
 static CamelFolderChangeInfo *
 mail_folder_hide_by_flag (CamelFolder *folder,
                           MessageList *message_list,
@@ -5018,7 +5837,9 @@ message_list_folder_changed (CamelFolder *folder,
 			camel_folder_change_info_cat (altered_changes, changes);
 		}
 
-		if (altered_changes->uid_added->len == 0 && altered_changes->uid_removed->len == 0 && altered_changes->uid_changed->len < 100) {
+		if (altered_changes->uid_changed->len < 100 &&
+		    ((altered_changes->uid_added->len == 0 && altered_changes->uid_removed->len == 0) ||
+		     message_list_thread_folder_changes (message_list, folder, altered_changes, hide_junk, hide_deleted))) {
 			for (i = 0; i < altered_changes->uid_changed->len; i++) {
 				GNode *node;
 
@@ -5172,8 +5993,12 @@ message_list_set_folder (MessageList *message_list,
 		message_list->seen_id = 0;
 	}
 
+	if (message_list->priv->folder != NULL)
+		message_list_save_sort_keys (message_list, message_list->priv->folder);
+
 	/* reset the normalised sort performance hack */
 	g_hash_table_remove_all (message_list->normalised_hash);
+	g_clear_pointer (&message_list->priv->stored_sort_keys, g_hash_table_destroy);
 
 	if (message_list->priv->folder != NULL)
 		save_tree_state (message_list, message_list->priv->folder);
@@ -5570,7 +6395,7 @@ on_selection_changed_cmd (ETree *tree,
 		else
 			newuid = NULL;
 	} else if ((cursor = e_tree_get_cursor (tree)))
-		newuid = (gchar *) camel_message_info_get_uid (cursor->data);
+		newuid = get_message_uid (message_list, cursor);
 	else
 		newuid = NULL;
 
@@ -6063,6 +6888,294 @@ message_list_regen_tweak_search_results (MessageList *message_list,
 	g_clear_object (&info);
 }
 
+typedef struct _WindowSortKey {
+	const gchar *uid;
+	gint64 value;
+	guint index;
+	gboolean has_value;
+} WindowSortKey;
+
+static gint
+ml_window_sort_key_compare (gconstpointer ptr1,
+                            gconstpointer ptr2,
+                            gpointer user_data)
+{
+	const WindowSortKey *key1 = ptr1, *key2 = ptr2;
+	gint res;
+
+	if (key1->value != key2->value)
+		res = key1->value < key2->value ? -1 : 1;
+	else
+		res = key1->index < key2->index ? -1 : (key1->index > key2->index ? 1 : 0);
+
+	/* Descending order, the same way ETable sorts */
+	if (GPOINTER_TO_INT (user_data))
+		res = -res;
+
+	return res;
+}
+
+static gint
+ml_window_read_sort_keys_cb (gpointer user_data,
+                             gint ncol,
+                             gchar **colvalues,
+                             gchar **colnames)
+{
+	GHashTable *uid_keys = user_data;
+	WindowSortKey *key;
+
+	if (ncol == 2 && colvalues[0] && colvalues[1]) {
+		key = g_hash_table_lookup (uid_keys, colvalues[0]);
+		if (key != NULL) {
+			key->value = g_ascii_strtoll (colvalues[1], NULL, 10);
+			key->has_value = TRUE;
+		}
+	}
+
+	return 0;
+}
+
+typedef struct _WindowFallbackData {
+	GHashTable *pending; /* listed UIDs not read from the database yet */
+	RegenData *regen_data;
+} WindowFallbackData;
+
+static void
+ml_window_track_fallback (RegenData *regen_data,
+                          const gchar *uid,
+                          guint32 flags,
+                          time_t date)
+{
+	if (flags & CAMEL_MESSAGE_SEEN) {
+		if (date > regen_data->window_newest_read_date) {
+			camel_pstring_free (regen_data->window_newest_read_uid);
+			regen_data->window_newest_read_uid = camel_pstring_strdup (uid);
+			regen_data->window_newest_read_date = date;
+		}
+	} else if (!regen_data->window_oldest_unread_uid ||
+		   date < regen_data->window_oldest_unread_date) {
+		camel_pstring_free (regen_data->window_oldest_unread_uid);
+		regen_data->window_oldest_unread_uid = camel_pstring_strdup (uid);
+		regen_data->window_oldest_unread_date = date;
+	}
+}
+
+static gint
+ml_window_read_fallback_cb (gpointer user_data,
+                            gint ncol,
+                            gchar **colvalues,
+                            gchar **colnames)
+{
+	WindowFallbackData *wfd = user_data;
+
+	if (ncol == 3 && colvalues[0] && colvalues[1] && colvalues[2] &&
+	    g_hash_table_remove (wfd->pending, colvalues[0])) {
+		ml_window_track_fallback (
+			wfd->regen_data, colvalues[0],
+			(guint32) g_ascii_strtoull (colvalues[1], NULL, 10),
+			(time_t) g_ascii_strtoll (colvalues[2], NULL, 10));
+	}
+
+	return 0;
+}
+
+/* Finds the oldest unread and the newest read message among the listed
+ * UIDs, as ml_uid_nodemap_insert() does for the regular flat list, but
+ * reading the flags and dates from the folder summary database. */
+static void
+message_list_regen_window_fallback (RegenData *regen_data,
+                                    CamelFolder *folder,
+                                    GPtrArray *uids,
+                                    GCancellable *cancellable)
+{
+	WindowFallbackData wfd;
+	CamelStore *store;
+	CamelDB *db;
+	GHashTableIter iter;
+	gpointer key;
+	guint ii;
+
+	wfd.regen_data = regen_data;
+	wfd.pending = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (ii = 0; ii < uids->len; ii++)
+		g_hash_table_add (wfd.pending, uids->pdata[ii]);
+
+	store = camel_folder_get_parent_store (folder);
+	db = store ? camel_store_get_db (store) : NULL;
+
+	if (db != NULL) {
+		gchar *query, *sqlized_foldername;
+		GError *local_error = NULL;
+
+		sqlized_foldername = camel_db_sqlize_string (camel_folder_get_full_name (folder));
+		query = g_strdup_printf ("SELECT uid, flags, dreceived FROM %s", sqlized_foldername);
+
+		camel_db_select (db, query, ml_window_read_fallback_cb, &wfd, &local_error);
+
+		if (local_error) {
+			g_debug ("%s: Failed to execute '%s': %s", G_STRFUNC, query, local_error->message);
+			g_clear_error (&local_error);
+		}
+
+		g_free (query);
+		camel_db_free_sqlized_string (sqlized_foldername);
+	}
+
+	/* Messages not saved into the database yet */
+	g_hash_table_iter_init (&iter, wfd.pending);
+	while (g_hash_table_iter_next (&iter, &key, NULL) &&
+	       !g_cancellable_is_cancelled (cancellable)) {
+		CamelMessageInfo *info;
+
+		info = camel_folder_get_message_info (folder, key);
+		if (info == NULL)
+			continue;
+
+		ml_window_track_fallback (
+			regen_data, key,
+			camel_message_info_get_flags (info),
+			camel_message_info_get_date_received (info));
+
+		g_object_unref (info);
+	}
+
+	g_hash_table_destroy (wfd.pending);
+}
+
+/* Sorts the UIDs for the windowed mode by reading the sort column
+ * directly from the folder summary database, rather than loading all
+ * the message infos.  Returns FALSE when the current sort order cannot
+ * be computed this way and the regular flat list should be used. */
+static gboolean
+message_list_regen_window_uids (RegenData *regen_data,
+                                CamelFolder *folder,
+                                GPtrArray *uids,
+                                GCancellable *cancellable)
+{
+	WindowSortKey *keys;
+	GtkSortType sort_type = GTK_SORT_ASCENDING;
+	const gchar *db_column = NULL;
+	gint sort_col = -1;
+	guint ii;
+
+	if (CAMEL_IS_VEE_FOLDER (folder))
+		return FALSE;
+
+	if (regen_data->sort_info != NULL &&
+	    e_table_sort_info_grouping_get_count (regen_data->sort_info) > 0)
+		return FALSE;
+
+	if (regen_data->sort_info != NULL &&
+	    e_table_sort_info_sorting_get_count (regen_data->sort_info) > 0) {
+		ETableColumnSpecification *spec;
+		ETableCol *col;
+
+		if (e_table_sort_info_sorting_get_count (regen_data->sort_info) > 1 ||
+		    regen_data->full_header == NULL)
+			return FALSE;
+
+		spec = e_table_sort_info_sorting_get_nth (regen_data->sort_info, 0, &sort_type);
+		col = e_table_header_get_column_by_spec (regen_data->full_header, spec);
+		if (col == NULL)
+			return FALSE;
+
+		sort_col = col->spec->compare_col;
+
+		switch (sort_col) {
+			case COL_SENT:
+				db_column = "dsent";
+				break;
+			case COL_RECEIVED:
+				db_column = "dreceived";
+				break;
+			case COL_SIZE:
+				db_column = "size";
+				break;
+			default:
+				return FALSE;
+		}
+	}
+
+	keys = g_new0 (WindowSortKey, uids->len);
+
+	for (ii = 0; ii < uids->len; ii++) {
+		keys[ii].uid = uids->pdata[ii];
+		keys[ii].index = ii;
+	}
+
+	if (db_column != NULL) {
+		CamelStore *store;
+		CamelDB *db;
+		GHashTable *uid_keys;
+
+		uid_keys = g_hash_table_new (g_str_hash, g_str_equal);
+
+		for (ii = 0; ii < uids->len; ii++)
+			g_hash_table_insert (uid_keys, (gpointer) keys[ii].uid, &keys[ii]);
+
+		store = camel_folder_get_parent_store (folder);
+		db = store ? camel_store_get_db (store) : NULL;
+
+		if (db != NULL) {
+			gchar *query, *sqlized_foldername;
+			GError *local_error = NULL;
+
+			sqlized_foldername = camel_db_sqlize_string (camel_folder_get_full_name (folder));
+			query = g_strdup_printf ("SELECT uid, %s FROM %s", db_column, sqlized_foldername);
+
+			camel_db_select (db, query, ml_window_read_sort_keys_cb, uid_keys, &local_error);
+
+			if (local_error) {
+				g_debug ("%s: Failed to execute '%s': %s", G_STRFUNC, query, local_error->message);
+				g_clear_error (&local_error);
+			}
+
+			g_free (query);
+			camel_db_free_sqlized_string (sqlized_foldername);
+		}
+
+		g_hash_table_destroy (uid_keys);
+
+		/* Messages not saved into the database yet */
+		for (ii = 0; ii < uids->len && !g_cancellable_is_cancelled (cancellable); ii++) {
+			CamelMessageInfo *info;
+
+			if (keys[ii].has_value)
+				continue;
+
+			info = camel_folder_get_message_info (folder, keys[ii].uid);
+			if (info == NULL)
+				continue;
+
+			if (sort_col == COL_SENT)
+				keys[ii].value = camel_message_info_get_date_sent (info);
+			else if (sort_col == COL_RECEIVED)
+				keys[ii].value = camel_message_info_get_date_received (info);
+			else
+				keys[ii].value = camel_message_info_get_size (info);
+
+			g_object_unref (info);
+		}
+
+		g_qsort_with_data (
+			keys, uids->len, sizeof (WindowSortKey),
+			ml_window_sort_key_compare,
+			GINT_TO_POINTER (sort_type == GTK_SORT_DESCENDING));
+	}
+
+	regen_data->window_uids = g_ptr_array_new_full (uids->len, (GDestroyNotify) camel_pstring_free);
+
+	for (ii = 0; ii < uids->len; ii++)
+		g_ptr_array_add (regen_data->window_uids, (gpointer) camel_pstring_strdup (keys[ii].uid));
+
+	g_free (keys);
+
+	message_list_regen_window_fallback (regen_data, folder, uids, cancellable);
+
+	return TRUE;
+}
+
 static void
 message_list_regen_thread (GSimpleAsyncResult *simple,
                            GObject *source_object,
@@ -6089,6 +7202,9 @@ message_list_regen_thread (GSimpleAsyncResult *simple,
 	/* Just for convenience. */
 	folder = g_object_ref (regen_data->folder);
 
+	if (regen_data->load_sort_keys)
+		regen_data->stored_sort_keys = message_list_load_sort_keys (message_list, folder);
+
 	hide_junk = message_list_get_hide_junk (message_list, folder);
 	hide_deleted = message_list_get_hide_deleted (message_list, folder);
 
@@ -6205,7 +7321,8 @@ message_list_regen_thread (GSimpleAsyncResult *simple,
 		 * gets invalidated before regen post-processing. */
 		regen_data->thread_tree = thread_tree;
 
-	} else {
+	} else if (uids->len < ML_WINDOWED_MIN_MESSAGES ||
+		   !message_list_regen_window_uids (regen_data, folder, uids, cancellable)) {
 		guint ii;
 
 		regen_data->summary = g_ptr_array_new ();
@@ -6385,6 +7502,13 @@ message_list_regen_done_cb (GObject *source_object,
 
 	e_activity_set_state (activity, E_ACTIVITY_COMPLETED);
 
+	if (regen_data->stored_sort_keys != NULL &&
+	    regen_data->folder == message_list->priv->folder) {
+		g_clear_pointer (&message_list->priv->stored_sort_keys, g_hash_table_destroy);
+		message_list->priv->stored_sort_keys = regen_data->stored_sort_keys;
+		regen_data->stored_sort_keys = NULL;
+	}
+
 	tree = E_TREE (message_list);
 	adapter = e_tree_get_table_adapter (tree);
 
@@ -6571,6 +7695,7 @@ message_list_regen_done_cb (GObject *source_object,
 		build_flat (
 			message_list,
 			regen_data->summary,
+			regen_data,
 			regen_data->folder_changed,
 			regen_data->removed_uids);
 	}
@@ -116,17 +116,19 @@ bogofilter_exited_cb (GPid *pid,
 	g_main_loop_quit (source_data->loop);
 }
 
+/* Runs Bogofilter with the @message on its standard input, or with all
+ * the @messages in the mbox format, when it's not %NULL. */
 static gint
-bogofilter_command (const gchar **argv,
-                    CamelMimeMessage *message,
-                    GCancellable *cancellable,
-                    GError **error)
+bogofilter_command_full (const gchar **argv,
+                         CamelMimeMessage *message,
+                         GPtrArray *messages,
+                         GCancellable *cancellable,
+                         GError **error)
 {
 	CamelStream *stream;
 	GMainContext *context;
 	GSource *source;
 	GPid child_pid;
-	gssize bytes_written;
 	gint standard_input;
 	gulong handler_id = 0;
 	gboolean success;
@@ -162,11 +164,16 @@ bogofilter_command (const gchar **argv,
 		return BOGOFILTER_EXIT_STATUS_ERROR;
 	}
 
-	/* Stream the CamelMimeMessage to Bogofilter. */
+	/* Stream the CamelMimeMessage(s) to Bogofilter. */
 	stream = camel_stream_fs_new_with_fd (standard_input);
-	bytes_written = camel_data_wrapper_write_to_stream_sync (
-		CAMEL_DATA_WRAPPER (message), stream, cancellable, error);
-	success = (bytes_written >= 0) &&
+	if (messages != NULL)
+		success = e_mail_junk_filter_write_mbox_sync (
+			messages, stream, cancellable, error);
+	else
+		success = camel_data_wrapper_write_to_stream_sync (
+			CAMEL_DATA_WRAPPER (message),
+			stream, cancellable, error) >= 0;
+	success = success &&
 		(camel_stream_close (stream, cancellable, error) == 0);
 	g_object_unref (stream);
 
@@ -228,12 +235,29 @@ bogofilter_command (const gchar **argv,
 	return source_data.exit_code;
 }
 
+static gint
+bogofilter_command (const gchar **argv,
+                    CamelMimeMessage *message,
+                    GCancellable *cancellable,
+                    GError **error)
+{
+	return bogofilter_command_full (
+		argv, message, NULL, cancellable, error);
+}
+
+static gboolean bogofilter_learn (EBogofilter *extension,
+				  GPtrArray *messages,
+				  gboolean is_junk,
+				  GCancellable *cancellable,
+				  GError **error);
+
 static void
 bogofilter_init_wordlist (EBogofilter *extension)
 {
 	CamelStream *stream;
 	CamelMimeParser *parser;
 	CamelMimeMessage *message;
+	GPtrArray *messages;
 
 	/* Initialize the Bogofilter database with a welcome message. */
 
@@ -249,9 +273,12 @@ bogofilter_init_wordlist (EBogofilter *extension)
 	camel_mime_part_construct_from_parser_sync (
 		CAMEL_MIME_PART (message), parser, NULL, NULL);
 
-	camel_junk_filter_learn_not_junk (
-		CAMEL_JUNK_FILTER (extension), message, NULL, NULL);
+	messages = g_ptr_array_new ();
+	g_ptr_array_add (messages, message);
+
+	bogofilter_learn (extension, messages, FALSE, NULL, NULL);
 
+	g_ptr_array_unref (messages);
 	g_object_unref (message);
 	g_object_unref (parser);
 }
@@ -452,30 +479,38 @@ retry:
 }
 
 static gboolean
-bogofilter_learn_junk (CamelJunkFilter *junk_filter,
-                       CamelMimeMessage *message,
-                       GCancellable *cancellable,
-                       GError **error)
+bogofilter_learn (EBogofilter *extension,
+                  GPtrArray *messages,
+                  gboolean is_junk,
+                  GCancellable *cancellable,
+                  GError **error)
 {
-	EBogofilter *extension = E_BOGOFILTER (junk_filter);
 	gint exit_code;
 
 	const gchar *argv[] = {
 		bogofilter_get_command_path (extension),
-		"--register-spam",
+		is_junk ? "--register-spam" : "--register-ham",
+		NULL,  /* leave room for mbox option */
 		NULL,  /* leave room for unicode option */
 		NULL
 	};
+	gint ii = 2;
 
+	/* Register all the messages with a single process in mbox mode */
+	if (messages->len > 1)
+		argv[ii++] = "-M";
 	if (bogofilter_get_convert_to_unicode (extension))
-		argv[2] = "--unicode=yes";
+		argv[ii++] = "--unicode=yes";
 
-	exit_code = bogofilter_command (argv, message, cancellable, error);
+	if (messages->len == 1)
+		exit_code = bogofilter_command (argv, messages->pdata[0], cancellable, error);
+	else
+		exit_code = bogofilter_command_full (argv, NULL, messages, cancellable, error);
 
 	if (exit_code != 0)
 		g_warning (
 			"Bogofilter: Unexpected exit code (%d) "
-			"while registering spam", exit_code);
+			"while registering %s", exit_code, is_junk ? "spam" : "ham");
 
 	/* Check that the return value and GError agree. */
 	if (exit_code != BOGOFILTER_EXIT_STATUS_ERROR)
@@ -486,39 +521,49 @@ bogofilter_learn_junk (CamelJunkFilter *junk_filter,
 	return (exit_code != BOGOFILTER_EXIT_STATUS_ERROR);
 }
 
+static gboolean
+bogofilter_learn_junk (CamelJunkFilter *junk_filter,
+                       CamelMimeMessage *message,
+                       GCancellable *cancellable,
+                       GError **error)
+{
+	/* Learnt in bulk, latest in bogofilter_synchronize() */
+	return e_mail_junk_filter_queue_learn_sync (
+		E_MAIL_JUNK_FILTER (junk_filter),
+		message, TRUE, cancellable, error);
+}
+
 static gboolean
 bogofilter_learn_not_junk (CamelJunkFilter *junk_filter,
                            CamelMimeMessage *message,
                            GCancellable *cancellable,
                            GError **error)
 {
-	EBogofilter *extension = E_BOGOFILTER (junk_filter);
-	gint exit_code;
-
-	const gchar *argv[] = {
-		bogofilter_get_command_path (extension),
-		"--register-ham",
-		NULL,  /* leave room for unicode option */
-		NULL
-	};
-
-	if (bogofilter_get_convert_to_unicode (extension))
-		argv[2] = "--unicode=yes";
-
-	exit_code = bogofilter_command (argv, message, cancellable, error);
-
-	if (exit_code != 0)
-		g_warning (
-			"Bogofilter: Unexpected exit code (%d) "
-			"while registering ham", exit_code);
+	/* Learnt in bulk, latest in bogofilter_synchronize() */
+	return e_mail_junk_filter_queue_learn_sync (
+		E_MAIL_JUNK_FILTER (junk_filter),
+		message, FALSE, cancellable, error);
+}
 
-	/* Check that the return value and GError agree. */
-	if (exit_code != BOGOFILTER_EXIT_STATUS_ERROR)
-		g_warn_if_fail (error == NULL || *error == NULL);
-	else
-		g_warn_if_fail (error == NULL || *error != NULL);
+static gboolean
+bogofilter_synchronize (CamelJunkFilter *junk_filter,
+                        GCancellable *cancellable,
+                        GError **error)
+{
+	return e_mail_junk_filter_flush_learn_sync (
+		E_MAIL_JUNK_FILTER (junk_filter), cancellable, error);
+}
 
-	return (exit_code != BOGOFILTER_EXIT_STATUS_ERROR);
+static gboolean
+bogofilter_learn_messages_sync (EMailJunkFilter *junk_filter,
+                                GPtrArray *messages,
+                                gboolean is_junk,
+                                GCancellable *cancellable,
+                                GError **error)
+{
+	return bogofilter_learn (
+		E_BOGOFILTER (junk_filter),
+		messages, is_junk, cancellable, error);
 }
 
 static void
@@ -537,6 +582,7 @@ e_bogofilter_class_init (EBogofilterClass *class)
 	junk_filter_class->display_name = _("Bogofilter");
 	junk_filter_class->available = bogofilter_available;
 	junk_filter_class->new_config_widget = bogofilter_new_config_widget;
+	junk_filter_class->learn_messages_sync = bogofilter_learn_messages_sync;
 
 	g_object_class_install_property (
 		object_class,
@@ -570,6 +616,7 @@ e_bogofilter_interface_init (CamelJunkFilterInterface *iface)
 	iface->classify = bogofilter_classify;
 	iface->learn_junk = bogofilter_learn_junk;
 	iface->learn_not_junk = bogofilter_learn_not_junk;
+	iface->synchronize = bogofilter_synchronize;
 }
 
 static void
@@ -20,6 +20,7 @@
 #include "e-autosave-utils.h"
 
 #include <errno.h>
+#include <string.h>
 #include <glib/gstdio.h>
 #include <camel/camel.h>
 
@@ -29,8 +30,18 @@
 #define SNAPSHOT_FILE_PREFIX	".evolution-composer.autosave"
 #define SNAPSHOT_FILE_SEED	SNAPSHOT_FILE_PREFIX "-XXXXXX"
 
+/* Attachment contents are stored once, named by their SHA-256 checksum,
+ * in a directory of their snapshot file's name under SNAPSHOT_PARTS_DIR.
+ * The snapshot file itself keeps only the message headers, the body and
+ * the attachments' MIME headers, with SNAPSHOT_PART_HEADER referencing
+ * the stored content. */
+#define SNAPSHOT_PARTS_KEY	"e-composer-snapshot-parts"
+#define SNAPSHOT_PARTS_DIR	".evolution-composer-parts"
+#define SNAPSHOT_PART_HEADER	"X-Evolution-Autosave-Part"
+
 typedef struct _LoadContext LoadContext;
 typedef struct _SaveContext SaveContext;
+typedef struct _SnapshotParts SnapshotParts;
 
 struct _LoadContext {
 	EMsgComposer *composer;
@@ -39,8 +50,123 @@ struct _LoadContext {
 struct _SaveContext {
 	GCancellable *cancellable;
 	GFile *snapshot_file;
+	SnapshotParts *parts;
+};
+
+/* Per-composer state of the stored attachment contents. The lock is held
+ * for the whole snapshot write, thus a cancelled snapshot which is still
+ * running cannot prune the parts a newer one has just stored. */
+struct _SnapshotParts {
+	volatile gint ref_count;
+	GMutex lock;
+	GHashTable *checksums; /* CamelDataWrapper * ~> gchar *checksum */
 };
 
+static SnapshotParts *
+snapshot_parts_ref (SnapshotParts *parts)
+{
+	g_atomic_int_inc (&parts->ref_count);
+
+	return parts;
+}
+
+static void
+snapshot_parts_unref (SnapshotParts *parts)
+{
+	if (parts && g_atomic_int_dec_and_test (&parts->ref_count)) {
+		g_hash_table_destroy (parts->checksums);
+		g_mutex_clear (&parts->lock);
+		g_slice_free (SnapshotParts, parts);
+	}
+}
+
+static SnapshotParts *
+snapshot_parts_get (EMsgComposer *composer)
+{
+	SnapshotParts *parts;
+
+	parts = g_object_get_data (G_OBJECT (composer), SNAPSHOT_PARTS_KEY);
+
+	if (!parts) {
+		parts = g_slice_new0 (SnapshotParts);
+		parts->ref_count = 1;
+		g_mutex_init (&parts->lock);
+		parts->checksums = g_hash_table_new_full (
+			g_direct_hash, g_direct_equal,
+			g_object_unref, g_free);
+
+		g_object_set_data_full (
+			G_OBJECT (composer), SNAPSHOT_PARTS_KEY, parts,
+			(GDestroyNotify) snapshot_parts_unref);
+	}
+
+	return parts;
+}
+
+static GFile *
+snapshot_get_parts_dir (GFile *snapshot_file)
+{
+	GFile *parent, *parts_root, *parts_dir;
+	gchar *basename;
+
+	parent = g_file_get_parent (snapshot_file);
+	parts_root = g_file_get_child (parent, SNAPSHOT_PARTS_DIR);
+	basename = g_file_get_basename (snapshot_file);
+	parts_dir = g_file_get_child (parts_root, basename);
+
+	g_object_unref (parent);
+	g_object_unref (parts_root);
+	g_free (basename);
+
+	return parts_dir;
+}
+
+/* Deletes the files in the directory which are not in the keep set,
+ * or all of them when it is NULL. Failures are silently ignored. */
+static void
+snapshot_delete_dir_files (GFile *directory,
+                           GHashTable *keep)
+{
+	GFileEnumerator *enumerator;
+	GFileInfo *info;
+
+	enumerator = g_file_enumerate_children (
+		directory, G_FILE_ATTRIBUTE_STANDARD_NAME,
+		G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+
+	if (!enumerator)
+		return;
+
+	while ((info = g_file_enumerator_next_file (enumerator, NULL, NULL)) != NULL) {
+		const gchar *name = g_file_info_get_name (info);
+
+		if (!keep || !g_hash_table_contains (keep, name)) {
+			GFile *child;
+
+			child = g_file_get_child (directory, name);
+			g_file_delete (child, NULL, NULL);
+			g_object_unref (child);
+		}
+
+		g_object_unref (info);
+	}
+
+	g_object_unref (enumerator);
+}
+
+static void
+snapshot_delete_parts (GFile *snapshot_file)
+{
+	GFile *parts_dir;
+
+	parts_dir = snapshot_get_parts_dir (snapshot_file);
+
+	snapshot_delete_dir_files (parts_dir, NULL);
+	g_file_delete (parts_dir, NULL, NULL);
+
+	g_object_unref (parts_dir);
+}
+
 static void
 load_context_free (LoadContext *context)
 {
@@ -55,6 +181,7 @@ save_context_free (SaveContext *context)
 {
 	g_clear_object (&context->cancellable);
 	g_clear_object (&context->snapshot_file);
+	g_clear_pointer (&context->parts, snapshot_parts_unref);
 
 	g_slice_free (SaveContext, context);
 }
@@ -62,7 +189,7 @@ save_context_free (SaveContext *context)
 static void
 delete_snapshot_file (GFile *snapshot_file)
 {
-	g_file_delete (snapshot_file, NULL, NULL);
+	e_composer_delete_snapshot (snapshot_file);
 	g_object_unref (snapshot_file);
 }
 
@@ -148,69 +275,154 @@ autosave_composer_created_cb (GObject *source_object,
 	g_slice_free (CreateComposerData, ccd);
 }
 
+static gboolean
+snapshot_checksum_is_valid (const gchar *checksum)
+{
+	/* It becomes a file name, thus be strict about it. */
+	return checksum && *checksum &&
+		strspn (checksum, "0123456789abcdef") == strlen (checksum);
+}
+
+/* Puts the stored attachment contents back into their placeholder parts. */
 static void
-load_snapshot_loaded_cb (GFile *snapshot_file,
-                         GAsyncResult *result,
-                         GSimpleAsyncResult *simple)
+snapshot_restore_parts (CamelMimeMessage *message,
+                        GFile *snapshot_file,
+                        GCancellable *cancellable)
+{
+	CamelDataWrapper *content;
+	CamelMultipart *multipart;
+	GFile *parts_dir;
+	guint ii, n_parts;
+
+	content = camel_medium_get_content (CAMEL_MEDIUM (message));
+	if (!CAMEL_IS_MULTIPART (content))
+		return;
+
+	multipart = CAMEL_MULTIPART (content);
+	n_parts = camel_multipart_get_number (multipart);
+	parts_dir = snapshot_get_parts_dir (snapshot_file);
+
+	for (ii = 0; ii < n_parts; ii++) {
+		CamelMimePart *part;
+		CamelDataWrapper *part_content;
+		CamelStream *camel_stream;
+		const gchar *checksum;
+		gchar *contents = NULL;
+		gsize length = 0;
+		GFile *file;
+		GError *local_error = NULL;
+
+		part = camel_multipart_get_part (multipart, ii);
+		checksum = camel_medium_get_header (CAMEL_MEDIUM (part), SNAPSHOT_PART_HEADER);
+
+		if (!checksum)
+			continue;
+
+		if (!snapshot_checksum_is_valid (checksum)) {
+			camel_medium_remove_header (CAMEL_MEDIUM (part), SNAPSHOT_PART_HEADER);
+			continue;
+		}
+
+		file = g_file_get_child (parts_dir, checksum);
+
+		if (!g_file_load_contents (file, cancellable, &contents, &length, NULL, &local_error)) {
+			/* Recover at least the rest of the message. */
+			g_warning ("%s: %s", G_STRFUNC, local_error ? local_error->message : "Unknown error");
+			g_clear_error (&local_error);
+		} else {
+			part_content = camel_data_wrapper_new ();
+			camel_stream = camel_stream_mem_new_with_buffer (contents, length);
+			camel_data_wrapper_construct_from_stream_sync (
+				part_content, camel_stream, NULL, NULL);
+			camel_data_wrapper_set_mime_type_field (
+				part_content, camel_mime_part_get_content_type (part));
+			camel_medium_set_content (CAMEL_MEDIUM (part), part_content);
+			g_object_unref (camel_stream);
+			g_object_unref (part_content);
+			g_free (contents);
+		}
+
+		camel_medium_remove_header (CAMEL_MEDIUM (part), SNAPSHOT_PART_HEADER);
+
+		g_object_unref (file);
+	}
+
+	g_object_unref (parts_dir);
+}
+
+static void
+load_snapshot_thread (GTask *task,
+                      gpointer source_object,
+                      gpointer task_data,
+                      GCancellable *cancellable)
 {
-	EShell *shell;
-	GObject *object;
-	LoadContext *context;
 	CamelMimeMessage *message;
 	CamelStream *camel_stream;
+	GFile *snapshot_file;
 	gchar *contents = NULL;
 	gsize length;
-	CreateComposerData *ccd;
 	GError *local_error = NULL;
 
-	context = g_simple_async_result_get_op_res_gpointer (simple);
-
-	g_file_load_contents_finish (
-		snapshot_file, result, &contents, &length, NULL, &local_error);
+	snapshot_file = task_data;
 
-	if (local_error != NULL) {
+	if (!g_file_load_contents (snapshot_file, cancellable, &contents, &length, NULL, &local_error)) {
 		g_warn_if_fail (contents == NULL);
-		g_simple_async_result_take_error (simple, local_error);
-		g_simple_async_result_complete (simple);
-		g_object_unref (simple);
+		g_task_return_error (task, local_error);
 		return;
 	}
 
-	/* Create an in-memory buffer for the MIME parser to read from.
-	 * We have to do this because CamelStreams are syncrhonous-only,
-	 * and feeding the parser a direct file stream would block. */
+	/* Create an in-memory buffer for the MIME parser to read from. */
 	message = camel_mime_message_new ();
 	camel_stream = camel_stream_mem_new_with_buffer (contents, length);
 	camel_data_wrapper_construct_from_stream_sync (
-		CAMEL_DATA_WRAPPER (message), camel_stream, NULL, &local_error);
+		CAMEL_DATA_WRAPPER (message), camel_stream, cancellable, &local_error);
 	g_object_unref (camel_stream);
 	g_free (contents);
 
 	if (local_error != NULL) {
+		g_task_return_error (task, local_error);
+		g_object_unref (message);
+		return;
+	}
+
+	snapshot_restore_parts (message, snapshot_file, cancellable);
+
+	g_task_return_pointer (task, message, g_object_unref);
+}
+
+static void
+load_snapshot_loaded_cb (GObject *source_object,
+                         GAsyncResult *result,
+                         gpointer user_data)
+{
+	GSimpleAsyncResult *simple = user_data;
+	LoadContext *context;
+	CamelMimeMessage *message;
+	CreateComposerData *ccd;
+	GError *local_error = NULL;
+
+	context = g_simple_async_result_get_op_res_gpointer (simple);
+
+	message = g_task_propagate_pointer (G_TASK (result), &local_error);
+
+	if (local_error != NULL) {
+		g_warn_if_fail (message == NULL);
 		g_simple_async_result_take_error (simple, local_error);
 		g_simple_async_result_complete (simple);
-		g_object_unref (message);
 		g_object_unref (simple);
 		return;
 	}
 
-	/* g_async_result_get_source_object() returns a new reference. */
-	object = g_async_result_get_source_object (G_ASYNC_RESULT (simple));
-
 	/* Create a new composer window from the loaded message and
 	 * restore its snapshot file so it continues auto-saving to
 	 * the same file. */
-	shell = E_SHELL (object);
-
 	ccd = g_slice_new0 (CreateComposerData);
 	ccd->simple = simple;
 	ccd->context = context;
 	ccd->message = message;
-	ccd->snapshot_file = g_object_ref (snapshot_file);
-
-	e_msg_composer_new (shell, autosave_composer_created_cb, ccd);
+	ccd->snapshot_file = g_object_ref (g_task_get_task_data (G_TASK (result)));
 
-	g_object_unref (object);
+	e_msg_composer_new (E_SHELL (source_object), autosave_composer_created_cb, ccd);
 }
 
 static void
@@ -232,31 +444,226 @@ save_snapshot_splice_cb (CamelDataWrapper *data_wrapper,
 	g_object_unref (simple);
 }
 
+/* Returns the checksum of the content, storing it in the parts
+ * directory first if it is not there yet. Contents seen by previous
+ * snapshots are not decoded again. */
+static gchar *
+snapshot_store_part (SnapshotParts *parts,
+                     CamelDataWrapper *content,
+                     GFile *parts_dir,
+                     GCancellable *cancellable,
+                     GError **error)
+{
+	GOutputStream *output_stream;
+	GFile *file;
+	gchar *checksum, *path;
+	gconstpointer data;
+	gsize size;
+	gboolean success = TRUE;
+
+	checksum = g_strdup (g_hash_table_lookup (parts->checksums, content));
+
+	if (checksum) {
+		file = g_file_get_child (parts_dir, checksum);
+
+		if (g_file_query_exists (file, cancellable)) {
+			g_object_unref (file);
+			return checksum;
+		}
+
+		g_object_unref (file);
+		g_clear_pointer (&checksum, g_free);
+	}
+
+	output_stream = g_memory_output_stream_new_resizable ();
+
+	if (camel_data_wrapper_decode_to_output_stream_sync (content, output_stream, cancellable, error) < 0 ||
+	    !g_output_stream_close (output_stream, cancellable, error)) {
+		g_object_unref (output_stream);
+		return NULL;
+	}
+
+	data = g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (output_stream));
+	size = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (output_stream));
+
+	checksum = g_compute_checksum_for_data (G_CHECKSUM_SHA256, data, size);
+
+	path = g_file_get_path (parts_dir);
+
+	errno = 0;
+	if (g_mkdir_with_parents (path, 0700) == -1) {
+		g_set_error (
+			error, G_FILE_ERROR,
+			g_file_error_from_errno (errno),
+			"%s", g_strerror (errno));
+		success = FALSE;
+	}
+
+	g_free (path);
+
+	file = g_file_get_child (parts_dir, checksum);
+
+	if (success && !g_file_query_exists (file, cancellable))
+		success = g_file_replace_contents (
+			file, data, size, NULL, FALSE,
+			G_FILE_CREATE_PRIVATE, NULL, cancellable, error);
+
+	g_object_unref (file);
+	g_object_unref (output_stream);
+
+	if (!success) {
+		g_free (checksum);
+		return NULL;
+	}
+
+	g_hash_table_insert (parts->checksums, g_object_ref (content), g_strdup (checksum));
+
+	return checksum;
+}
+
+/* A copy of the attachment part with its headers, but no content. */
+static CamelMimePart *
+snapshot_new_placeholder_part (CamelMimePart *part,
+                               const gchar *checksum)
+{
+	CamelMimePart *placeholder;
+	CamelDataWrapper *content;
+	const CamelNameValueArray *headers;
+	guint ii, length;
+
+	placeholder = camel_mime_part_new ();
+
+	content = camel_data_wrapper_new ();
+	camel_data_wrapper_set_mime_type_field (
+		content, camel_mime_part_get_content_type (part));
+	camel_medium_set_content (CAMEL_MEDIUM (placeholder), content);
+	g_object_unref (content);
+
+	headers = camel_medium_get_headers (CAMEL_MEDIUM (part));
+	length = camel_name_value_array_get_length (headers);
+
+	for (ii = 0; ii < length; ii++) {
+		const gchar *header_name = NULL, *header_value = NULL;
+
+		if (!camel_name_value_array_get (headers, ii, &header_name, &header_value) ||
+		    !header_name || g_ascii_strcasecmp (header_name, "Content-Type") == 0)
+			continue;
+
+		camel_medium_add_header (CAMEL_MEDIUM (placeholder), header_name, header_value);
+	}
+
+	camel_medium_set_header (CAMEL_MEDIUM (placeholder), SNAPSHOT_PART_HEADER, checksum);
+
+	return placeholder;
+}
+
+/* The composer puts attachments into a top-level multipart/mixed after
+ * the body. Their contents are stored separately and replaced with
+ * placeholders in the message; the checksums are added to the used set.
+ * Attached messages and multiparts are left in the message. */
+static gboolean
+snapshot_store_parts (CamelMimeMessage *message,
+                      SnapshotParts *parts,
+                      GFile *parts_dir,
+                      GHashTable *used,
+                      GCancellable *cancellable,
+                      GError **error)
+{
+	CamelDataWrapper *content;
+	CamelMultipart *multipart, *snapshot_multipart;
+	guint ii, n_parts;
+
+	content = camel_medium_get_content (CAMEL_MEDIUM (message));
+
+	if (!CAMEL_IS_MULTIPART (content) ||
+	    !camel_content_type_is (camel_data_wrapper_get_mime_type_field (content), "multipart", "mixed"))
+		return TRUE;
+
+	multipart = CAMEL_MULTIPART (content);
+	n_parts = camel_multipart_get_number (multipart);
+
+	if (n_parts < 2)
+		return TRUE;
+
+	snapshot_multipart = camel_multipart_new ();
+	camel_data_wrapper_set_mime_type_field (
+		CAMEL_DATA_WRAPPER (snapshot_multipart),
+		camel_data_wrapper_get_mime_type_field (content));
+
+	for (ii = 0; ii < n_parts; ii++) {
+		CamelMimePart *part;
+		CamelDataWrapper *part_content;
+		gchar *checksum;
+
+		part = camel_multipart_get_part (multipart, ii);
+		part_content = camel_medium_get_content (CAMEL_MEDIUM (part));
+
+		if (ii == 0 || !part_content ||
+		    CAMEL_IS_MULTIPART (part_content) ||
+		    CAMEL_IS_MEDIUM (part_content)) {
+			camel_multipart_add_part (snapshot_multipart, part);
+			continue;
+		}
+
+		checksum = snapshot_store_part (parts, part_content, parts_dir, cancellable, error);
+
+		if (!checksum) {
+			g_object_unref (snapshot_multipart);
+			return FALSE;
+		}
+
+		part = snapshot_new_placeholder_part (part, checksum);
+		camel_multipart_add_part (snapshot_multipart, part);
+		g_object_unref (part);
+
+		g_hash_table_add (used, checksum);
+	}
+
+	camel_medium_set_content (CAMEL_MEDIUM (message), CAMEL_DATA_WRAPPER (snapshot_multipart));
+	g_object_unref (snapshot_multipart);
+
+	return TRUE;
+}
+
+static gboolean
+snapshot_checksum_unused_cb (gpointer key,
+                             gpointer value,
+                             gpointer user_data)
+{
+	return !g_hash_table_contains (user_data, value);
+}
+
 static void
 write_message_to_stream_thread (GTask *task,
 				gpointer source_object,
 				gpointer task_data,
 				GCancellable *cancellable)
 {
+	SaveContext *context;
 	GFileOutputStream *file_output_stream;
 	GOutputStream *output_stream;
-	GFile *snapshot_file;
-	gssize bytes_written;
+	GFile *parts_dir;
+	GHashTable *used;
+	gssize bytes_written = 0;
 	GError *local_error = NULL;
 
-	snapshot_file = task_data;
+	context = task_data;
 
-	file_output_stream = g_file_replace (snapshot_file, NULL, FALSE,
-		G_FILE_CREATE_PRIVATE, cancellable, &local_error);
+	g_mutex_lock (&context->parts->lock);
 
-	if (!file_output_stream) {
-		if (local_error)
-			g_task_return_error (task, local_error);
-		else
-			g_task_return_int (task, 0);
+	parts_dir = snapshot_get_parts_dir (context->snapshot_file);
+	used = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 
-		return;
-	}
+	/* The attachments go first, the snapshot references them. */
+	if (!snapshot_store_parts (CAMEL_MIME_MESSAGE (source_object), context->parts,
+	    parts_dir, used, cancellable, &local_error))
+		goto exit;
+
+	file_output_stream = g_file_replace (context->snapshot_file, NULL, FALSE,
+		G_FILE_CREATE_PRIVATE, cancellable, &local_error);
+
+	if (!file_output_stream)
+		goto exit;
 
 	output_stream = G_OUTPUT_STREAM (file_output_stream);
 
@@ -268,6 +675,18 @@ write_message_to_stream_thread (GTask *task,
 
 	g_object_unref (file_output_stream);
 
+	/* Forget attachments which are gone since the last snapshot. */
+	if (local_error == NULL) {
+		g_hash_table_foreach_remove (context->parts->checksums, snapshot_checksum_unused_cb, used);
+		snapshot_delete_dir_files (parts_dir, used);
+	}
+
+exit:
+	g_mutex_unlock (&context->parts->lock);
+
+	g_hash_table_destroy (used);
+	g_object_unref (parts_dir);
+
 	if (local_error != NULL) {
 		g_task_return_error (task, local_error);
 	} else {
@@ -302,7 +721,9 @@ save_snapshot_get_message_cb (EMsgComposer *composer,
 
 	task = g_task_new (message, context->cancellable, (GAsyncReadyCallback) save_snapshot_splice_cb, simple);
 
-	g_task_set_task_data (task, g_object_ref (context->snapshot_file), g_object_unref);
+	/* The context lives until the task finishes,
+	 * the async result holding it is its callback data. */
+	g_task_set_task_data (task, context, NULL);
 
 	g_task_run_in_thread (task, write_message_to_stream_thread);
 
@@ -340,6 +761,43 @@ composer_registry_lookup (GQueue *registry,
 	return NULL;
 }
 
+/* Removes attachment contents left behind by snapshot
+ * files which were deleted without their parts. */
+static void
+composer_delete_stale_parts (const gchar *dirname)
+{
+	GDir *dir;
+	const gchar *basename;
+	gchar *parts_root;
+
+	parts_root = g_build_filename (dirname, SNAPSHOT_PARTS_DIR, NULL);
+
+	dir = g_dir_open (parts_root, 0, NULL);
+	if (dir == NULL) {
+		g_free (parts_root);
+		return;
+	}
+
+	while ((basename = g_dir_read_name (dir)) != NULL) {
+		gchar *filename;
+
+		filename = g_build_filename (dirname, basename, NULL);
+
+		if (!g_file_test (filename, G_FILE_TEST_EXISTS)) {
+			GFile *snapshot_file;
+
+			snapshot_file = g_file_new_for_path (filename);
+			snapshot_delete_parts (snapshot_file);
+			g_object_unref (snapshot_file);
+		}
+
+		g_free (filename);
+	}
+
+	g_dir_close (dir);
+	g_free (parts_root);
+}
+
 GList *
 e_composer_find_orphans (GQueue *registry,
                          GError **error)
@@ -385,11 +843,18 @@ e_composer_find_orphans (GQueue *registry,
 		/* If the file is empty, delete it.  Failure here
 		 * is non-fatal; just emit a warning and move on. */
 		if (st.st_size == 0) {
+			GFile *snapshot_file;
+
 			errno = 0;
 			if (g_unlink (filename) < 0) {
 				errmsg = g_strerror (errno);
 				g_warning ("%s: %s", filename, errmsg);
 			}
+
+			snapshot_file = g_file_new_for_path (filename);
+			snapshot_delete_parts (snapshot_file);
+			g_object_unref (snapshot_file);
+
 			g_free (filename);
 			continue;
 		}
@@ -402,6 +867,8 @@ e_composer_find_orphans (GQueue *registry,
 
 	g_dir_close (dir);
 
+	composer_delete_stale_parts (dirname);
+
 	return g_list_reverse (orphans);
 }
 
@@ -414,6 +881,7 @@ e_composer_load_snapshot (EShell *shell,
 {
 	GSimpleAsyncResult *simple;
 	LoadContext *context;
+	GTask *task;
 
 	g_return_if_fail (E_IS_SHELL (shell));
 	g_return_if_fail (G_IS_FILE (snapshot_file));
@@ -429,9 +897,13 @@ e_composer_load_snapshot (EShell *shell,
 	g_simple_async_result_set_op_res_gpointer (
 		simple, context, (GDestroyNotify) load_context_free);
 
-	g_file_load_contents_async (
-		snapshot_file, cancellable, (GAsyncReadyCallback)
-		load_snapshot_loaded_cb, simple);
+	task = g_task_new (shell, cancellable, load_snapshot_loaded_cb, simple);
+
+	g_task_set_task_data (task, g_object_ref (snapshot_file), g_object_unref);
+
+	g_task_run_in_thread (task, load_snapshot_thread);
+
+	g_object_unref (task);
 }
 
 EMsgComposer *
@@ -501,6 +973,7 @@ e_composer_save_snapshot (EMsgComposer *composer,
 	g_return_if_fail (G_IS_FILE (snapshot_file));
 
 	context->snapshot_file = g_object_ref (snapshot_file);
+	context->parts = snapshot_parts_ref (snapshot_parts_get (composer));
 
 	e_msg_composer_get_message_draft (
 		composer, G_PRIORITY_DEFAULT,
@@ -561,3 +1034,12 @@ e_composer_allow_snapshot_file_delete (EMsgComposer *composer)
 			snapshot_file, (GDestroyNotify) delete_snapshot_file);
 	}
 }
+
+void
+e_composer_delete_snapshot (GFile *snapshot_file)
+{
+	g_return_if_fail (G_IS_FILE (snapshot_file));
+
+	g_file_delete (snapshot_file, NULL, NULL);
+	snapshot_delete_parts (snapshot_file);
+}
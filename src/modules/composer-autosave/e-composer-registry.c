@@ -112,7 +112,7 @@ composer_registry_restore_orphans (EComposerRegistry *registry,
 				composer_registry_recovered_cb,
 				g_object_ref (registry));
 		else
-			g_file_delete (file, NULL, NULL);
+			e_composer_delete_snapshot (file);
 
 		g_object_unref (file);
 
@@ -141,6 +141,7 @@ spam_assassin_exited_cb (GPid *pid,
 static gint
 spam_assassin_command_full (const gchar **argv,
                             CamelMimeMessage *message,
+                            GPtrArray *messages,
                             const gchar *input_data,
                             GByteArray *output_buffer,
                             gboolean wait_for_termination,
@@ -192,16 +193,19 @@ spam_assassin_command_full (const gchar **argv,
 		return SPAM_ASSASSIN_EXIT_STATUS_ERROR;
 	}
 
-	if (message != NULL) {
+	if (message != NULL || messages != NULL) {
 		CamelStream *stream;
-		gssize bytes_written;
 
-		/* Stream the CamelMimeMessage to SpamAssassin. */
+		/* Stream the CamelMimeMessage(s) to SpamAssassin. */
 		stream = camel_stream_fs_new_with_fd (standard_input);
-		bytes_written = camel_data_wrapper_write_to_stream_sync (
-			CAMEL_DATA_WRAPPER (message),
-			stream, cancellable, error);
-		success = (bytes_written >= 0) &&
+		if (messages != NULL)
+			success = e_mail_junk_filter_write_mbox_sync (
+				messages, stream, cancellable, error);
+		else
+			success = camel_data_wrapper_write_to_stream_sync (
+				CAMEL_DATA_WRAPPER (message),
+				stream, cancellable, error) >= 0;
+		success = success &&
 			(camel_stream_close (stream, cancellable, error) == 0);
 		g_object_unref (stream);
 
@@ -324,7 +328,7 @@ spam_assassin_command (const gchar **argv,
                        GError **error)
 {
 	return spam_assassin_command_full (
-		argv, message, input_data, NULL, TRUE, cancellable, error);
+		argv, message, NULL, input_data, NULL, TRUE, cancellable, error);
 }
 
 static gboolean
@@ -481,7 +485,7 @@ spam_assassin_get_version (ESpamAssassin *extension,
 	output_buffer = g_byte_array_new ();
 
 	exit_code = spam_assassin_command_full (
-		argv, NULL, NULL, output_buffer, TRUE, cancellable, error);
+		argv, NULL, NULL, NULL, output_buffer, TRUE, cancellable, error);
 
 	if (exit_code != 0) {
 		g_byte_array_free (output_buffer, TRUE);
@@ -622,13 +626,13 @@ spam_assassin_classify (CamelJunkFilter *junk_filter,
 }
 
 static gboolean
-spam_assassin_learn_junk (CamelJunkFilter *junk_filter,
-                          CamelMimeMessage *message,
-                          GCancellable *cancellable,
-                          GError **error)
+spam_assassin_learn (ESpamAssassin *extension,
+                     GPtrArray *messages,
+                     gboolean is_junk,
+                     GCancellable *cancellable,
+                     GError **error)
 {
-	ESpamAssassin *extension = E_SPAM_ASSASSIN (junk_filter);
-	const gchar *argv[5];
+	const gchar *argv[6];
 	gint exit_code;
 	gint ii = 0;
 
@@ -636,16 +640,23 @@ spam_assassin_learn_junk (CamelJunkFilter *junk_filter,
 		return FALSE;
 
 	argv[ii++] = spam_assassin_get_learn_command_path (extension);
-	argv[ii++] = "--spam";
+	argv[ii++] = is_junk ? "--spam" : "--ham";
 	argv[ii++] = "--no-sync";
+	if (messages->len > 1)
+		argv[ii++] = "--mbox";
 	if (extension->local_only)
 		argv[ii++] = "--local";
 	argv[ii] = NULL;
 
 	g_return_val_if_fail (ii < G_N_ELEMENTS (argv), FALSE);
 
-	exit_code = spam_assassin_command (
-		argv, message, NULL, cancellable, error);
+	/* Learn all the messages with a single process in mbox mode */
+	if (messages->len == 1)
+		exit_code = spam_assassin_command (
+			argv, messages->pdata[0], NULL, cancellable, error);
+	else
+		exit_code = spam_assassin_command_full (
+			argv, NULL, messages, NULL, NULL, TRUE, cancellable, error);
 
 	/* Check that the return value and GError agree. */
 	if (exit_code == SPAM_ASSASSIN_EXIT_STATUS_SUCCESS)
@@ -656,39 +667,28 @@ spam_assassin_learn_junk (CamelJunkFilter *junk_filter,
 	return (exit_code == SPAM_ASSASSIN_EXIT_STATUS_SUCCESS);
 }
 
+static gboolean
+spam_assassin_learn_junk (CamelJunkFilter *junk_filter,
+                          CamelMimeMessage *message,
+                          GCancellable *cancellable,
+                          GError **error)
+{
+	/* Learnt in bulk, latest in spam_assassin_synchronize() */
+	return e_mail_junk_filter_queue_learn_sync (
+		E_MAIL_JUNK_FILTER (junk_filter),
+		message, TRUE, cancellable, error);
+}
+
 static gboolean
 spam_assassin_learn_not_junk (CamelJunkFilter *junk_filter,
                               CamelMimeMessage *message,
                               GCancellable *cancellable,
                               GError **error)
 {
-	ESpamAssassin *extension = E_SPAM_ASSASSIN (junk_filter);
-	const gchar *argv[5];
-	gint exit_code;
-	gint ii = 0;
-
-	if (g_cancellable_set_error_if_cancelled (cancellable, error))
-		return FALSE;
-
-	argv[ii++] = spam_assassin_get_learn_command_path (extension);
-	argv[ii++] = "--ham";
-	argv[ii++] = "--no-sync";
-	if (extension->local_only)
-		argv[ii++] = "--local";
-	argv[ii] = NULL;
-
-	g_return_val_if_fail (ii < G_N_ELEMENTS (argv), FALSE);
-
-	exit_code = spam_assassin_command (
-		argv, message, NULL, cancellable, error);
-
-	/* Check that the return value and GError agree. */
-	if (exit_code == SPAM_ASSASSIN_EXIT_STATUS_SUCCESS)
-		g_warn_if_fail (error == NULL || *error == NULL);
-	else
-		g_warn_if_fail (error == NULL || *error != NULL);
-
-	return (exit_code == SPAM_ASSASSIN_EXIT_STATUS_SUCCESS);
+	/* Learnt in bulk, latest in spam_assassin_synchronize() */
+	return e_mail_junk_filter_queue_learn_sync (
+		E_MAIL_JUNK_FILTER (junk_filter),
+		message, FALSE, cancellable, error);
 }
 
 static gboolean
@@ -704,6 +704,9 @@ spam_assassin_synchronize (CamelJunkFilter *junk_filter,
 	if (g_cancellable_set_error_if_cancelled (cancellable, error))
 		return FALSE;
 
+	if (!e_mail_junk_filter_flush_learn_sync (E_MAIL_JUNK_FILTER (extension), cancellable, error))
+		return FALSE;
+
 	argv[ii++] = spam_assassin_get_learn_command_path (extension);
 	argv[ii++] = "--sync";
 	if (extension->local_only)
@@ -724,6 +727,18 @@ spam_assassin_synchronize (CamelJunkFilter *junk_filter,
 	return (exit_code == SPAM_ASSASSIN_EXIT_STATUS_SUCCESS);
 }
 
+static gboolean
+spam_assassin_learn_messages_sync (EMailJunkFilter *junk_filter,
+                                   GPtrArray *messages,
+                                   gboolean is_junk,
+                                   GCancellable *cancellable,
+                                   GError **error)
+{
+	return spam_assassin_learn (
+		E_SPAM_ASSASSIN (junk_filter),
+		messages, is_junk, cancellable, error);
+}
+
 static void
 e_spam_assassin_class_init (ESpamAssassinClass *class)
 {
@@ -740,6 +755,7 @@ e_spam_assassin_class_init (ESpamAssassinClass *class)
 	junk_filter_class->display_name = _("SpamAssassin");
 	junk_filter_class->available = spam_assassin_available;
 	junk_filter_class->new_config_widget = spam_assassin_new_config_widget;
+	junk_filter_class->learn_messages_sync = spam_assassin_learn_messages_sync;
 
 	g_object_class_install_property (
 		object_class,
@@ -19,6 +19,7 @@
 
 #include "e-mail-formatter-text-highlight.h"
 #include "languages.h"
+#include "tokenizer.h"
 
 #include <em-format/e-mail-formatter-extension.h>
 #include <em-format/e-mail-formatter.h>
@@ -40,13 +41,31 @@ typedef EExtensionClass EMailFormatterTextHighlightLoaderClass;
 typedef struct _TextHighlightClosure TextHighlightClosure;
 
 struct _TextHighlightClosure {
-	gboolean wrote_anything;
 	CamelStream *read_stream;
-	GOutputStream *output_stream;
+	GByteArray *output;
 	GCancellable *cancellable;
 	GError *error;
 };
 
+/* The highlighted output is kept for re-renders of the same content,
+ * the key is a checksum of the content with the highlight arguments. */
+#define OUTPUT_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+typedef struct _OutputCacheEntry {
+	gchar *key;
+	GBytes *output;
+} OutputCacheEntry;
+
+G_LOCK_DEFINE_STATIC (output_cache);
+static GHashTable *output_cache = NULL; /* gchar *key ~> GList * in output_cache_lru */
+static GQueue output_cache_lru = G_QUEUE_INIT; /* OutputCacheEntry *, most recent first */
+static gsize output_cache_size = 0;
+
+/* Style sheets printed by the 'highlight' for the tokenizer's output, the key
+ * are the font and style arguments; an empty style sheet means a failure. */
+G_LOCK_DEFINE_STATIC (style_cache);
+static GHashTable *style_cache = NULL; /* gchar *key ~> gchar *style_sheet */
+
 GType e_mail_formatter_text_highlight_get_type (void);
 
 G_DEFINE_DYNAMIC_TYPE (
@@ -130,6 +149,136 @@ get_syntax (EMailPart *part,
 	return syntax;
 }
 
+static void
+output_cache_entry_free (gpointer ptr)
+{
+	OutputCacheEntry *entry = ptr;
+
+	if (entry) {
+		g_free (entry->key);
+		g_bytes_unref (entry->output);
+		g_slice_free (OutputCacheEntry, entry);
+	}
+}
+
+static GBytes *
+output_cache_lookup (const gchar *key)
+{
+	GBytes *output = NULL;
+	GList *link;
+
+	G_LOCK (output_cache);
+
+	link = output_cache ? g_hash_table_lookup (output_cache, key) : NULL;
+	if (link) {
+		OutputCacheEntry *entry = link->data;
+
+		g_queue_unlink (&output_cache_lru, link);
+		g_queue_push_head_link (&output_cache_lru, link);
+
+		output = g_bytes_ref (entry->output);
+	}
+
+	G_UNLOCK (output_cache);
+
+	return output;
+}
+
+static void
+output_cache_insert (const gchar *key,
+                     GBytes *output)
+{
+	OutputCacheEntry *entry;
+	gsize size;
+
+	size = g_bytes_get_size (output);
+
+	/* Do not let a single huge part evict everything else */
+	if (size > OUTPUT_CACHE_MAX_SIZE / 4)
+		return;
+
+	G_LOCK (output_cache);
+
+	if (!output_cache)
+		output_cache = g_hash_table_new (g_str_hash, g_str_equal);
+
+	if (!g_hash_table_contains (output_cache, key)) {
+		entry = g_slice_new (OutputCacheEntry);
+		entry->key = g_strdup (key);
+		entry->output = g_bytes_ref (output);
+
+		g_queue_push_head (&output_cache_lru, entry);
+		g_hash_table_insert (output_cache, entry->key, output_cache_lru.head);
+		output_cache_size += size;
+
+		while (output_cache_size > OUTPUT_CACHE_MAX_SIZE) {
+			entry = g_queue_pop_tail (&output_cache_lru);
+
+			g_hash_table_remove (output_cache, entry->key);
+			output_cache_size -= g_bytes_get_size (entry->output);
+			output_cache_entry_free (entry);
+		}
+	}
+
+	G_UNLOCK (output_cache);
+}
+
+/* Returns the decoded content of the @data_wrapper converted to UTF-8,
+ * which the 'highlight' expects; it can cope with non-UTF-8 letters,
+ * thus no need for a content UTF-8-validation. */
+static GBytes *
+text_highlight_decode_content (CamelDataWrapper *data_wrapper,
+                               GCancellable *cancellable,
+                               GError **error)
+{
+	CamelContentType *content_type;
+	CamelStream *mem_stream, *stream;
+	GByteArray *byte_array;
+
+	byte_array = g_byte_array_new ();
+
+	mem_stream = camel_stream_mem_new ();
+	camel_stream_mem_set_byte_array (CAMEL_STREAM_MEM (mem_stream), byte_array);
+
+	stream = g_object_ref (mem_stream);
+
+	content_type = camel_data_wrapper_get_mime_type_field (data_wrapper);
+	if (content_type) {
+		const gchar *charset = camel_content_type_param (content_type, "charset");
+
+		if (charset && g_ascii_strcasecmp (charset, "utf-8") != 0) {
+			CamelMimeFilter *filter;
+
+			filter = camel_mime_filter_charset_new (charset, "UTF-8");
+			if (filter != NULL) {
+				CamelStream *filtered = camel_stream_filter_new (stream);
+
+				if (filtered) {
+					camel_stream_filter_add (CAMEL_STREAM_FILTER (filtered), filter);
+					g_object_unref (stream);
+					stream = filtered;
+				}
+
+				g_object_unref (filter);
+			}
+		}
+	}
+
+	if (camel_data_wrapper_decode_to_stream_sync (data_wrapper, stream, cancellable, error) < 0 ||
+	    camel_stream_flush (stream, cancellable, error) < 0) {
+		g_object_unref (stream);
+		g_object_unref (mem_stream);
+		g_byte_array_unref (byte_array);
+
+		return NULL;
+	}
+
+	g_object_unref (stream);
+	g_object_unref (mem_stream);
+
+	return g_byte_array_free_to_bytes (byte_array);
+}
+
 static gpointer
 text_hightlight_read_data_thread (gpointer user_data)
 {
@@ -144,17 +293,12 @@ text_hightlight_read_data_thread (gpointer user_data)
 	while (!camel_stream_eos (closure->read_stream) &&
 	       !g_cancellable_set_error_if_cancelled (closure->cancellable, &closure->error)) {
 		gssize read;
-		gsize wrote = 0;
 
 		read = camel_stream_read (closure->read_stream, buffer, nbuffer, closure->cancellable, &closure->error);
 		if (read < 0 || closure->error)
 			break;
 
-		closure->wrote_anything = closure->wrote_anything || read > 0;
-
-		if (!g_output_stream_write_all (closure->output_stream, buffer, read, &wrote, closure->cancellable, &closure->error) ||
-		    (gssize) wrote != read || closure->error)
-			break;
+		g_byte_array_append (closure->output, (const guint8 *) buffer, read);
 	}
 
 	g_free (buffer);
@@ -162,23 +306,30 @@ text_hightlight_read_data_thread (gpointer user_data)
 	return NULL;
 }
 
-static gboolean
-text_highlight_feed_data (GOutputStream *output_stream,
-                          CamelDataWrapper *data_wrapper,
-                          gint pipe_stdin,
-                          gint pipe_stdout,
-                          GCancellable *cancellable,
-                          GError **error)
+/* Runs the 'highlight' over the @content and returns its output,
+ * or %NULL when it failed or produced nothing. */
+static GBytes *
+text_highlight_run (const gchar **argv,
+                    GBytes *content,
+                    GCancellable *cancellable,
+                    GError **error)
 {
 	TextHighlightClosure closure;
-	CamelContentType *content_type;
 	CamelStream *write_stream;
+	gconstpointer data;
+	gsize size;
+	gint pipe_stdin, pipe_stdout;
+	GPid pid;
 	gboolean success = TRUE;
 	GThread *thread;
 
-	closure.wrote_anything = FALSE;
+	if (!g_spawn_async_with_pipes (
+		NULL, (gchar **) argv, NULL, 0, NULL, NULL,
+		&pid, &pipe_stdin, &pipe_stdout, NULL, NULL))
+		return NULL;
+
 	closure.read_stream = camel_stream_fs_new_with_fd (pipe_stdout);
-	closure.output_stream = output_stream;
+	closure.output = g_byte_array_new ();
 	closure.cancellable = cancellable;
 	closure.error = NULL;
 
@@ -186,42 +337,21 @@ text_highlight_feed_data (GOutputStream *output_stream,
 
 	thread = g_thread_new (NULL, text_hightlight_read_data_thread, &closure);
 
-	content_type = camel_data_wrapper_get_mime_type_field (data_wrapper);
-	if (content_type) {
-		const gchar *charset = camel_content_type_param (content_type, "charset");
-
-		/* Convert to UTF-8 charset, if needed, which the 'highlight' expects;
-		   it can cope with non-UTF-8 letters, thus no need for a content UTF-8-validation */
-		if (charset && g_ascii_strcasecmp (charset, "utf-8") != 0) {
-			CamelMimeFilter *filter;
-
-			filter = camel_mime_filter_charset_new (charset, "UTF-8");
-			if (filter != NULL) {
-				CamelStream *filtered = camel_stream_filter_new (write_stream);
+	data = g_bytes_get_data (content, &size);
 
-				if (filtered) {
-					camel_stream_filter_add (CAMEL_STREAM_FILTER (filtered), filter);
-					g_object_unref (write_stream);
-					write_stream = filtered;
-				}
-
-				g_object_unref (filter);
-			}
-		}
-	}
-
-	if (camel_data_wrapper_decode_to_stream_sync (data_wrapper, write_stream, cancellable, error) < 0) {
+	if (size > 0 && camel_stream_write (write_stream, data, size, cancellable, error) < 0) {
 		g_cancellable_cancel (cancellable);
 		success = FALSE;
-	} else {
-		/* Close the stream, thus the highlight knows no more data will come */
-		g_clear_object (&write_stream);
 	}
 
+	/* Close the stream, thus the highlight knows no more data will come */
+	g_clear_object (&write_stream);
+
 	g_thread_join (thread);
 
 	g_clear_object (&closure.read_stream);
-	g_clear_object (&write_stream);
+
+	g_spawn_close_pid (pid);
 
 	if (closure.error) {
 		if (error && !*error)
@@ -229,10 +359,131 @@ text_highlight_feed_data (GOutputStream *output_stream,
 		else
 			g_clear_error (&closure.error);
 
-		return FALSE;
+		success = FALSE;
 	}
 
-	return success && closure.wrote_anything;
+	if (!success || !closure.output->len) {
+		g_byte_array_unref (closure.output);
+		return NULL;
+	}
+
+	return g_byte_array_free_to_bytes (closure.output);
+}
+
+/* Returns the style sheet of the 'highlight' for the given font and style
+ * arguments, or %NULL when it is not available. The 'highlight' is run once
+ * for each such combination. */
+static gchar *
+text_highlight_dup_style_sheet (const gchar *font_family_arg,
+                                const gchar *font_size_arg,
+                                const gchar *style_arg,
+                                GCancellable *cancellable)
+{
+	GBytes *output;
+	gchar *key, *style_sheet;
+
+	const gchar *argv[] = {
+		HIGHLIGHT_COMMAND,
+		font_family_arg,
+		font_size_arg,
+		style_arg,
+		"--out-format=html",
+		"--print-style",
+		"--style-outfile=stdout",
+		NULL };
+
+	key = g_strjoin ("\n", font_family_arg, font_size_arg, style_arg, NULL);
+
+	G_LOCK (style_cache);
+	style_sheet = style_cache ? g_strdup (g_hash_table_lookup (style_cache, key)) : NULL;
+	G_UNLOCK (style_cache);
+
+	if (!style_sheet) {
+		GBytes *empty = g_bytes_new_static ("", 0);
+
+		output = text_highlight_run (argv, empty, cancellable, NULL);
+
+		g_bytes_unref (empty);
+
+		if (output) {
+			style_sheet = g_strndup (g_bytes_get_data (output, NULL), g_bytes_get_size (output));
+			g_bytes_unref (output);
+		} else {
+			style_sheet = g_strdup ("");
+		}
+
+		/* Do not remember a failure of a cancelled run */
+		if (*style_sheet || !g_cancellable_is_cancelled (cancellable)) {
+			G_LOCK (style_cache);
+
+			if (!style_cache)
+				style_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+
+			g_hash_table_insert (style_cache, g_strdup (key), g_strdup (style_sheet));
+
+			G_UNLOCK (style_cache);
+		}
+	}
+
+	g_free (key);
+
+	if (!*style_sheet) {
+		g_free (style_sheet);
+		return NULL;
+	}
+
+	return style_sheet;
+}
+
+/* Highlights the @content in-process, with the same markup and style sheet
+ * as the 'highlight' uses, thus without running it for every part. Returns
+ * %NULL when the @syntax is not supported or the style sheet is unknown. */
+static GBytes *
+text_highlight_tokenize (const gchar *syntax,
+                         const gchar *font_family_arg,
+                         const gchar *font_size_arg,
+                         const gchar *style_arg,
+                         GBytes *content,
+                         GCancellable *cancellable)
+{
+	GString *html;
+	gchar *style_sheet;
+	gconstpointer data;
+	gsize size;
+
+	if (!tokenizer_supports_syntax (syntax))
+		return NULL;
+
+	style_sheet = text_highlight_dup_style_sheet (font_family_arg, font_size_arg, style_arg, cancellable);
+	if (!style_sheet)
+		return NULL;
+
+	data = g_bytes_get_data (content, &size);
+
+	html = g_string_sized_new (2 * size + strlen (style_sheet) + 256);
+
+	g_string_append (html,
+		"<!DOCTYPE html>\n"
+		"<html>\n"
+		"<head>\n"
+		"<style type=\"text/css\">\n");
+	g_string_append (html, style_sheet);
+	g_string_append (html,
+		"</style>\n"
+		"</head>\n"
+		"<body class=\"hl\">\n"
+		"<pre class=\"hl\">");
+
+	tokenizer_format_html (syntax, data, size, html);
+
+	g_string_append (html,
+		"</pre>\n"
+		"</body>\n"
+		"</html>\n");
+
+	g_free (style_sheet);
+
+	return g_string_free_to_bytes (html);
 }
 
 static gboolean
@@ -268,9 +519,9 @@ emfe_text_highlight_format (EMailFormatterExtension *extension,
 		goto exit;
 
 	} else if (context->mode == E_MAIL_FORMATTER_MODE_RAW) {
-		gint pipe_stdin, pipe_stdout;
-		GPid pid;
 		CamelDataWrapper *dw;
+		GBytes *content;
+		GError *local_error = NULL;
 		gchar *font_family, *font_size, *syntax, *theme;
 		PangoFontDescription *fd;
 		GSettings *settings;
@@ -368,37 +619,59 @@ emfe_text_highlight_format (EMailFormatterExtension *extension,
 		argv[2] = font_size;
 		argv[3] = g_strdup_printf ("--syntax=%s", syntax);
 		argv[4] = g_strdup_printf ("--style=%s", theme);
-		g_free (syntax);
 		g_free (theme);
 
-		success = g_spawn_async_with_pipes (
-			NULL, (gchar **) argv, NULL, 0, NULL, NULL,
-			&pid, &pipe_stdin, &pipe_stdout, NULL, NULL);
+		content = text_highlight_decode_content (dw, cancellable, &local_error);
+
+		if (content) {
+			GBytes *output;
+			gchar *checksum, *key;
+
+			checksum = g_compute_checksum_for_bytes (G_CHECKSUM_SHA256, content);
+			key = g_strjoin ("\n", checksum, argv[1], argv[2], argv[3], argv[4], NULL);
 
-		if (success) {
-			GError *local_error = NULL;
+			/* Re-renders of the same content are not highlighted again */
+			output = output_cache_lookup (key);
 
-			success = text_highlight_feed_data (
-				stream, dw,
-				pipe_stdin, pipe_stdout,
-				cancellable, &local_error);
+			if (!output) {
+				/* Common syntaxes are highlighted in-process, others by the 'highlight' */
+				output = text_highlight_tokenize (syntax, argv[1], argv[2], argv[4], content, cancellable);
 
-			if (g_error_matches (
-				local_error, G_IO_ERROR,
-				G_IO_ERROR_CANCELLED)) {
-				/* Do nothing. */
+				if (!output && !g_cancellable_is_cancelled (cancellable))
+					output = text_highlight_run (argv, content, cancellable, &local_error);
 
-			} else if (local_error != NULL) {
-				g_warning (
-					"%s: %s", G_STRFUNC,
-					local_error->message);
+				if (output)
+					output_cache_insert (key, output);
 			}
 
-			g_clear_error (&local_error);
+			success = output && g_output_stream_write_all (
+				stream,
+				g_bytes_get_data (output, NULL),
+				g_bytes_get_size (output),
+				NULL, cancellable, &local_error);
+
+			if (output)
+				g_bytes_unref (output);
+			g_bytes_unref (content);
+			g_free (checksum);
+			g_free (key);
+		} else {
+			success = FALSE;
+		}
+
+		if (g_error_matches (
+			local_error, G_IO_ERROR,
+			G_IO_ERROR_CANCELLED)) {
+			/* Do nothing. */
 
-			g_spawn_close_pid (pid);
+		} else if (local_error != NULL) {
+			g_warning (
+				"%s: %s", G_STRFUNC,
+				local_error->message);
 		}
 
+		g_clear_error (&local_error);
+
 		if (!success) {
 			/* We can't call e_mail_formatter_format_as on text/plain,
 			 * because text-highlight is registered as an handler for
@@ -421,6 +694,7 @@ emfe_text_highlight_format (EMailFormatterExtension *extension,
 
 		g_free (font_family);
 		g_free (font_size);
+		g_free (syntax);
 		g_free ((gchar *) argv[3]);
 		g_free ((gchar *) argv[4]);
 		pango_font_description_free (fd);
@@ -239,6 +239,11 @@ static struct Language other_languages[] = {
 	  (const gchar *[]) { (gchar[]) { "text/x-haskell" }, NULL }
 	},
 
+	{ "json", N_("_JSON"),
+	  (const gchar *[]) { (gchar[]) { "json" }, NULL },
+	  (const gchar *[]) { NULL }
+	},
+
 	{ "jsp", N_("_JSP"),
 	  (const gchar *[]) { (gchar[]) { "jsp" }, NULL },
 	  (const gchar *[]) { (gchar[]) { "text/x-jsp" }, NULL }
@@ -0,0 +1,564 @@
+/*
+ * tokenizer.c
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of MERCHANTABILITY
+ * or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License
+ * for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with this program; if not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/* An in-process tokenizer for the most common syntaxes in mail. It writes
+ * the same HTML markup as the 'highlight' does, with its style classes,
+ * thus the style sheet of the user's theme, as printed by the 'highlight',
+ * applies to it. The 'highlight' itself is run only for other syntaxes. */
+
+#include "evolution-config.h"
+
+#include <string.h>
+
+#include "tokenizer.h"
+
+/* The 'highlight' style classes */
+#define CLASS_NUMBER		"num"
+#define CLASS_ESCAPE		"esc"
+#define CLASS_STRING		"str"
+#define CLASS_COMMENT		"com"
+#define CLASS_PREPROCESSOR	"ppc"
+#define CLASS_OPERATOR		"opt"
+#define CLASS_INTERPOLATION	"ipl"
+#define CLASS_KEYWORD_A		"kwa"
+#define CLASS_KEYWORD_B		"kwb"
+#define CLASS_KEYWORD_C		"kwc"
+#define CLASS_KEYWORD_D		"kwd"
+
+/* Keyword lists, sorted by their bytes for a binary search */
+
+static const gchar *c_keywords[] = {
+	"auto", "break", "case", "catch", "class", "const", "continue",
+	"default", "delete", "do", "else", "enum", "extern", "false", "for",
+	"goto", "if", "inline", "namespace", "new", "nullptr", "operator",
+	"private", "protected", "public", "register", "restrict", "return",
+	"sizeof", "static", "struct", "switch", "template", "this", "throw",
+	"true", "try", "typedef", "union", "using", "virtual", "volatile",
+	"while"
+};
+
+static const gchar *c_types[] = {
+	"bool", "char", "double", "float", "gboolean", "gchar",
+	"gconstpointer", "gdouble", "gint", "gint64", "glong", "gpointer",
+	"gsize", "gssize", "guint", "guint64", "gulong", "int", "int16_t",
+	"int32_t", "int64_t", "int8_t", "long", "short", "signed", "size_t",
+	"ssize_t", "uint16_t", "uint32_t", "uint64_t", "uint8_t", "unsigned",
+	"void", "wchar_t"
+};
+
+static const gchar *python_keywords[] = {
+	"False", "None", "True", "and", "as", "assert", "async", "await",
+	"break", "class", "continue", "def", "del", "elif", "else", "except",
+	"finally", "for", "from", "global", "if", "import", "in", "is",
+	"lambda", "nonlocal", "not", "or", "pass", "raise", "return", "try",
+	"while", "with", "yield"
+};
+
+static const gchar *python_types[] = {
+	"bool", "bytes", "dict", "float", "int", "len", "list", "object",
+	"print", "range", "self", "set", "str", "super", "tuple", "type"
+};
+
+static const gchar *sh_keywords[] = {
+	"case", "do", "done", "elif", "else", "esac", "fi", "for", "function",
+	"if", "in", "local", "return", "select", "then", "until", "while"
+};
+
+static const gchar *sh_types[] = {
+	"alias", "break", "cd", "continue", "echo", "eval", "exec", "exit",
+	"export", "printf", "read", "readonly", "set", "shift", "source",
+	"test", "trap", "unset"
+};
+
+static const gchar *json_keywords[] = {
+	"false", "null", "true"
+};
+
+typedef enum {
+	SYNTAX_KIND_CODE,
+	SYNTAX_KIND_DIFF,
+	SYNTAX_KIND_XML
+} SyntaxKind;
+
+typedef struct _Syntax {
+	const gchar *name;
+	SyntaxKind kind;
+	const gchar **keywords;
+	guint n_keywords;
+	const gchar **types;
+	guint n_types;
+	const gchar *line_comment;
+	const gchar *block_comment_start;
+	const gchar *block_comment_end;
+	const gchar *quotes;
+	gboolean triple_quotes;
+	gboolean preprocessor;
+	gboolean variables;
+} Syntax;
+
+static const Syntax syntaxes[] = {
+	{ "c", SYNTAX_KIND_CODE,
+	  c_keywords, G_N_ELEMENTS (c_keywords),
+	  c_types, G_N_ELEMENTS (c_types),
+	  "//", "/*", "*/", "\"'", FALSE, TRUE, FALSE },
+	{ "python", SYNTAX_KIND_CODE,
+	  python_keywords, G_N_ELEMENTS (python_keywords),
+	  python_types, G_N_ELEMENTS (python_types),
+	  "#", NULL, NULL, "\"'", TRUE, FALSE, FALSE },
+	{ "sh", SYNTAX_KIND_CODE,
+	  sh_keywords, G_N_ELEMENTS (sh_keywords),
+	  sh_types, G_N_ELEMENTS (sh_types),
+	  "#", NULL, NULL, "\"'`", FALSE, FALSE, TRUE },
+	{ "json", SYNTAX_KIND_CODE,
+	  json_keywords, G_N_ELEMENTS (json_keywords),
+	  NULL, 0,
+	  NULL, NULL, NULL, "\"", FALSE, FALSE, FALSE },
+	{ "diff", SYNTAX_KIND_DIFF,
+	  NULL, 0, NULL, 0,
+	  NULL, NULL, NULL, NULL, FALSE, FALSE, FALSE },
+	{ "xml", SYNTAX_KIND_XML,
+	  NULL, 0, NULL, 0,
+	  NULL, NULL, NULL, NULL, FALSE, FALSE, FALSE }
+};
+
+static const Syntax *
+tokenizer_lookup_syntax (const gchar *name)
+{
+	guint ii;
+
+	if (!name)
+		return NULL;
+
+	for (ii = 0; ii < G_N_ELEMENTS (syntaxes); ii++) {
+		if (g_ascii_strcasecmp (syntaxes[ii].name, name) == 0)
+			return &syntaxes[ii];
+	}
+
+	return NULL;
+}
+
+static gboolean
+tokenizer_is_word_list_member (const gchar **words,
+                               guint n_words,
+                               const gchar *word,
+                               gsize word_len)
+{
+	guint low = 0, high = n_words;
+
+	while (low < high) {
+		guint middle = (low + high) / 2;
+		gint cmp;
+
+		cmp = strncmp (words[middle], word, word_len);
+		if (cmp == 0 && words[middle][word_len])
+			cmp = 1;
+
+		if (cmp == 0)
+			return TRUE;
+		else if (cmp < 0)
+			low = middle + 1;
+		else
+			high = middle;
+	}
+
+	return FALSE;
+}
+
+static void
+tokenizer_append_escaped (GString *html,
+                          const gchar *text,
+                          gsize len)
+{
+	const gchar *end = text + len;
+
+	while (text < end) {
+		const gchar *special = text;
+
+		while (special < end && *special != '&' && *special != '<' && *special != '>')
+			special++;
+
+		g_string_append_len (html, text, special - text);
+
+		if (special == end)
+			break;
+
+		if (*special == '&')
+			g_string_append (html, "&amp;");
+		else if (*special == '<')
+			g_string_append (html, "&lt;");
+		else
+			g_string_append (html, "&gt;");
+
+		text = special + 1;
+	}
+}
+
+static void
+tokenizer_append_token (GString *html,
+                        const gchar *class_name,
+                        const gchar *text,
+                        gsize len)
+{
+	if (!len)
+		return;
+
+	if (class_name) {
+		g_string_append_printf (html, "<span class=\"hl %s\">", class_name);
+		tokenizer_append_escaped (html, text, len);
+		g_string_append (html, "</span>");
+	} else {
+		tokenizer_append_escaped (html, text, len);
+	}
+}
+
+static gboolean
+tokenizer_has_prefix (const gchar *text,
+                      gsize pos,
+                      gsize len,
+                      const gchar *prefix)
+{
+	gsize prefix_len;
+
+	if (!prefix)
+		return FALSE;
+
+	prefix_len = strlen (prefix);
+
+	return len - pos >= prefix_len && strncmp (text + pos, prefix, prefix_len) == 0;
+}
+
+static gsize
+tokenizer_find_line_end (const gchar *text,
+                         gsize pos,
+                         gsize len)
+{
+	const gchar *eol;
+
+	eol = memchr (text + pos, '\n', len - pos);
+
+	return eol ? (gsize) (eol - text) : len;
+}
+
+/* Returns the position after the @end_str, or @len when not found */
+static gsize
+tokenizer_find_after (const gchar *text,
+                      gsize pos,
+                      gsize len,
+                      const gchar *end_str)
+{
+	gsize end_len = strlen (end_str);
+
+	while (pos < len) {
+		if (tokenizer_has_prefix (text, pos, len, end_str))
+			return pos + end_len;
+		pos++;
+	}
+
+	return len;
+}
+
+#define IS_WORD_START(c) (g_ascii_isalpha (c) || (c) == '_')
+#define IS_WORD_CHAR(c) (g_ascii_isalnum (c) || (c) == '_')
+#define IS_ONE_OF(c, set) ((c) && strchr ((set), (c)))
+#define OPERATOR_CHARS "+-*/%=<>!&|^~?:;,.()[]{}"
+
+static void
+tokenizer_format_code (const Syntax *syntax,
+                       const gchar *text,
+                       gsize len,
+                       GString *html)
+{
+	gboolean line_start = TRUE;
+	gsize pos = 0;
+
+	while (pos < len) {
+		const gchar *class_name = NULL;
+		gchar chr = text[pos];
+		gsize end = pos + 1;
+
+		if (syntax->preprocessor && line_start && chr == '#') {
+			/* Up to the end of the line, with continuation lines */
+			end = tokenizer_find_line_end (text, pos, len);
+			while (end < len && end > pos && text[end - 1] == '\\')
+				end = tokenizer_find_line_end (text, end + 1, len);
+			class_name = CLASS_PREPROCESSOR;
+
+		} else if (tokenizer_has_prefix (text, pos, len, syntax->line_comment) &&
+			   (!syntax->variables || pos == 0 || g_ascii_isspace (text[pos - 1]) || text[pos - 1] == ';')) {
+			end = tokenizer_find_line_end (text, pos, len);
+			class_name = CLASS_COMMENT;
+
+		} else if (tokenizer_has_prefix (text, pos, len, syntax->block_comment_start)) {
+			end = tokenizer_find_after (text, pos + strlen (syntax->block_comment_start), len, syntax->block_comment_end);
+			class_name = CLASS_COMMENT;
+
+		} else if (syntax->triple_quotes &&
+			   (tokenizer_has_prefix (text, pos, len, "\"\"\"") ||
+			    tokenizer_has_prefix (text, pos, len, "'''"))) {
+			end = tokenizer_find_after (text, pos + 3, len, chr == '"' ? "\"\"\"" : "'''");
+			class_name = CLASS_STRING;
+
+		} else if (syntax->quotes && IS_ONE_OF (chr, syntax->quotes)) {
+			/* Shell strings can span lines, single-quoted ones without escapes */
+			gboolean multiline = syntax->variables;
+			gboolean escapes = !syntax->variables || chr != '\'';
+
+			while (end < len && text[end] != chr && (multiline || text[end] != '\n')) {
+				if (escapes && text[end] == '\\' && end + 1 < len)
+					end++;
+				end++;
+			}
+
+			if (end < len && text[end] == chr)
+				end++;
+
+			class_name = CLASS_STRING;
+
+		} else if (syntax->variables && chr == '$' && end < len) {
+			if (text[end] == '{') {
+				while (end < len && text[end] != '}' && text[end] != '\n')
+					end++;
+				if (end < len && text[end] == '}')
+					end++;
+			} else if (IS_WORD_START (text[end])) {
+				while (end < len && IS_WORD_CHAR (text[end]))
+					end++;
+			} else if (g_ascii_isdigit (text[end]) || IS_ONE_OF (text[end], "@*#?$!-")) {
+				end++;
+			}
+
+			if (end > pos + 1)
+				class_name = CLASS_INTERPOLATION;
+
+		} else if (g_ascii_isdigit (chr) ||
+			   (chr == '.' && end < len && g_ascii_isdigit (text[end]))) {
+			gboolean is_hex = chr == '0' && end < len && (text[end] == 'x' || text[end] == 'X');
+
+			while (end < len) {
+				if (IS_WORD_CHAR (text[end]) || text[end] == '.')
+					end++;
+				else if (!is_hex && (text[end] == '+' || text[end] == '-') &&
+					 (text[end - 1] == 'e' || text[end - 1] == 'E'))
+					end++;
+				else
+					break;
+			}
+
+			class_name = CLASS_NUMBER;
+
+		} else if (IS_WORD_START (chr)) {
+			while (end < len && IS_WORD_CHAR (text[end]))
+				end++;
+
+			if (tokenizer_is_word_list_member (syntax->keywords, syntax->n_keywords, text + pos, end - pos))
+				class_name = CLASS_KEYWORD_A;
+			else if (syntax->types && tokenizer_is_word_list_member (syntax->types, syntax->n_types, text + pos, end - pos))
+				class_name = CLASS_KEYWORD_B;
+
+		} else if (IS_ONE_OF (chr, OPERATOR_CHARS)) {
+			while (end < len && IS_ONE_OF (text[end], OPERATOR_CHARS) &&
+			       !tokenizer_has_prefix (text, end, len, syntax->line_comment) &&
+			       !tokenizer_has_prefix (text, end, len, syntax->block_comment_start))
+				end++;
+
+			class_name = CLASS_OPERATOR;
+
+		} else {
+			/* Whitespace and the rest, including non-ASCII letters */
+			while (end < len && !g_ascii_isgraph (text[end]) && text[end] != '\n' && (text[end] & 0x80) == (chr & 0x80))
+				end++;
+		}
+
+		tokenizer_append_token (html, class_name, text + pos, end - pos);
+
+		if (chr == '\n' || (class_name == NULL && memchr (text + pos, '\n', end - pos)))
+			line_start = TRUE;
+		else if (!g_ascii_isspace (chr))
+			line_start = FALSE;
+
+		pos = end;
+	}
+}
+
+static void
+tokenizer_format_diff (const gchar *text,
+                       gsize len,
+                       GString *html)
+{
+	gsize pos = 0;
+
+	while (pos < len) {
+		const gchar *class_name = NULL;
+		gsize end;
+
+		end = tokenizer_find_line_end (text, pos, len);
+
+		if (tokenizer_has_prefix (text, pos, len, "diff ") ||
+		    tokenizer_has_prefix (text, pos, len, "index ") ||
+		    tokenizer_has_prefix (text, pos, len, "--- ") ||
+		    tokenizer_has_prefix (text, pos, len, "+++ ") ||
+		    tokenizer_has_prefix (text, pos, len, "new file ") ||
+		    tokenizer_has_prefix (text, pos, len, "deleted file ") ||
+		    tokenizer_has_prefix (text, pos, len, "similarity index ") ||
+		    tokenizer_has_prefix (text, pos, len, "rename ") ||
+		    tokenizer_has_prefix (text, pos, len, "Only in "))
+			class_name = CLASS_KEYWORD_A;
+		else if (tokenizer_has_prefix (text, pos, len, "@@"))
+			class_name = CLASS_KEYWORD_D;
+		else if (text[pos] == '+' || text[pos] == '>')
+			class_name = CLASS_KEYWORD_B;
+		else if (text[pos] == '-' || text[pos] == '<')
+			class_name = CLASS_KEYWORD_C;
+		else if (text[pos] == '\\')
+			class_name = CLASS_COMMENT;
+
+		tokenizer_append_token (html, class_name, text + pos, end - pos);
+
+		if (end < len)
+			g_string_append_c (html, '\n');
+
+		pos = end + 1;
+	}
+}
+
+static void
+tokenizer_format_xml (const gchar *text,
+                      gsize len,
+                      GString *html)
+{
+	gsize pos = 0;
+
+	while (pos < len) {
+		gsize end;
+
+		if (tokenizer_has_prefix (text, pos, len, "<!--")) {
+			end = tokenizer_find_after (text, pos + 4, len, "-->");
+			tokenizer_append_token (html, CLASS_COMMENT, text + pos, end - pos);
+
+		} else if (tokenizer_has_prefix (text, pos, len, "<![CDATA[")) {
+			end = tokenizer_find_after (text, pos + 9, len, "]]>");
+			tokenizer_append_token (html, CLASS_STRING, text + pos, end - pos);
+
+		} else if (tokenizer_has_prefix (text, pos, len, "<?") ||
+			   tokenizer_has_prefix (text, pos, len, "<!")) {
+			end = tokenizer_find_after (text, pos + 2, len, ">");
+			tokenizer_append_token (html, CLASS_PREPROCESSOR, text + pos, end - pos);
+
+		} else if (text[pos] == '<') {
+			/* The tag name, then its attributes */
+			end = pos + 1;
+			if (end < len && text[end] == '/')
+				end++;
+			while (end < len && !g_ascii_isspace (text[end]) && text[end] != '>' && text[end] != '/')
+				end++;
+
+			tokenizer_append_token (html, CLASS_KEYWORD_A, text + pos, end - pos);
+			pos = end;
+
+			while (pos < len && text[pos] != '>' && text[pos] != '<') {
+				const gchar *class_name = NULL;
+				gchar chr = text[pos];
+
+				end = pos + 1;
+
+				if (chr == '"' || chr == '\'') {
+					while (end < len && text[end] != chr)
+						end++;
+					if (end < len)
+						end++;
+					class_name = CLASS_STRING;
+				} else if (chr == '=') {
+					class_name = CLASS_OPERATOR;
+				} else if (chr == '/') {
+					class_name = CLASS_KEYWORD_A;
+				} else if (!g_ascii_isspace (chr)) {
+					while (end < len && !g_ascii_isspace (text[end]) && !IS_ONE_OF (text[end], "=/<>\"'"))
+						end++;
+					class_name = CLASS_KEYWORD_B;
+				}
+
+				tokenizer_append_token (html, class_name, text + pos, end - pos);
+				pos = end;
+			}
+
+			end = pos;
+			if (end < len && text[end] == '>') {
+				end++;
+				tokenizer_append_token (html, CLASS_KEYWORD_A, text + pos, end - pos);
+			}
+
+		} else if (text[pos] == '&') {
+			end = pos + 1;
+			while (end < len && end - pos < 12 && (g_ascii_isalnum (text[end]) || text[end] == '#'))
+				end++;
+
+			if (end < len && text[end] == ';') {
+				end++;
+				tokenizer_append_token (html, CLASS_ESCAPE, text + pos, end - pos);
+			} else {
+				end = pos + 1;
+				tokenizer_append_token (html, NULL, text + pos, end - pos);
+			}
+
+		} else {
+			end = pos + 1;
+			while (end < len && text[end] != '<' && text[end] != '&')
+				end++;
+
+			tokenizer_append_token (html, NULL, text + pos, end - pos);
+		}
+
+		pos = end;
+	}
+}
+
+/* Whether tokenizer_format_html() can highlight the 'highlight' @syntax */
+gboolean
+tokenizer_supports_syntax (const gchar *syntax)
+{
+	return tokenizer_lookup_syntax (syntax) != NULL;
+}
+
+/* Appends the @text highlighted as the @syntax into the @html, which is
+ * only the content of the <pre class="hl"> element; the @syntax should be
+ * supported, as tokenizer_supports_syntax() tells. */
+void
+tokenizer_format_html (const gchar *syntax,
+                       const gchar *text,
+                       gsize text_len,
+                       GString *html)
+{
+	const Syntax *def;
+
+	g_return_if_fail (text != NULL || !text_len);
+	g_return_if_fail (html != NULL);
+
+	def = tokenizer_lookup_syntax (syntax);
+	g_return_if_fail (def != NULL);
+
+	switch (def->kind) {
+	case SYNTAX_KIND_CODE:
+		tokenizer_format_code (def, text, text_len, html);
+		break;
+	case SYNTAX_KIND_DIFF:
+		tokenizer_format_diff (text, text_len, html);
+		break;
+	case SYNTAX_KIND_XML:
+		tokenizer_format_xml (text, text_len, html);
+		break;
+	}
+}
@@ -45,6 +45,14 @@ static GSList *publish_uris = NULL;
 static GSList *queued_publishes = NULL;
 static gint online = 0;
 
+/* How long to wait for more changes in a published calendar
+ * before publishing it again */
+#define PUBLISH_CHANGES_DELAY_SECONDS 30
+
+static GHashTable *publish_watches = NULL;	/* gchar *source_uid ~> PublishWatch * */
+static GHashTable *pending_publishes = NULL;	/* EPublishUri * ~> timeout id */
+G_LOCK_DEFINE_STATIC (publish_state);
+
 static GSList *error_queue = NULL;
 static GMutex error_queue_lock;
 static guint error_queue_show_idle_id = 0;
@@ -52,7 +60,7 @@ static void  error_queue_add (gchar *descriptions, GError *error);
 
 gint          e_plugin_lib_enable (EPlugin *ep, gint enable);
 GtkWidget   *publish_calendar_locations (EPlugin *epl, EConfigHookItemFactoryData *data);
-static void  update_timestamp (EPublishUri *uri);
+static void  update_timestamp (EPublishUri *uri, const gchar *digest, const gchar *etag);
 static void publish (EPublishUri *uri, gboolean can_report_success);
 
 static GtkStatusIcon *status_icon = NULL;
@@ -189,20 +197,408 @@ publish_uri_async (EPublishUri *uri)
 	}
 }
 
+static gboolean
+publish_changes_timeout_cb (gpointer user_data)
+{
+	EPublishUri *uri = user_data;
+
+	g_hash_table_remove (pending_publishes, uri);
+
+	publish_uri_async (uri);
+
+	return FALSE;
+}
+
+static void
+publish_cancel_scheduled (EPublishUri *uri)
+{
+	guint id;
+
+	if (!pending_publishes)
+		return;
+
+	id = GPOINTER_TO_UINT (g_hash_table_lookup (pending_publishes, uri));
+	if (id) {
+		g_source_remove (id);
+		g_hash_table_remove (pending_publishes, uri);
+	}
+}
+
+/* Publishes all the locations using the source with the @source_uid,
+ * once its content stops changing for a while. */
+static void
+publish_schedule_for_source (const gchar *source_uid)
+{
+	GSList *link;
+
+	if (!pending_publishes)
+		pending_publishes = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+	for (link = publish_uris; link; link = g_slist_next (link)) {
+		EPublishUri *uri = link->data;
+		guint id;
+
+		if (!uri->enabled || uri->publish_frequency == URI_PUBLISH_MANUAL ||
+		    !g_slist_find_custom (uri->events, source_uid, (GCompareFunc) g_strcmp0))
+			continue;
+
+		publish_cancel_scheduled (uri);
+
+		id = e_named_timeout_add_seconds (
+			PUBLISH_CHANGES_DELAY_SECONDS,
+			publish_changes_timeout_cb, uri);
+		g_hash_table_insert (pending_publishes, uri, GUINT_TO_POINTER (id));
+	}
+}
+
+typedef struct _PublishWatch {
+	gchar *source_uid;
+	GCancellable *cancellable;
+	ECalClientView *view;
+	gboolean complete;
+} PublishWatch;
+
+static void
+publish_watch_free (gpointer ptr)
+{
+	PublishWatch *watch = ptr;
+
+	if (watch) {
+		g_cancellable_cancel (watch->cancellable);
+
+		if (watch->view) {
+			g_signal_handlers_disconnect_by_data (watch->view, watch);
+			e_cal_client_view_stop (watch->view, NULL);
+			g_object_unref (watch->view);
+		}
+
+		g_object_unref (watch->cancellable);
+		g_free (watch->source_uid);
+		g_slice_free (PublishWatch, watch);
+	}
+}
+
+static void
+publish_watch_objects_changed_cb (ECalClientView *view,
+				  const GSList *objects,
+				  gpointer user_data)
+{
+	PublishWatch *watch = user_data;
+
+	/* Skip the initial notifications about existing objects */
+	if (watch->complete)
+		publish_schedule_for_source (watch->source_uid);
+}
+
+static void
+publish_watch_complete_cb (ECalClientView *view,
+			   const GError *error,
+			   gpointer user_data)
+{
+	PublishWatch *watch = user_data;
+
+	watch->complete = TRUE;
+}
+
+static void
+publish_watch_got_view_cb (GObject *source_object,
+			   GAsyncResult *result,
+			   gpointer user_data)
+{
+	gchar *source_uid = user_data;
+	PublishWatch *watch;
+	ECalClientView *view = NULL;
+	GError *error = NULL;
+
+	if (!e_cal_client_get_view_finish (E_CAL_CLIENT (source_object), result, &view, &error)) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("%s: Failed to get view for '%s': %s", G_STRFUNC, source_uid, error ? error->message : "Unknown error");
+
+		g_clear_error (&error);
+		g_free (source_uid);
+		return;
+	}
+
+	watch = publish_watches ? g_hash_table_lookup (publish_watches, source_uid) : NULL;
+
+	if (watch && !watch->view) {
+		watch->view = view;
+
+		g_signal_connect (
+			view, "objects-added",
+			G_CALLBACK (publish_watch_objects_changed_cb), watch);
+		g_signal_connect (
+			view, "objects-modified",
+			G_CALLBACK (publish_watch_objects_changed_cb), watch);
+		g_signal_connect (
+			view, "objects-removed",
+			G_CALLBACK (publish_watch_objects_changed_cb), watch);
+		g_signal_connect (
+			view, "complete",
+			G_CALLBACK (publish_watch_complete_cb), watch);
+
+		e_cal_client_view_start (view, &error);
+
+		if (error) {
+			g_warning ("%s: Failed to start view for '%s': %s", G_STRFUNC, source_uid, error->message);
+			g_clear_error (&error);
+		}
+	} else {
+		g_object_unref (view);
+	}
+
+	g_free (source_uid);
+}
+
+static void
+publish_watch_got_client_cb (GObject *source_object,
+			     GAsyncResult *result,
+			     gpointer user_data)
+{
+	gchar *source_uid = user_data;
+	PublishWatch *watch;
+	EClient *client;
+	GError *error = NULL;
+
+	client = e_client_cache_get_client_finish (E_CLIENT_CACHE (source_object), result, &error);
+
+	if (!client) {
+		if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+			g_warning ("%s: Failed to open '%s': %s", G_STRFUNC, source_uid, error ? error->message : "Unknown error");
+
+		g_clear_error (&error);
+		g_free (source_uid);
+		return;
+	}
+
+	watch = publish_watches ? g_hash_table_lookup (publish_watches, source_uid) : NULL;
+
+	if (watch && !watch->view) {
+		/* Only the fact that something changed matters */
+		e_cal_client_get_view (
+			E_CAL_CLIENT (client), "#t", watch->cancellable,
+			publish_watch_got_view_cb, source_uid);
+	} else {
+		g_free (source_uid);
+	}
+
+	g_object_unref (client);
+}
+
+static PublishWatch *
+publish_watch_new (const gchar *source_uid)
+{
+	EShell *shell;
+	ESource *source;
+	PublishWatch *watch;
+
+	shell = e_shell_get_default ();
+	source = e_source_registry_ref_source (e_shell_get_registry (shell), source_uid);
+
+	if (!source)
+		return NULL;
+
+	watch = g_slice_new0 (PublishWatch);
+	watch->source_uid = g_strdup (source_uid);
+	watch->cancellable = g_cancellable_new ();
+
+	e_client_cache_get_client (
+		e_shell_get_client_cache (shell), source,
+		E_SOURCE_EXTENSION_CALENDAR, 30, watch->cancellable,
+		publish_watch_got_client_cb, g_strdup (source_uid));
+
+	g_object_unref (source);
+
+	return watch;
+}
+
+/* Makes sure there is a view for each calendar published automatically,
+ * and only for those. Call it whenever the list of locations changes. */
+static void
+publish_watches_update (void)
+{
+	GHashTable *needed;
+	GHashTableIter iter;
+	GSList *link;
+	gpointer key;
+
+	needed = g_hash_table_new (g_str_hash, g_str_equal);
+
+	for (link = publish_uris; link; link = g_slist_next (link)) {
+		EPublishUri *uri = link->data;
+		GSList *elink;
+
+		if (!uri->enabled || uri->publish_frequency == URI_PUBLISH_MANUAL)
+			continue;
+
+		for (elink = uri->events; elink; elink = g_slist_next (elink)) {
+			if (elink->data)
+				g_hash_table_add (needed, elink->data);
+		}
+	}
+
+	if (!publish_watches)
+		publish_watches = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, publish_watch_free);
+
+	g_hash_table_iter_init (&iter, publish_watches);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		if (!g_hash_table_contains (needed, key))
+			g_hash_table_iter_remove (&iter);
+	}
+
+	g_hash_table_iter_init (&iter, needed);
+	while (g_hash_table_iter_next (&iter, &key, NULL)) {
+		if (!g_hash_table_contains (publish_watches, key)) {
+			PublishWatch *watch;
+
+			watch = publish_watch_new (key);
+			if (watch)
+				g_hash_table_insert (publish_watches, watch->source_uid, watch);
+		}
+	}
+
+	g_hash_table_destroy (needed);
+}
+
+static gboolean
+publish_watches_update_idle_cb (gpointer user_data)
+{
+	publish_watches_update ();
+
+	return FALSE;
+}
+
+/* The location is part of the digest, thus a changed destination
+ * is published even when the content itself did not change. */
+static gchar *
+publish_compute_digest (EPublishUri *uri,
+			gconstpointer data,
+			gsize data_size)
+{
+	GChecksum *checksum;
+	gchar *digest;
+
+	checksum = g_checksum_new (G_CHECKSUM_SHA256);
+	g_checksum_update (checksum, (const guchar *) uri->location, -1);
+	g_checksum_update (checksum, (const guchar *) "\n", 1);
+	g_checksum_update (checksum, data, data_size);
+	digest = g_strdup (g_checksum_get_string (checksum));
+	g_checksum_free (checksum);
+
+	return digest;
+}
+
+/* Returns whether the @file already holds the content with the @digest.
+ * When the location provided an entity tag on the last upload, it is
+ * verified the file was not changed or removed there since then. */
+static gboolean
+publish_is_unchanged (EPublishUri *uri,
+		      GFile *file,
+		      const gchar *digest,
+		      GError **error)
+{
+	GFileInfo *info;
+	GError *local_error = NULL;
+	gchar *etag;
+	gboolean unchanged;
+
+	G_LOCK (publish_state);
+	unchanged = g_strcmp0 (uri->digest, digest) == 0;
+	etag = g_strdup (uri->etag);
+	G_UNLOCK (publish_state);
+
+	if (!unchanged || !etag) {
+		g_free (etag);
+		return unchanged;
+	}
+
+	info = g_file_query_info (file, G_FILE_ATTRIBUTE_ETAG_VALUE, G_FILE_QUERY_INFO_NONE, NULL, &local_error);
+
+	if (info) {
+		unchanged = g_strcmp0 (g_file_info_get_etag (info), etag) == 0;
+		g_object_unref (info);
+	} else {
+		if (g_error_matches (local_error, G_IO_ERROR, G_IO_ERROR_NOT_MOUNTED))
+			g_propagate_error (error, local_error);
+		else
+			g_clear_error (&local_error);
+
+		unchanged = FALSE;
+	}
+
+	g_free (etag);
+
+	return unchanged;
+}
+
 static void
 publish_online (EPublishUri *uri,
                 GFile *file,
                 GError **perror,
                 gboolean can_report_success)
 {
-	GOutputStream *stream;
+	GOutputStream *stream, *mem_stream;
 	GError *error = NULL;
+	gconstpointer data;
+	gsize data_size;
+	gchar *digest, *etag = NULL;
+	gboolean success;
+
+	/* Generate the content first, to be able to skip the upload
+	 * when nothing changed since the last publish. */
+	mem_stream = g_memory_output_stream_new_resizable ();
 
-	stream = G_OUTPUT_STREAM (g_file_replace (
-		file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error));
+	switch (uri->publish_format) {
+		case URI_PUBLISH_AS_ICAL:
+			publish_calendar_as_ical (mem_stream, uri, &error);
+			break;
+		case URI_PUBLISH_AS_FB:
+		case URI_PUBLISH_AS_FB_WITH_DETAILS:
+			publish_calendar_as_fb (mem_stream, uri, &error);
+			break;
+	}
+
+	if (error != NULL) {
+		error_queue_add (
+			g_strdup_printf (
+				_("There was an error while publishing to %s:"),
+				uri->location),
+			error);
+
+		update_timestamp (uri, NULL, NULL);
+		g_object_unref (mem_stream);
+		return;
+	}
+
+	g_output_stream_close (mem_stream, NULL, NULL);
+
+	data = g_memory_output_stream_get_data (G_MEMORY_OUTPUT_STREAM (mem_stream));
+	data_size = g_memory_output_stream_get_data_size (G_MEMORY_OUTPUT_STREAM (mem_stream));
+	digest = publish_compute_digest (uri, data, data_size);
+
+	/* Publishing requested by the user always uploads */
+	if (!can_report_success && publish_is_unchanged (uri, file, digest, &error)) {
+		G_LOCK (publish_state);
+		etag = g_strdup (uri->etag);
+		G_UNLOCK (publish_state);
+
+		update_timestamp (uri, digest, etag);
+
+		g_object_unref (mem_stream);
+		g_free (digest);
+		g_free (etag);
+		return;
+	}
+
+	if (error == NULL) {
+		stream = G_OUTPUT_STREAM (g_file_replace (
+			file, NULL, FALSE, G_FILE_CREATE_NONE, NULL, &error));
+	} else {
+		stream = NULL;
+	}
 
 	/* Sanity check. */
-	g_return_if_fail (
+	g_warn_if_fail (
 		((stream != NULL) && (error == NULL)) ||
 		((stream == NULL) && (error != NULL)));
 
@@ -216,18 +612,18 @@ publish_online (EPublishUri *uri,
 					uri->location),
 				error);
 		}
+
+		g_clear_object (&stream);
+		g_object_unref (mem_stream);
+		g_free (digest);
 		return;
 	}
 
-	switch (uri->publish_format) {
-		case URI_PUBLISH_AS_ICAL:
-			publish_calendar_as_ical (stream, uri, &error);
-			break;
-		case URI_PUBLISH_AS_FB:
-		case URI_PUBLISH_AS_FB_WITH_DETAILS:
-			publish_calendar_as_fb (stream, uri, &error);
-			break;
-	}
+	success = g_output_stream_write_all (stream, data, data_size, NULL, NULL, &error) &&
+		g_output_stream_close (stream, NULL, &error);
+
+	if (success)
+		etag = g_strdup (g_file_output_stream_get_etag (G_FILE_OUTPUT_STREAM (stream)));
 
 	if (error != NULL)
 		error_queue_add (
@@ -242,10 +638,14 @@ publish_online (EPublishUri *uri,
 				uri->location),
 			NULL);
 
-	update_timestamp (uri);
+	/* Forget the digest on failure, to upload again the next time */
+	update_timestamp (uri, success ? digest : NULL, etag);
 
 	g_output_stream_close (stream, NULL, NULL);
 	g_object_unref (stream);
+	g_object_unref (mem_stream);
+	g_free (digest);
+	g_free (etag);
 }
 
 static void
@@ -521,7 +921,9 @@ add_timeout (EPublishUri *uri)
 }
 
 static void
-update_timestamp (EPublishUri *uri)
+update_timestamp (EPublishUri *uri,
+		  const gchar *digest,
+		  const gchar *etag)
 {
 	GSettings *settings;
 	gchar **set_uris;
@@ -545,6 +947,17 @@ update_timestamp (EPublishUri *uri)
 		g_free (uri->last_pub_time);
 	uri->last_pub_time = g_strdup_printf ("%d", (gint) time (NULL));
 
+	G_LOCK (publish_state);
+	if (g_strcmp0 (uri->digest, digest) != 0) {
+		g_free (uri->digest);
+		uri->digest = g_strdup (digest);
+	}
+	if (g_strcmp0 (uri->etag, etag) != 0) {
+		g_free (uri->etag);
+		uri->etag = g_strdup (etag);
+	}
+	G_UNLOCK (publish_state);
+
 	uris_array = g_ptr_array_new_full (3, g_free);
 	settings = e_util_ref_settings (PC_SETTINGS_ID);
 	set_uris = g_settings_get_strv (settings, PC_SETTINGS_URIS);
@@ -665,6 +1078,7 @@ url_list_enable_toggled (GtkCellRendererToggle *renderer,
 		gtk_list_store_set (GTK_LIST_STORE (model), &iter, URL_LIST_ENABLED_COLUMN, url->enabled, -1);
 
 		url_list_changed (ui);
+		publish_watches_update ();
 	}
 
 	gtk_tree_path_free (path);
@@ -713,6 +1127,7 @@ url_add_clicked (GtkButton *button,
 			publish_uris = g_slist_prepend (publish_uris, uri);
 			add_timeout (uri);
 			publish_uri_async (uri);
+			publish_watches_update ();
 		} else {
 			g_free (uri);
 		}
@@ -750,6 +1165,7 @@ url_edit_clicked (GtkButton *button,
 			add_timeout (uri);
 			url_list_changed (ui);
 			publish_uri_async (uri);
+			publish_watches_update ();
 		}
 
 		gtk_widget_destroy (url_editor);
@@ -811,6 +1227,11 @@ url_remove_clicked (GtkButton *button,
 		if (id)
 			g_source_remove (id);
 
+		publish_cancel_scheduled (url);
+		publish_watches_update ();
+
+		g_free (url->digest);
+		g_free (url->etag);
 		g_free (url);
 		url_list_changed (ui);
 	}
@@ -950,6 +1371,9 @@ publish_uris_set_timeout (gchar **uris)
 
 	g_strfreev (uris);
 
+	/* Views should be created in the main thread */
+	g_idle_add (publish_watches_update_idle_cb, NULL);
+
 	return NULL;
 }
 
@@ -992,6 +1416,24 @@ e_plugin_lib_enable (EPlugin *ep,
 		} else {
 			g_thread_unref (thread);
 		}
+	} else {
+		if (pending_publishes) {
+			GHashTableIter iter;
+			gpointer value;
+
+			g_hash_table_iter_init (&iter, pending_publishes);
+			while (g_hash_table_iter_next (&iter, NULL, &value)) {
+				g_source_remove (GPOINTER_TO_UINT (value));
+			}
+
+			g_hash_table_destroy (pending_publishes);
+			pending_publishes = NULL;
+		}
+
+		if (publish_watches) {
+			g_hash_table_destroy (publish_watches);
+			publish_watches = NULL;
+		}
 	}
 
 	return 0;
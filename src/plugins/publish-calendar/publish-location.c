@@ -134,7 +134,7 @@ e_publish_uri_from_xml (const gchar *xml)
 	xmlDocPtr doc;
 	xmlNodePtr root, p;
 	xmlChar *location, *enabled, *frequency, *fb_duration_value, *fb_duration_type;
-	xmlChar *publish_time, *format, *username = NULL;
+	xmlChar *publish_time, *format, *username = NULL, *digest, *etag;
 	GSList *events = NULL;
 	EPublishUri *uri;
 
@@ -161,6 +161,8 @@ e_publish_uri_from_xml (const gchar *xml)
 	publish_time = xmlGetProp (root, (const guchar *)"publish_time");
 	fb_duration_value = xmlGetProp (root, (xmlChar *)"fb_duration_value");
 	fb_duration_type = xmlGetProp (root, (xmlChar *)"fb_duration_type");
+	digest = xmlGetProp (root, (const guchar *)"digest");
+	etag = xmlGetProp (root, (const guchar *)"etag");
 
 	if (location != NULL)
 		uri->location = (gchar *) location;
@@ -172,6 +174,10 @@ e_publish_uri_from_xml (const gchar *xml)
 		uri->publish_format = atoi ((gchar *) format);
 	if (publish_time != NULL)
 		uri->last_pub_time = (gchar *) publish_time;
+	if (digest != NULL)
+		uri->digest = g_strdup ((gchar *) digest);
+	if (etag != NULL)
+		uri->etag = g_strdup ((gchar *) etag);
 
 	if (fb_duration_value)
 		uri->fb_duration_value = atoi ((gchar *) fb_duration_value);
@@ -207,6 +213,8 @@ e_publish_uri_from_xml (const gchar *xml)
 	xmlFree (format);
 	xmlFree (fb_duration_value);
 	xmlFree (fb_duration_type);
+	xmlFree (digest);
+	xmlFree (etag);
 	xmlFreeDoc (doc);
 
 	return uri;
@@ -237,6 +245,10 @@ e_publish_uri_to_xml (EPublishUri *uri)
 	xmlSetProp (root, (const guchar *)"frequency", (guchar *) frequency);
 	xmlSetProp (root, (const guchar *)"format", (guchar *) format);
 	xmlSetProp (root, (const guchar *)"publish_time", (guchar *) uri->last_pub_time);
+	if (uri->digest)
+		xmlSetProp (root, (const guchar *)"digest", (guchar *) uri->digest);
+	if (uri->etag)
+		xmlSetProp (root, (const guchar *)"etag", (guchar *) uri->etag);
 
 	g_free (format);
 	format = g_strdup_printf ("%d", uri->fb_duration_value);
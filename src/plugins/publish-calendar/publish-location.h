@@ -61,6 +61,11 @@ struct _EPublishUri {
 	gint fb_duration_type;
 
 	gint service_type;
+
+	/* checksum of the last published content and the entity tag
+	 * of the uploaded file, if the location provides any */
+	gchar *digest;
+	gchar *etag;
 };
 
 EPublishUri *e_publish_uri_from_xml (const gchar *xml);
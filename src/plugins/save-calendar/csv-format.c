@@ -42,20 +42,6 @@ struct _CsvPluginData
 	GtkWidget *delimiter_entry, *newline_entry, *quote_entry, *header_check;
 };
 
-static void
-display_error_message (GtkWidget *parent,
-                       GError *error)
-{
-	GtkWidget *dialog;
-
-	dialog = gtk_message_dialog_new (
-		GTK_WINDOW (parent), 0,
-		GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
-		"%s", error->message);
-	gtk_dialog_run (GTK_DIALOG (dialog));
-	gtk_widget_destroy (dialog);
-}
-
 enum { /* CSV helper enum */
 	ECALCOMPONENTTEXT,
 	ECALCOMPONENTATTENDEE,
@@ -287,8 +273,204 @@ userstring_to_systemstring (const gchar *userstring)
 	return g_string_free (str, FALSE);
 }
 
+static void
+csv_config_free (gpointer ptr)
+{
+	CsvConfig *config = ptr;
+
+	if (config) {
+		g_free (config->delimiter);
+		g_free (config->quote);
+		g_free (config->newline);
+		g_free (config);
+	}
+}
+
+/* Runs in a dedicated thread, writing one record at a time */
+static gboolean
+write_calendar_csv (ECalClient *client,
+		    GOutputStream *stream,
+		    gpointer user_data,
+		    GCancellable *cancellable,
+		    GError **error)
+{
+	CsvConfig *config = user_data;
+	GSList *objects = NULL, *iter;
+	GString *line = NULL;
+	guint done = 0, total;
+	gboolean success = TRUE;
+
+	if (!e_cal_client_get_object_list_as_comps_sync (client, "#t", &objects, cancellable, error))
+		return FALSE;
+
+	total = g_slist_length (objects);
+
+	if (config->header) {
+
+		gint i = 0;
+
+		static const gchar *labels[] = {
+			 N_("UID"),
+			 N_("Summary"),
+			 N_("Description List"),
+			 N_("Categories List"),
+			 N_("Comment List"),
+			 N_("Completed"),
+			 N_("Created"),
+			 N_("Contact List"),
+			 N_("Start"),
+			 N_("End"),
+			 N_("Due"),
+			 N_("percent Done"),
+			 N_("Priority"),
+			 N_("URL"),
+			 N_("Attendees List"),
+			 N_("Location"),
+			 N_("Modified"),
+		};
+
+		line = g_string_new ("");
+		for (i = 0; i < G_N_ELEMENTS (labels); i++) {
+			if (i > 0)
+				g_string_append (line, config->delimiter);
+			g_string_append (line, _(labels[i]));
+		}
+
+		g_string_append (line, config->newline);
+
+		success = g_output_stream_write_all (
+			stream, line->str, line->len,
+			NULL, cancellable, error);
+		g_string_free (line, TRUE);
+	}
+
+	for (iter = objects; success && iter; iter = iter->next) {
+		ECalComponent *comp = iter->data;
+		gchar *delimiter_temp = NULL;
+		const gchar *temp_constchar;
+		gchar *temp_char;
+		GSList *temp_list;
+		ECalComponentDateTime* temp_dt;
+		ICalTime *temp_time;
+		gint temp_int;
+		ECalComponentText* temp_comptext;
+
+		line = g_string_new ("");
+
+		/* Getting the stuff */
+		temp_constchar = e_cal_component_get_uid (comp);
+		line = add_string_to_csv (line, temp_constchar, config);
+
+		temp_comptext = e_cal_component_get_summary (comp);
+		line = add_string_to_csv (
+			line, temp_comptext ? e_cal_component_text_get_value (temp_comptext) : NULL, config);
+		e_cal_component_text_free (temp_comptext);
+
+		temp_list = e_cal_component_get_descriptions (comp);
+		line = add_list_to_csv (
+			line, temp_list, config, ECALCOMPONENTTEXT);
+		g_slist_free_full (temp_list, e_cal_component_text_free);
+
+		temp_list = e_cal_component_get_categories_list (comp);
+		line = add_list_to_csv (
+			line, temp_list, config, CONSTCHAR);
+		g_slist_free_full (temp_list, g_free);
+
+		temp_list = e_cal_component_get_comments (comp);
+		line = add_list_to_csv (
+			line, temp_list, config, ECALCOMPONENTTEXT);
+		g_slist_free_full (temp_list, e_cal_component_text_free);
+
+		temp_time = e_cal_component_get_completed (comp);
+		line = add_time_to_csv (line, temp_time, config);
+		g_clear_object (&temp_time);
+
+		temp_time = e_cal_component_get_created (comp);
+		line = add_time_to_csv (line, temp_time, config);
+		g_clear_object (&temp_time);
+
+		temp_list = e_cal_component_get_contacts (comp);
+		line = add_list_to_csv (
+			line, temp_list, config, ECALCOMPONENTTEXT);
+		g_slist_free_full (temp_list, e_cal_component_text_free);
+
+		temp_dt = e_cal_component_get_dtstart (comp);
+		line = add_time_to_csv (
+			line, temp_dt && e_cal_component_datetime_get_value (temp_dt) ?
+			e_cal_component_datetime_get_value (temp_dt) : NULL, config);
+		e_cal_component_datetime_free (temp_dt);
+
+		temp_dt = e_cal_component_get_dtend (comp);
+		line = add_time_to_csv (
+			line, temp_dt && e_cal_component_datetime_get_value (temp_dt) ?
+			e_cal_component_datetime_get_value (temp_dt) : NULL, config);
+		e_cal_component_datetime_free (temp_dt);
+
+		temp_dt = e_cal_component_get_due (comp);
+		line = add_time_to_csv (
+			line, temp_dt && e_cal_component_datetime_get_value (temp_dt) ?
+			e_cal_component_datetime_get_value (temp_dt) : NULL, config);
+		e_cal_component_datetime_free (temp_dt);
+
+		temp_int = e_cal_component_get_percent_complete (comp);
+		line = add_nummeric_to_csv (line, temp_int, config);
+
+		temp_int = e_cal_component_get_priority (comp);
+		line = add_nummeric_to_csv (line, temp_int, config);
+
+		temp_char = e_cal_component_get_url (comp);
+		line = add_string_to_csv (line, temp_char, config);
+		g_free (temp_char);
+
+		if (e_cal_component_has_attendees (comp)) {
+			temp_list = e_cal_component_get_attendees (comp);
+			line = add_list_to_csv (
+				line, temp_list, config,
+				ECALCOMPONENTATTENDEE);
+			g_slist_free_full (temp_list, e_cal_component_attendee_free);
+		} else {
+			line = add_list_to_csv (
+				line, NULL, config,
+				ECALCOMPONENTATTENDEE);
+		}
+
+		temp_char = e_cal_component_get_location (comp);
+		line = add_string_to_csv (line, temp_char, config);
+		g_free (temp_char);
+
+		temp_time = e_cal_component_get_last_modified (comp);
+
+		/* Append a newline (record delimiter) */
+		delimiter_temp = config->delimiter;
+		config->delimiter = config->newline;
+
+		line = add_time_to_csv (line, temp_time, config);
+		g_clear_object (&temp_time);
+
+		/* And restore for the next record */
+		config->delimiter = delimiter_temp;
+
+		success = g_output_stream_write_all (
+			stream, line->str, line->len,
+			NULL, cancellable, error);
+
+		/* It's written, so we can free it */
+		g_string_free (line, TRUE);
+
+		/* and also the component, the list can be large */
+		g_clear_object (&iter->data);
+
+		save_calendar_report_progress (cancellable, ++done, total);
+	}
+
+	e_util_free_nullable_object_slist (objects);
+
+	return success;
+}
+
 static void
 do_save_calendar_csv (FormatHandler *handler,
+		      EShellView *shell_view,
                       ESourceSelector *selector,
 		      EClientCache *client_cache,
                       gchar *dest_uri)
@@ -303,12 +485,6 @@ do_save_calendar_csv (FormatHandler *handler,
 	 * http://www.creativyst.com/cgi-bin/Prod/15/eg/csv2xml.pl
 	 */
 
-	ESource *primary_source;
-	EClient *source_client;
-	GError *error = NULL;
-	GSList *objects = NULL;
-	GOutputStream *stream;
-	GString *line = NULL;
 	CsvConfig *config = NULL;
 	CsvPluginData *d = handler->data;
 	const gchar *tmp = NULL;
@@ -316,25 +492,6 @@ do_save_calendar_csv (FormatHandler *handler,
 	if (!dest_uri)
 		return;
 
-	/* open source client */
-	primary_source = e_source_selector_ref_primary_selection (selector);
-	source_client = e_client_cache_get_client_sync (client_cache,
-		primary_source, e_source_selector_get_extension_name (selector), 30, NULL, &error);
-	g_object_unref (primary_source);
-
-	/* Sanity check. */
-	g_return_if_fail (
-		((source_client != NULL) && (error == NULL)) ||
-		((source_client == NULL) && (error != NULL)));
-
-	if (source_client == NULL) {
-		display_error_message (
-			gtk_widget_get_toplevel (GTK_WIDGET (selector)),
-			error);
-		g_error_free (error);
-		return;
-	}
-
 	config = g_new (CsvConfig, 1);
 
 	tmp = gtk_entry_get_text (GTK_ENTRY (d->delimiter_entry));
@@ -346,187 +503,8 @@ do_save_calendar_csv (FormatHandler *handler,
 	config->header = gtk_toggle_button_get_active (
 		GTK_TOGGLE_BUTTON (d->header_check));
 
-	stream = open_for_writing (
-		GTK_WINDOW (gtk_widget_get_toplevel (GTK_WIDGET (selector))),
-		dest_uri, &error);
-
-	if (stream && e_cal_client_get_object_list_as_comps_sync (E_CAL_CLIENT (source_client), "#t", &objects, NULL, NULL)) {
-		GSList *iter;
-
-		if (config->header) {
-
-			gint i = 0;
-
-			static const gchar *labels[] = {
-				 N_("UID"),
-				 N_("Summary"),
-				 N_("Description List"),
-				 N_("Categories List"),
-				 N_("Comment List"),
-				 N_("Completed"),
-				 N_("Created"),
-				 N_("Contact List"),
-				 N_("Start"),
-				 N_("End"),
-				 N_("Due"),
-				 N_("percent Done"),
-				 N_("Priority"),
-				 N_("URL"),
-				 N_("Attendees List"),
-				 N_("Location"),
-				 N_("Modified"),
-			};
-
-			line = g_string_new ("");
-			for (i = 0; i < G_N_ELEMENTS (labels); i++) {
-				if (i > 0)
-					g_string_append (line, config->delimiter);
-				g_string_append (line, _(labels[i]));
-			}
-
-			g_string_append (line, config->newline);
-
-			g_output_stream_write_all (
-				stream, line->str, line->len,
-				NULL, NULL, NULL);
-			g_string_free (line, TRUE);
-		}
-
-		for (iter = objects; iter; iter = iter->next) {
-			ECalComponent *comp = iter->data;
-			gchar *delimiter_temp = NULL;
-			const gchar *temp_constchar;
-			gchar *temp_char;
-			GSList *temp_list;
-			ECalComponentDateTime* temp_dt;
-			ICalTime *temp_time;
-			gint temp_int;
-			ECalComponentText* temp_comptext;
-
-			line = g_string_new ("");
-
-			/* Getting the stuff */
-			temp_constchar = e_cal_component_get_uid (comp);
-			line = add_string_to_csv (line, temp_constchar, config);
-
-			temp_comptext = e_cal_component_get_summary (comp);
-			line = add_string_to_csv (
-				line, temp_comptext ? e_cal_component_text_get_value (temp_comptext) : NULL, config);
-			e_cal_component_text_free (temp_comptext);
-
-			temp_list = e_cal_component_get_descriptions (comp);
-			line = add_list_to_csv (
-				line, temp_list, config, ECALCOMPONENTTEXT);
-			g_slist_free_full (temp_list, e_cal_component_text_free);
-
-			temp_list = e_cal_component_get_categories_list (comp);
-			line = add_list_to_csv (
-				line, temp_list, config, CONSTCHAR);
-			g_slist_free_full (temp_list, g_free);
-
-			temp_list = e_cal_component_get_comments (comp);
-			line = add_list_to_csv (
-				line, temp_list, config, ECALCOMPONENTTEXT);
-			g_slist_free_full (temp_list, e_cal_component_text_free);
-
-			temp_time = e_cal_component_get_completed (comp);
-			line = add_time_to_csv (line, temp_time, config);
-			g_clear_object (&temp_time);
-
-			temp_time = e_cal_component_get_created (comp);
-			line = add_time_to_csv (line, temp_time, config);
-			g_clear_object (&temp_time);
-
-			temp_list = e_cal_component_get_contacts (comp);
-			line = add_list_to_csv (
-				line, temp_list, config, ECALCOMPONENTTEXT);
-			g_slist_free_full (temp_list, e_cal_component_text_free);
-
-			temp_dt = e_cal_component_get_dtstart (comp);
-			line = add_time_to_csv (
-				line, temp_dt && e_cal_component_datetime_get_value (temp_dt) ?
-				e_cal_component_datetime_get_value (temp_dt) : NULL, config);
-			e_cal_component_datetime_free (temp_dt);
-
-			temp_dt = e_cal_component_get_dtend (comp);
-			line = add_time_to_csv (
-				line, temp_dt && e_cal_component_datetime_get_value (temp_dt) ?
-				e_cal_component_datetime_get_value (temp_dt) : NULL, config);
-			e_cal_component_datetime_free (temp_dt);
-
-			temp_dt = e_cal_component_get_due (comp);
-			line = add_time_to_csv (
-				line, temp_dt && e_cal_component_datetime_get_value (temp_dt) ?
-				e_cal_component_datetime_get_value (temp_dt) : NULL, config);
-			e_cal_component_datetime_free (temp_dt);
-
-			temp_int = e_cal_component_get_percent_complete (comp);
-			line = add_nummeric_to_csv (line, temp_int, config);
-
-			temp_int = e_cal_component_get_priority (comp);
-			line = add_nummeric_to_csv (line, temp_int, config);
-
-			temp_char = e_cal_component_get_url (comp);
-			line = add_string_to_csv (line, temp_char, config);
-			g_free (temp_char);
-
-			if (e_cal_component_has_attendees (comp)) {
-				temp_list = e_cal_component_get_attendees (comp);
-				line = add_list_to_csv (
-					line, temp_list, config,
-					ECALCOMPONENTATTENDEE);
-				g_slist_free_full (temp_list, e_cal_component_attendee_free);
-			} else {
-				line = add_list_to_csv (
-					line, NULL, config,
-					ECALCOMPONENTATTENDEE);
-			}
-
-			temp_char = e_cal_component_get_location (comp);
-			line = add_string_to_csv (line, temp_char, config);
-			g_free (temp_char);
-
-			temp_time = e_cal_component_get_last_modified (comp);
-
-			/* Append a newline (record delimiter) */
-			delimiter_temp = config->delimiter;
-			config->delimiter = config->newline;
-
-			line = add_time_to_csv (line, temp_time, config);
-			g_clear_object (&temp_time);
-
-			/* And restore for the next record */
-			config->delimiter = delimiter_temp;
-
-			g_output_stream_write_all (
-				stream, line->str, line->len,
-				NULL, NULL, &error);
-
-			/* It's written, so we can free it */
-			g_string_free (line, TRUE);
-		}
-
-		g_output_stream_close (stream, NULL, NULL);
-
-		e_util_free_nullable_object_slist (objects);
-	}
-
-	if (stream)
-		g_object_unref (stream);
-
-	g_object_unref (source_client);
-
-	g_free (config->delimiter);
-	g_free (config->quote);
-	g_free (config->newline);
-	g_free (config);
-
-	if (error != NULL) {
-		display_error_message (
-			gtk_widget_get_toplevel (GTK_WIDGET (selector)),
-			error);
-		g_error_free (error);
-	}
+	save_calendar_submit_job (shell_view, selector, client_cache, dest_uri,
+		write_calendar_csv, config, csv_config_free);
 }
 
 static GtkWidget *
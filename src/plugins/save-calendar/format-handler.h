@@ -23,6 +23,7 @@
 #include <libecal/libecal.h>
 
 #include <e-util/e-util.h>
+#include <shell/e-shell-view.h>
 #include <calendar/gui/itip-utils.h>
 
 typedef struct _FormatHandler FormatHandler;
@@ -37,6 +38,7 @@ struct _FormatHandler
 	gpointer data;
 
 	void	(*save)		(FormatHandler *handler,
+				 EShellView *shell_view,
 				 ESourceSelector *selector,
 				 EClientCache *client_cache,
 				 gchar *dest_uri);
@@ -47,3 +49,21 @@ FormatHandler *ical_format_handler_new (void);
 FormatHandler *rdf_format_handler_new (void);
 
 GOutputStream *open_for_writing (GtkWindow *parent, const gchar *uri, GError **error);
+
+/* Writes the content of the @client into the @stream; runs in a dedicated thread */
+typedef gboolean (* SaveCalendarWriteFunc) (ECalClient *client,
+					    GOutputStream *stream,
+					    gpointer user_data,
+					    GCancellable *cancellable,
+					    GError **error);
+
+void save_calendar_submit_job (EShellView *shell_view,
+			       ESourceSelector *selector,
+			       EClientCache *client_cache,
+			       const gchar *dest_uri,
+			       SaveCalendarWriteFunc write_func,
+			       gpointer user_data,
+			       GDestroyNotify free_user_data);
+void save_calendar_report_progress (GCancellable *cancellable,
+				    guint done,
+				    guint total);
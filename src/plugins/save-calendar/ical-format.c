@@ -27,23 +27,10 @@
 
 #include "format-handler.h"
 
-static void
-display_error_message (GtkWidget *parent,
-                       const gchar *message)
-{
-	GtkWidget *dialog;
-
-	dialog = gtk_message_dialog_new (
-		GTK_WINDOW (parent), 0,
-		GTK_MESSAGE_ERROR, GTK_BUTTONS_CLOSE,
-		"%s", message);
-	gtk_dialog_run (GTK_DIALOG (dialog));
-	gtk_widget_destroy (dialog);
-}
-
 typedef struct {
 	GHashTable *zones;
 	ECalClient *client;
+	GCancellable *cancellable;
 } CompTzData;
 
 static void
@@ -58,10 +45,10 @@ insert_tz_comps (ICalParameter *param,
 
 	tzid = i_cal_parameter_get_tzid (param);
 
-	if (g_hash_table_lookup (tdata->zones, tzid))
+	if (!tzid || g_hash_table_contains (tdata->zones, tzid))
 		return;
 
-	if (!e_cal_client_get_timezone_sync (tdata->client, tzid, &zone, NULL, &error))
+	if (!e_cal_client_get_timezone_sync (tdata->client, tzid, &zone, tdata->cancellable, &error))
 		zone = NULL;
 
 	if (error != NULL) {
@@ -73,103 +60,103 @@ insert_tz_comps (ICalParameter *param,
 	}
 
 	tzcomp = i_cal_component_clone (i_cal_timezone_get_component (zone));
-	g_hash_table_insert (tdata->zones, (gpointer) tzid, (gpointer) tzcomp);
+	g_hash_table_insert (tdata->zones, g_strdup (tzid), tzcomp);
 }
 
-static void
-append_tz_to_comp (gpointer key,
-		   gpointer value,
-		   ICalComponent *toplevel)
+static gboolean
+write_ical_component (GOutputStream *stream,
+		      ICalComponent *icomp,
+		      GCancellable *cancellable,
+		      GError **error)
 {
-	i_cal_component_add_component (toplevel, (ICalComponent *) value);
-}
+	gchar *ical_str;
+	gboolean success;
 
-static void
-do_save_calendar_ical (FormatHandler *handler,
-                       ESourceSelector *selector,
-		       EClientCache *client_cache,
-                       gchar *dest_uri)
-{
-	ESource *primary_source;
-	EClient *source_client;
-	GError *error = NULL;
-	GSList *objects = NULL;
-	ICalComponent *top_level = NULL;
-
-	if (!dest_uri)
-		return;
+	ical_str = i_cal_component_as_ical_string (icomp);
+	success = g_output_stream_write_all (stream, ical_str, strlen (ical_str), NULL, cancellable, error);
+	g_free (ical_str);
 
-	/* open source client */
-	primary_source = e_source_selector_ref_primary_selection (selector);
-	source_client = e_client_cache_get_client_sync (client_cache,
-		primary_source, e_source_selector_get_extension_name (selector), 30, NULL, &error);
-	g_object_unref (primary_source);
-
-	/* Sanity check. */
-	g_return_if_fail (
-		((source_client != NULL) && (error == NULL)) ||
-		((source_client == NULL) && (error != NULL)));
+	return success;
+}
 
-	if (error != NULL) {
-		display_error_message (
-			gtk_widget_get_toplevel (GTK_WIDGET (selector)),
-			error->message);
-		g_error_free (error);
-		return;
+/* Writes the VCALENDAR piece by piece: the VTIMEZONE-s first, then
+ * one component at a time, instead of building the whole calendar
+ * in memory and serializing it into one string. */
+static gboolean
+write_calendar_ical (ECalClient *client,
+		     GOutputStream *stream,
+		     gpointer user_data,
+		     GCancellable *cancellable,
+		     GError **error)
+{
+	CompTzData tdata;
+	ICalComponent *top_level;
+	GHashTableIter iter;
+	GSList *objects = NULL, *link;
+	gpointer value;
+	gchar *ical_str, *end;
+	guint done = 0, total;
+	gboolean success;
+
+	if (!e_cal_client_get_object_list_sync (client, "#t", &objects, cancellable, error))
+		return FALSE;
+
+	tdata.zones = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+	tdata.client = client;
+	tdata.cancellable = cancellable;
+
+	for (link = objects; link && !g_cancellable_is_cancelled (cancellable); link = g_slist_next (link)) {
+		i_cal_component_foreach_tzid (link->data, insert_tz_comps, &tdata);
 	}
 
-	/* create destination file */
+	/* Write the top-level properties without the closing line */
 	top_level = e_cal_util_new_top_level ();
+	ical_str = i_cal_component_as_ical_string (top_level);
+	end = strstr (ical_str, "END:VCALENDAR");
 
-	e_cal_client_get_object_list_sync (
-		E_CAL_CLIENT (source_client), "#t", &objects, NULL, &error);
-
-	if (objects != NULL) {
-		CompTzData tdata;
-		GOutputStream *stream;
-		GSList *iter;
-
-		tdata.zones = g_hash_table_new (g_str_hash, g_str_equal);
-		tdata.client = E_CAL_CLIENT (source_client);
+	success = !g_cancellable_set_error_if_cancelled (cancellable, error) &&
+		g_output_stream_write_all (stream, ical_str, end ? end - ical_str : strlen (ical_str), NULL, cancellable, error);
 
-		for (iter = objects; iter; iter = iter->next) {
-			ICalComponent *icomp = i_cal_component_clone (iter->data);
+	g_free (ical_str);
+	g_object_unref (top_level);
 
-			i_cal_component_foreach_tzid (icomp, insert_tz_comps, &tdata);
-			i_cal_component_take_component (top_level, icomp);
-		}
+	g_hash_table_iter_init (&iter, tdata.zones);
+	while (success && g_hash_table_iter_next (&iter, NULL, &value)) {
+		success = write_ical_component (stream, value, cancellable, error);
+	}
 
-		g_hash_table_foreach (tdata.zones, (GHFunc) append_tz_to_comp, top_level);
+	total = g_slist_length (objects);
 
-		g_hash_table_destroy (tdata.zones);
-		tdata.zones = NULL;
+	for (link = objects; success && link; link = g_slist_next (link)) {
+		success = write_ical_component (stream, link->data, cancellable, error);
 
-		/* save the file */
-		stream = open_for_writing (GTK_WINDOW (gtk_widget_get_toplevel (GTK_WIDGET (selector))), dest_uri, &error);
+		/* Release what is written, the list can be large */
+		g_clear_object (&link->data);
 
-		if (stream) {
-			gchar *ical_str = i_cal_component_as_ical_string (top_level);
+		save_calendar_report_progress (cancellable, ++done, total);
+	}
 
-			g_output_stream_write_all (stream, ical_str, strlen (ical_str), NULL, NULL, &error);
-			g_output_stream_close (stream, NULL, NULL);
+	if (success)
+		success = g_output_stream_write_all (stream, "END:VCALENDAR\r\n", 15, NULL, cancellable, error);
 
-			g_object_unref (stream);
-			g_free (ical_str);
-		}
+	g_hash_table_destroy (tdata.zones);
+	e_util_free_nullable_object_slist (objects);
 
-		e_util_free_nullable_object_slist (objects);
-	}
+	return success;
+}
 
-	if (error != NULL) {
-		display_error_message (
-			gtk_widget_get_toplevel (GTK_WIDGET (selector)),
-			error->message);
-		g_error_free (error);
-	}
+static void
+do_save_calendar_ical (FormatHandler *handler,
+		       EShellView *shell_view,
+                       ESourceSelector *selector,
+		       EClientCache *client_cache,
+                       gchar *dest_uri)
+{
+	if (!dest_uri)
+		return;
 
-	/* terminate */
-	g_object_unref (source_client);
-	g_object_unref (top_level);
+	save_calendar_submit_job (shell_view, selector, client_cache, dest_uri,
+		write_calendar_ical, NULL, NULL);
 }
 
 FormatHandler *
@@ -170,6 +170,7 @@ add_string_to_rdf (xmlNodePtr node,
 
 static void
 do_save_calendar_rdf (FormatHandler *handler,
+		      EShellView *shell_view,
                       ESourceSelector *selector,
 		      EClientCache *client_cache,
                       gchar *dest_uri)
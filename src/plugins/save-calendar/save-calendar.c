@@ -107,7 +107,8 @@ format_handlers_foreach_free (gpointer data)
 }
 
 static void
-ask_destination_and_save (ESourceSelector *selector,
+ask_destination_and_save (EShellView *shell_view,
+			  ESourceSelector *selector,
 			  EClientCache *client_cache)
 {
 	FormatHandler *handler = NULL;
@@ -219,7 +220,7 @@ ask_destination_and_save (ESourceSelector *selector,
 				dest_uri = temp;
 			}
 
-			handler->save (handler, selector, client_cache, dest_uri);
+			handler->save (handler, shell_view, selector, client_cache, dest_uri);
 		} else {
 			g_warn_if_reached ();
 		}
@@ -289,6 +290,157 @@ open_for_writing (GtkWindow *parent,
 	return NULL;
 }
 
+typedef struct _SaveJobData {
+	EClientCache *client_cache;
+	ESource *source;
+	gchar *extension_name;
+	GOutputStream *stream;
+	SaveCalendarWriteFunc write_func;
+	gpointer user_data;
+	GDestroyNotify free_user_data;
+} SaveJobData;
+
+static void
+save_job_data_free (gpointer ptr)
+{
+	SaveJobData *sjd = ptr;
+
+	if (sjd) {
+		if (sjd->free_user_data)
+			sjd->free_user_data (sjd->user_data);
+
+		g_clear_object (&sjd->client_cache);
+		g_clear_object (&sjd->source);
+		g_clear_object (&sjd->stream);
+		g_free (sjd->extension_name);
+		g_slice_free (SaveJobData, sjd);
+	}
+}
+
+static void
+save_calendar_thread (EAlertSinkThreadJobData *job_data,
+		      gpointer user_data,
+		      GCancellable *cancellable,
+		      GError **error)
+{
+	SaveJobData *sjd = user_data;
+	EClient *client;
+	gboolean success = FALSE;
+
+	g_return_if_fail (sjd != NULL);
+
+	client = e_client_cache_get_client_sync (sjd->client_cache,
+		sjd->source, sjd->extension_name, 30, cancellable, error);
+
+	if (client) {
+		GOutputStream *buffered;
+
+		/* The writers produce many small chunks; do not pass each
+		 * of them to the (possibly remote) file separately. */
+		buffered = g_buffered_output_stream_new_sized (sjd->stream, 64 * 1024);
+		g_filter_output_stream_set_close_base_stream (G_FILTER_OUTPUT_STREAM (buffered), FALSE);
+
+		success = sjd->write_func (E_CAL_CLIENT (client), buffered, sjd->user_data, cancellable, error) &&
+			g_output_stream_close (buffered, cancellable, error);
+
+		g_object_unref (buffered);
+		g_object_unref (client);
+	}
+
+	if (success) {
+		g_output_stream_close (sjd->stream, cancellable, error);
+	} else {
+		GCancellable *abort_cancellable;
+
+		/* Closing with a cancelled cancellable makes the stream
+		 * drop the replacement instead of committing it. */
+		abort_cancellable = g_cancellable_new ();
+		g_cancellable_cancel (abort_cancellable);
+		g_output_stream_close (sjd->stream, abort_cancellable, NULL);
+		g_object_unref (abort_cancellable);
+	}
+}
+
+/* Opens the @dest_uri for writing, asking whether to overwrite it when
+ * it exists, and then runs the @write_func in a dedicated thread, with
+ * the progress and the cancellation shown in the @shell_view. The
+ * @free_user_data is called on the @user_data in any case. */
+void
+save_calendar_submit_job (EShellView *shell_view,
+			  ESourceSelector *selector,
+			  EClientCache *client_cache,
+			  const gchar *dest_uri,
+			  SaveCalendarWriteFunc write_func,
+			  gpointer user_data,
+			  GDestroyNotify free_user_data)
+{
+	SaveJobData *sjd;
+	ESource *primary_source;
+	EActivity *activity;
+	GOutputStream *stream;
+	GtkWidget *toplevel;
+	GFile *file;
+	gchar *display_name, *description;
+	GError *error = NULL;
+
+	g_return_if_fail (E_IS_SHELL_VIEW (shell_view));
+	g_return_if_fail (E_IS_SOURCE_SELECTOR (selector));
+	g_return_if_fail (dest_uri != NULL);
+	g_return_if_fail (write_func != NULL);
+
+	toplevel = gtk_widget_get_toplevel (GTK_WIDGET (selector));
+	file = g_file_new_for_uri (dest_uri);
+	display_name = g_file_get_parse_name (file);
+	g_object_unref (file);
+
+	stream = open_for_writing (GTK_WINDOW (toplevel), dest_uri, &error);
+
+	if (!stream) {
+		if (error) {
+			e_alert_run_dialog_for_args (
+				GTK_WINDOW (toplevel), "system:no-save-file",
+				display_name, error->message, NULL);
+			g_error_free (error);
+		}
+
+		if (free_user_data)
+			free_user_data (user_data);
+		g_free (display_name);
+		return;
+	}
+
+	primary_source = e_source_selector_ref_primary_selection (selector);
+
+	sjd = g_slice_new0 (SaveJobData);
+	sjd->client_cache = g_object_ref (client_cache);
+	sjd->source = primary_source;
+	sjd->extension_name = g_strdup (e_source_selector_get_extension_name (selector));
+	sjd->stream = stream;
+	sjd->write_func = write_func;
+	sjd->user_data = user_data;
+	sjd->free_user_data = free_user_data;
+
+	description = g_strdup_printf (_("Saving “%s”"), e_source_get_display_name (primary_source));
+
+	activity = e_shell_view_submit_thread_job (shell_view, description,
+		"system:no-save-file", display_name, save_calendar_thread,
+		sjd, save_job_data_free);
+
+	g_clear_object (&activity);
+	g_free (description);
+	g_free (display_name);
+}
+
+/* Updates the job progress, but only when the percentage changes */
+void
+save_calendar_report_progress (GCancellable *cancellable,
+			       guint done,
+			       guint total)
+{
+	if (total > 0 && done > 0 && done * 100 / total != (done - 1) * 100 / total)
+		camel_operation_progress (cancellable, done * 100 / total);
+}
+
 static void
 save_general (EShellView *shell_view)
 {
@@ -303,7 +455,7 @@ save_general (EShellView *shell_view)
 	g_object_get (shell_sidebar, "selector", &selector, NULL);
 	g_return_if_fail (selector != NULL);
 
-	ask_destination_and_save (selector, e_shell_get_client_cache (shell));
+	ask_destination_and_save (shell_view, selector, e_shell_get_client_cache (shell));
 
 	g_object_unref (selector);
 }